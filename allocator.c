@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+
+// The header is as large as the strictest alignment of the types it could be in front of, so blocks stay aligned.
+typedef union AllocatorHeader {
+    struct {
+        size_t size;
+        AllocatorTag tag;
+    } block;
+    long double align_float;
+    long long align_int;
+    void *align_ptr;
+} AllocatorHeader;
+
+typedef struct AllocatorStats {
+    unsigned long long allocations;
+    unsigned long long bytes;
+    unsigned long long live;
+    unsigned long long peak;
+} AllocatorStats;
+
+static AllocatorStats allocator_stats[ALLOCATOR_TAG_COUNT];
+static unsigned long long allocator_live;
+static unsigned long long allocator_peak;
+
+static const char *allocator_tag_names[ALLOCATOR_TAG_COUNT] = {
+    "string_cache", "string_builder", "lexer", "parser", "typecheck", "optimize", "regex", "codegen", "diagnostics", "lsp"
+};
+
+// Growing a block with realloc counts its new size as allocated bytes, but not as another allocation.
+static void allocator_count(AllocatorTag tag, size_t size, bool allocation) {
+    AllocatorStats *stats = allocator_stats + tag;
+    stats->allocations += allocation;
+    stats->bytes += size;
+    stats->live += size;
+    if (stats->live > stats->peak) stats->peak = stats->live;
+    allocator_live += size;
+    if (allocator_live > allocator_peak) allocator_peak = allocator_live;
+}
+
+static void allocator_uncount(AllocatorHeader *header) {
+    allocator_stats[header->block.tag].live -= header->block.size;
+    allocator_live -= header->block.size;
+}
+
+static void allocator_out_of_memory(void) {
+    fprintf(stderr, "The compiler ran out of memory.\n");
+    exit(EXIT_FAILURE);
+}
+
+void *allocator_malloc(AllocatorTag tag, size_t size) {
+    AllocatorHeader *header = malloc(sizeof(AllocatorHeader) + size);
+    if (!header) allocator_out_of_memory();
+    header->block.size = size;
+    header->block.tag = tag;
+    allocator_count(tag, size, true);
+    return header + 1;
+}
+
+void *allocator_calloc(AllocatorTag tag, size_t count, size_t size) {
+    void *block = allocator_malloc(tag, count * size);
+    memset(block, 0, count * size);
+    return block;
+}
+
+void *allocator_realloc(AllocatorTag tag, void *block, size_t size) {
+    if (!block) return allocator_malloc(tag, size);
+    AllocatorHeader *header = (AllocatorHeader *) block - 1;
+    allocator_uncount(header);
+    header = realloc(header, sizeof(AllocatorHeader) + size);
+    if (!header) allocator_out_of_memory();
+    header->block.size = size;
+    allocator_count(header->block.tag, size, false);
+    return header + 1;
+}
+
+void allocator_free(void *block) {
+    if (!block) return;
+    AllocatorHeader *header = (AllocatorHeader *) block - 1;
+    allocator_uncount(header);
+    free(header);
+}
+
+const char *allocator_tag_name(AllocatorTag tag) {
+    return allocator_tag_names[tag];
+}
+
+unsigned long long allocator_live_bytes(AllocatorTag tag) {
+    return allocator_stats[tag].live;
+}
+
+void allocator_report(FILE *outfile, unsigned long long source_bytes) {
+    fprintf(outfile, "%-15s %12s %14s %14s %14s\n", "subsystem", "allocations", "bytes", "live bytes", "peak bytes");
+    AllocatorStats total = { 0 };
+    for (int i = 0; i < ALLOCATOR_TAG_COUNT; i++) {
+        AllocatorStats *stats = allocator_stats + i;
+        fprintf(outfile, "%-15s %12llu %14llu %14llu %14llu\n", allocator_tag_names[i], stats->allocations, stats->bytes, stats->live, stats->peak);
+        total.allocations += stats->allocations;
+        total.bytes += stats->bytes;
+    }
+    fprintf(outfile, "%-15s %12llu %14llu %14llu %14llu\n", "total", total.allocations, total.bytes, allocator_live, allocator_peak);
+    if (source_bytes > 0) fprintf(outfile, "The peak is %.1f times the %llu bytes of the source.\n", (double) allocator_peak / source_bytes, source_bytes);
+}
+
+bool allocator_leak_check(FILE *outfile) {
+    if (allocator_live == 0) return true;
+    fprintf(outfile, "%llu bytes were never freed:\n", allocator_live);
+    for (int i = 0; i < ALLOCATOR_TAG_COUNT; i++) {
+        if (allocator_stats[i].live > 0) fprintf(outfile, "%-15s %14llu\n", allocator_tag_names[i], allocator_stats[i].live);
+    }
+    return false;
+}
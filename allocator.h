@@ -0,0 +1,40 @@
+#ifndef CREED_ALLOCATOR_H
+#define CREED_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Every allocation of the compiler is counted under the subsystem that made it.
+typedef enum AllocatorTag {
+    ALLOCATOR_STRING_CACHE,
+    ALLOCATOR_STRING_BUILDER,
+    ALLOCATOR_LEXER,
+    ALLOCATOR_PARSER, // The syntax tree, including the copies the typechecker and optimizations make of parts of it.
+    ALLOCATOR_TYPECHECK,
+    ALLOCATOR_OPTIMIZE,
+    ALLOCATOR_REGEX,
+    ALLOCATOR_CODEGEN,
+    ALLOCATOR_DIAGNOSTICS,
+    ALLOCATOR_LSP,
+    ALLOCATOR_TAG_COUNT
+} AllocatorTag;
+
+// The same as malloc, calloc, realloc and free, but every block has a header with its size and tag in front of it,
+// so blocks from these have to be freed with allocator_free, and nothing else can be. A block keeps the tag it was first allocated with.
+void *allocator_malloc(AllocatorTag tag, size_t size);
+void *allocator_calloc(AllocatorTag tag, size_t count, size_t size);
+void *allocator_realloc(AllocatorTag tag, void *block, size_t size);
+void allocator_free(void *block);
+
+const char *allocator_tag_name(AllocatorTag tag);
+unsigned long long allocator_live_bytes(AllocatorTag tag);
+
+// Writes the number of allocations, the bytes allocated, and the live and peak live bytes of every tag,
+// and how the peak compares to the size of the source.
+void allocator_report(FILE *outfile, unsigned long long source_bytes);
+
+// Once everything has been freed, returns true if no bytes are live. Otherwise writes the live bytes of each tag and returns false.
+bool allocator_leak_check(FILE *outfile);
+
+#endif
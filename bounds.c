@@ -0,0 +1,534 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "bounds.h"
+#include "constant.h"
+#include "opt_util.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+#include "token.h"
+
+#define BOUNDS_PASS "bounds"
+
+// Something known about a loop counter inside the body of its loop: it is at least 0,
+// and below the count of array, or below limit if array is NULL.
+typedef struct BoundsFact {
+    Declaration *counter;
+    Declaration *array;
+    unsigned long long limit;
+} BoundsFact;
+
+typedef struct Bounds {
+    SourceFile *file;
+    DeclarationSet assigned; // Variables assigned as a whole somewhere in the program.
+    DeclarationSet address_taken; // Variables that could be changed through a pointer.
+
+    BoundsFact *facts;
+    int fact_count;
+    int fact_count_alloc;
+
+    int eliminated;
+    int retained;
+} Bounds;
+
+static Expr *bounds_unparen(Expr *expr) {
+    while (expr->type == EXPR_PAREN) expr = expr->data.parenthesized;
+    return expr;
+}
+
+// Returns the variable an lvalue is part of.
+static Declaration *bounds_lval_declaration(Expr *expr) {
+    while (true) {
+        switch (expr->type) {
+            case EXPR_PAREN: expr = expr->data.parenthesized; break;
+            case EXPR_ACCESS_MEMBER: expr = expr->data.access_member.operand; break;
+            case EXPR_ACCESS_ARRAY: expr = expr->data.access_array.operand; break;
+            case EXPR_ID: return expr->data.id.declaration;
+            default: return NULL;
+        }
+    }
+}
+
+static void bounds_collect_scope(DeclarationSet *assigned, DeclarationSet *address_taken, Scope *scope);
+
+static void bounds_collect_expr(DeclarationSet *address_taken, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            bounds_collect_expr(address_taken, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            if (expr->data.unary.type == EXPR_UNARY_REF) {
+                Declaration *decl = bounds_lval_declaration(expr->data.unary.operand);
+                if (decl) declaration_set_add(address_taken, decl);
+            }
+            bounds_collect_expr(address_taken, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            bounds_collect_expr(address_taken, expr->data.binary.lhs);
+            bounds_collect_expr(address_taken, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            bounds_collect_expr(address_taken, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            bounds_collect_expr(address_taken, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            bounds_collect_expr(address_taken, expr->data.access_array.operand);
+            bounds_collect_expr(address_taken, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            bounds_collect_expr(address_taken, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) bounds_collect_expr(address_taken, expr->data.function_call.params + i);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) bounds_collect_expr(address_taken, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) bounds_collect_expr(address_taken, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) bounds_collect_expr(address_taken, expr->data.file.args + i);
+            break;
+        case EXPR_FUNCTION:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void bounds_collect_statement(DeclarationSet *assigned, DeclarationSet *address_taken, Statement *statement) {
+    Expr *target = NULL;
+    switch (statement->type) {
+        case STATEMENT_DECLARATION: {
+            Declaration *decl = &statement->data.declaration;
+            if (decl->type != DECLARATION_VAR) break;
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+                Expr *value = &decl->data.var.data.constant.value;
+                if (value->type == EXPR_FUNCTION) bounds_collect_scope(assigned, address_taken, value->data.function.scope);
+                else bounds_collect_expr(address_taken, value);
+            } else if (decl->data.var.data.mutable.value_exists) {
+                bounds_collect_expr(address_taken, &decl->data.var.data.mutable.value);
+            }
+        } break;
+        case STATEMENT_INCREMENT:
+            target = &statement->data.increment;
+            break;
+        case STATEMENT_DEINCREMENT:
+            target = &statement->data.deincrement;
+            break;
+        case STATEMENT_ASSIGN:
+            target = &statement->data.assign.assignee;
+            bounds_collect_expr(address_taken, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            bounds_collect_expr(address_taken, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) bounds_collect_expr(address_taken, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+
+    if (target) {
+        // Assigning to an item or member doesn't change the count of an array.
+        Expr *assignee = bounds_unparen(target);
+        if (assignee->type == EXPR_ID) declaration_set_add(assigned, assignee->data.id.declaration);
+        bounds_collect_expr(address_taken, target);
+    }
+}
+
+static void bounds_collect_scope(DeclarationSet *assigned, DeclarationSet *address_taken, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            bounds_collect_statement(assigned, address_taken, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            bounds_collect_expr(address_taken, &scope->data.conditional.condition);
+            bounds_collect_scope(assigned, address_taken, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) bounds_collect_scope(assigned, address_taken, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            bounds_collect_statement(assigned, address_taken, &scope->data.loop_for.init);
+            bounds_collect_expr(address_taken, &scope->data.loop_for.expr);
+            bounds_collect_statement(assigned, address_taken, &scope->data.loop_for.step);
+            bounds_collect_scope(assigned, address_taken, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            bounds_collect_expr(address_taken, &scope->data.loop_for_each.array);
+            bounds_collect_scope(assigned, address_taken, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            bounds_collect_expr(address_taken, &scope->data.loop_while.expr);
+            bounds_collect_scope(assigned, address_taken, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) bounds_collect_scope(assigned, address_taken, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            bounds_collect_expr(address_taken, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) bounds_collect_scope(assigned, address_taken, scope->data.match.cases[i].scopes + j);
+            }
+            break;
+    }
+}
+
+// Reads a constant integer that isn't negative.
+static bool bounds_constant(Expr *expr, unsigned long long *value) {
+    expr = bounds_unparen(expr);
+    if (!constant_is_folded(expr) || expr->type != EXPR_LITERAL) return false;
+    switch (expr->data.literal.type) {
+        case LITERAL_INT8:
+        case LITERAL_INT16:
+        case LITERAL_INT:
+        case LITERAL_INT64:
+            if ((long long) literal_get_bits(&expr->data.literal) < 0) return false;
+            // fall through
+        case LITERAL_UINT8:
+        case LITERAL_UINT16:
+        case LITERAL_UINT:
+        case LITERAL_UINT64:
+            *value = literal_get_bits(&expr->data.literal);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Type *bounds_declaration_type(Declaration *decl) {
+    if (decl->type != DECLARATION_VAR) return NULL;
+    if (decl->data.var.type == DECLARATION_VAR_MUTABLE) return &decl->data.var.data.mutable.type;
+    return &decl->data.var.data.constant.type;
+}
+
+static bool bounds_is_global(Bounds *bounds, Declaration *decl) {
+    return bounds->file->declarations <= decl && decl < bounds->file->declarations + bounds->file->declaration_count;
+}
+
+// The size of the array literal an array was declared with, if the array is never replaced by another one.
+static bool bounds_fixed_count(Bounds *bounds, Declaration *array, unsigned long long *count) {
+    if (array->type != DECLARATION_VAR || declaration_set_has(&bounds->assigned, array) || declaration_set_has(&bounds->address_taken, array)) return false;
+    Expr *value;
+    if (array->data.var.type == DECLARATION_VAR_CONSTANT) value = &array->data.var.data.constant.value;
+    else if (array->data.var.data.mutable.value_exists) value = &array->data.var.data.mutable.value;
+    else return false;
+
+    if (value->type != EXPR_LITERAL_ARRAY) return false;
+    return bounds_constant(value->data.literal_array.count, count);
+}
+
+static bool bounds_in_bounds(Bounds *bounds, Expr *expr) {
+    Expr *operand = bounds_unparen(expr->data.access_array.operand);
+    if (operand->type != EXPR_ID) return false;
+    Declaration *array = operand->data.id.declaration;
+    unsigned long long fixed_count;
+    bool fixed = bounds_fixed_count(bounds, array, &fixed_count);
+
+    Expr *index = bounds_unparen(expr->data.access_array.index);
+    unsigned long long constant;
+    if (bounds_constant(index, &constant)) return fixed && constant < fixed_count;
+    if (index->type != EXPR_ID) return false;
+
+    for (int i = bounds->fact_count - 1; i >= 0; i--) {
+        BoundsFact *fact = bounds->facts + i;
+        if (fact->counter != index->data.id.declaration) continue;
+        if (fact->array == array) return true;
+        if (!fact->array && fixed && fact->limit <= fixed_count) return true;
+    }
+    return false;
+}
+
+// The largest value of an integer type, as the emitted C has it.
+static unsigned long long bounds_type_max(TokenType primitive) {
+    switch (primitive) {
+        case TOKEN_KEYWORD_TYPE_INT8: return SCHAR_MAX;
+        case TOKEN_KEYWORD_TYPE_INT16: return SHRT_MAX;
+        case TOKEN_KEYWORD_TYPE_INT: return INT_MAX;
+        case TOKEN_KEYWORD_TYPE_INT64: return LLONG_MAX;
+        case TOKEN_KEYWORD_TYPE_UINT8: return UCHAR_MAX;
+        case TOKEN_KEYWORD_TYPE_UINT16: return USHRT_MAX;
+        case TOKEN_KEYWORD_TYPE_UINT: return UINT_MAX;
+        default: return ULLONG_MAX;
+    }
+}
+
+// Finds the bound in a condition counter < bound, where bound is array.count or a constant.
+// Casts of constants are folded, so a cast here is of a count. Only a cast to uint64, the type of a count, keeps every count.
+// Any other cast narrows it, to a value the counter could step over and overflow past, so the bound isn't trusted.
+static bool bounds_fact_from_bound(Bounds *bounds, Scope *body, Declaration *counter, Expr *bound, BoundsFact *fact) {
+    bound = bounds_unparen(bound);
+    while (bound->type == EXPR_TYPECAST && bound->data.typecast.cast_to.type == TYPE_PRIMITIVE
+            && bound->data.typecast.cast_to.data.primitive == TOKEN_KEYWORD_TYPE_UINT64) {
+        bound = bounds_unparen(bound->data.typecast.operand);
+    }
+
+    *fact = (BoundsFact) { .counter = counter };
+    if (bound->type == EXPR_LITERAL) {
+        // A negative limit means the loop never runs, so any limit works.
+        if (!bounds_constant(bound, &fact->limit)) fact->limit = 0;
+        return true;
+    }
+
+    if (bound->type != EXPR_ACCESS_MEMBER || strcmp(string_cache_get(bound->data.access_member.member), "count")) return false;
+    Expr *operand = bounds_unparen(bound->data.access_member.operand);
+    if (operand->type != EXPR_ID) return false;
+    Declaration *array = operand->data.id.declaration;
+    Type *type = bounds_declaration_type(array);
+    if (!type || type->type != TYPE_ARRAY || declaration_set_has(&bounds->address_taken, array)) return false;
+
+    // A call in the body could replace a global array.
+    if (bounds_is_global(bounds, array) && declaration_set_has(&bounds->assigned, array)) return false;
+    DeclarationSet assigned = {0};
+    DeclarationSet address_taken = {0};
+    bounds_collect_scope(&assigned, &address_taken, body);
+    bool replaced = declaration_set_has(&assigned, array);
+    declaration_set_free(&assigned);
+    declaration_set_free(&address_taken);
+    if (replaced) return false;
+
+    fact->array = array;
+    return true;
+}
+
+static void bounds_fact_push(Bounds *bounds, BoundsFact fact) {
+    bounds->fact_count++;
+    if (bounds->fact_count > bounds->fact_count_alloc) {
+        bounds->fact_count_alloc = bounds->fact_count_alloc == 0 ? 8 : bounds->fact_count_alloc * 2;
+        bounds->facts = allocator_realloc(ALLOCATOR_OPTIMIZE, bounds->facts, sizeof(BoundsFact) * bounds->fact_count_alloc);
+    }
+    bounds->facts[bounds->fact_count - 1] = fact;
+}
+
+// Every operand of a chain of && has to be true in the body, so each comparison with the counter is a fact.
+static void bounds_facts_from_condition(Bounds *bounds, Scope *body, Declaration *counter, Expr *condition) {
+    condition = bounds_unparen(condition);
+    if (condition->type != EXPR_BINARY) return;
+
+    Expr *lhs = bounds_unparen(condition->data.binary.lhs);
+    Expr *rhs = bounds_unparen(condition->data.binary.rhs);
+    Expr *bound = NULL;
+    switch (condition->data.binary.operator) {
+        case TOKEN_OP_LOGICAL_AND:
+            bounds_facts_from_condition(bounds, body, counter, lhs);
+            bounds_facts_from_condition(bounds, body, counter, rhs);
+            return;
+        case TOKEN_OP_LT:
+            if (lhs->type == EXPR_ID && lhs->data.id.declaration == counter) bound = rhs;
+            break;
+        case TOKEN_OP_GT:
+            if (rhs->type == EXPR_ID && rhs->data.id.declaration == counter) bound = lhs;
+            break;
+        default:
+            break;
+    }
+
+    BoundsFact fact;
+    if (bound && bounds_fact_from_bound(bounds, body, counter, bound, &fact)) bounds_fact_push(bounds, fact);
+}
+
+// Adds the facts a for loop guarantees in its body, if its counter starts at a constant that isn't negative and never goes down.
+// The counter also can't overflow, which holds when it would still fit in its type after stepping past one of its bounds.
+static void bounds_facts_from_loop(Bounds *bounds, Scope *scope) {
+    Statement *init = &scope->data.loop_for.init;
+    if (init->type != STATEMENT_DECLARATION || init->data.declaration.type != DECLARATION_VAR) return;
+    Declaration *counter = &init->data.declaration;
+    if (counter->data.var.type != DECLARATION_VAR_MUTABLE || !counter->data.var.data.mutable.value_exists) return;
+    Type *type = &counter->data.var.data.mutable.type;
+    if (type->type != TYPE_PRIMITIVE || type->data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN || TOKEN_KEYWORD_TYPE_INTEGER_MAX < type->data.primitive) return;
+    unsigned long long start;
+    if (!bounds_constant(&counter->data.var.data.mutable.value, &start)) return;
+    if (declaration_set_has(&bounds->address_taken, counter)) return;
+
+    Statement *step = &scope->data.loop_for.step;
+    unsigned long long increase = 1;
+    if (step->type == STATEMENT_INCREMENT) {
+        Expr *operand = bounds_unparen(&step->data.increment);
+        if (operand->type != EXPR_ID || operand->data.id.declaration != counter) return;
+    } else if (step->type == STATEMENT_ASSIGN && step->data.assign.type == TOKEN_ASSIGN_PLUS) {
+        Expr *assignee = bounds_unparen(&step->data.assign.assignee);
+        if (assignee->type != EXPR_ID || assignee->data.id.declaration != counter) return;
+        if (!bounds_constant(&step->data.assign.value, &increase)) return;
+    } else {
+        return;
+    }
+
+    DeclarationSet assigned = {0};
+    DeclarationSet address_taken = {0};
+    bounds_collect_scope(&assigned, &address_taken, scope->data.loop_for.scope);
+    bool changed = declaration_set_has(&assigned, counter);
+    declaration_set_free(&assigned);
+    declaration_set_free(&address_taken);
+    if (changed) return;
+
+    int fact_count = bounds->fact_count;
+    bounds_facts_from_condition(bounds, scope->data.loop_for.scope, counter, &scope->data.loop_for.expr);
+
+    // The counter is below the bound in the body, so the most it can be after a step is the bound - 1 + increase.
+    // A count is compared in the type of the counter, so it's at most the largest value of that type.
+    unsigned long long counter_max = bounds_type_max(type->data.primitive);
+    for (int i = fact_count; i < bounds->fact_count; i++) {
+        BoundsFact *fact = bounds->facts + i;
+        unsigned long long bound_max = fact->array ? counter_max : fact->limit;
+        if (increase == 0 || (bound_max <= counter_max && increase - 1 <= counter_max - bound_max)) return;
+    }
+    bounds->fact_count = fact_count;
+}
+
+static void bounds_visit_scope(Bounds *bounds, Scope *scope);
+
+static void bounds_visit_expr(Bounds *bounds, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            bounds_visit_expr(bounds, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            bounds_visit_expr(bounds, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            bounds_visit_expr(bounds, expr->data.binary.lhs);
+            bounds_visit_expr(bounds, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            bounds_visit_expr(bounds, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            bounds_visit_expr(bounds, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            if (expr->data.access_array.checked) {
+                if (bounds_in_bounds(bounds, expr)) {
+                    expr->data.access_array.checked = false;
+                    bounds->eliminated++;
+                    remark(expr->location, BOUNDS_PASS, "bounds check removed, the index is always in bounds");
+                } else {
+                    bounds->retained++;
+                    remark(expr->location, BOUNDS_PASS, "bounds check kept, the index could not be proven to be in bounds");
+                }
+            }
+            bounds_visit_expr(bounds, expr->data.access_array.operand);
+            bounds_visit_expr(bounds, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION: {
+            // Facts about the loops around a function don't hold inside of it.
+            int fact_count = bounds->fact_count;
+            bounds->fact_count = 0;
+            bounds_visit_scope(bounds, expr->data.function.scope);
+            bounds->fact_count = fact_count;
+        } break;
+        case EXPR_FUNCTION_CALL:
+            bounds_visit_expr(bounds, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) bounds_visit_expr(bounds, expr->data.function_call.params + i);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) bounds_visit_expr(bounds, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) bounds_visit_expr(bounds, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) bounds_visit_expr(bounds, expr->data.file.args + i);
+            break;
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void bounds_visit_statement(Bounds *bounds, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION: {
+            Declaration *decl = &statement->data.declaration;
+            if (decl->type != DECLARATION_VAR) break;
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) bounds_visit_expr(bounds, &decl->data.var.data.constant.value);
+            else if (decl->data.var.data.mutable.value_exists) bounds_visit_expr(bounds, &decl->data.var.data.mutable.value);
+        } break;
+        case STATEMENT_INCREMENT:
+            bounds_visit_expr(bounds, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            bounds_visit_expr(bounds, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            bounds_visit_expr(bounds, &statement->data.assign.assignee);
+            bounds_visit_expr(bounds, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            bounds_visit_expr(bounds, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) bounds_visit_expr(bounds, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+static void bounds_visit_scope(Bounds *bounds, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            bounds_visit_statement(bounds, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            bounds_visit_expr(bounds, &scope->data.conditional.condition);
+            bounds_visit_scope(bounds, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) bounds_visit_scope(bounds, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR: {
+            bounds_visit_statement(bounds, &scope->data.loop_for.init);
+            bounds_visit_expr(bounds, &scope->data.loop_for.expr);
+            bounds_visit_statement(bounds, &scope->data.loop_for.step);
+            int fact_count = bounds->fact_count;
+            bounds_facts_from_loop(bounds, scope);
+            bounds_visit_scope(bounds, scope->data.loop_for.scope);
+            bounds->fact_count = fact_count;
+        } break;
+        case SCOPE_LOOP_FOR_EACH:
+            bounds_visit_expr(bounds, &scope->data.loop_for_each.array);
+            bounds_visit_scope(bounds, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            bounds_visit_expr(bounds, &scope->data.loop_while.expr);
+            bounds_visit_scope(bounds, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) bounds_visit_scope(bounds, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            bounds_visit_expr(bounds, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) bounds_visit_scope(bounds, scope->data.match.cases[i].scopes + j);
+            }
+            break;
+    }
+}
+
+void bounds_check_eliminate(SourceFile *file) {
+    Bounds bounds = { .file = file };
+    for (int i = 0; i < file->declaration_count; i++) {
+        Statement statement = { .type = STATEMENT_DECLARATION, .data.declaration = file->declarations[i] };
+        bounds_collect_statement(&bounds.assigned, &bounds.address_taken, &statement);
+    }
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (decl->type != DECLARATION_VAR) continue;
+        if (decl->data.var.type == DECLARATION_VAR_CONSTANT) bounds_visit_expr(&bounds, &decl->data.var.data.constant.value);
+        else if (decl->data.var.data.mutable.value_exists) bounds_visit_expr(&bounds, &decl->data.var.data.mutable.value);
+    }
+    declaration_set_free(&bounds.assigned);
+    declaration_set_free(&bounds.address_taken);
+    allocator_free(bounds.facts);
+
+    remark_summary(BOUNDS_PASS, "%i of %i bounds checks removed, %i kept", bounds.eliminated, bounds.eliminated + bounds.retained, bounds.retained);
+}
@@ -0,0 +1,13 @@
+#ifndef CREED_BOUNDS_H
+#define CREED_BOUNDS_H
+
+#include "parser.h"
+
+// Array accesses are checked against the count of the array at runtime. This removes the checks on indices that are known to be in bounds:
+//  - a for loop counter that starts at a constant that isn't negative, only goes up, and is kept below the count of the array
+//    or below a constant no larger than the size of an array literal the array was declared with,
+//  - a constant index into an array declared with an array literal of a larger size.
+// for .. in loops never index their array, so they have no checks to begin with. Run this after typechecking.
+void bounds_check_eliminate(SourceFile *file);
+
+#endif
@@ -0,0 +1,298 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "call_graph.h"
+#include "parser.h"
+
+typedef struct CallGraphBuilder {
+    CallGraph *graph;
+    SourceFile *file;
+    int from;
+} CallGraphBuilder;
+
+int call_graph_index(CallGraph *graph, Declaration *decl) {
+    if (!decl || graph->node_count == 0) return -1;
+    Declaration *first = graph->nodes[0].decl;
+    if (decl < first || first + graph->node_count <= decl) return -1;
+    return (int) (decl - first);
+}
+
+static void call_graph_edge_add(CallGraphBuilder *builder, Declaration *decl) {
+    int to = call_graph_index(builder->graph, decl);
+    if (to < 0) return;
+
+    CallGraphNode *node = builder->graph->nodes + builder->from;
+    for (int i = 0; i < node->edge_count; i++) {
+        if (node->edges[i] == to) return;
+    }
+
+    node->edge_count++;
+    if (node->edge_count > node->edge_count_alloc) {
+        node->edge_count_alloc = node->edge_count_alloc == 0 ? 4 : node->edge_count_alloc * 2;
+        node->edges = allocator_realloc(ALLOCATOR_OPTIMIZE, node->edges, sizeof(int) * node->edge_count_alloc);
+    }
+    node->edges[node->edge_count - 1] = to;
+}
+
+static void call_graph_visit_scope(CallGraphBuilder *builder, Scope *scope);
+
+static void call_graph_visit_type(CallGraphBuilder *builder, Type *type) {
+    switch (type->type) {
+        case TYPE_PRIMITIVE:
+        case TYPE_VECTOR:
+            break;
+        case TYPE_ID:
+            call_graph_edge_add(builder, type->data.id.type_declaration);
+            break;
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+        case TYPE_ARRAY:
+            call_graph_visit_type(builder, type->data.sub_type);
+            break;
+        case TYPE_FUNCTION:
+            for (int i = 0; i < type->data.function.param_count; i++) {
+                call_graph_visit_type(builder, &type->data.function.params[i].type);
+            }
+            call_graph_visit_type(builder, type->data.function.result);
+            break;
+    }
+}
+
+static void call_graph_visit_expr(CallGraphBuilder *builder, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            call_graph_visit_expr(builder, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            call_graph_visit_expr(builder, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            call_graph_visit_expr(builder, expr->data.binary.lhs);
+            call_graph_visit_expr(builder, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            call_graph_visit_expr(builder, expr->data.typecast.operand);
+            call_graph_visit_type(builder, &expr->data.typecast.cast_to);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            call_graph_visit_expr(builder, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            call_graph_visit_expr(builder, expr->data.access_array.operand);
+            call_graph_visit_expr(builder, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION:
+            call_graph_visit_type(builder, &expr->data.function.type);
+            call_graph_visit_scope(builder, expr->data.function.scope);
+            break;
+        case EXPR_FUNCTION_CALL:
+            call_graph_visit_expr(builder, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                call_graph_visit_expr(builder, expr->data.function_call.params + i);
+            }
+            break;
+        case EXPR_ID:
+            call_graph_edge_add(builder, expr->data.id.declaration);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            call_graph_visit_type(builder, &expr->data.literal_array.type);
+            call_graph_visit_expr(builder, expr->data.literal_array.count);
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
+                call_graph_visit_expr(builder, expr->data.literal_array.members + i);
+            }
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) {
+                call_graph_visit_expr(builder, expr->data.vector.args + i);
+            }
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) {
+                call_graph_visit_expr(builder, expr->data.file.args + i);
+            }
+            break;
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void call_graph_visit_declaration(CallGraphBuilder *builder, Declaration *decl) {
+    switch (decl->type) {
+        case DECLARATION_VAR:
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+                call_graph_visit_type(builder, &decl->data.var.data.constant.type);
+                call_graph_visit_expr(builder, &decl->data.var.data.constant.value);
+            } else {
+                call_graph_visit_type(builder, &decl->data.var.data.mutable.type);
+                if (decl->data.var.data.mutable.value_exists) call_graph_visit_expr(builder, &decl->data.var.data.mutable.value);
+            }
+            break;
+        case DECLARATION_STRUCT:
+        case DECLARATION_UNION:
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) {
+                call_graph_visit_type(builder, &decl->data.struct_union.members[i].type);
+            }
+            break;
+        case DECLARATION_SUM:
+            for (int i = 0; i < decl->data.sum.member_count; i++) {
+                if (decl->data.sum.members[i].type_exists) call_graph_visit_type(builder, &decl->data.sum.members[i].type);
+            }
+            break;
+        case DECLARATION_ENUM:
+            break;
+    }
+}
+
+static void call_graph_visit_statement(CallGraphBuilder *builder, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            call_graph_visit_declaration(builder, &statement->data.declaration);
+            break;
+        case STATEMENT_INCREMENT:
+            call_graph_visit_expr(builder, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            call_graph_visit_expr(builder, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            call_graph_visit_expr(builder, &statement->data.assign.assignee);
+            call_graph_visit_expr(builder, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            call_graph_visit_expr(builder, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) call_graph_visit_expr(builder, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+static void call_graph_visit_scope(CallGraphBuilder *builder, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            call_graph_visit_statement(builder, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            call_graph_visit_expr(builder, &scope->data.conditional.condition);
+            call_graph_visit_scope(builder, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) call_graph_visit_scope(builder, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            call_graph_visit_statement(builder, &scope->data.loop_for.init);
+            call_graph_visit_expr(builder, &scope->data.loop_for.expr);
+            call_graph_visit_statement(builder, &scope->data.loop_for.step);
+            call_graph_visit_scope(builder, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            call_graph_visit_expr(builder, &scope->data.loop_for_each.array);
+            call_graph_visit_scope(builder, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            call_graph_visit_expr(builder, &scope->data.loop_while.expr);
+            call_graph_visit_scope(builder, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) call_graph_visit_scope(builder, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            call_graph_visit_expr(builder, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) {
+                    call_graph_visit_scope(builder, scope->data.match.cases[i].scopes + j);
+                }
+            }
+            break;
+    }
+}
+
+// Tarjan's strongly connected components algorithm. Components are completed callees first,
+// which is the order passes like the inliner want to visit functions in.
+typedef struct Tarjan {
+    CallGraph *graph;
+    int *stack;
+    int stack_count;
+    int index;
+    int order_count;
+} Tarjan;
+
+static void call_graph_tarjan(Tarjan *tarjan, int idx) {
+    CallGraphNode *node = tarjan->graph->nodes + idx;
+    node->tarjan_index = tarjan->index;
+    node->tarjan_lowlink = tarjan->index;
+    tarjan->index++;
+    tarjan->stack[tarjan->stack_count++] = idx;
+    node->tarjan_on_stack = true;
+
+    for (int i = 0; i < node->edge_count; i++) {
+        int to = node->edges[i];
+        CallGraphNode *node_to = tarjan->graph->nodes + to;
+        if (to == idx) node->recursive = true;
+        if (node_to->tarjan_index < 0) {
+            call_graph_tarjan(tarjan, to);
+            if (node_to->tarjan_lowlink < node->tarjan_lowlink) node->tarjan_lowlink = node_to->tarjan_lowlink;
+        } else if (node_to->tarjan_on_stack && node_to->tarjan_index < node->tarjan_lowlink) {
+            node->tarjan_lowlink = node_to->tarjan_index;
+        }
+    }
+
+    if (node->tarjan_lowlink != node->tarjan_index) return;
+
+    int component_start = tarjan->order_count;
+    while (true) {
+        int member = tarjan->stack[--tarjan->stack_count];
+        tarjan->graph->nodes[member].tarjan_on_stack = false;
+        tarjan->graph->order[tarjan->order_count++] = member;
+        if (member == idx) break;
+    }
+    if (tarjan->order_count - component_start > 1) {
+        for (int i = component_start; i < tarjan->order_count; i++) {
+            tarjan->graph->nodes[tarjan->graph->order[i]].recursive = true;
+        }
+    }
+}
+
+CallGraph call_graph_new(SourceFile *file) {
+    CallGraph graph = {
+        .nodes = allocator_calloc(ALLOCATOR_OPTIMIZE, file->declaration_count, sizeof(CallGraphNode)),
+        .node_count = file->declaration_count,
+        .order = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(int) * file->declaration_count)
+    };
+
+    for (int i = 0; i < file->declaration_count; i++) {
+        graph.nodes[i].decl = file->declarations + i;
+        graph.nodes[i].tarjan_index = -1;
+    }
+
+    for (int i = 0; i < file->declaration_count; i++) {
+        CallGraphBuilder builder = { .graph = &graph, .file = file, .from = i };
+        call_graph_visit_declaration(&builder, file->declarations + i);
+    }
+
+    Tarjan tarjan = {
+        .graph = &graph,
+        .stack = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(int) * file->declaration_count),
+        .stack_count = 0,
+        .index = 0,
+        .order_count = 0
+    };
+    for (int i = 0; i < graph.node_count; i++) {
+        if (graph.nodes[i].tarjan_index < 0) call_graph_tarjan(&tarjan, i);
+    }
+    assert(tarjan.order_count == graph.node_count);
+    allocator_free(tarjan.stack);
+
+    return graph;
+}
+
+void call_graph_free(CallGraph *graph) {
+    for (int i = 0; i < graph->node_count; i++) allocator_free(graph->nodes[i].edges);
+    allocator_free(graph->nodes);
+    allocator_free(graph->order);
+}
@@ -0,0 +1,32 @@
+#ifndef CREED_CALL_GRAPH_H
+#define CREED_CALL_GRAPH_H
+
+#include <stdbool.h>
+#include "parser.h"
+
+// A graph of which top-level declarations reference each other, through identifiers or through types.
+// Only valid on a typechecked file, since it follows the declarations the typechecker resolved.
+
+typedef struct CallGraphNode {
+    Declaration *decl;
+    int *edges; // Indices of the nodes this declaration references.
+    int edge_count;
+    int edge_count_alloc;
+    bool recursive; // Part of a reference cycle, including referencing itself.
+
+    int tarjan_index; // private
+    int tarjan_lowlink; // private
+    bool tarjan_on_stack; // private
+} CallGraphNode;
+
+typedef struct CallGraph {
+    CallGraphNode *nodes; // One per top-level declaration, in the same order as the source file.
+    int node_count;
+    int *order; // Node indices ordered so that declarations come after everything they reference, except within cycles.
+} CallGraph;
+
+CallGraph call_graph_new(SourceFile *file);
+void call_graph_free(CallGraph *graph);
+int call_graph_index(CallGraph *graph, Declaration *decl); // Returns -1 if this is not a top-level declaration.
+
+#endif
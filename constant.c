@@ -0,0 +1,372 @@
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "constant.h"
+#include "parser.h"
+#include "prelude.h"
+#include "token.h"
+
+// Integers are evaluated on 64 bit values and then truncated back to the width of their literal type.
+// Signed values are sign-extended before they are widened so the truncation wraps around the same way it does in C.
+
+static bool literal_is_signed(int type) {
+    return type == LITERAL_CHAR || (LITERAL_INT8 <= type && type <= LITERAL_INT64);
+}
+
+static bool literal_is_integer(int type) {
+    return type == LITERAL_CHAR || (LITERAL_INT8 <= type && type <= LITERAL_UINT64);
+}
+
+static bool literal_is_float(int type) {
+    return type == LITERAL_FLOAT || type == LITERAL_FLOAT64;
+}
+
+static int literal_bit_width(int type) {
+    switch (type) {
+        case LITERAL_CHAR:
+        case LITERAL_INT8:
+        case LITERAL_UINT8:
+            return 8;
+        case LITERAL_INT16:
+        case LITERAL_UINT16:
+            return 16;
+        case LITERAL_INT:
+        case LITERAL_UINT:
+        case LITERAL_FLOAT:
+            return 32;
+        default:
+            return 64;
+    }
+}
+
+static long long literal_get_signed(Literal *literal) {
+    switch (literal->type) {
+        case LITERAL_CHAR: return literal->data.l_char;
+        case LITERAL_INT8: return literal->data.l_int8;
+        case LITERAL_INT16: return literal->data.l_int16;
+        case LITERAL_INT: return literal->data.l_int;
+        case LITERAL_INT64: return literal->data.l_int64;
+        default: assert(false); return 0;
+    }
+}
+
+static unsigned long long literal_get_unsigned(Literal *literal) {
+    switch (literal->type) {
+        case LITERAL_UINT8: return literal->data.l_uint8;
+        case LITERAL_UINT16: return literal->data.l_uint16;
+        case LITERAL_UINT: return literal->data.l_uint;
+        case LITERAL_UINT64: return literal->data.l_uint64;
+        default: assert(false); return 0;
+    }
+}
+
+unsigned long long literal_get_bits(Literal *literal) {
+    if (literal_is_signed(literal->type)) return (unsigned long long) literal_get_signed(literal);
+    return literal_get_unsigned(literal);
+}
+
+static double literal_get_float(Literal *literal) {
+    switch (literal->type) {
+        case LITERAL_FLOAT: return literal->data.l_float;
+        case LITERAL_FLOAT64: return literal->data.l_float64;
+        default:
+            if (literal_is_signed(literal->type)) return (double) literal_get_signed(literal);
+            return (double) literal_get_unsigned(literal);
+    }
+}
+
+// Truncates the bits to the width of the type.
+Literal literal_from_bits(int type, unsigned long long bits) {
+    Literal literal = { .type = type };
+    switch (type) {
+        case LITERAL_CHAR: literal.data.l_char = (char) bits; break;
+        case LITERAL_INT8: literal.data.l_int8 = (char) bits; break;
+        case LITERAL_INT16: literal.data.l_int16 = (short) bits; break;
+        case LITERAL_INT: literal.data.l_int = (int) bits; break;
+        case LITERAL_INT64: literal.data.l_int64 = (long long) bits; break;
+        case LITERAL_UINT8: literal.data.l_uint8 = (unsigned char) bits; break;
+        case LITERAL_UINT16: literal.data.l_uint16 = (unsigned short) bits; break;
+        case LITERAL_UINT: literal.data.l_uint = (unsigned int) bits; break;
+        case LITERAL_UINT64: literal.data.l_uint64 = bits; break;
+        default: assert(false); break;
+    }
+    return literal;
+}
+
+static Literal literal_from_float(Location location, int type, double value) {
+    Literal literal = { .type = type };
+    if (type == LITERAL_FLOAT) {
+        literal.data.l_float = (float) value;
+        if (isfinite(value) && !isfinite(literal.data.l_float)) error_exit(location, "This constant expression overflows its floating point type.");
+    } else {
+        literal.data.l_float64 = value;
+    }
+    if (!isfinite(value)) error_exit(location, "This constant expression does not evaluate to a finite number.");
+    return literal;
+}
+
+bool constant_is_folded(Expr *expr) {
+    return (expr->type == EXPR_LITERAL && expr->data.literal.type != LITERAL_STRING) || expr->type == EXPR_LITERAL_BOOL;
+}
+
+static void expr_replace_literal(Expr *expr, Literal literal) {
+    Location location = expr->location;
+    expr_free(expr);
+    *expr = (Expr) {
+        .location = location,
+        .type = EXPR_LITERAL,
+        .data.literal = literal
+    };
+}
+
+static void expr_replace_bool(Expr *expr, bool value) {
+    Location location = expr->location;
+    expr_free(expr);
+    *expr = (Expr) {
+        .location = location,
+        .type = EXPR_LITERAL_BOOL,
+        .data.literal_bool = value
+    };
+}
+
+static void constant_fold_unary(Expr *expr) {
+    Expr *operand = expr->data.unary.operand;
+
+    switch (expr->data.unary.type) {
+        case EXPR_UNARY_LOGICAL_NOT:
+            expr_replace_bool(expr, !operand->data.literal_bool);
+            break;
+
+        case EXPR_UNARY_BITWISE_NOT: {
+            Literal *literal = &operand->data.literal;
+            expr_replace_literal(expr, literal_from_bits(literal->type, ~literal_get_bits(literal)));
+        } break;
+
+        case EXPR_UNARY_NEGATE: {
+            Literal *literal = &operand->data.literal;
+            if (literal_is_float(literal->type)) {
+                expr_replace_literal(expr, literal_from_float(expr->location, literal->type, -literal_get_float(literal)));
+            } else {
+                expr_replace_literal(expr, literal_from_bits(literal->type, 0ull - literal_get_bits(literal)));
+            }
+        } break;
+
+        case EXPR_UNARY_REF:
+        case EXPR_UNARY_DEREF:
+            break;
+    }
+}
+
+static void constant_fold_binary_bool(Expr *expr) {
+    bool lhs = expr->data.binary.lhs->data.literal_bool;
+    bool rhs = expr->data.binary.rhs->data.literal_bool;
+
+    switch (expr->data.binary.operator) {
+        case TOKEN_OP_LOGICAL_AND: expr_replace_bool(expr, lhs && rhs); break;
+        case TOKEN_OP_LOGICAL_OR: expr_replace_bool(expr, lhs || rhs); break;
+        case TOKEN_OP_EQ: expr_replace_bool(expr, lhs == rhs); break;
+        case TOKEN_OP_NE: expr_replace_bool(expr, lhs != rhs); break;
+        default: break;
+    }
+}
+
+static void constant_fold_binary_float(Expr *expr) {
+    Literal lhs = expr->data.binary.lhs->data.literal;
+    Literal rhs = expr->data.binary.rhs->data.literal;
+    double l = literal_get_float(&lhs);
+    double r = literal_get_float(&rhs);
+
+    switch (expr->data.binary.operator) {
+        case TOKEN_OP_EQ: expr_replace_bool(expr, l == r); return;
+        case TOKEN_OP_NE: expr_replace_bool(expr, l != r); return;
+        case TOKEN_OP_LT: expr_replace_bool(expr, l < r); return;
+        case TOKEN_OP_GT: expr_replace_bool(expr, l > r); return;
+        case TOKEN_OP_LE: expr_replace_bool(expr, l <= r); return;
+        case TOKEN_OP_GE: expr_replace_bool(expr, l >= r); return;
+        default: break;
+    }
+
+    if (expr->data.binary.operator == TOKEN_OP_DIVIDE && r == 0.0) {
+        error_exit(expr->location, "Division by zero in a constant expression.");
+    }
+
+    double result;
+    if (lhs.type == LITERAL_FLOAT) { // Evaluate in single precision so the rounding matches the runtime.
+        float lf = lhs.data.l_float;
+        float rf = rhs.data.l_float;
+        float value;
+        switch (expr->data.binary.operator) {
+            case TOKEN_OP_PLUS: value = lf + rf; break;
+            case TOKEN_OP_MINUS: value = lf - rf; break;
+            case TOKEN_OP_MULTIPLY: value = lf * rf; break;
+            case TOKEN_OP_DIVIDE: value = lf / rf; break;
+            default: return;
+        }
+        result = value;
+        if (isfinite(l) && isfinite(r) && !isfinite(value)) {
+            error_exit(expr->location, "This constant expression overflows its floating point type.");
+        }
+    } else {
+        switch (expr->data.binary.operator) {
+            case TOKEN_OP_PLUS: result = l + r; break;
+            case TOKEN_OP_MINUS: result = l - r; break;
+            case TOKEN_OP_MULTIPLY: result = l * r; break;
+            case TOKEN_OP_DIVIDE: result = l / r; break;
+            default: return;
+        }
+    }
+    expr_replace_literal(expr, literal_from_float(expr->location, lhs.type, result));
+}
+
+static void constant_fold_binary_integer(Expr *expr) {
+    Literal lhs = expr->data.binary.lhs->data.literal;
+    Literal rhs = expr->data.binary.rhs->data.literal;
+    TokenType operator = expr->data.binary.operator;
+    bool is_signed = literal_is_signed(lhs.type);
+    unsigned long long l = literal_get_bits(&lhs);
+    unsigned long long r = literal_get_bits(&rhs);
+
+    switch (operator) {
+        case TOKEN_OP_EQ: expr_replace_bool(expr, l == r); return;
+        case TOKEN_OP_NE: expr_replace_bool(expr, l != r); return;
+
+        case TOKEN_OP_LT:
+        case TOKEN_OP_GT:
+        case TOKEN_OP_LE:
+        case TOKEN_OP_GE: {
+            int comparison;
+            if (is_signed) {
+                long long ls = literal_get_signed(&lhs);
+                long long rs = literal_get_signed(&rhs);
+                comparison = (ls > rs) - (ls < rs);
+            } else {
+                comparison = (l > r) - (l < r);
+            }
+            bool value;
+            if (operator == TOKEN_OP_LT) value = comparison < 0;
+            else if (operator == TOKEN_OP_GT) value = comparison > 0;
+            else if (operator == TOKEN_OP_LE) value = comparison <= 0;
+            else value = comparison >= 0;
+            expr_replace_bool(expr, value);
+        } return;
+
+        default: break;
+    }
+
+    unsigned long long bits;
+    switch (operator) {
+        case TOKEN_OP_PLUS: bits = l + r; break;
+        case TOKEN_OP_MINUS: bits = l - r; break;
+        case TOKEN_OP_MULTIPLY: bits = l * r; break;
+        case TOKEN_OP_BITWISE_AND: bits = l & r; break;
+        case TOKEN_OP_BITWISE_OR: bits = l | r; break;
+        case TOKEN_OP_BITWISE_XOR: bits = l ^ r; break;
+
+        case TOKEN_OP_DIVIDE:
+        case TOKEN_OP_MODULO:
+            if (r == 0) error_exit(expr->location, "Division by zero in a constant expression.");
+            if (is_signed) {
+                long long ls = literal_get_signed(&lhs);
+                long long rs = literal_get_signed(&rhs);
+                if (ls == LLONG_MIN && rs == -1) { // The only signed division that overflows 64 bits. It wraps back around to itself.
+                    bits = operator == TOKEN_OP_DIVIDE ? l : 0;
+                } else {
+                    bits = (unsigned long long) (operator == TOKEN_OP_DIVIDE ? ls / rs : ls % rs);
+                }
+            } else {
+                bits = operator == TOKEN_OP_DIVIDE ? l / r : l % r;
+            }
+            break;
+
+        case TOKEN_OP_SHIFT_LEFT:
+        case TOKEN_OP_SHIFT_RIGHT:
+            if (r >= (unsigned long long) literal_bit_width(lhs.type)) {
+                error_exit(expr->location, "This constant bit shift is greater than or equal to the width of its type.");
+            }
+            bits = operator == TOKEN_OP_SHIFT_LEFT ? l << r : l >> r;
+            break;
+
+        default:
+            return;
+    }
+    expr_replace_literal(expr, literal_from_bits(lhs.type, bits));
+}
+
+static void constant_fold_typecast(Expr *expr) {
+    Expr *operand = expr->data.typecast.operand;
+    Type *cast_to = &expr->data.typecast.cast_to;
+    if (cast_to->type != TYPE_PRIMITIVE || cast_to->data.primitive == TOKEN_KEYWORD_TYPE_VOID) return;
+    TokenType primitive = cast_to->data.primitive;
+
+    if (primitive == TOKEN_KEYWORD_TYPE_BOOL) {
+        bool value;
+        if (operand->type == EXPR_LITERAL_BOOL) value = operand->data.literal_bool;
+        else if (literal_is_float(operand->data.literal.type)) value = literal_get_float(&operand->data.literal) != 0.0;
+        else value = literal_get_bits(&operand->data.literal) != 0;
+        expr_replace_bool(expr, value);
+        return;
+    }
+
+    int type = LITERAL_CHAR + primitive - TOKEN_KEYWORD_TYPE_CHAR;
+    Literal source;
+    if (operand->type == EXPR_LITERAL_BOOL) {
+        source = literal_from_bits(LITERAL_UINT8, operand->data.literal_bool);
+    } else {
+        source = operand->data.literal;
+    }
+
+    if (literal_is_float(type)) {
+        expr_replace_literal(expr, literal_from_float(expr->location, type, literal_get_float(&source)));
+    } else if (literal_is_float(source.type)) {
+        double value = trunc(literal_get_float(&source));
+        int width = literal_bit_width(type);
+        double min = literal_is_signed(type) ? -ldexp(1.0, width - 1) : 0.0;
+        double max = literal_is_signed(type) ? ldexp(1.0, width - 1) : ldexp(1.0, width);
+        if (!(min <= value && value < max)) {
+            error_exit(expr->location, "This constant cannot be represented by the integer type it is cast to.");
+        }
+        unsigned long long bits = literal_is_signed(type) ? (unsigned long long) (long long) value : (unsigned long long) value;
+        expr_replace_literal(expr, literal_from_bits(type, bits));
+    } else {
+        assert(literal_is_integer(source.type));
+        expr_replace_literal(expr, literal_from_bits(type, literal_get_bits(&source)));
+    }
+}
+
+void constant_fold(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN: {
+            Expr *parenthesized = expr->data.parenthesized;
+            if (!constant_is_folded(parenthesized)) break;
+            Location location = expr->location;
+            *expr = *parenthesized;
+            expr->location = location;
+            allocator_free(parenthesized);
+        } break;
+
+        case EXPR_UNARY:
+            if (constant_is_folded(expr->data.unary.operand)) constant_fold_unary(expr);
+            break;
+
+        case EXPR_BINARY: {
+            Expr *lhs = expr->data.binary.lhs;
+            Expr *rhs = expr->data.binary.rhs;
+            if (!constant_is_folded(lhs) || !constant_is_folded(rhs)) break;
+
+            if (lhs->type == EXPR_LITERAL_BOOL) constant_fold_binary_bool(expr);
+            else if (literal_is_float(lhs->data.literal.type)) constant_fold_binary_float(expr);
+            else constant_fold_binary_integer(expr);
+        } break;
+
+        case EXPR_TYPECAST:
+            if (constant_is_folded(expr->data.typecast.operand)) constant_fold_typecast(expr);
+            break;
+
+        default:
+            break;
+    }
+}
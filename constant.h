@@ -0,0 +1,21 @@
+#ifndef CREED_CONSTANT_H
+#define CREED_CONSTANT_H
+
+#include <stdbool.h>
+#include "parser.h"
+
+// Returns true if this expression is a literal that constant expressions can be folded into.
+bool constant_is_folded(Expr *expr);
+
+// Replaces a typechecked constant expression with the literal it evaluates to.
+// Only folds if the operands have already been folded, so call this bottom-up.
+// Integer arithmetic wraps around at the width of the type of the expression, the same as it would at runtime.
+void constant_fold(Expr *expr);
+
+// The two's complement representation of an integer or char literal, sign-extended to 64 bits.
+unsigned long long literal_get_bits(Literal *literal);
+
+// Makes an integer or char literal of this literal type from the low bits of a 64-bit value.
+Literal literal_from_bits(int type, unsigned long long bits);
+
+#endif
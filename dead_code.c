@@ -0,0 +1,99 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "dead_code.h"
+#include "call_graph.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+
+#define DEAD_CODE_PASS "dce"
+
+typedef struct DeadCode {
+    Declaration *declarations;
+    int declaration_count;
+    int *idx_new; // Where each live declaration moves to.
+} DeadCode;
+
+static void *dead_code_relocate(void *context, void *ptr) {
+    DeadCode *dead = context;
+    Declaration *decl = ptr;
+    if (decl < dead->declarations || dead->declarations + dead->declaration_count <= decl) return ptr;
+    return dead->declarations + dead->idx_new[decl - dead->declarations];
+}
+
+void dead_code_eliminate(SourceFile *file) {
+    CallGraph graph = call_graph_new(file);
+    bool *live = allocator_calloc(ALLOCATOR_OPTIMIZE, graph.node_count, sizeof(bool));
+    int *stack = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(int) * graph.node_count);
+    int stack_count = 0;
+
+    StringId id_main = string_cache_insert_static("main");
+    for (int i = 0; i < graph.node_count; i++) {
+        Declaration *decl = graph.nodes[i].decl;
+        if (decl->exported || decl->id.idx == id_main.idx) {
+            live[i] = true;
+            stack[stack_count++] = i;
+        }
+    }
+
+    if (stack_count == 0) {
+        remark_summary(DEAD_CODE_PASS, "no main or exported declarations, nothing was dropped");
+        allocator_free(live);
+        allocator_free(stack);
+        call_graph_free(&graph);
+        return;
+    }
+
+    while (stack_count > 0) {
+        CallGraphNode *node = graph.nodes + stack[--stack_count];
+        for (int i = 0; i < node->edge_count; i++) {
+            if (live[node->edges[i]]) continue;
+            live[node->edges[i]] = true;
+            stack[stack_count++] = node->edges[i];
+        }
+    }
+
+    int dropped_functions = 0;
+    int dropped_globals = 0;
+    int dropped_types = 0;
+    DeadCode dead = {
+        .declarations = file->declarations,
+        .declaration_count = file->declaration_count,
+        .idx_new = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(int) * file->declaration_count)
+    };
+
+    // Live declarations only ever refer to other live declarations, so they can be moved down in place.
+    int live_count = 0;
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (live[i]) {
+            dead.idx_new[i] = live_count;
+            live_count++;
+            continue;
+        }
+
+        if (declaration_is_function(decl)) dropped_functions++;
+        else if (decl->type == DECLARATION_VAR) dropped_globals++;
+        else dropped_types++;
+        remark(decl->location, DEAD_CODE_PASS, "'%s' is unreachable and was dropped", string_cache_get(decl->id));
+        declaration_free(decl);
+        dead.idx_new[i] = -1;
+    }
+
+    for (int i = 0; i < file->declaration_count; i++) {
+        if (live[i]) file->declarations[dead.idx_new[i]] = file->declarations[i];
+    }
+    Relocation relocation = { .relocate = dead_code_relocate, .context = &dead };
+    for (int i = 0; i < live_count; i++) relocate_declaration(&relocation, file->declarations + i);
+
+    remark_summary(DEAD_CODE_PASS, "dropped %i of %i declarations (%i functions, %i globals, %i types)",
+        file->declaration_count - live_count, file->declaration_count, dropped_functions, dropped_globals, dropped_types);
+    file->declaration_count = live_count;
+
+    allocator_free(dead.idx_new);
+    allocator_free(live);
+    allocator_free(stack);
+    call_graph_free(&graph);
+}
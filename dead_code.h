@@ -0,0 +1,10 @@
+#ifndef CREED_DEAD_CODE_H
+#define CREED_DEAD_CODE_H
+
+#include "parser.h"
+
+// Removes top-level declarations that can't be reached from main or from an exported declaration,
+// following both identifiers and type references. Files with neither are left alone. Run this after typechecking.
+void dead_code_eliminate(SourceFile *file);
+
+#endif
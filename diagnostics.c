@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "diagnostics.h"
+
+#define CMD_RED "\x1B[31m"
+#define CMD_GREEN "\x1B[32m"
+#define CMD_RESET "\x1B[0m"
+
+static const char *diagnostic_severity_names[] = { "Error", "Warning", "Note" };
+
+static Diagnostic *diagnostics;
+static int diagnostic_count = 0;
+static int diagnostic_count_alloc = 0;
+static int diagnostic_error_count = 0;
+static int diagnostic_max_errors = 20;
+static FILE *diagnostic_output = NULL; // stdout, which can't be used to initialize a static.
+static bool diagnostic_output_set = false;
+
+static DiagnosticRecovery *diagnostic_recovery = NULL;
+
+// Prints the message, where it is, and the line it is on with the part it is about in red.
+static void diagnostic_print(Diagnostic *diagnostic, FILE *outfile) {
+    Location location = diagnostic->location;
+    fprintf(outfile, "%s! %s\n%s:%i\n", diagnostic_severity_names[diagnostic->severity], diagnostic->message, string_cache_get(location.file_name), location.idx_line + 1);
+    
+    const char *file = string_cache_get(location.file_content);
+    int idx_start_line = location.idx_start;
+    while (idx_start_line > 0 && file[idx_start_line - 1] != '\n') idx_start_line--;
+    
+    fputc('\n', outfile);
+    fputs(CMD_GREEN, outfile);
+    fwrite(file + idx_start_line, sizeof(char), location.idx_start - idx_start_line, outfile);
+    
+    fputs(CMD_RED, outfile);
+    fwrite(file + location.idx_start, sizeof(char), location.idx_end - location.idx_start, outfile);
+    fputs(CMD_GREEN, outfile);
+    
+    int idx_end_line = location.idx_end;
+    while (file[idx_end_line] != '\n' && file[idx_end_line] != '\0') idx_end_line++;
+    
+    fwrite(file + location.idx_end, sizeof(char), idx_end_line - location.idx_end, outfile);
+    fputs(CMD_RESET"\n\n", outfile);
+}
+
+void diagnostics_set_output(FILE *outfile) {
+    diagnostic_output = outfile;
+    diagnostic_output_set = true;
+}
+
+void diagnostics_set_max_errors(int max_errors) {
+    diagnostic_max_errors = max_errors;
+}
+
+void diagnostics_report(DiagnosticSeverity severity, Location location, const char *message) {
+    if (diagnostic_count == diagnostic_count_alloc) {
+        diagnostic_count_alloc = diagnostic_count_alloc ? diagnostic_count_alloc * 2 : 8;
+        diagnostics = allocator_realloc(ALLOCATOR_DIAGNOSTICS, diagnostics, sizeof(Diagnostic) * diagnostic_count_alloc);
+    }
+    Diagnostic *diagnostic = diagnostics + diagnostic_count++;
+    *diagnostic = (Diagnostic) {
+        .severity = severity,
+        .location = location,
+        .message = message
+    };
+    FILE *outfile = diagnostic_output_set ? diagnostic_output : stdout;
+    if (outfile) diagnostic_print(diagnostic, outfile);
+
+    if (severity != DIAGNOSTIC_ERROR) return;
+    diagnostic_error_count++;
+    if (diagnostic_error_count == diagnostic_max_errors) {
+        if (outfile) fprintf(outfile, "Stopping after %i errors. Use --max-errors=<count> to see more.\n", diagnostic_error_count);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int diagnostics_error_count(void) {
+    return diagnostic_error_count;
+}
+
+const Diagnostic *diagnostics_get(int *count) {
+    *count = diagnostic_count;
+    return diagnostics;
+}
+
+void diagnostics_clear(void) {
+    allocator_free(diagnostics);
+    diagnostics = NULL;
+    diagnostic_count = 0;
+    diagnostic_count_alloc = 0;
+    diagnostic_error_count = 0;
+}
+
+void diagnostics_recovery_push(DiagnosticRecovery *recovery) {
+    recovery->outer = diagnostic_recovery;
+    diagnostic_recovery = recovery;
+}
+
+void diagnostics_recovery_pop(DiagnosticRecovery *recovery) {
+    assert(diagnostic_recovery == recovery);
+    diagnostic_recovery = recovery->outer;
+}
+
+void diagnostics_unwind(void) {
+    DiagnosticRecovery *recovery = diagnostic_recovery;
+    if (!recovery) exit(EXIT_FAILURE);
+    diagnostic_recovery = recovery->outer;
+    longjmp(recovery->jump, 1);
+}
@@ -0,0 +1,46 @@
+#ifndef CREED_DIAGNOSTICS_H
+#define CREED_DIAGNOSTICS_H
+
+#include <setjmp.h>
+#include <stdio.h>
+#include "prelude.h"
+
+typedef enum DiagnosticSeverity {
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING,
+    DIAGNOSTIC_NOTE,
+} DiagnosticSeverity;
+
+// Messages are string literals, so a diagnostic does not own its message.
+typedef struct Diagnostic {
+    DiagnosticSeverity severity;
+    Location location;
+    const char *message;
+} Diagnostic;
+
+// Printed to stdout as they are reported, and kept until diagnostics_clear.
+// Once max_errors errors have been reported the compile stops. 0 never stops it.
+void diagnostics_set_max_errors(int max_errors);
+// Where diagnostics are printed instead of stdout, or NULL to only keep them.
+void diagnostics_set_output(FILE *outfile);
+void diagnostics_report(DiagnosticSeverity severity, Location location, const char *message);
+int diagnostics_error_count(void);
+const Diagnostic *diagnostics_get(int *count);
+void diagnostics_clear(void);
+
+// A point the parser or typechecker can go back to when an error is reported below it, to skip what failed and go on.
+// Used as: push, then if (setjmp(recovery.jump)) { recover } else { work, then pop }.
+// The recovery point is already popped when setjmp returns the second time.
+typedef struct DiagnosticRecovery {
+    jmp_buf jump;
+    struct DiagnosticRecovery *outer;
+} DiagnosticRecovery;
+
+void diagnostics_recovery_push(DiagnosticRecovery *recovery);
+void diagnostics_recovery_pop(DiagnosticRecovery *recovery);
+
+// Goes back to the innermost recovery point without reporting anything, for errors that were already reported.
+// Without a recovery point, the compile ends.
+void diagnostics_unwind(void);
+
+#endif
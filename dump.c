@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dump.h"
+#include "token.h"
+
+static void dump_string(const char *string) {
+    putchar('"');
+    for (; *string; string++) {
+        if (*string == '"' || *string == '\\') printf("\\%c", *string);
+        else if ((unsigned char) *string < 0x20) printf("\\u%04x", *string);
+        else putchar(*string);
+    }
+    putchar('"');
+}
+
+// The source text between two offsets of a location's file, which is what a token was lexed from.
+static void dump_source(Location location) {
+    const char *content = string_cache_get(location.file_content);
+    putchar('"');
+    for (int i = location.idx_start; i < location.idx_end && content[i]; i++) {
+        if (content[i] == '"' || content[i] == '\\') printf("\\%c", content[i]);
+        else if ((unsigned char) content[i] < 0x20) printf("\\u%04x", content[i]);
+        else putchar(content[i]);
+    }
+    putchar('"');
+}
+
+static void dump_location(Location location) {
+    printf("\"line\":%i,\"start\":%i,\"end\":%i", location.idx_line + 1, location.idx_start, location.idx_end);
+}
+
+static const char *dump_token_kind(TokenType type) {
+    if (type == TOKEN_LITERAL) return "literal";
+    if (type == TOKEN_ID) return "id";
+    if (TOKEN_OP_MIN <= type && type <= TOKEN_OP_MAX) return "operator";
+    if (TOKEN_KEYWORD_MIN <= type && type <= TOKEN_KEYWORD_MAX) return "keyword";
+    if (TOKEN_ASSIGN_MIN <= type && type <= TOKEN_ASSIGN_MAX) return "assign";
+    if (TOKEN_ERROR_MIN <= type && type <= TOKEN_ERROR_MAX) return "error";
+    return "punctuation";
+}
+
+void dump_tokens(Lexer lexer, DumpFormat format) {
+    if (format == DUMP_FORMAT_JSON) putchar('[');
+    bool first = true;
+    while (true) {
+        Token token = lexer_token_get(&lexer);
+        if (token.type == TOKEN_NULL) break;
+        if (format == DUMP_FORMAT_TEXT) {
+            token_print(&token);
+            printf("\t\t\t[%i type %i]\n", token.location.idx_line + 1, token.type);
+        } else {
+            printf("%s\n{\"kind\":\"%s\",\"type\":%i,\"text\":", first ? "" : ",", dump_token_kind(token.type), token.type);
+            dump_source(token.location);
+            putchar(',');
+            dump_location(token.location);
+            putchar('}');
+        }
+        first = false;
+        if (TOKEN_ERROR_MIN <= token.type && token.type <= TOKEN_ERROR_MAX) break;
+    }
+    if (format == DUMP_FORMAT_JSON) printf("\n]\n");
+}
+
+static void dump_expr(Expr *expr);
+static void dump_scope(Scope *scope);
+static void dump_declaration(Declaration *decl);
+
+static const char *dump_keyword(TokenType type) {
+    return string_keywords[type - TOKEN_KEYWORD_MIN];
+}
+
+static void dump_type(Type *type) {
+    switch (type->type) {
+        case TYPE_PRIMITIVE:
+            printf("{\"kind\":\"primitive\",\"name\":\"%s\"}", dump_keyword(type->data.primitive));
+            break;
+        case TYPE_ID:
+            printf("{\"kind\":\"id\",\"name\":");
+            dump_string(string_cache_get(type->data.id.type_declaration_id));
+            putchar('}');
+            break;
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+            printf("{\"kind\":\"pointer\",\"nullable\":%s,\"to\":", type->type == TYPE_PTR_NULLABLE ? "true" : "false");
+            dump_type(type->data.sub_type);
+            putchar('}');
+            break;
+        case TYPE_ARRAY:
+            printf("{\"kind\":\"array\",\"of\":");
+            dump_type(type->data.sub_type);
+            putchar('}');
+            break;
+        case TYPE_FUNCTION:
+            printf("{\"kind\":\"function\",\"params\":[");
+            for (int i = 0; i < type->data.function.param_count; i++) {
+                if (i > 0) putchar(',');
+                printf("{\"name\":");
+                dump_string(string_cache_get(type->data.function.params[i].id));
+                printf(",\"type\":");
+                dump_type(&type->data.function.params[i].type);
+                putchar('}');
+            }
+            printf("],\"result\":");
+            dump_type(type->data.function.result);
+            putchar('}');
+            break;
+        case TYPE_VECTOR:
+            printf("{\"kind\":\"vector\",\"width\":%i,\"of\":\"%s\"}", type->data.vector.width, dump_keyword(type->data.vector.element));
+            break;
+    }
+}
+
+static void dump_literal(Literal *literal) {
+    static const char *types[] = {
+        [LITERAL_STRING] = "string", [LITERAL_CHAR] = "char",
+        [LITERAL_INT8] = "int8", [LITERAL_INT16] = "int16", [LITERAL_INT] = "int", [LITERAL_INT64] = "int64",
+        [LITERAL_UINT8] = "uint8", [LITERAL_UINT16] = "uint16", [LITERAL_UINT] = "uint", [LITERAL_UINT64] = "uint64",
+        [LITERAL_FLOAT] = "float", [LITERAL_FLOAT64] = "float64",
+    };
+    printf("\"type\":\"%s\",\"value\":", types[literal->type]);
+    switch (literal->type) {
+        case LITERAL_STRING: dump_string(string_cache_get(literal->data.l_string)); break;
+        case LITERAL_CHAR: {
+            char string[2] = { literal->data.l_char, '\0' };
+            dump_string(string);
+        } break;
+        case LITERAL_INT8: printf("%i", literal->data.l_int8); break;
+        case LITERAL_INT16: printf("%i", literal->data.l_int16); break;
+        case LITERAL_INT: printf("%i", literal->data.l_int); break;
+        case LITERAL_INT64: printf("%lli", literal->data.l_int64); break;
+        case LITERAL_UINT8: printf("%u", literal->data.l_uint8); break;
+        case LITERAL_UINT16: printf("%u", literal->data.l_uint16); break;
+        case LITERAL_UINT: printf("%u", literal->data.l_uint); break;
+        case LITERAL_UINT64: printf("%llu", literal->data.l_uint64); break;
+        case LITERAL_FLOAT: printf("%.9g", literal->data.l_float); break;
+        case LITERAL_FLOAT64: printf("%.17g", literal->data.l_float64); break;
+    }
+}
+
+static void dump_exprs(Expr *exprs, int count) {
+    putchar('[');
+    for (int i = 0; i < count; i++) {
+        if (i > 0) putchar(',');
+        dump_expr(exprs + i);
+    }
+    putchar(']');
+}
+
+static void dump_expr(Expr *expr) {
+    putchar('{');
+    switch (expr->type) {
+        case EXPR_PAREN:
+            printf("\"kind\":\"paren\",\"expr\":");
+            dump_expr(expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            printf("\"kind\":\"unary\",\"operator\":\"%c\",\"operand\":", expr->data.unary.type);
+            dump_expr(expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            printf("\"kind\":\"binary\",\"operator\":\"%s\",\"lhs\":", string_operators[expr->data.binary.operator - TOKEN_OP_MIN]);
+            dump_expr(expr->data.binary.lhs);
+            printf(",\"rhs\":");
+            dump_expr(expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            printf("\"kind\":\"cast\",\"operand\":");
+            dump_expr(expr->data.typecast.operand);
+            printf(",\"to\":");
+            dump_type(&expr->data.typecast.cast_to);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            printf("\"kind\":\"member\",\"operand\":");
+            dump_expr(expr->data.access_member.operand);
+            printf(",\"member\":");
+            dump_string(string_cache_get(expr->data.access_member.member));
+            break;
+        case EXPR_ACCESS_ARRAY:
+            printf("\"kind\":\"index\",\"operand\":");
+            dump_expr(expr->data.access_array.operand);
+            printf(",\"index\":");
+            dump_expr(expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION:
+            printf("\"kind\":\"function\",\"inline\":%s,\"type\":", expr->data.function.is_inline ? "true" : "false");
+            dump_type(&expr->data.function.type);
+            printf(",\"body\":");
+            dump_scope(expr->data.function.scope);
+            break;
+        case EXPR_FUNCTION_CALL:
+            printf("\"kind\":\"call\",\"function\":");
+            dump_expr(expr->data.function_call.function);
+            printf(",\"args\":");
+            dump_exprs(expr->data.function_call.params, expr->data.function_call.param_count);
+            break;
+        case EXPR_ID:
+            printf("\"kind\":\"id\",\"name\":");
+            dump_string(string_cache_get(expr->data.id.declaration_id));
+            break;
+        case EXPR_LITERAL:
+            printf("\"kind\":\"literal\",");
+            dump_literal(&expr->data.literal);
+            break;
+        case EXPR_LITERAL_BOOL:
+            printf("\"kind\":\"literal\",\"type\":\"bool\",\"value\":%s", expr->data.literal_bool ? "true" : "false");
+            break;
+        case EXPR_LITERAL_ARRAY:
+            printf("\"kind\":\"array\",\"type\":");
+            dump_type(&expr->data.literal_array.type);
+            printf(",\"count\":");
+            dump_expr(expr->data.literal_array.count);
+            printf(",\"items\":");
+            dump_exprs(expr->data.literal_array.members, expr->data.literal_array.allocated_count);
+            break;
+        case EXPR_VECTOR: {
+            static const char *ops[] = {
+                [EXPR_VECTOR_BUILD] = "build", [EXPR_VECTOR_LOAD] = "load", [EXPR_VECTOR_STORE] = "store", [EXPR_VECTOR_SHUFFLE] = "shuffle",
+                [EXPR_VECTOR_TOTAL] = "total", [EXPR_VECTOR_MIN] = "min", [EXPR_VECTOR_MAX] = "max",
+            };
+            printf("\"kind\":\"vector\",\"op\":\"%s\",\"type\":", ops[expr->data.vector.op]);
+            dump_type(&expr->data.vector.type);
+            printf(",\"args\":");
+            dump_exprs(expr->data.vector.args, expr->data.vector.arg_count);
+        } break;
+        case EXPR_REGEX:
+            printf("\"kind\":\"regex\",\"pattern\":");
+            dump_string(string_cache_get(expr->data.regex));
+            break;
+        case EXPR_FILE: {
+            static const char *ops[] = { [EXPR_FILE_MAP] = "map", [EXPR_FILE_OPEN] = "open", [EXPR_FILE_NEXT] = "next", [EXPR_FILE_CLOSE] = "close" };
+            printf("\"kind\":\"file\",\"op\":\"%s\",\"args\":", ops[expr->data.file.op]);
+            dump_exprs(expr->data.file.args, expr->data.file.arg_count);
+        } break;
+    }
+    putchar(',');
+    dump_location(expr->location);
+    putchar('}');
+}
+
+static void dump_statement(Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            dump_declaration(&statement->data.declaration);
+            return;
+        case STATEMENT_INCREMENT:
+        case STATEMENT_DEINCREMENT:
+            printf("{\"kind\":\"%s\",\"expr\":", statement->type == STATEMENT_INCREMENT ? "increment" : "decrement");
+            dump_expr(statement->type == STATEMENT_INCREMENT ? &statement->data.increment : &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            printf("{\"kind\":\"assign\",\"operator\":\"%s\",\"assignee\":", string_assigns[statement->data.assign.type - TOKEN_ASSIGN_MIN]);
+            dump_expr(&statement->data.assign.assignee);
+            printf(",\"value\":");
+            dump_expr(&statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            printf("{\"kind\":\"expr\",\"expr\":");
+            dump_expr(&statement->data.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            printf("{\"kind\":\"%s\",\"label\":", statement->type == STATEMENT_LABEL ? "label" : "goto");
+            dump_string(string_cache_get(statement->type == STATEMENT_LABEL ? statement->data.label : statement->data.label_goto));
+            break;
+        case STATEMENT_RETURN:
+            printf("{\"kind\":\"return\"");
+            if (statement->data.return_value.exists) {
+                printf(",\"value\":");
+                dump_expr(&statement->data.return_value.expr);
+            }
+            break;
+    }
+    putchar(',');
+    dump_location(statement->location);
+    putchar('}');
+}
+
+static void dump_scopes(Scope *scopes, int count) {
+    putchar('[');
+    for (int i = 0; i < count; i++) {
+        if (i > 0) putchar(',');
+        dump_scope(scopes + i);
+    }
+    putchar(']');
+}
+
+static void dump_scope(Scope *scope) {
+    if (scope->type == SCOPE_STATEMENT) {
+        dump_statement(&scope->data.statement);
+        return;
+    }
+    putchar('{');
+    switch (scope->type) {
+        case SCOPE_BLOCK:
+            printf("\"kind\":\"block\",\"scopes\":");
+            dump_scopes(scope->data.block.scopes, scope->data.block.scope_count);
+            break;
+        case SCOPE_STATEMENT:
+            break;
+        case SCOPE_CONDITIONAL:
+            printf("\"kind\":\"if\",\"condition\":");
+            dump_expr(&scope->data.conditional.condition);
+            printf(",\"then\":");
+            dump_scope(scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) {
+                printf(",\"else\":");
+                dump_scope(scope->data.conditional.scope_else);
+            }
+            break;
+        case SCOPE_LOOP_FOR:
+            printf("\"kind\":\"for\",\"parallel\":%s,\"init\":", scope->data.loop_for.parallel ? "true" : "false");
+            dump_statement(&scope->data.loop_for.init);
+            printf(",\"condition\":");
+            dump_expr(&scope->data.loop_for.expr);
+            printf(",\"step\":");
+            dump_statement(&scope->data.loop_for.step);
+            printf(",\"body\":");
+            dump_scope(scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            printf("\"kind\":\"for_each\",\"parallel\":%s,\"element\":", scope->data.loop_for_each.parallel ? "true" : "false");
+            dump_string(string_cache_get(scope->data.loop_for_each.element));
+            printf(",\"array\":");
+            dump_expr(&scope->data.loop_for_each.array);
+            printf(",\"body\":");
+            dump_scope(scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            printf("\"kind\":\"while\",\"condition\":");
+            dump_expr(&scope->data.loop_while.expr);
+            printf(",\"body\":");
+            dump_scope(scope->data.loop_while.scope);
+            break;
+        case SCOPE_MATCH:
+            printf("\"kind\":\"match\",\"expr\":");
+            dump_expr(&scope->data.match.expr);
+            printf(",\"cases\":[");
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                if (i > 0) putchar(',');
+                printf("{\"member\":");
+                dump_string(string_cache_get(match_case->match_id));
+                if (match_case->declares) {
+                    printf(",\"binds\":");
+                    dump_string(string_cache_get(match_case->declared_var.data.declaration.id));
+                }
+                printf(",\"scopes\":");
+                dump_scopes(match_case->scopes, match_case->scope_count);
+                putchar(',');
+                dump_location(match_case->location);
+                putchar('}');
+            }
+            putchar(']');
+            break;
+    }
+    putchar(',');
+    dump_location(scope->location);
+    putchar('}');
+}
+
+static void dump_declaration(Declaration *decl) {
+    printf("{\"kind\":");
+    switch (decl->type) {
+        case DECLARATION_VAR:
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+                printf("\"constant\",\"name\":");
+                dump_string(string_cache_get(decl->id));
+                if (decl->data.var.data.constant.type_explicit) {
+                    printf(",\"type\":");
+                    dump_type(&decl->data.var.data.constant.type);
+                }
+                printf(",\"value\":");
+                dump_expr(&decl->data.var.data.constant.value);
+            } else {
+                printf("\"variable\",\"name\":");
+                dump_string(string_cache_get(decl->id));
+                printf(",\"type\":");
+                dump_type(&decl->data.var.data.mutable.type);
+                if (decl->data.var.data.mutable.value_exists) {
+                    printf(",\"value\":");
+                    dump_expr(&decl->data.var.data.mutable.value);
+                }
+            }
+            break;
+        case DECLARATION_ENUM:
+            printf("\"enum\",\"name\":");
+            dump_string(string_cache_get(decl->id));
+            printf(",\"members\":[");
+            for (int i = 0; i < decl->data.enumeration.member_count; i++) {
+                if (i > 0) putchar(',');
+                dump_string(string_cache_get(decl->data.enumeration.members[i]));
+            }
+            putchar(']');
+            break;
+        case DECLARATION_STRUCT:
+        case DECLARATION_UNION:
+            printf("\"%s\",\"name\":", decl->type == DECLARATION_STRUCT ? "struct" : "union");
+            dump_string(string_cache_get(decl->id));
+            printf(",\"soa\":%s,\"members\":[", decl->data.struct_union.soa ? "true" : "false");
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) {
+                if (i > 0) putchar(',');
+                printf("{\"name\":");
+                dump_string(string_cache_get(decl->data.struct_union.members[i].id));
+                printf(",\"type\":");
+                dump_type(&decl->data.struct_union.members[i].type);
+                putchar('}');
+            }
+            putchar(']');
+            break;
+        case DECLARATION_SUM:
+            printf("\"sum\",\"name\":");
+            dump_string(string_cache_get(decl->id));
+            printf(",\"members\":[");
+            for (int i = 0; i < decl->data.sum.member_count; i++) {
+                if (i > 0) putchar(',');
+                printf("{\"name\":");
+                dump_string(string_cache_get(decl->data.sum.members[i].id));
+                if (decl->data.sum.members[i].type_exists) {
+                    printf(",\"type\":");
+                    dump_type(&decl->data.sum.members[i].type);
+                }
+                putchar('}');
+            }
+            putchar(']');
+            break;
+    }
+    if (decl->exported) printf(",\"exported\":true");
+    putchar(',');
+    dump_location(decl->location);
+    putchar('}');
+}
+
+void dump_ast(SourceFile *file, DumpFormat format) {
+    if (format == DUMP_FORMAT_TEXT) {
+        source_file_print(file);
+        return;
+    }
+    putchar('[');
+    for (int i = 0; i < file->declaration_count; i++) {
+        printf("%s\n", i ? "," : "");
+        dump_declaration(file->declarations + i);
+    }
+    printf("\n]\n");
+}
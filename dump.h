@@ -0,0 +1,16 @@
+#ifndef CREED_DUMP_H
+#define CREED_DUMP_H
+
+#include "lexer.h"
+#include "parser.h"
+
+typedef enum DumpFormat {
+    DUMP_FORMAT_TEXT, // The colored source the printers in the parser write, for people.
+    DUMP_FORMAT_JSON, // Compact JSON with one top-level item per line, for tools.
+} DumpFormat;
+
+// Both write to stdout. Lexes a copy of the lexer, so the lexer itself is left where it was.
+void dump_tokens(Lexer lexer, DumpFormat format);
+void dump_ast(SourceFile *file, DumpFormat format);
+
+#endif
@@ -0,0 +1,468 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "escape.h"
+#include "constant.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+
+#define ESCAPE_PASS "escape"
+
+// An array variable or array literal. Arrays are views, so assigning one to a variable shares its items with that variable.
+typedef struct EscapeNode {
+    void *key; // The Declaration of a variable or the Expr of a literal.
+    bool literal;
+    int depth; // How many blocks deep it is in the function.
+    int loop; // The innermost loop it is in, or -1.
+    bool escapes; // Its items can be used after the function returns.
+
+    int *edges; // Nodes that its items are assigned to.
+    int edge_count;
+    int edge_count_alloc;
+} EscapeNode;
+
+// A loop in the function. If every array literal in its body that goes in the arena is only reached from variables in the body,
+// the arena can be reset to where it was before the loop at the start of every iteration.
+typedef struct EscapeLoop {
+    Scope *scope;
+    int depth; // How many blocks deep its body is.
+    int parent; // The loop it is in, or -1.
+    bool literals;
+    bool kept; // A literal in it is used after the iteration it was allocated in.
+} EscapeLoop;
+
+typedef struct Escape {
+    SourceFile *file;
+    bool **param_escapes; // For every function in the file, whether the items of each array parameter can outlive the call.
+    bool changed;
+
+    // The function being analyzed.
+    EscapeNode *nodes;
+    int node_count;
+    int node_count_alloc;
+    int depth;
+    EscapeLoop *loops;
+    int loop_count;
+    int loop_count_alloc;
+    int loop; // The loop being visited, or -1.
+
+    int stack;
+    int arena;
+    int heap;
+    bool final; // Only remark on the last round.
+} Escape;
+
+static int escape_node_find(Escape *escape, void *key) {
+    for (int i = 0; i < escape->node_count; i++) {
+        if (escape->nodes[i].key == key) return i;
+    }
+    return -1;
+}
+
+static int escape_node_add(Escape *escape, void *key, bool literal) {
+    escape->node_count++;
+    if (escape->node_count > escape->node_count_alloc) {
+        escape->node_count_alloc = escape->node_count_alloc == 0 ? 16 : escape->node_count_alloc * 2;
+        escape->nodes = allocator_realloc(ALLOCATOR_OPTIMIZE, escape->nodes, sizeof(EscapeNode) * escape->node_count_alloc);
+    }
+    escape->nodes[escape->node_count - 1] = (EscapeNode) { .key = key, .literal = literal, .depth = escape->depth, .loop = escape->loop };
+    return escape->node_count - 1;
+}
+
+static void escape_edge_add(Escape *escape, int from, int to) {
+    EscapeNode *node = escape->nodes + from;
+    node->edge_count++;
+    if (node->edge_count > node->edge_count_alloc) {
+        node->edge_count_alloc = node->edge_count_alloc == 0 ? 2 : node->edge_count_alloc * 2;
+        node->edges = allocator_realloc(ALLOCATOR_OPTIMIZE, node->edges, sizeof(int) * node->edge_count_alloc);
+    }
+    node->edges[node->edge_count - 1] = to;
+}
+
+static void escape_mark(Escape *escape, int node) {
+    if (node >= 0) escape->nodes[node].escapes = true;
+}
+
+static bool escape_is_array_declaration(Declaration *decl) {
+    if (decl->type != DECLARATION_VAR) return false;
+    if (decl->data.var.type == DECLARATION_VAR_MUTABLE) return decl->data.var.data.mutable.type.type == TYPE_ARRAY;
+    return decl->data.var.data.constant.type.type == TYPE_ARRAY;
+}
+
+// The node whose items an expression evaluates to, or -1 if they aren't from this function.
+static int escape_source(Escape *escape, Expr *expr) {
+    while (expr->type == EXPR_PAREN) expr = expr->data.parenthesized;
+    if (expr->type == EXPR_LITERAL_ARRAY) return escape_node_find(escape, expr);
+    if (expr->type == EXPR_ID) return escape_node_find(escape, expr->data.id.declaration);
+    return -1;
+}
+
+static Declaration *escape_lval_declaration(Expr *expr) {
+    while (true) {
+        switch (expr->type) {
+            case EXPR_PAREN: expr = expr->data.parenthesized; break;
+            case EXPR_ACCESS_MEMBER: expr = expr->data.access_member.operand; break;
+            case EXPR_ACCESS_ARRAY: expr = expr->data.access_array.operand; break;
+            case EXPR_ID: return expr->data.id.declaration;
+            default: return NULL;
+        }
+    }
+}
+
+// Whether a call could keep the items of the array passed as this argument.
+static bool escape_argument_escapes(Escape *escape, Expr *function, int idx) {
+    while (function->type == EXPR_PAREN) function = function->data.parenthesized;
+    if (function->type != EXPR_ID) return true;
+    Declaration *decl = function->data.id.declaration;
+    if (decl < escape->file->declarations || escape->file->declarations + escape->file->declaration_count <= decl) return true;
+    bool *params = escape->param_escapes[decl - escape->file->declarations];
+    return !params || params[idx];
+}
+
+static void escape_function(Escape *escape, Expr *function, bool *param_escapes);
+static void escape_visit_scope(Escape *escape, Scope *scope);
+
+static void escape_visit_expr(Escape *escape, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            escape_visit_expr(escape, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            // A pointer to an array or its items can be kept anywhere.
+            if (expr->data.unary.type == EXPR_UNARY_REF) {
+                Declaration *decl = escape_lval_declaration(expr->data.unary.operand);
+                if (decl) escape_mark(escape, escape_node_find(escape, decl));
+            }
+            escape_visit_expr(escape, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            escape_visit_expr(escape, expr->data.binary.lhs);
+            escape_visit_expr(escape, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            escape_visit_expr(escape, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            if (!strcmp(string_cache_get(expr->data.access_member.member), "data")) escape_mark(escape, escape_source(escape, expr->data.access_member.operand));
+            escape_visit_expr(escape, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            escape_visit_expr(escape, expr->data.access_array.operand);
+            escape_visit_expr(escape, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION: {
+            // A function inside of a function has its own arena.
+            Escape inner = *escape;
+            inner.nodes = NULL;
+            inner.node_count = 0;
+            inner.node_count_alloc = 0;
+            inner.loops = NULL;
+            inner.loop_count = 0;
+            inner.loop_count_alloc = 0;
+            escape_function(&inner, expr, NULL);
+            escape->stack = inner.stack;
+            escape->arena = inner.arena;
+            escape->heap = inner.heap;
+        } break;
+        case EXPR_FUNCTION_CALL:
+            escape_visit_expr(escape, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                Expr *param = expr->data.function_call.params + i;
+                escape_visit_expr(escape, param);
+                if (escape_argument_escapes(escape, expr->data.function_call.function, i)) escape_mark(escape, escape_source(escape, param));
+            }
+            break;
+        case EXPR_LITERAL_ARRAY:
+            escape_visit_expr(escape, expr->data.literal_array.count);
+            escape_node_add(escape, expr, true);
+            // Arrays in arrays are not followed, so they are treated as escaping.
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
+                Expr *member = expr->data.literal_array.members + i;
+                escape_visit_expr(escape, member);
+                escape_mark(escape, escape_source(escape, member));
+            }
+            break;
+        case EXPR_VECTOR:
+            // Loads and stores only use the items of an array while they run.
+            for (int i = 0; i < expr->data.vector.arg_count; i++) escape_visit_expr(escape, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            // Paths are only read while the file is opened.
+            for (int i = 0; i < expr->data.file.arg_count; i++) escape_visit_expr(escape, expr->data.file.args + i);
+            break;
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+// The items of value are assigned to the variable decl. Anything that isn't a variable of this function is somewhere the items can escape to.
+static void escape_assign(Escape *escape, Expr *assignee, Declaration *decl, Expr *value) {
+    int source = escape_source(escape, value);
+    if (source < 0) return;
+
+    if (assignee) {
+        while (assignee->type == EXPR_PAREN) assignee = assignee->data.parenthesized;
+        decl = assignee->type == EXPR_ID ? assignee->data.id.declaration : NULL;
+    }
+    int target = decl ? escape_node_find(escape, decl) : -1;
+    if (target < 0) escape_mark(escape, source);
+    else escape_edge_add(escape, source, target);
+}
+
+static void escape_visit_statement(Escape *escape, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION: {
+            Declaration *decl = &statement->data.declaration;
+            if (decl->type != DECLARATION_VAR) break;
+            Expr *value = NULL;
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) value = &decl->data.var.data.constant.value;
+            else if (decl->data.var.data.mutable.value_exists) value = &decl->data.var.data.mutable.value;
+
+            if (value) escape_visit_expr(escape, value);
+            if (escape_is_array_declaration(decl)) {
+                escape_node_add(escape, decl, false);
+                if (value) escape_assign(escape, NULL, decl, value);
+            }
+        } break;
+        case STATEMENT_INCREMENT:
+            escape_visit_expr(escape, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            escape_visit_expr(escape, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            escape_visit_expr(escape, &statement->data.assign.assignee);
+            escape_visit_expr(escape, &statement->data.assign.value);
+            escape_assign(escape, &statement->data.assign.assignee, NULL, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            escape_visit_expr(escape, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) {
+                escape_visit_expr(escape, &statement->data.return_value.expr);
+                escape_mark(escape, escape_source(escape, &statement->data.return_value.expr));
+            }
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+// Enters a loop whose body is the given number of blocks deeper than the loop itself.
+static void escape_loop_enter(Escape *escape, Scope *scope, int body_depth) {
+    escape->loop_count++;
+    if (escape->loop_count > escape->loop_count_alloc) {
+        escape->loop_count_alloc = escape->loop_count_alloc == 0 ? 8 : escape->loop_count_alloc * 2;
+        escape->loops = allocator_realloc(ALLOCATOR_OPTIMIZE, escape->loops, sizeof(EscapeLoop) * escape->loop_count_alloc);
+    }
+    int loop = escape->loop_count - 1;
+    escape->loops[loop] = (EscapeLoop) { .scope = scope, .depth = escape->depth + body_depth, .parent = escape->loop };
+    escape->loop = loop;
+}
+
+static void escape_loop_exit(Escape *escape) {
+    escape->loop = escape->loops[escape->loop].parent;
+}
+
+// Every scope inside of an if or a loop is a block in C, even if it is a single statement.
+static void escape_visit_block(Escape *escape, Scope *scope) {
+    escape->depth++;
+    escape_visit_scope(escape, scope);
+    escape->depth--;
+}
+
+static void escape_visit_scope(Escape *escape, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            escape_visit_statement(escape, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            escape_visit_expr(escape, &scope->data.conditional.condition);
+            escape_visit_block(escape, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) escape_visit_block(escape, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            escape_loop_enter(escape, scope, 2);
+            escape->depth++;
+            escape_visit_statement(escape, &scope->data.loop_for.init);
+            escape_visit_expr(escape, &scope->data.loop_for.expr);
+            escape_visit_statement(escape, &scope->data.loop_for.step);
+            escape_visit_block(escape, scope->data.loop_for.scope);
+            escape->depth--;
+            escape_loop_exit(escape);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            escape_loop_enter(escape, scope, 2);
+            escape->depth++;
+            escape_visit_expr(escape, &scope->data.loop_for_each.array);
+            escape->depth++;
+            if (escape_is_array_declaration(scope->data.loop_for_each.element_declaration)) escape_node_add(escape, scope->data.loop_for_each.element_declaration, false);
+            escape_visit_scope(escape, scope->data.loop_for_each.scope);
+            escape->depth -= 2;
+            escape_loop_exit(escape);
+            break;
+        case SCOPE_LOOP_WHILE:
+            escape_loop_enter(escape, scope, 1);
+            escape_visit_expr(escape, &scope->data.loop_while.expr);
+            escape_visit_block(escape, scope->data.loop_while.scope);
+            escape_loop_exit(escape);
+            break;
+        case SCOPE_BLOCK:
+            escape->depth++;
+            for (int i = 0; i < scope->data.block.scope_count; i++) escape_visit_scope(escape, scope->data.block.scopes + i);
+            escape->depth--;
+            break;
+        case SCOPE_MATCH:
+            escape_visit_expr(escape, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                escape->depth++;
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) escape_visit_scope(escape, scope->data.match.cases[i].scopes + j);
+                escape->depth--;
+            }
+            break;
+    }
+}
+
+// Follows the assignments from a node, and returns if the items can escape the function. Depth is set to the shallowest variable they reach.
+static bool escape_reach(Escape *escape, int start, bool *visited, int *depth) {
+    bool escapes = false;
+    int *stack = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(int) * escape->node_count);
+    int stack_count = 0;
+    memset(visited, 0, sizeof(bool) * escape->node_count);
+    visited[start] = true;
+    stack[stack_count++] = start;
+    *depth = escape->nodes[start].depth;
+
+    while (stack_count > 0) {
+        EscapeNode *node = escape->nodes + stack[--stack_count];
+        if (node->escapes) escapes = true;
+        if (node->depth < *depth) *depth = node->depth;
+        for (int i = 0; i < node->edge_count; i++) {
+            if (visited[node->edges[i]]) continue;
+            visited[node->edges[i]] = true;
+            stack[stack_count++] = node->edges[i];
+        }
+    }
+    allocator_free(stack);
+    return escapes;
+}
+
+static void escape_function(Escape *escape, Expr *function, bool *param_escapes) {
+    escape->depth = 0;
+    escape->loop = -1;
+    int param_count = function->data.function.type.data.function.param_count;
+    for (int i = 0; i < param_count; i++) {
+        Declaration *param = function->data.function.param_declarations + i;
+        if (escape_is_array_declaration(param)) escape_node_add(escape, param, false);
+    }
+    escape_visit_scope(escape, function->data.function.scope);
+
+    bool *visited = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(bool) * (escape->node_count + 1));
+    for (int i = 0; i < param_count && param_escapes; i++) {
+        int node = escape_node_find(escape, function->data.function.param_declarations + i);
+        int depth;
+        bool escapes = node >= 0 && escape_reach(escape, node, visited, &depth);
+        if (escapes && !param_escapes[i]) {
+            param_escapes[i] = true;
+            escape->changed = true;
+        }
+    }
+
+    function->data.function.uses_arena = false;
+    for (int i = 0; i < escape->node_count; i++) {
+        if (!escape->nodes[i].literal) continue;
+        Expr *literal = escape->nodes[i].key;
+        int depth;
+        bool escapes = escape_reach(escape, i, visited, &depth);
+        bool size_constant = constant_is_folded(literal->data.literal_array.count);
+
+        if (escapes) {
+            literal->data.literal_array.storage = ARRAY_STORAGE_HEAP;
+            escape->heap++;
+            if (escape->final) remark(literal->location, ESCAPE_PASS, "array literal allocated on the heap, it can be used after the function returns");
+        } else if (depth < escape->nodes[i].depth || !size_constant) {
+            literal->data.literal_array.storage = ARRAY_STORAGE_ARENA;
+            function->data.function.uses_arena = true;
+            escape->arena++;
+            for (int loop = escape->nodes[i].loop; loop >= 0; loop = escape->loops[loop].parent) {
+                escape->loops[loop].literals = true;
+                if (depth < escape->loops[loop].depth) escape->loops[loop].kept = true;
+            }
+            if (escape->final) remark(literal->location, ESCAPE_PASS, size_constant
+                ? "array literal allocated in the arena of the function, it is used outside of its block"
+                : "array literal allocated in the arena of the function, its size is only known at runtime");
+        } else {
+            literal->data.literal_array.storage = ARRAY_STORAGE_STACK;
+            escape->stack++;
+            if (escape->final) remark(literal->location, ESCAPE_PASS, "array literal allocated on the stack");
+        }
+    }
+    allocator_free(visited);
+
+    for (int i = 0; i < escape->loop_count; i++) {
+        EscapeLoop *loop = escape->loops + i;
+        bool resets = loop->literals && !loop->kept;
+        switch (loop->scope->type) {
+            case SCOPE_LOOP_FOR:
+                loop->scope->data.loop_for.resets_arena = resets;
+                break;
+            case SCOPE_LOOP_FOR_EACH:
+                loop->scope->data.loop_for_each.resets_arena = resets;
+                break;
+            default:
+                loop->scope->data.loop_while.resets_arena = resets;
+                break;
+        }
+        if (resets && escape->final) remark(loop->scope->location, ESCAPE_PASS, "arena reset on every iteration of the loop, the array literals in it are dead after the iteration");
+    }
+    allocator_free(escape->loops);
+    escape->loops = NULL;
+    escape->loop_count = 0;
+    escape->loop_count_alloc = 0;
+
+    for (int i = 0; i < escape->node_count; i++) allocator_free(escape->nodes[i].edges);
+    allocator_free(escape->nodes);
+    escape->nodes = NULL;
+    escape->node_count = 0;
+    escape->node_count_alloc = 0;
+}
+
+void escape_analyze(SourceFile *file) {
+    Escape escape = { .file = file };
+    escape.param_escapes = allocator_calloc(ALLOCATOR_OPTIMIZE, file->declaration_count, sizeof(bool *));
+    for (int i = 0; i < file->declaration_count; i++) {
+        if (!declaration_is_function(file->declarations + i)) continue;
+        Expr *function = &file->declarations[i].data.var.data.constant.value;
+        escape.param_escapes[i] = allocator_calloc(ALLOCATOR_OPTIMIZE, function->data.function.type.data.function.param_count + 1, sizeof(bool));
+    }
+
+    // Whether a parameter escapes depends on the functions it is passed on to, so repeat until nothing changes.
+    // Parameters only ever go from not escaping to escaping, so this ends.
+    do {
+        escape.changed = false;
+        escape.stack = escape.arena = escape.heap = 0;
+        for (int i = 0; i < file->declaration_count; i++) {
+            if (!declaration_is_function(file->declarations + i)) continue;
+            escape_function(&escape, &file->declarations[i].data.var.data.constant.value, escape.param_escapes[i]);
+        }
+        if (!escape.changed && !escape.final) {
+            escape.final = true;
+            escape.changed = true;
+        } else if (escape.final) {
+            break;
+        }
+    } while (escape.changed);
+
+    for (int i = 0; i < file->declaration_count; i++) allocator_free(escape.param_escapes[i]);
+    allocator_free(escape.param_escapes);
+
+    remark_summary(ESCAPE_PASS, "%i array literals on the stack, %i in function arenas, %i on the heap", escape.stack, escape.arena, escape.heap);
+}
@@ -0,0 +1,14 @@
+#ifndef CREED_ESCAPE_H
+#define CREED_ESCAPE_H
+
+#include "parser.h"
+
+// Decides where the items of every array literal in a function live, by following the variables the array is assigned to.
+//  - On the stack if it has a constant size and never leaves the block it is in.
+//  - In an arena that is freed when the function returns if it leaves its block but not the function, or its size is only known at runtime.
+//  - On the heap if it can outlive the function: it is returned, stored in a global, a struct, another array or behind a pointer,
+//    or passed to a function that does one of those with it.
+// The code generator depends on this, so it always has to run after typechecking and the other passes.
+void escape_analyze(SourceFile *file);
+
+#endif
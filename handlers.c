@@ -1,15 +1,60 @@
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "allocator.h"
+#include "constant.h"
 #include "handlers.h"
+#include "layout.h"
 #include "parser.h"
+#include "regex.h"
 #include "string_cache.h"
 #include "symbol_table.h"
+#include "trace.h"
 
 int indent;
 int array_count;
+int for_each_count;
+int match_count;
+int parallel_count;
+int regex_count;
+// Set when an array literal is allocated in an arena or on the heap, so the allocation functions are written out.
+static bool array_allocations;
+// Set when there is a parallel loop, so the thread pool is written out.
+static bool parallel_loops;
+// Set when a file is mapped or opened, or the file type is printed, so the file functions are written out.
+static bool file_io;
+// Set when an array literal is allocated in the arena of the function, so the body of a parallel loop knows it needs one of its own.
+static bool arena_used;
+// Numbers the marks loops reset the arena to.
+static int arena_mark_count;
+// The function whose body is being written, so returns know to free its arena first.
+static Expr * current_function;
+// The file being written, so the bodies of parallel loops can tell global variables from local ones.
+static SourceFile * current_file;
+// The bodies of parallel loops and the matchers of regexes are written here as functions of their own, before the declaration they are in.
+static FILE * outlined_file;
+
+// Arrays are emitted as one struct per item type, so every array type that gets printed is recorded here
+// and the structs are written at the top of the file once the rest of it is done.
+static struct {
+    const char * name;
+    const char * item_type;
+    Declaration * soa; // The struct, if the array is stored member by member.
+} * array_types;
+static int array_count_alloc;
+
+// Vectors are GCC vector types, recorded like arrays so their typedefs and helper functions are written at the top of the file.
+static struct {
+    const char * name;
+    TokenType element;
+    int width;
+    bool memory; // Loaded from or stored to an array, which needs the array struct.
+} * vector_types;
+static int vector_count;
+static int vector_count_alloc;
 
 // Prints the appropriate number of 4-space indents
 void write_indent(int count, FILE * outfile) {
@@ -18,23 +63,76 @@ void write_indent(int count, FILE * outfile) {
     }
 }
 
-// TO DO: Figure out how to parse identifier for arrays
+// Type names are kept in the string cache so they live as long as the program does.
+static const char * intern_type(const char * format, const char * name) {
+    char * c_type = allocator_malloc(ALLOCATOR_CODEGEN, strlen(format) + strlen(name) + 1);
+    sprintf(c_type, format, name);
+    return string_cache_get(string_cache_insert(c_type));
+}
+
+// The part of the array struct name that comes after Array_, so [][]char becomes Array_Array_char.
+static const char * get_array_item_name(Type * item) {
+    switch (item->type) {
+        case TYPE_PRIMITIVE:
+            return string_keywords[item->data.primitive - TOKEN_KEYWORD_MIN];
+        case TYPE_ID:
+            return string_cache_get(item->data.id.type_declaration_id);
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+            return intern_type("ptr_%s", get_array_item_name(item->data.sub_type));
+        case TYPE_ARRAY:
+        case TYPE_VECTOR:
+            return get_type(*item);
+        case TYPE_FUNCTION:
+            break;
+    }
+    assert(false);
+    return NULL;
+}
+
+static int get_vector_index(Type vector) {
+    char format[32];
+    sprintf(format, "Vec%i_%%s", vector.data.vector.width);
+    const char * name = intern_type(format, string_keywords[vector.data.vector.element - TOKEN_KEYWORD_MIN]);
+    for (int i = 0; i < vector_count; i++) {
+        if (vector_types[i].name == name) return i;
+    }
+    vector_count++;
+    if (vector_count > vector_count_alloc) {
+        vector_count_alloc = vector_count_alloc == 0 ? 4 : vector_count_alloc * 2;
+        vector_types = allocator_realloc(ALLOCATOR_CODEGEN, vector_types, sizeof(*vector_types) * vector_count_alloc);
+    }
+    vector_types[vector_count - 1].name = name;
+    vector_types[vector_count - 1].element = vector.data.vector.element;
+    vector_types[vector_count - 1].width = vector.data.vector.width;
+    vector_types[vector_count - 1].memory = false;
+    return vector_count - 1;
+}
+
 const char * get_complex_type(Type creadz_type) {
-    const char * c_prim_type = get_type(*creadz_type.data.sub_type);
+    const char * c_sub_type = get_type(*creadz_type.data.sub_type);
 
     if (creadz_type.type == TYPE_PTR || creadz_type.type == TYPE_PTR_NULLABLE) {
-        char c_type[16];
-        sprintf(c_type, "%s *", c_prim_type);
-        const char * c_type_out = c_type;
-        return c_type_out;
+        return intern_type("%s *", c_sub_type);
     }
-    else if (creadz_type.type == TYPE_ARRAY) {
 
-        return c_prim_type;
+    const char * name = intern_type("Array_%s", get_array_item_name(creadz_type.data.sub_type));
+    for (int i = 0; i < array_count; i++) {
+        if (array_types[i].name == name) return name;
     }
-    else {
-        return c_prim_type;
+    Declaration * soa = type_is_soa(creadz_type.data.sub_type) ? creadz_type.data.sub_type->data.id.type_declaration : NULL;
+    // The member arrays of an soa array are printed first too.
+    for (int i = 0; soa && i < soa->data.struct_union.member_count; i++) get_type(soa->data.struct_union.members[i].type);
+    // The item type was printed first, so arrays of arrays are always recorded after the arrays they contain.
+    array_count++;
+    if (array_count > array_count_alloc) {
+        array_count_alloc = array_count_alloc == 0 ? 4 : array_count_alloc * 2;
+        array_types = allocator_realloc(ALLOCATOR_CODEGEN, array_types, sizeof(*array_types) * array_count_alloc);
     }
+    array_types[array_count - 1].name = name;
+    array_types[array_count - 1].item_type = c_sub_type;
+    array_types[array_count - 1].soa = soa;
+    return name;
 }
 
 const char * get_type(Type creadz_type) {
@@ -77,6 +175,10 @@ const char * get_type(Type creadz_type) {
             case TOKEN_KEYWORD_TYPE_BOOL:
                 c_prim_type = "int";
                 break;
+            case TOKEN_KEYWORD_FILE:
+                file_io = true;
+                c_prim_type = "struct CreedFile *";
+                break;
             default:
                 assert(false);
         }
@@ -85,13 +187,580 @@ const char * get_type(Type creadz_type) {
     else if (creadz_type.type == TYPE_ARRAY || creadz_type.type == TYPE_PTR || creadz_type.type ==  TYPE_PTR_NULLABLE) {
         return get_complex_type(creadz_type);
     }
+    else if (creadz_type.type == TYPE_VECTOR) {
+        int idx = get_vector_index(creadz_type);
+        return vector_types[idx].name;
+    }
+    else if (creadz_type.type == TYPE_ID) {
+        Declaration * declaration = creadz_type.data.id.type_declaration;
+        const char * keyword = declaration->type == DECLARATION_UNION ? "union %s" : declaration->type == DECLARATION_ENUM ? "enum %s" : "struct %s";
+        return intern_type(keyword, string_cache_get(declaration->id));
+    }
     else {
         return "";
     }
 }
 
-void handle_arrays(Type * type) {
+// Array literals that outlive their block go in an arena that belongs to one call of a function. The first 4096 bytes are
+// in the arena itself on the stack of the function, and anything beyond that is allocated in chunks that are all freed when it returns.
+// An arena of NULL allocates on the heap instead, for arrays that outlive the function.
+// A loop whose arrays are dead after each iteration marks the arena before it starts, and resets it to the mark on every iteration.
+static void handle_arena(FILE * outfile) {
+    fprintf(outfile,
+        "#include <string.h>\n\n"
+        "typedef union CreedArenaChunk {\n"
+        "    union CreedArenaChunk *next;\n"
+        "    long double align;\n"
+        "} CreedArenaChunk;\n\n"
+        "typedef struct CreedArena {\n"
+        "    union {\n"
+        "        long double align;\n"
+        "        unsigned char bytes[4096];\n"
+        "    } buffer;\n"
+        "    unsigned long long used;\n"
+        "    CreedArenaChunk *chunks;\n"
+        "} CreedArena;\n\n"
+        "typedef struct CreedArenaMark {\n"
+        "    unsigned long long used;\n"
+        "    CreedArenaChunk *chunks;\n"
+        "} CreedArenaMark;\n\n"
+        "static void creed_out_of_memory(void) {\n"
+        "    fprintf(stderr, \"Out of memory.\\n\");\n"
+        "    abort();\n"
+        "}\n\n"
+        "static inline void creed_arena_init(CreedArena *arena) {\n"
+        "    arena->used = 0;\n"
+        "    arena->chunks = 0;\n"
+        "}\n\n"
+        "static inline void creed_arena_release(CreedArena *arena) {\n"
+        "    while (arena->chunks) {\n"
+        "        CreedArenaChunk *next = arena->chunks->next;\n"
+        "        free(arena->chunks);\n"
+        "        arena->chunks = next;\n"
+        "    }\n"
+        "}\n\n"
+        "static inline CreedArenaMark creed_arena_mark(CreedArena *arena) {\n"
+        "    CreedArenaMark mark = { arena->used, arena->chunks };\n"
+        "    return mark;\n"
+        "}\n\n"
+        "static inline void creed_arena_reset(CreedArena *arena, CreedArenaMark mark) {\n"
+        "    while (arena->chunks != mark.chunks) {\n"
+        "        CreedArenaChunk *next = arena->chunks->next;\n"
+        "        free(arena->chunks);\n"
+        "        arena->chunks = next;\n"
+        "    }\n"
+        "    arena->used = mark.used;\n"
+        "}\n\n"
+        "static void *creed_alloc(CreedArena *arena, unsigned long long count, unsigned long long size) {\n"
+        "    if (!arena) {\n"
+        "        void *memory = calloc(count, size);\n"
+        "        if (!memory) creed_out_of_memory();\n"
+        "        return memory;\n"
+        "    }\n"
+        "    if (count > (~0ull - sizeof(CreedArenaChunk) - 15) / size) creed_out_of_memory();\n"
+        "    unsigned long long bytes = (count * size + 15) & ~15ull;\n"
+        "    void *memory;\n"
+        "    if (bytes <= sizeof(arena->buffer) - arena->used) {\n"
+        "        memory = arena->buffer.bytes + arena->used;\n"
+        "        arena->used += bytes;\n"
+        "    } else {\n"
+        "        CreedArenaChunk *chunk = malloc(sizeof(CreedArenaChunk) + bytes);\n"
+        "        if (!chunk) creed_out_of_memory();\n"
+        "        chunk->next = arena->chunks;\n"
+        "        arena->chunks = chunk;\n"
+        "        memory = chunk + 1;\n"
+        "    }\n"
+        "    return memset(memory, 0, bytes);\n"
+        "}\n\n");
+}
+
+// file.map maps a whole file privately, so its bytes are only paged in as they are read and never copied, and writing to one
+// only copies the page it is on, without changing the file. Mappings live as long as the program.
+// file.open reads a file a chunk at a time with read into one buffer that is aligned to pages, and each chunk is returned in place.
+// Both tell the kernel the file is read from start to end, so it reads ahead.
+static void handle_file_runtime(FILE * outfile) {
+    fprintf(outfile,
+        "#include <errno.h>\n"
+        "#include <fcntl.h>\n"
+        "#include <string.h>\n"
+        "#include <sys/mman.h>\n"
+        "#include <sys/stat.h>\n"
+        "#include <unistd.h>\n\n"
+        "#define CREED_FILE_CHUNK (1 << 20)\n"
+        "#define CREED_FILE_ALIGN 4096\n\n"
+        "typedef struct CreedFile {\n"
+        "    int fd;\n"
+        "    unsigned char *buffer;\n"
+        "    Array_uint8 chunk; // The last chunk that was read.\n"
+        "} CreedFile;\n\n"
+        "static void creed_file_fail(const char *action, Array_char path, const char *location) {\n"
+        "    fprintf(stderr, \"%%s: Failed to %%s %%.*s: %%s\\n\", location, action, (int) path.count, path.data, strerror(errno));\n"
+        "    exit(EXIT_FAILURE);\n"
+        "}\n\n"
+        "static int creed_file_descriptor(Array_char path, const char *location) {\n"
+        "    char *name = malloc(path.count + 1);\n"
+        "    if (!name) creed_file_fail(\"open\", path, location);\n"
+        "    memcpy(name, path.data, path.count);\n"
+        "    name[path.count] = '\\0';\n"
+        "    int fd = open(name, O_RDONLY);\n"
+        "    free(name);\n"
+        "    if (fd < 0) creed_file_fail(\"open\", path, location);\n"
+        "    return fd;\n"
+        "}\n\n");
+    fprintf(outfile,
+        "static Array_uint8 creed_file_map(Array_char path, const char *location) {\n"
+        "    int fd = creed_file_descriptor(path, location);\n"
+        "    struct stat info;\n"
+        "    if (fstat(fd, &info) != 0) creed_file_fail(\"map\", path, location);\n"
+        "    Array_uint8 bytes = { (unsigned long long) info.st_size, NULL };\n"
+        "    if (bytes.count > 0) {\n"
+        "        void *data = mmap(NULL, bytes.count, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);\n"
+        "        if (data == MAP_FAILED) creed_file_fail(\"map\", path, location);\n"
+        "        posix_madvise(data, bytes.count, POSIX_MADV_SEQUENTIAL);\n"
+        "        bytes.data = data;\n"
+        "    }\n"
+        "    close(fd);\n"
+        "    return bytes;\n"
+        "}\n\n"
+        "static CreedFile *creed_file_open(Array_char path, const char *location) {\n"
+        "    CreedFile *file = malloc(sizeof(CreedFile));\n"
+        "    void *buffer;\n"
+        "    if (!file || posix_memalign(&buffer, CREED_FILE_ALIGN, CREED_FILE_CHUNK) != 0) creed_file_fail(\"open\", path, location);\n"
+        "    file->fd = creed_file_descriptor(path, location);\n"
+        "    file->buffer = buffer;\n"
+        "    file->chunk = (Array_uint8) { 0, buffer };\n"
+        "    posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);\n"
+        "    return file;\n"
+        "}\n\n"
+        "// The chunk is only valid until the next one is read.\n"
+        "static Array_uint8 creed_file_next(CreedFile *file, const char *location) {\n"
+        "    ssize_t length;\n"
+        "    do length = read(file->fd, file->buffer, CREED_FILE_CHUNK); while (length < 0 && errno == EINTR);\n"
+        "    if (length < 0) {\n"
+        "        fprintf(stderr, \"%%s: Failed to read a file: %%s\\n\", location, strerror(errno));\n"
+        "        exit(EXIT_FAILURE);\n"
+        "    }\n"
+        "    file->chunk.count = (unsigned long long) length;\n"
+        "    return file->chunk;\n"
+        "}\n\n"
+        "static void creed_file_close(CreedFile *file) {\n"
+        "    close(file->fd);\n"
+        "    free(file->buffer);\n"
+        "    free(file);\n"
+        "}\n\n");
+}
+
+// Parallel loops run on a pool of threads that is started by the first one. Each thread owns a range of chunks of iterations,
+// takes chunks from the front of it, and once it runs out steals the back half of the range of another thread.
+// The thread that starts a loop works on it too, and loops inside a parallel loop run on the thread that reaches them.
+static void handle_parallel_runtime(FILE * outfile) {
+    fprintf(outfile,
+        "#include <pthread.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <unistd.h>\n\n"
+        "#define CREED_PARALLEL_WORKERS 64\n\n"
+        "typedef void (*CreedParallelBody)(void *context, long long begin, long long end, int worker);\n\n"
+        "typedef struct CreedParallelRange {\n"
+        "    pthread_mutex_t lock;\n"
+        "    long long begin;\n"
+        "    long long end;\n"
+        "} CreedParallelRange;\n\n"
+        "static struct {\n"
+        "    int worker_count;\n"
+        "    CreedParallelRange ranges[CREED_PARALLEL_WORKERS];\n"
+        "    pthread_mutex_t lock;\n"
+        "    pthread_cond_t start;\n"
+        "    pthread_cond_t done;\n"
+        "    unsigned long long generation;\n"
+        "    int running;\n"
+        "    int busy;\n"
+        "    CreedParallelBody body;\n"
+        "    void *context;\n"
+        "    long long count;\n"
+        "    long long grain;\n"
+        "} creed_parallel;\n\n"
+        "static int creed_parallel_take(int worker, long long *chunk) {\n"
+        "    CreedParallelRange *range = creed_parallel.ranges + worker;\n"
+        "    pthread_mutex_lock(&range->lock);\n"
+        "    int taken = range->begin < range->end;\n"
+        "    if (taken) *chunk = range->begin++;\n"
+        "    pthread_mutex_unlock(&range->lock);\n"
+        "    return taken;\n"
+        "}\n\n"
+        "static int creed_parallel_steal(int worker) {\n"
+        "    for (int i = 1; i < creed_parallel.worker_count; i++) {\n"
+        "        CreedParallelRange *victim = creed_parallel.ranges + (worker + i) %% creed_parallel.worker_count;\n"
+        "        pthread_mutex_lock(&victim->lock);\n"
+        "        long long end = victim->end;\n"
+        "        long long begin = end - (end - victim->begin + 1) / 2;\n"
+        "        if (begin < end) victim->end = begin;\n"
+        "        pthread_mutex_unlock(&victim->lock);\n"
+        "        if (begin < end) {\n"
+        "            CreedParallelRange *range = creed_parallel.ranges + worker;\n"
+        "            pthread_mutex_lock(&range->lock);\n"
+        "            range->begin = begin;\n"
+        "            range->end = end;\n"
+        "            pthread_mutex_unlock(&range->lock);\n"
+        "            return 1;\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n\n");
+    fprintf(outfile,
+        "static void creed_parallel_work(int worker) {\n"
+        "    long long chunk;\n"
+        "    do {\n"
+        "        while (creed_parallel_take(worker, &chunk)) {\n"
+        "            long long begin = chunk * creed_parallel.grain;\n"
+        "            long long end = creed_parallel.count - begin < creed_parallel.grain ? creed_parallel.count : begin + creed_parallel.grain;\n"
+        "            creed_parallel.body(creed_parallel.context, begin, end, worker);\n"
+        "        }\n"
+        "    } while (creed_parallel_steal(worker));\n"
+        "    pthread_mutex_lock(&creed_parallel.lock);\n"
+        "    if (--creed_parallel.running == 0) pthread_cond_signal(&creed_parallel.done);\n"
+        "    pthread_mutex_unlock(&creed_parallel.lock);\n"
+        "}\n\n"
+        "static void *creed_parallel_thread(void *argument) {\n"
+        "    int worker = (int) (long) argument;\n"
+        "    unsigned long long generation = 0;\n"
+        "    pthread_mutex_lock(&creed_parallel.lock);\n"
+        "    for (;;) {\n"
+        "        while (creed_parallel.generation == generation) pthread_cond_wait(&creed_parallel.start, &creed_parallel.lock);\n"
+        "        generation = creed_parallel.generation;\n"
+        "        pthread_mutex_unlock(&creed_parallel.lock);\n"
+        "        creed_parallel_work(worker);\n"
+        "        pthread_mutex_lock(&creed_parallel.lock);\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n\n");
+    fprintf(outfile,
+        "// The number of threads is the number of processors, or CREED_THREADS if it is set.\n"
+        "static void creed_parallel_start(void) {\n"
+        "    const char *threads = getenv(\"CREED_THREADS\");\n"
+        "    long count = threads ? atol(threads) : sysconf(_SC_NPROCESSORS_ONLN);\n"
+        "    if (count < 1) count = 1;\n"
+        "    if (count > CREED_PARALLEL_WORKERS) count = CREED_PARALLEL_WORKERS;\n"
+        "    pthread_mutex_init(&creed_parallel.lock, 0);\n"
+        "    pthread_cond_init(&creed_parallel.start, 0);\n"
+        "    pthread_cond_init(&creed_parallel.done, 0);\n"
+        "    for (int i = 0; i < CREED_PARALLEL_WORKERS; i++) pthread_mutex_init(&creed_parallel.ranges[i].lock, 0);\n"
+        "    creed_parallel.worker_count = 1;\n"
+        "    for (long i = 1; i < count; i++) {\n"
+        "        pthread_t thread;\n"
+        "        if (pthread_create(&thread, 0, creed_parallel_thread, (void *) i)) break;\n"
+        "        pthread_detach(thread);\n"
+        "        creed_parallel.worker_count++;\n"
+        "    }\n"
+        "}\n\n"
+        "static long long creed_parallel_trips(long long start, long long bound, long long step, int inclusive) {\n"
+        "    if (inclusive) return bound < start ? 0 : (bound - start) / step + 1;\n"
+        "    return bound <= start ? 0 : (bound - start - 1) / step + 1;\n"
+        "}\n\n");
+    fprintf(outfile,
+        "static void creed_parallel_for(CreedParallelBody body, void *context, long long count) {\n"
+        "    if (count <= 0) return;\n"
+        "    if (!creed_parallel.worker_count) creed_parallel_start();\n"
+        "    int workers = creed_parallel.worker_count;\n"
+        "    if (creed_parallel.busy || workers == 1 || count == 1) {\n"
+        "        body(context, 0, count, 0);\n"
+        "        return;\n"
+        "    }\n"
+        "    // A few chunks per thread, so threads that finish early have something to steal.\n"
+        "    long long grain = count / (workers * 8);\n"
+        "    if (grain < 1) grain = 1;\n"
+        "    long long chunks = (count + grain - 1) / grain;\n"
+        "    for (int i = 0; i < workers; i++) {\n"
+        "        long long extra = chunks %% workers;\n"
+        "        creed_parallel.ranges[i].begin = chunks / workers * i + (i < extra ? i : extra);\n"
+        "        creed_parallel.ranges[i].end = creed_parallel.ranges[i].begin + chunks / workers + (i < extra);\n"
+        "    }\n"
+        "    pthread_mutex_lock(&creed_parallel.lock);\n"
+        "    creed_parallel.body = body;\n"
+        "    creed_parallel.context = context;\n"
+        "    creed_parallel.count = count;\n"
+        "    creed_parallel.grain = grain;\n"
+        "    creed_parallel.running = workers;\n"
+        "    creed_parallel.busy = 1;\n"
+        "    creed_parallel.generation++;\n"
+        "    pthread_cond_broadcast(&creed_parallel.start);\n"
+        "    pthread_mutex_unlock(&creed_parallel.lock);\n"
+        "    creed_parallel_work(0);\n"
+        "    pthread_mutex_lock(&creed_parallel.lock);\n"
+        "    while (creed_parallel.running) pthread_cond_wait(&creed_parallel.done, &creed_parallel.lock);\n"
+        "    creed_parallel.busy = 0;\n"
+        "    pthread_mutex_unlock(&creed_parallel.lock);\n"
+        "}\n\n");
+}
+
+// The C type of the tag that tells the members of a sum apart.
+static const char * sum_tag_type(Declaration * sum) {
+    switch (layout_sum_tag_size(sum)) {
+        case 1: return "unsigned char";
+        case 2: return "unsigned short";
+        default: return "unsigned int";
+    }
+}
+
+static bool sum_has_values(Declaration * sum) {
+    for (int i = 0; i < sum->data.sum.member_count; i++) {
+        if (sum->data.sum.members[i].type_exists) return true;
+    }
+    return false;
+}
+
+// The lanes of vectors with 8-byte integers are long, since that is what GCC compares vectors of long long into on 64-bit targets.
+// The lanes of vectors with 1-byte integers are signed char for the same reason.
+static const char * get_vector_element_type(TokenType element) {
+    switch (element) {
+        case TOKEN_KEYWORD_TYPE_INT8: return "signed char";
+        case TOKEN_KEYWORD_TYPE_INT64: return "long";
+        case TOKEN_KEYWORD_TYPE_UINT64: return "unsigned long";
+        default: return get_type((Type) { .type = TYPE_PRIMITIVE, .data.primitive = element });
+    }
+}
+
+// Written before the arrays, since arrays can hold vectors. GCC turns the reductions into shuffles of the vector.
+void handle_vectors(FILE * outfile) {
+    for (int i = 0; i < vector_count; i++) {
+        const char * name = vector_types[i].name;
+        const char * element = get_vector_element_type(vector_types[i].element);
+        Type element_type = { .type = TYPE_PRIMITIVE, .data.primitive = vector_types[i].element };
+        int width = vector_types[i].width;
+        unsigned long long size = layout_type_size(&element_type).size * width;
+        fprintf(outfile, "typedef %s %s __attribute__((vector_size(%llu), aligned(%llu)));\n\n", element, name, size, size < 16 ? size : 16);
+
+        fprintf(outfile, "static inline %s %s_splat(%s value) {\n", name, name, element);
+        write_indent(1, outfile);
+        fprintf(outfile, "return (%s) { 0 } + value;\n}\n\n", name);
+
+        static const char * reductions[][2] = { { "total", "result += vector[i]" }, { "min", "if (vector[i] < result) result = vector[i]" }, { "max", "if (vector[i] > result) result = vector[i]" } };
+        for (int j = 0; j < 3; j++) {
+            fprintf(outfile, "static inline %s %s_%s(%s vector) {\n", element, name, reductions[j][0], name);
+            write_indent(1, outfile);
+            fprintf(outfile, "%s result = vector[0];\n", element);
+            write_indent(1, outfile);
+            fprintf(outfile, "for (int i = 1; i < %i; i++) %s;\n", width, reductions[j][1]);
+            write_indent(1, outfile);
+            fprintf(outfile, "return result;\n}\n\n");
+        }
+    }
+}
+
+// Loads and stores copy the lanes one by one, which GCC turns into a single unaligned move.
+static void handle_vector_memory(int idx, FILE * outfile) {
+    const char * name = vector_types[idx].name;
+    int width = vector_types[idx].width;
+    Type element = { .type = TYPE_PRIMITIVE, .data.primitive = vector_types[idx].element };
+    Type array = { .type = TYPE_ARRAY, .data.sub_type = &element };
+    const char * array_name = get_type(array);
+
+    fprintf(outfile, "static inline %s %s_load(%s array, unsigned long long index, const char *location) {\n", name, name, array_name);
+    write_indent(1, outfile);
+    fprintf(outfile, "%s vector;\n", name);
+    write_indent(1, outfile);
+    fprintf(outfile, "if (location && (array.count < %i || index > array.count - %i)) creed_index_fail(index + %i, array.count, location);\n", width, width, width - 1);
+    write_indent(1, outfile);
+    fprintf(outfile, "for (int i = 0; i < %i; i++) vector[i] = array.data[index + i];\n", width);
+    write_indent(1, outfile);
+    fprintf(outfile, "return vector;\n}\n\n");
+
+    fprintf(outfile, "static inline void %s_store(%s vector, %s array, unsigned long long index, const char *location) {\n", name, name, array_name);
+    write_indent(1, outfile);
+    fprintf(outfile, "if (location && (array.count < %i || index > array.count - %i)) creed_index_fail(index + %i, array.count, location);\n", width, width, width - 1);
+    write_indent(1, outfile);
+    fprintf(outfile, "for (int i = 0; i < %i; i++) array.data[index + i] = vector[i];\n}\n\n", width);
+}
+
+void handle_arrays(FILE * outfile) {
+    if (array_count == 0) return;
+    fprintf(outfile, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+    fprintf(outfile, "static void creed_index_fail(unsigned long long index, unsigned long long count, const char *location) {\n");
+    write_indent(1, outfile);
+    fprintf(outfile, "fprintf(stderr, \"%%s: Index %%llu is out of bounds for an array with count %%llu.\\n\", location, index, count);\n");
+    write_indent(1, outfile);
+    fprintf(outfile, "abort();\n}\n\n");
+    if (array_allocations) handle_arena(outfile);
 
+    for (int i = 0; i < array_count; i++) {
+        fprintf(outfile, "typedef struct %s {\n", array_types[i].name);
+        write_indent(1, outfile);
+        fprintf(outfile, "unsigned long long count;\n");
+        Declaration * soa = array_types[i].soa;
+        for (int j = 0; soa && j < soa->data.struct_union.member_count; j++) {
+            write_indent(1, outfile);
+            fprintf(outfile, "%s *%s;\n", get_type(soa->data.struct_union.members[j].type), string_cache_get(soa->data.struct_union.members[j].id));
+        }
+        if (!soa) {
+            write_indent(1, outfile);
+            fprintf(outfile, "%s *data;\n", array_types[i].item_type);
+        }
+        fprintf(outfile, "} %s;\n\n", array_types[i].name);
+    }
+}
+
+// Arrays of an soa struct have an accessor per member instead, and functions that gather an item from the member arrays and scatter it back.
+// A location of NULL skips the bounds check.
+static void handle_soa_accessors(int idx, FILE * outfile) {
+    const char * name = array_types[idx].name;
+    const char * item_type = array_types[idx].item_type;
+    Declaration * soa = array_types[idx].soa;
+    int member_count = soa->data.struct_union.member_count;
+
+    for (int i = 0; i < member_count; i++) {
+        const char * member = string_cache_get(soa->data.struct_union.members[i].id);
+        fprintf(outfile, "static inline %s *%s_%s_at(%s array, unsigned long long index, const char *location) {\n", get_type(soa->data.struct_union.members[i].type), name, member, name);
+        write_indent(1, outfile);
+        fprintf(outfile, "if (index >= array.count) creed_index_fail(index, array.count, location);\n");
+        write_indent(1, outfile);
+        fprintf(outfile, "return array.%s + index;\n}\n\n", member);
+    }
+
+    fprintf(outfile, "static inline %s %s_get(%s array, unsigned long long index, const char *location) {\n", item_type, name, name);
+    write_indent(1, outfile);
+    fprintf(outfile, "%s item;\n", item_type);
+    write_indent(1, outfile);
+    fprintf(outfile, "if (location && index >= array.count) creed_index_fail(index, array.count, location);\n");
+    for (int i = 0; i < member_count; i++) {
+        const char * member = string_cache_get(soa->data.struct_union.members[i].id);
+        write_indent(1, outfile);
+        fprintf(outfile, "item.%s = array.%s[index];\n", member, member);
+    }
+    write_indent(1, outfile);
+    fprintf(outfile, "return item;\n}\n\n");
+
+    fprintf(outfile, "static inline void %s_set(%s array, unsigned long long index, %s item, const char *location) {\n", name, name, item_type);
+    write_indent(1, outfile);
+    fprintf(outfile, "if (location && index >= array.count) creed_index_fail(index, array.count, location);\n");
+    for (int i = 0; i < member_count; i++) {
+        const char * member = string_cache_get(soa->data.struct_union.members[i].id);
+        write_indent(1, outfile);
+        fprintf(outfile, "array.%s[index] = item.%s;\n", member, member);
+    }
+    fprintf(outfile, "}\n\n");
+
+    // Scatters the members of an array literal into the member arrays.
+    fprintf(outfile, "static inline %s %s_fill(%s array, const %s *init, unsigned long long init_count) {\n", name, name, name, item_type);
+    write_indent(1, outfile);
+    fprintf(outfile, "if (init_count > array.count) init_count = array.count;\n");
+    write_indent(1, outfile);
+    fprintf(outfile, "for (unsigned long long i = 0; i < init_count; i++) %s_set(array, i, init[i], 0);\n", name);
+    write_indent(1, outfile);
+    fprintf(outfile, "return array;\n}\n\n");
+
+    if (!array_allocations) return;
+    fprintf(outfile, "static inline %s %s_new(CreedArena *arena, unsigned long long count, const void *init, unsigned long long init_count) {\n", name, name);
+    write_indent(1, outfile);
+    fprintf(outfile, "%s array = { 0 };\n", name);
+    write_indent(1, outfile);
+    fprintf(outfile, "array.count = count;\n");
+    write_indent(1, outfile);
+    fprintf(outfile, "if (count == 0) return array;\n");
+    for (int i = 0; i < member_count; i++) {
+        const char * member = string_cache_get(soa->data.struct_union.members[i].id);
+        write_indent(1, outfile);
+        fprintf(outfile, "array.%s = creed_alloc(arena, count, sizeof(%s));\n", member, get_type(soa->data.struct_union.members[i].type));
+    }
+    write_indent(1, outfile);
+    fprintf(outfile, "return %s_fill(array, init, init_count);\n}\n\n", name);
+}
+
+// Checked array accesses go through an accessor per array type, so the array is only evaluated once.
+// Written after the type declarations, since the item types have to be complete.
+void handle_array_accessors(FILE * outfile) {
+    for (int i = 0; i < vector_count; i++) {
+        if (vector_types[i].memory) handle_vector_memory(i, outfile);
+    }
+    for (int i = 0; i < array_count; i++) {
+        if (array_types[i].soa) {
+            handle_soa_accessors(i, outfile);
+            continue;
+        }
+        fprintf(outfile, "static inline %s *%s_at(%s array, unsigned long long index, const char *location) {\n", array_types[i].item_type, array_types[i].name, array_types[i].name);
+        write_indent(1, outfile);
+        fprintf(outfile, "if (index >= array.count) creed_index_fail(index, array.count, location);\n");
+        write_indent(1, outfile);
+        fprintf(outfile, "return array.data + index;\n}\n\n");
+        if (!array_allocations) continue;
+
+        // Copies the members of the literal into the start of a new array, and leaves the rest zeroed.
+        fprintf(outfile, "static inline %s %s_new(CreedArena *arena, unsigned long long count, const void *init, unsigned long long init_count) {\n", array_types[i].name, array_types[i].name);
+        write_indent(1, outfile);
+        fprintf(outfile, "%s array = { count, 0 };\n", array_types[i].name);
+        write_indent(1, outfile);
+        fprintf(outfile, "if (count == 0) return array;\n");
+        write_indent(1, outfile);
+        fprintf(outfile, "array.data = creed_alloc(arena, count, sizeof(%s));\n", array_types[i].item_type);
+        write_indent(1, outfile);
+        fprintf(outfile, "if (init_count > count) init_count = count;\n");
+        write_indent(1, outfile);
+        fprintf(outfile, "if (init_count > 0) memcpy(array.data, init, init_count * sizeof(%s));\n", array_types[i].item_type);
+        write_indent(1, outfile);
+        fprintf(outfile, "return array;\n}\n\n");
+    }
+}
+
+// Every sum gets a function that returns which member it holds, numbered in the order they are declared so a match is a dense switch,
+// and a function per member that creates the sum, named after the sum and the member.
+void handle_sums(SourceFile * file, FILE * outfile) {
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration * sum = file->declarations + i;
+        if (sum->type != DECLARATION_SUM) continue;
+        const char * name = string_cache_get(sum->id);
+        int niche = layout_sum_niche_member(sum);
+
+        fprintf(outfile, "static inline unsigned %s__tag(struct %s value) {\n", name, name);
+        write_indent(1, outfile);
+        if (niche >= 0) {
+            fprintf(outfile, "unsigned long long address = (unsigned long long) value.as.%s;\n", string_cache_get(sum->data.sum.members[niche].id));
+            write_indent(1, outfile);
+            fprintf(outfile, "return address < %i ? (unsigned) address : %i;\n}\n\n", sum->data.sum.member_count, niche);
+        } else {
+            fprintf(outfile, "return value.tag;\n}\n\n");
+        }
+
+        for (int j = 0; j < sum->data.sum.member_count; j++) {
+            MemberSum * member = sum->data.sum.members + j;
+            const char * member_name = string_cache_get(member->id);
+            if (member->type_exists) {
+                fprintf(outfile, "static inline struct %s %s_%s(%s value) {\n", name, name, member_name, get_type(member->type));
+                write_indent(1, outfile);
+                if (niche >= 0) fprintf(outfile, "struct %s sum = { .as.%s = value };\n", name, member_name);
+                else fprintf(outfile, "struct %s sum = { .tag = %i, .as.%s = value };\n", name, j, member_name);
+            } else {
+                fprintf(outfile, "static inline struct %s %s_%s(void) {\n", name, name, member_name);
+                write_indent(1, outfile);
+                if (niche >= 0) {
+                    MemberSum * pointer = sum->data.sum.members + niche;
+                    fprintf(outfile, "struct %s sum = { .as.%s = (%s) %iull };\n", name, string_cache_get(pointer->id), get_type(pointer->type), j);
+                } else fprintf(outfile, "struct %s sum = { .tag = %i };\n", name, j);
+            }
+            write_indent(1, outfile);
+            fprintf(outfile, "return sum;\n}\n\n");
+        }
+    }
+}
+
+void handle_literal_char(char c, FILE * outfile) {
+    switch (c) {
+        case '\\': fprintf(outfile, "\\\\"); break;
+        case '\n': fprintf(outfile, "\\n"); break;
+        case '\t': fprintf(outfile, "\\t"); break;
+        case '\0': fprintf(outfile, "\\0"); break;
+        case '\'': fprintf(outfile, "\\'"); break;
+        case '\"': fprintf(outfile, "\\\""); break;
+        case '\r': fprintf(outfile, "\\r"); break;
+        default: fputc(c, outfile); break;
+    }
+}
+
+// Folded constants can be negative or lose precision with %f, so negative values are parenthesized
+// and floats are written with enough digits to round-trip.
+void handle_literal_float(double value, int digits, const char * suffix, FILE * outfile) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+    if (!strpbrk(buffer, ".e")) strcat(buffer, ".0");
+    if (value < 0) fprintf(outfile, "(%s%s)", buffer, suffix);
+    else fprintf(outfile, "%s%s", buffer, suffix);
 }
 
 void handle_literals(Literal * literal, FILE * outfile) {
@@ -101,22 +770,24 @@ void handle_literals(Literal * literal, FILE * outfile) {
             int idx = 0;
             char * string = string_cache_get(literal->data.l_string);
             while (string[idx] != '\0') {
-                print_literal_char(string[idx]);
+                handle_literal_char(string[idx], outfile);
                 idx++;
             }
             fputc('"', outfile);
             break;
         case LITERAL_INT8:
-            fprintf(outfile, "%d", literal->data.l_int8);  
+            fprintf(outfile, literal->data.l_int8 < 0 ? "(%d)" : "%d", literal->data.l_int8);  
             break;     
         case LITERAL_INT16:
-            fprintf(outfile, "%hi", literal->data.l_int16);     
+            fprintf(outfile, literal->data.l_int16 < 0 ? "(%hi)" : "%hi", literal->data.l_int16);     
             break;  
         case LITERAL_INT:
-            fprintf(outfile, "%d", literal->data.l_int);     
+            if (literal->data.l_int == INT_MIN) fprintf(outfile, "(%d - 1)", INT_MIN + 1);
+            else fprintf(outfile, literal->data.l_int < 0 ? "(%d)" : "%d", literal->data.l_int);     
             break;  
         case LITERAL_INT64:
-            fprintf(outfile, "%lldll", literal->data.l_int64);       
+            if (literal->data.l_int64 == LLONG_MIN) fprintf(outfile, "(%lldll - 1)", LLONG_MIN + 1);
+            else fprintf(outfile, literal->data.l_int64 < 0 ? "(%lldll)" : "%lldll", literal->data.l_int64);       
             break; 
         case LITERAL_UINT8:
             fprintf(outfile, "%uu", literal->data.l_uint8);
@@ -131,17 +802,132 @@ void handle_literals(Literal * literal, FILE * outfile) {
             fprintf(outfile, "%lluull", literal->data.l_uint64);
             break;
         case LITERAL_FLOAT:
-            fprintf(outfile, "%ff", literal->data.l_float);
+            handle_literal_float(literal->data.l_float, 9, "f", outfile);
             break;
         case LITERAL_FLOAT64:
-            fprintf(outfile, "%lf", literal->data.l_float64);
+            handle_literal_float(literal->data.l_float64, 17, "", outfile);
             break;
         case LITERAL_CHAR:
-            fprintf(outfile, "%c", literal->data.l_char);
+            fputc('\'', outfile);
+            handle_literal_char(literal->data.l_char, outfile);
+            fputc('\'', outfile);
             break;
     }
 }
 
+// String and array literals become an array struct pointing at a C99 compound literal, which lives as long as the enclosing block,
+// or the whole program at file scope. Initializers leave out the cast because a compound literal is not a constant expression in C.
+// An array of an soa struct on the stack has an array of each member, and its items are scattered into them.
+static void handle_soa_literal(Expr * expr, unsigned long long count, bool initializer, FILE * outfile) {
+    Type item = expr->data.literal_array.type;
+    Type array = { .type = TYPE_ARRAY, .data.sub_type = &item };
+    Declaration * soa = item.data.id.type_declaration;
+    int member_count = expr->data.literal_array.allocated_count;
+    if (member_count > 0 && !current_function) error_exit(expr->location, "A global array of a struct declared with soa can only be initialized to zeroes.");
+
+    if (member_count > 0) fprintf(outfile, "%s_fill(", get_type(array));
+    if (member_count > 0 || !initializer) fprintf(outfile, "(%s) ", get_type(array));
+    if (count == 0) {
+        fprintf(outfile, "{ 0 }"); // C has no arrays of size 0.
+    } else {
+        fprintf(outfile, "{ %lluull", count);
+        for (int i = 0; i < soa->data.struct_union.member_count; i++) {
+            Type member = soa->data.struct_union.members[i].type;
+            fprintf(outfile, ", (%s[%llu]) { %s }", get_type(member), count, member.type == TYPE_ID || member.type == TYPE_ARRAY ? "{ 0 }" : "0");
+        }
+        fprintf(outfile, " }");
+    }
+    if (member_count == 0) return;
+
+    fprintf(outfile, ", (%s[%i]) { ", get_type(item), member_count);
+    for (int i = 0; i < member_count; i++) {
+        if (i > 0) fprintf(outfile, ", ");
+        handle_expr(&expr->data.literal_array.members[i], outfile);
+    }
+    fprintf(outfile, " }, %i)", member_count);
+}
+
+void handle_array_literal(Expr * expr, bool initializer, FILE * outfile) {
+    Type item = expr->data.literal_array.type;
+    Type array = { .type = TYPE_ARRAY, .data.sub_type = &item };
+    bool stack = expr->data.literal_array.storage == ARRAY_STORAGE_STACK;
+    if (!initializer && stack) fprintf(outfile, "(%s) ", get_type(array));
+    // The chars of a string are copied out of the C string literal, which can't be written to.
+    Literal string = { .type = LITERAL_STRING, .data.l_string = expr->data.literal_array.string };
+    bool from_string = expr->data.literal_array.from_string;
+
+    if (expr->data.literal_array.storage != ARRAY_STORAGE_STACK) {
+        array_allocations = true;
+        const char * arena = expr->data.literal_array.storage == ARRAY_STORAGE_ARENA ? "&_arena" : "0";
+        if (expr->data.literal_array.storage == ARRAY_STORAGE_ARENA) arena_used = true;
+        int member_count = expr->data.literal_array.allocated_count;
+        fprintf(outfile, "%s_new(%s, ", get_type(array), arena);
+        handle_expr(expr->data.literal_array.count, outfile);
+        if (from_string) {
+            fprintf(outfile, ", ");
+            handle_literals(&string, outfile);
+            fprintf(outfile, ", ");
+            handle_expr(expr->data.literal_array.count, outfile);
+            fputc(TOKEN_PAREN_CLOSE, outfile);
+            return;
+        }
+        if (member_count == 0) {
+            fprintf(outfile, ", 0, 0)");
+            return;
+        }
+        fprintf(outfile, ", (%s[%i]) { ", get_type(item), member_count);
+        for (int i = 0; i < member_count; i++) {
+            if (i > 0) fprintf(outfile, ", ");
+            handle_expr(&expr->data.literal_array.members[i], outfile);
+        }
+        fprintf(outfile, " }, %i)", member_count);
+        return;
+    }
+
+    unsigned long long count = literal_get_bits(&expr->data.literal_array.count->data.literal);
+    if (type_is_soa(&item)) {
+        handle_soa_literal(expr, count, initializer, outfile);
+        return;
+    }
+    if (count == 0) {
+        fprintf(outfile, "{ 0, 0 }"); // C has no arrays of size 0.
+        return;
+    }
+    fprintf(outfile, "{ %lluull, (%s[%llu]) { ", count, get_type(item), count);
+    if (from_string) handle_literals(&string, outfile);
+    else if (expr->data.literal_array.allocated_count == 0) fprintf(outfile, item.type == TYPE_ID || item.type == TYPE_ARRAY ? "{ 0 }" : "0");
+    for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
+        if (i > 0) fprintf(outfile, ", ");
+        handle_expr(&expr->data.literal_array.members[i], outfile);
+    }
+    fprintf(outfile, " } }");
+}
+
+// Writes the value a declaration is initialized with.
+static void handle_initializer(Expr * value, FILE * outfile) {
+    if (value->type == EXPR_LITERAL_ARRAY) {
+        handle_array_literal(value, true, outfile);
+    } else {
+        handle_expr(value, outfile);
+    }
+}
+
+// Returns the array access an expression reads an item of an soa array with, ignoring parentheses, or NULL.
+static Expr * soa_access(Expr * expr) {
+    while (expr->type == EXPR_PAREN) expr = expr->data.parenthesized;
+    if (expr->type != EXPR_ACCESS_ARRAY || !type_is_soa(&expr->data.access_array.item_type)) return NULL;
+    return expr;
+}
+
+// Writes the array, index and location arguments of an soa accessor. A location of 0 skips the bounds check.
+static void handle_soa_arguments(Expr * access, FILE * outfile) {
+    handle_expr(access->data.access_array.operand, outfile);
+    fprintf(outfile, ", ");
+    handle_expr(access->data.access_array.index, outfile);
+    if (access->data.access_array.checked) fprintf(outfile, ", \"%s:%i\")", string_cache_get(access->location.file_name), access->location.idx_line + 1);
+    else fprintf(outfile, ", 0)");
+}
+
 void handle_statement(Statement * statement, FILE * outfile) {
     switch (statement->type) {
         case STATEMENT_DECLARATION:
@@ -158,25 +944,51 @@ void handle_statement(Statement * statement, FILE * outfile) {
             handle_expr(&statement->data.deincrement, outfile);
             break;
 
-        case STATEMENT_ASSIGN:
+        case STATEMENT_ASSIGN: {
+            // A whole item of an soa array is scattered into the member arrays.
+            Expr * access = soa_access(&statement->data.assign.assignee);
+            if (access) {
+                Type array = { .type = TYPE_ARRAY, .data.sub_type = &access->data.access_array.item_type };
+                fprintf(outfile, "%s_set(", get_type(array));
+                handle_expr(access->data.access_array.operand, outfile);
+                fprintf(outfile, ", ");
+                handle_expr(access->data.access_array.index, outfile);
+                fprintf(outfile, ", ");
+                handle_expr(&statement->data.assign.value, outfile);
+                if (access->data.access_array.checked) fprintf(outfile, ", \"%s:%i\")", string_cache_get(access->location.file_name), access->location.idx_line + 1);
+                else fprintf(outfile, ", 0)");
+                break;
+            }
             handle_expr(&statement->data.assign.assignee, outfile);
             fprintf(outfile, " %s ", string_assigns[statement->data.assign.type - TOKEN_ASSIGN_MIN]);
             handle_expr(&statement->data.assign.value, outfile);
-            break;
+        } break;
 
         case STATEMENT_EXPR:
             handle_expr(&statement->data.expr, outfile);
             break;
 
         case STATEMENT_LABEL:
-            fprintf(outfile, "%s%c\n", string_cache_get(statement->data.label), TOKEN_COLON);
+            fprintf(outfile, "%s%c", string_cache_get(statement->data.label), TOKEN_COLON); // followed by an empty statement, since C doesn't allow a label right before a declaration.
             break;
 
         case STATEMENT_LABEL_GOTO:
-            fprintf(outfile, "goto %s%c", string_cache_get(statement->data.label_goto), TOKEN_SEMICOLON);
+            fprintf(outfile, "goto %s", string_cache_get(statement->data.label_goto));
             break;
 
         case STATEMENT_RETURN:
+            // The value is computed before the arena is freed, since it can read arrays that are in it.
+            if (current_function && current_function->data.function.uses_arena) {
+                fprintf(outfile, "do { ");
+                if (statement->data.return_value.exists) {
+                    fprintf(outfile, "%s _return = ", get_type(*current_function->data.function.type.data.function.result));
+                    handle_expr(&statement->data.return_value.expr, outfile);
+                    fprintf(outfile, "; creed_arena_release(&_arena); return _return; } while (0)");
+                } else {
+                    fprintf(outfile, "creed_arena_release(&_arena); return; } while (0)");
+                }
+                break;
+            }
             fprintf(outfile, "return");
             if (statement->data.return_value.exists) {
                 fputc(' ', outfile);
@@ -185,6 +997,450 @@ void handle_statement(Statement * statement, FILE * outfile) {
     }
 }
 
+static void handle_block_scopes(Scope * block, FILE * outfile) {
+    for (int i = 0; i < block->data.block.scope_count; i++) {
+        if (block->data.block.scopes[i].type == SCOPE_BLOCK) write_indent(indent, outfile);
+        handle_scope(&block->data.block.scopes[i], outfile);
+    }
+}
+
+// A loop that resets the arena is in a block that marks the arena first. Returns the number of the mark, or -1.
+static int handle_arena_mark(bool resets_arena, FILE * outfile) {
+    if (!resets_arena) return -1;
+    int mark = arena_mark_count++;
+    fprintf(outfile, "{\n");
+    indent++;
+    write_indent(indent, outfile);
+    fprintf(outfile, "CreedArenaMark _mark%i = creed_arena_mark(&_arena);\n", mark);
+    write_indent(indent, outfile);
+    return mark;
+}
+
+static void handle_arena_mark_end(int mark, FILE * outfile) {
+    if (mark < 0) return;
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n\n");
+}
+
+// Resets the arena at the start of an iteration, which frees the arrays of the one before it.
+static void handle_arena_reset(int mark, FILE * outfile) {
+    if (mark < 0) return;
+    write_indent(indent, outfile);
+    fprintf(outfile, "creed_arena_reset(&_arena, _mark%i);\n", mark);
+}
+
+// The body of a for or while loop, which starts by resetting the arena if the loop marked it.
+static void handle_loop_body(Scope * body, int mark, FILE * outfile) {
+    if (mark < 0) {
+        handle_scope(body, outfile);
+        return;
+    }
+    fprintf(outfile, "{\n");
+    indent++;
+    handle_arena_reset(mark, outfile);
+    if (body->type == SCOPE_BLOCK) handle_block_scopes(body, outfile);
+    else handle_scope(body, outfile);
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n");
+}
+
+// The bytes of a file that haven't been read yet are iterated in place in the buffer of the file. Once the index reaches the end
+// of a chunk the condition reads the next one, so the loop is still a single C loop.
+static void handle_for_each_file(Scope * scope, int id, int mark, FILE * outfile) {
+    Declaration * element = scope->data.loop_for_each.element_declaration;
+    Expr * file = &scope->data.loop_for_each.array;
+    fprintf(outfile, "{\n");
+    indent++;
+    write_indent(indent, outfile);
+    fprintf(outfile, "struct CreedFile * _each%i = ", id);
+    handle_expr(file, outfile);
+    handle_statement_end(outfile);
+    write_indent(indent, outfile);
+    fprintf(outfile, "for (unsigned long long _each%i_index = _each%i->chunk.count; _each%i_index < _each%i->chunk.count || (_each%i_index = 0, creed_file_next(_each%i, \"%s:%i\").count > 0); ++_each%i_index) {\n",
+        id, id, id, id, id, id, string_cache_get(file->location.file_name), file->location.idx_line + 1, id);
+    indent++;
+    handle_arena_reset(mark, outfile);
+    write_indent(indent, outfile);
+    fprintf(outfile, "%s %s = _each%i->chunk.data[_each%i_index]", get_type(element->data.var.data.mutable.type), string_cache_get(element->id), id, id);
+    handle_statement_end(outfile);
+    Scope * body = scope->data.loop_for_each.scope;
+    if (body->type == SCOPE_BLOCK) handle_block_scopes(body, outfile);
+    else handle_scope(body, outfile);
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n");
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n\n");
+}
+
+// A for .. in loop walks a pointer from the first item to the end of the array. The end is computed once before the loop,
+// and nothing in the loop can change it, so the C compiler knows the trip count and can vectorize the loop.
+static void handle_for_each(Scope * scope, int mark, FILE * outfile) {
+    Expr * array = &scope->data.loop_for_each.array;
+    Declaration * element = scope->data.loop_for_each.element_declaration;
+    const char * item_type = get_type(element->data.var.data.mutable.type);
+    int id = for_each_count++;
+    if (scope->data.loop_for_each.file) {
+        handle_for_each_file(scope, id, mark, outfile);
+        return;
+    }
+
+    // Arrays that aren't just a variable are only evaluated once, into a variable in a block around the loop.
+    bool copy = array->type != EXPR_ID;
+    if (copy) {
+        fprintf(outfile, "{\n");
+        indent++;
+        write_indent(indent, outfile);
+        Type array_type = { .type = TYPE_ARRAY, .data.sub_type = &element->data.var.data.mutable.type };
+        fprintf(outfile, "%s _each%i = ", get_type(array_type), id);
+        if (array->type == EXPR_LITERAL_ARRAY) {
+            handle_array_literal(array, true, outfile);
+        } else {
+            handle_expr(array, outfile);
+        }
+        handle_statement_end(outfile);
+        write_indent(indent, outfile);
+    }
+    const char * array_name = copy ? NULL : string_cache_get(array->data.id.declaration_id);
+    char copy_name[32];
+    if (copy) {
+        sprintf(copy_name, "_each%i", id);
+        array_name = copy_name;
+    }
+
+    if (type_is_soa(&element->data.var.data.mutable.type)) {
+        // The items of an soa array are gathered from the member arrays by index.
+        Type array_type = { .type = TYPE_ARRAY, .data.sub_type = &element->data.var.data.mutable.type };
+        fprintf(outfile, "for (unsigned long long _each%i_index = 0, _each%i_end = %s.count; _each%i_index != _each%i_end; ++_each%i_index) {\n",
+            id, id, array_name, id, id, id);
+        indent++;
+        handle_arena_reset(mark, outfile);
+        write_indent(indent, outfile);
+        fprintf(outfile, "%s %s = %s_get(%s, _each%i_index, 0)", item_type, string_cache_get(element->id), get_type(array_type), array_name, id);
+    } else {
+        fprintf(outfile, "for (%s *_each%i_item = %s.data, *_each%i_end = %s.data + %s.count; _each%i_item != _each%i_end; ++_each%i_item) {\n",
+            item_type, id, array_name, id, array_name, array_name, id, id, id);
+        indent++;
+        handle_arena_reset(mark, outfile);
+        write_indent(indent, outfile);
+        fprintf(outfile, "%s %s = *_each%i_item", item_type, string_cache_get(element->id), id);
+    }
+    handle_statement_end(outfile);
+    Scope * body = scope->data.loop_for_each.scope;
+    if (body->type == SCOPE_BLOCK) handle_block_scopes(body, outfile);
+    else handle_scope(body, outfile);
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n");
+
+    if (copy) {
+        indent--;
+        write_indent(indent, outfile);
+        fprintf(outfile, "}\n");
+    }
+    fputc('\n', outfile);
+}
+
+static void handle_copy(FILE * from, FILE * to) {
+    char buffer[4096];
+    size_t length;
+    rewind(from);
+    while ((length = fread(buffer, 1, sizeof(buffer), from)) > 0) fwrite(buffer, 1, length, to);
+    fclose(from);
+}
+
+// The declarations a parallel loop body uses, sorted into the ones it makes, the variables it adds to, and the ones it reads a copy of.
+typedef struct DeclarationList {
+    Declaration ** items;
+    int count;
+} DeclarationList;
+
+typedef struct ParallelBody {
+    DeclarationList inside;
+    DeclarationList reductions;
+    DeclarationList used;
+} ParallelBody;
+
+static bool declaration_list_has(DeclarationList * list, Declaration * decl) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->items[i] == decl) return true;
+    }
+    return false;
+}
+
+static void declaration_list_add(DeclarationList * list, Declaration * decl) {
+    if (declaration_list_has(list, decl)) return;
+    list->items = allocator_realloc(ALLOCATOR_CODEGEN, list->items, sizeof(Declaration *) * (list->count + 1));
+    list->items[list->count++] = decl;
+}
+
+static Type * declaration_var_type(Declaration * decl) {
+    return decl->data.var.type == DECLARATION_VAR_MUTABLE ? &decl->data.var.data.mutable.type : &decl->data.var.data.constant.type;
+}
+
+static void parallel_collect_statement(ParallelBody * body, Statement * statement) {
+    if (statement->type == STATEMENT_DECLARATION) declaration_list_add(&body->inside, &statement->data.declaration);
+    if (statement->type == STATEMENT_ASSIGN && statement->data.assign.type == TOKEN_ASSIGN_PLUS) {
+        Expr * assignee = &statement->data.assign.assignee;
+        while (assignee->type == EXPR_PAREN) assignee = assignee->data.parenthesized;
+        if (assignee->type == EXPR_ID) declaration_list_add(&body->reductions, assignee->data.id.declaration);
+    }
+}
+
+static void parallel_collect_scope(ParallelBody * body, Scope * scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            parallel_collect_statement(body, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            parallel_collect_scope(body, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) parallel_collect_scope(body, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            parallel_collect_statement(body, &scope->data.loop_for.init);
+            parallel_collect_statement(body, &scope->data.loop_for.step);
+            parallel_collect_scope(body, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            declaration_list_add(&body->inside, scope->data.loop_for_each.element_declaration);
+            parallel_collect_scope(body, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            parallel_collect_scope(body, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) parallel_collect_scope(body, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase * match_case = scope->data.match.cases + i;
+                if (match_case->declares) parallel_collect_statement(body, &match_case->declared_var);
+                for (int j = 0; j < match_case->scope_count; j++) parallel_collect_scope(body, match_case->scopes + j);
+            }
+            break;
+    }
+}
+
+static void * parallel_used_visit(void * context, void * ptr) {
+    if (ptr) declaration_list_add(context, ptr);
+    return ptr;
+}
+
+// Local variables of the function declared outside of the loop. Globals are used directly.
+static bool parallel_is_captured(ParallelBody * body, Declaration * decl, Declaration * counter) {
+    if (decl->type != DECLARATION_VAR || decl == counter || declaration_is_function(decl)) return false;
+    if (current_file->declarations <= decl && decl < current_file->declarations + current_file->declaration_count) return false;
+    return !declaration_list_has(&body->inside, decl) && !declaration_list_has(&body->reductions, decl);
+}
+
+// The body of a parallel loop becomes a function that runs a range of iterations, which is written before the function the loop is in.
+// It gets a copy of every local variable it reads through a struct, and adds to its own copy of the variables it adds to,
+// one per thread, which are added to the variables once the loop is done.
+static void handle_parallel(Scope * scope, FILE * outfile) {
+    int id = parallel_count++;
+    bool each = scope->type == SCOPE_LOOP_FOR_EACH;
+    Scope * loop_body = each ? scope->data.loop_for_each.scope : scope->data.loop_for.scope;
+    Declaration * counter = each ? scope->data.loop_for_each.element_declaration : &scope->data.loop_for.init.data.declaration;
+    Type * counter_type = &counter->data.var.data.mutable.type;
+
+    ParallelBody body = { { NULL, 0 }, { NULL, 0 }, { NULL, 0 } };
+    parallel_collect_scope(&body, loop_body);
+    Relocation relocation = { .relocate = parallel_used_visit, .context = &body.used };
+    relocate_scope(&relocation, loop_body);
+    DeclarationList reductions = { NULL, 0 };
+    for (int i = 0; i < body.reductions.count; i++) {
+        if (!declaration_list_has(&body.inside, body.reductions.items[i])) declaration_list_add(&reductions, body.reductions.items[i]);
+    }
+    allocator_free(body.reductions.items);
+    body.reductions = reductions;
+
+    FILE * bodyfile = tmpfile();
+    if (bodyfile == NULL) {
+        perror("Failed to open a temporary file.");
+        exit(EXIT_FAILURE);
+    }
+    int outer_indent = indent;
+    indent = 0;
+    Type array_type = { .type = TYPE_ARRAY, .data.sub_type = counter_type };
+    fprintf(bodyfile, "struct _parallel%i {\n", id);
+    for (int i = 0; i < body.used.count; i++) {
+        Declaration * decl = body.used.items[i];
+        if (parallel_is_captured(&body, decl, counter)) fprintf(bodyfile, "    %s %s;\n", get_type(*declaration_var_type(decl)), string_cache_get(decl->id));
+    }
+    for (int i = 0; i < body.reductions.count; i++) {
+        fprintf(bodyfile, "    %s %s[CREED_PARALLEL_WORKERS];\n", get_type(*declaration_var_type(body.reductions.items[i])), string_cache_get(body.reductions.items[i]->id));
+    }
+    if (each) fprintf(bodyfile, "    %s _array;\n", get_type(array_type));
+    else fprintf(bodyfile, "    %s _start;\n", get_type(*counter_type));
+    fprintf(bodyfile, "};\n\n");
+
+    fprintf(bodyfile, "static void _parallel%i_body(void * _context, long long _begin, long long _end, int _worker) {\n", id);
+    indent++;
+    write_indent(indent, bodyfile);
+    fprintf(bodyfile, "struct _parallel%i * _ctx = _context;\n", id);
+    for (int i = 0; i < body.used.count; i++) {
+        Declaration * decl = body.used.items[i];
+        if (!parallel_is_captured(&body, decl, counter)) continue;
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "%s %s = _ctx->%s;\n", get_type(*declaration_var_type(decl)), string_cache_get(decl->id), string_cache_get(decl->id));
+    }
+    for (int i = 0; i < body.reductions.count; i++) {
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "%s %s = { 0 };\n", get_type(*declaration_var_type(body.reductions.items[i])), string_cache_get(body.reductions.items[i]->id));
+    }
+    // The loop is written first, to find out if the body needs an arena.
+    FILE * loopfile = tmpfile();
+    if (loopfile == NULL) {
+        perror("Failed to open a temporary file.");
+        exit(EXIT_FAILURE);
+    }
+    bool outer_arena_used = arena_used;
+    arena_used = false;
+    bool resets_arena = each ? scope->data.loop_for_each.resets_arena : scope->data.loop_for.resets_arena;
+    int mark = resets_arena ? arena_mark_count++ : -1;
+    if (resets_arena) {
+        write_indent(indent, loopfile);
+        fprintf(loopfile, "CreedArenaMark _mark%i = creed_arena_mark(&_arena);\n", mark);
+    }
+    write_indent(indent, loopfile);
+    fprintf(loopfile, "for (long long _k = _begin; _k < _end; ++_k) {\n");
+    indent++;
+    handle_arena_reset(mark, loopfile);
+    long long step = 1;
+    if (!each && scope->data.loop_for.step.type == STATEMENT_ASSIGN) step = (long long) literal_get_bits(&scope->data.loop_for.step.data.assign.value.data.literal);
+    // The counter or element is only declared if the body uses it.
+    if (declaration_list_has(&body.used, counter)) {
+        write_indent(indent, loopfile);
+        if (!each) fprintf(loopfile, "%s %s = (%s) (_ctx->_start + _k * %lli)", get_type(*counter_type), string_cache_get(counter->id), get_type(*counter_type), step);
+        else if (type_is_soa(counter_type)) fprintf(loopfile, "%s %s = %s_get(_ctx->_array, _k, 0)", get_type(*counter_type), string_cache_get(counter->id), get_type(array_type));
+        else fprintf(loopfile, "%s %s = _ctx->_array.data[_k]", get_type(*counter_type), string_cache_get(counter->id));
+        handle_statement_end(loopfile);
+    }
+    if (loop_body->type == SCOPE_BLOCK) handle_block_scopes(loop_body, loopfile);
+    else handle_scope(loop_body, loopfile);
+    indent--;
+    write_indent(indent, loopfile);
+    fprintf(loopfile, "}\n");
+    // Arrays in the body that would be in the arena of the function go in an arena of the range instead.
+    bool arena = arena_used;
+    arena_used = outer_arena_used;
+    if (arena) {
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "CreedArena _arena;\n");
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "creed_arena_init(&_arena);\n");
+    }
+    handle_copy(loopfile, bodyfile);
+    for (int i = 0; i < body.reductions.count; i++) {
+        const char * name = string_cache_get(body.reductions.items[i]->id);
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "_ctx->%s[_worker] += %s;\n", name, name);
+    }
+    if (arena) {
+        write_indent(indent, bodyfile);
+        fprintf(bodyfile, "creed_arena_release(&_arena);\n");
+    }
+    fprintf(bodyfile, "}\n\n");
+    handle_copy(bodyfile, outlined_file);
+    indent = outer_indent;
+
+    // The loop itself fills in the struct and runs the body on the threads.
+    fprintf(outfile, "{\n");
+    indent++;
+    write_indent(indent, outfile);
+    fprintf(outfile, "struct _parallel%i _parallel%i_context = { ", id, id);
+    for (int i = 0; i < body.used.count; i++) {
+        Declaration * decl = body.used.items[i];
+        if (parallel_is_captured(&body, decl, counter)) fprintf(outfile, ".%s = %s, ", string_cache_get(decl->id), string_cache_get(decl->id));
+    }
+    if (each) {
+        fprintf(outfile, "._array = ");
+        handle_initializer(&scope->data.loop_for_each.array, outfile);
+    } else {
+        fprintf(outfile, "._start = ");
+        handle_expr(&counter->data.var.data.mutable.value, outfile);
+    }
+    fprintf(outfile, " };\n");
+    write_indent(indent, outfile);
+    if (each) {
+        fprintf(outfile, "creed_parallel_for(_parallel%i_body, &_parallel%i_context, (long long) _parallel%i_context._array.count);\n", id, id, id);
+    } else {
+        Expr * condition = &scope->data.loop_for.expr;
+        while (condition->type == EXPR_PAREN) condition = condition->data.parenthesized;
+        fprintf(outfile, "creed_parallel_for(_parallel%i_body, &_parallel%i_context, creed_parallel_trips((long long) _parallel%i_context._start, (long long) (", id, id, id);
+        handle_expr(condition->data.binary.rhs, outfile);
+        fprintf(outfile, "), %lli, %i));\n", step, condition->data.binary.operator == TOKEN_OP_LE);
+    }
+    for (int i = 0; i < body.reductions.count; i++) {
+        const char * name = string_cache_get(body.reductions.items[i]->id);
+        write_indent(indent, outfile);
+        fprintf(outfile, "for (int _thread = 0; _thread < CREED_PARALLEL_WORKERS; ++_thread) %s += _parallel%i_context.%s[_thread];\n", name, id, name);
+    }
+    indent--;
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n");
+
+    allocator_free(body.inside.items);
+    allocator_free(body.reductions.items);
+    allocator_free(body.used.items);
+    parallel_loops = true;
+}
+
+// A match becomes a switch over the number of the member, which the C compiler turns into a jump table since every member has a case.
+static void handle_match(Scope * scope, FILE * outfile) {
+    Expr * expr = &scope->data.match.expr;
+    Declaration * sum = scope->data.match.sum;
+    const char * name = string_cache_get(sum->id);
+    int id = match_count++;
+
+    // The value of each case is read from the sum after the switch, so anything but a variable is evaluated once before it.
+    bool copy = expr->type != EXPR_ID;
+    char copy_name[32];
+    const char * sum_name = copy ? copy_name : string_cache_get(expr->data.id.declaration_id);
+    if (copy) {
+        sprintf(copy_name, "_match%i", id);
+        fprintf(outfile, "{\n");
+        indent++;
+        write_indent(indent, outfile);
+        fprintf(outfile, "struct %s %s = ", name, copy_name);
+        handle_expr(expr, outfile);
+        handle_statement_end(outfile);
+        write_indent(indent, outfile);
+    }
+
+    fprintf(outfile, "switch (%s__tag(%s)) {\n", name, sum_name);
+    for (int i = 0; i < scope->data.match.case_count; i++) {
+        MatchCase * match_case = scope->data.match.cases + i;
+        write_indent(indent + 1, outfile);
+        fprintf(outfile, "case %i: {\n", match_case->member);
+        indent += 2;
+        if (match_case->declares) {
+            Declaration * decl = &match_case->declared_var.data.declaration;
+            write_indent(indent, outfile);
+            fprintf(outfile, "%s %s = %s.as.%s", get_type(decl->data.var.data.mutable.type), string_cache_get(decl->id), sum_name, string_cache_get(match_case->match_id));
+            handle_statement_end(outfile);
+        }
+        for (int j = 0; j < match_case->scope_count; j++) {
+            if (match_case->scopes[j].type == SCOPE_BLOCK) write_indent(indent, outfile);
+            handle_scope(match_case->scopes + j, outfile);
+        }
+        indent -= 2;
+        write_indent(indent + 1, outfile);
+        fprintf(outfile, "} break;\n");
+    }
+    write_indent(indent, outfile);
+    fprintf(outfile, "}\n");
+
+    if (copy) {
+        indent--;
+        write_indent(indent, outfile);
+        fprintf(outfile, "}\n");
+    }
+}
+
 void handle_scope(Scope * scope, FILE * outfile) {
     if (scope->type != SCOPE_BLOCK) {
         write_indent(indent, outfile);
@@ -198,7 +1454,7 @@ void handle_scope(Scope * scope, FILE * outfile) {
         case SCOPE_CONDITIONAL:
             fprintf(outfile, "if (");
             handle_expr(&scope->data.conditional.condition, outfile);
-            fprintf(outfile, ")");
+            fprintf(outfile, ") ");
             handle_scope(scope->data.conditional.scope_if, outfile);
             if (scope->data.conditional.scope_else) {
                 fprintf(outfile, "\nelse ");
@@ -206,7 +1462,12 @@ void handle_scope(Scope * scope, FILE * outfile) {
             }
             break;
             
-        case SCOPE_LOOP_FOR:
+        case SCOPE_LOOP_FOR: {
+            if (scope->data.loop_for.parallel) {
+                handle_parallel(scope, outfile);
+                break;
+            }
+            int mark = handle_arena_mark(scope->data.loop_for.resets_arena, outfile);
             fprintf(outfile, "for (");
             handle_statement(&scope->data.loop_for.init, outfile);
             fprintf(outfile, "%c ", TOKEN_SEMICOLON);
@@ -214,36 +1475,102 @@ void handle_scope(Scope * scope, FILE * outfile) {
             fprintf(outfile, "%c ", TOKEN_SEMICOLON);
             handle_statement(&scope->data.loop_for.step, outfile);
             fprintf(outfile, ") ");
-            handle_scope(scope->data.loop_for.scope, outfile);
-            break;
+            handle_loop_body(scope->data.loop_for.scope, mark, outfile);
+            handle_arena_mark_end(mark, outfile);
+        } break;
             
-        // TO DO: Get size of array for iteration
-        case SCOPE_LOOP_FOR_EACH:
-            break;
+        case SCOPE_LOOP_FOR_EACH: {
+            if (scope->data.loop_for_each.parallel) {
+                handle_parallel(scope, outfile);
+                break;
+            }
+            int mark = handle_arena_mark(scope->data.loop_for_each.resets_arena, outfile);
+            handle_for_each(scope, mark, outfile);
+            handle_arena_mark_end(mark, outfile);
+        } break;
             
-        case SCOPE_LOOP_WHILE:
+        case SCOPE_LOOP_WHILE: {
+            int mark = handle_arena_mark(scope->data.loop_while.resets_arena, outfile);
             fprintf(outfile, "while (");
             handle_expr(&scope->data.loop_while.expr, outfile);
-            fprintf(outfile, ")");
-            handle_scope(scope->data.loop_while.scope, outfile);
-            break;
+            fprintf(outfile, ") ");
+            handle_loop_body(scope->data.loop_while.scope, mark, outfile);
+            handle_arena_mark_end(mark, outfile);
+        } break;
 
         case SCOPE_BLOCK:
-            fprintf(outfile, " {\n");
+            fprintf(outfile, "{\n");
             indent++;
-            for (int i = 0; i < scope->data.block.scope_count; i++) {
-                handle_scope(&scope->data.block.scopes[i], outfile);
-            }
+            handle_block_scopes(scope, outfile);
             indent--;
             write_indent(indent, outfile);
             fprintf(outfile, "}\n\n");
+            break;
 
-        // TO DO: Handle match statements?
         case SCOPE_MATCH:
+            handle_match(scope, outfile);
             break;
     }
 }   
 
+static void handle_vector(Expr * expr, FILE * outfile) {
+    int idx = get_vector_index(expr->data.vector.type);
+    const char * name = vector_types[idx].name;
+    Expr * args = expr->data.vector.args;
+    int arg_count = expr->data.vector.arg_count;
+    switch (expr->data.vector.op) {
+        case EXPR_VECTOR_BUILD:
+            if (arg_count == 1) {
+                fprintf(outfile, "%s_splat(", name);
+                handle_expr(args, outfile);
+                fputc(TOKEN_PAREN_CLOSE, outfile);
+                break;
+            }
+            fprintf(outfile, "((%s) { ", name);
+            for (int i = 0; i < arg_count; i++) {
+                if (i > 0) fprintf(outfile, ", ");
+                handle_expr(args + i, outfile);
+            }
+            fprintf(outfile, " })");
+            break;
+
+        case EXPR_VECTOR_LOAD:
+        case EXPR_VECTOR_STORE:
+            // The array struct is recorded now, since it is written out before the loads and stores.
+            vector_types[idx].memory = true;
+            Type element = { .type = TYPE_PRIMITIVE, .data.primitive = vector_types[idx].element };
+            get_type((Type) { .type = TYPE_ARRAY, .data.sub_type = &element });
+            fprintf(outfile, "%s_%s(", name, expr->data.vector.op == EXPR_VECTOR_LOAD ? "load" : "store");
+            for (int i = 0; i < arg_count; i++) {
+                handle_expr(args + i, outfile);
+                fprintf(outfile, ", ");
+            }
+            if (expr->data.vector.checked) fprintf(outfile, "\"%s:%i\")", string_cache_get(expr->location.file_name), expr->location.idx_line + 1);
+            else fprintf(outfile, "0)");
+            break;
+
+        case EXPR_VECTOR_SHUFFLE: {
+            Type mask = type_vector_mask(&expr->data.vector.type);
+            fprintf(outfile, "__builtin_shuffle(");
+            handle_expr(args, outfile);
+            fprintf(outfile, ", (%s) { ", get_type(mask));
+            for (int i = 1; i < arg_count; i++) {
+                if (i > 1) fprintf(outfile, ", ");
+                handle_expr(args + i, outfile);
+            }
+            fprintf(outfile, " })");
+        } break;
+
+        case EXPR_VECTOR_TOTAL:
+        case EXPR_VECTOR_MIN:
+        case EXPR_VECTOR_MAX:
+            fprintf(outfile, "%s_%s(", name, expr->data.vector.op == EXPR_VECTOR_TOTAL ? "total" : expr->data.vector.op == EXPR_VECTOR_MIN ? "min" : "max");
+            handle_expr(args, outfile);
+            fputc(TOKEN_PAREN_CLOSE, outfile);
+            break;
+    }
+}
+
 void handle_expr(Expr * expr, FILE * outfile) {
     switch(expr->type) {
         case EXPR_PAREN:
@@ -264,6 +1591,12 @@ void handle_expr(Expr * expr, FILE * outfile) {
             break;
 
         case EXPR_TYPECAST:
+            if (expr->data.typecast.cast_to.type == TYPE_VECTOR) {
+                fprintf(outfile, "__builtin_convertvector(");
+                handle_expr(expr->data.typecast.operand, outfile);
+                fprintf(outfile, ", %s)", get_type(expr->data.typecast.cast_to));
+                break;
+            }
             fputc(TOKEN_PAREN_OPEN, outfile);
             const char * type = get_type(expr->data.typecast.cast_to);
             fprintf(outfile, "%s", type);
@@ -272,13 +1605,56 @@ void handle_expr(Expr * expr, FILE * outfile) {
             break;
 
         case EXPR_ACCESS_MEMBER:
+            if (expr->data.access_member.operand->type == EXPR_ID && expr->data.access_member.operand->data.id.declaration->type == DECLARATION_SUM) {
+                Declaration * sum = expr->data.access_member.operand->data.id.declaration;
+                fprintf(outfile, "%s_%s", string_cache_get(sum->id), string_cache_get(expr->data.access_member.member));
+                // Members that hold a value are called with it.
+                for (int i = 0; i < sum->data.sum.member_count; i++) {
+                    if (sum->data.sum.members[i].id.idx == expr->data.access_member.member.idx && !sum->data.sum.members[i].type_exists) fprintf(outfile, "()");
+                }
+                break;
+            }
+            // A member of an item of an soa array is read straight from the array of that member.
+            Expr * access = soa_access(expr->data.access_member.operand);
+            if (access) {
+                Type array = { .type = TYPE_ARRAY, .data.sub_type = &access->data.access_array.item_type };
+                const char * member = string_cache_get(expr->data.access_member.member);
+                if (access->data.access_array.checked) {
+                    fprintf(outfile, "(*%s_%s_at(", get_type(array), member);
+                    handle_soa_arguments(access, outfile);
+                    fputc(TOKEN_PAREN_CLOSE, outfile);
+                    break;
+                }
+                handle_expr(access->data.access_array.operand, outfile);
+                fprintf(outfile, ".%s", member);
+                fputc(TOKEN_BRACKET_OPEN, outfile);
+                handle_expr(access->data.access_array.index, outfile);
+                fputc(TOKEN_BRACKET_CLOSE, outfile);
+                break;
+            }
             handle_expr(expr->data.access_member.operand, outfile);
             fputc(TOKEN_DOT, outfile);
             fprintf(outfile, "%s", string_cache_get(expr->data.access_member.member));
             break;
 
         case EXPR_ACCESS_ARRAY:
+            if (type_is_soa(&expr->data.access_array.item_type)) {
+                Type array = { .type = TYPE_ARRAY, .data.sub_type = &expr->data.access_array.item_type };
+                fprintf(outfile, "%s_get(", get_type(array));
+                handle_soa_arguments(expr, outfile);
+                break;
+            }
+            if (expr->data.access_array.checked) {
+                Type array = { .type = TYPE_ARRAY, .data.sub_type = &expr->data.access_array.item_type };
+                fprintf(outfile, "(*%s_at(", get_type(array));
+                handle_expr(expr->data.access_array.operand, outfile);
+                fprintf(outfile, ", ");
+                handle_expr(expr->data.access_array.index, outfile);
+                fprintf(outfile, ", \"%s:%i\"))", string_cache_get(expr->location.file_name), expr->location.idx_line + 1);
+                break;
+            }
             handle_expr(expr->data.access_array.operand, outfile);
+            if (!expr->data.access_array.vector) fprintf(outfile, ".data");
             fputc(TOKEN_BRACKET_OPEN, outfile);
             handle_expr(expr->data.access_array.index, outfile);
             fputc(TOKEN_BRACKET_CLOSE, outfile);
@@ -298,8 +1674,31 @@ void handle_expr(Expr * expr, FILE * outfile) {
                 fprintf(outfile, "%s", string_cache_get(expr->data.function.type.data.function.params[expr->data.function.type.data.function.param_count - 1].id));
             }
             fputc(TOKEN_PAREN_CLOSE, outfile);
-            handle_scope(expr->data.function.scope, outfile);
-            
+            fputc(' ', outfile);
+            Expr * outer_function = current_function;
+            current_function = expr;
+            if (expr->data.function.uses_arena && expr->data.function.scope->type == SCOPE_BLOCK) {
+                fprintf(outfile, "{\n");
+                indent++;
+                write_indent(indent, outfile);
+                fprintf(outfile, "CreedArena _arena;\n");
+                write_indent(indent, outfile);
+                fprintf(outfile, "creed_arena_init(&_arena);\n");
+                handle_block_scopes(expr->data.function.scope, outfile);
+                // A body that ends in a return has already freed the arena.
+                Scope * body = expr->data.function.scope;
+                Scope * last = body->data.block.scope_count > 0 ? &body->data.block.scopes[body->data.block.scope_count - 1] : NULL;
+                if (!last || last->type != SCOPE_STATEMENT || last->data.statement.type != STATEMENT_RETURN) {
+                    write_indent(indent, outfile);
+                    fprintf(outfile, "creed_arena_release(&_arena);\n");
+                }
+                indent--;
+                write_indent(indent, outfile);
+                fprintf(outfile, "}\n\n");
+            } else {
+                handle_scope(expr->data.function.scope, outfile);
+            }
+            current_function = outer_function;
             break;
 
         case EXPR_FUNCTION_CALL:
@@ -317,7 +1716,7 @@ void handle_expr(Expr * expr, FILE * outfile) {
             break;
 
         case EXPR_ID:
-            fprintf(outfile, "%s", string_cache_get(expr->data.id));
+            fprintf(outfile, "%s", string_cache_get(expr->data.id.declaration_id));
             break;
 
         case EXPR_LITERAL:
@@ -334,17 +1733,32 @@ void handle_expr(Expr * expr, FILE * outfile) {
             break;
 
         case EXPR_LITERAL_ARRAY:
-            fputc(TOKEN_CURLY_BRACE_OPEN, outfile);
-            if (expr->data.literal_array.allocated_count) {
-                for (int i = 0; i < expr->data.literal_array.allocated_count-1; i++) {
-                    handle_expr(&expr->data.literal_array.members[i], outfile);
-                    fprintf(outfile, ", ");
-                }
-                handle_expr(&expr->data.literal_array.members[expr->data.literal_array.allocated_count-1], outfile);
-            }
+            handle_array_literal(expr, false, outfile);
+            break;
 
-            fputc(TOKEN_CURLY_BRACE_CLOSE, outfile);
+        case EXPR_VECTOR:
+            handle_vector(expr, outfile);
             break;
+
+        case EXPR_FILE: {
+            static const char * functions[] = { [EXPR_FILE_MAP] = "map", [EXPR_FILE_OPEN] = "open", [EXPR_FILE_NEXT] = "next", [EXPR_FILE_CLOSE] = "close" };
+            file_io = true;
+            fprintf(outfile, "creed_file_%s(", functions[expr->data.file.op]);
+            handle_expr(expr->data.file.args, outfile);
+            if (expr->data.file.op != EXPR_FILE_CLOSE) fprintf(outfile, ", \"%s:%i\"", string_cache_get(expr->location.file_name), expr->location.idx_line + 1);
+            fputc(TOKEN_PAREN_CLOSE, outfile);
+        } break;
+
+        case EXPR_REGEX: {
+            char name[32];
+            snprintf(name, sizeof(name), "_regex%i", regex_count++);
+            Type item = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_CHAR };
+            Type text = { .type = TYPE_ARRAY, .data.sub_type = &item };
+            RegexDfa dfa = regex_compile(string_cache_get(expr->data.regex), expr->location);
+            regex_write_matcher(&dfa, name, get_type(text), outlined_file);
+            regex_free(&dfa);
+            fprintf(outfile, "%s", name);
+        } break;
     }   
 }
 
@@ -356,45 +1770,32 @@ void handle_declaration(Declaration * declaration, FILE * outfile) {
                     if (!declaration->id.idx) {
                         error_exit(declaration->location, "Declaration must include an identifier.");
                     } 
-                    if (declaration->data.var.data.constant.type_explicit) {
-                        Type type = declaration->data.var.data.constant.type;
-                        if (!type.type) {
-                            error_exit(declaration->location, "Declaration must include a type.");
-                        }
+                    const char * id = string_cache_get(declaration->id);
+                    if (declaration->data.var.data.constant.value.type == EXPR_FUNCTION) {
+                        Type type = *declaration->data.var.data.constant.value.data.function.type.data.function.result;
                         const char * type_str = get_type(type);
-                        fprintf(outfile, "%s ", type_str);
+                        fprintf(outfile, "%s %s", type_str, id);
+                    }
+                    else if (declaration->data.var.data.constant.value.type == EXPR_REGEX) {
+                        Type item = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_CHAR };
+                        Type text = { .type = TYPE_ARRAY, .data.sub_type = &item };
+                        fprintf(outfile, "int (* const %s)(%s) %s ", id, get_type(text), string_assigns[TOKEN_ASSIGN - TOKEN_ASSIGN_MIN]);
                     }
                     else {
-                        if (declaration->data.var.data.constant.value.type == EXPR_FUNCTION) {
-                            Type type = *declaration->data.var.data.constant.value.data.function.type.data.function.result;
-                            const char * type_str = get_type(type);
-                            fprintf(outfile, "%s ", type_str);
-                        }
+                        // The typechecker infers the type of constants and folds their values into literals.
+                        const char * type_str = get_type(declaration->data.var.data.constant.type);
+                        fprintf(outfile, "const %s %s %s ", type_str, id, string_assigns[TOKEN_ASSIGN - TOKEN_ASSIGN_MIN]);
                     }
-                    const char * id = string_cache_get(declaration->id);
-                    fprintf(outfile, "%s", id);
-                    handle_expr(&declaration->data.var.data.constant.value, outfile);
+                    handle_initializer(&declaration->data.var.data.constant.value, outfile);
                     break;
                 }
                 case DECLARATION_VAR_MUTABLE: {
                     const char * type = get_type(declaration->data.var.data.mutable.type);
                     const char * id = string_cache_get(declaration->id);
-                    if (declaration->data.var.data.mutable.type.type == TYPE_ARRAY) {
-                        if (declaration->data.var.data.mutable.value.data.literal_array.count != NULL) {
-                            fprintf(outfile, "%s %s[", type, id);
-                            handle_expr(declaration->data.var.data.mutable.value.data.literal_array.count, outfile);
-                            fprintf(outfile, "]");
-                        }
-                        else {
-                            fprintf(outfile, "%s %s[]", type, id);
-                        }
-                    }
-                    else {
-                        fprintf(outfile, "%s %s", type, id);
-                    }
+                    fprintf(outfile, "%s %s", type, id);
                     if (declaration->data.var.data.mutable.value_exists) {
                         fprintf(outfile, " %s ", string_assigns[TOKEN_ASSIGN - TOKEN_ASSIGN_MIN]);
-                        handle_expr(&declaration->data.var.data.mutable.value, outfile);
+                        handle_initializer(&declaration->data.var.data.mutable.value, outfile);
                     }                   
                     break;
                 }
@@ -442,10 +1843,33 @@ void handle_declaration(Declaration * declaration, FILE * outfile) {
             fprintf(outfile, "%c", TOKEN_CURLY_BRACE_CLOSE);
             break;
 
-        // TO DO: Implement sum types?
-        case DECLARATION_SUM:
-            error_exit(declaration->location, "Translating this kind of declaration into C has not been implemented yet.");
-            break;
+        // A sum is a tag followed by a union of the values of its members. The tag is left out if the union is a pointer with room for it.
+        case DECLARATION_SUM: {
+            int niche = layout_sum_niche_member(declaration);
+            fprintf(outfile, "struct %s %c\n", string_cache_get(declaration->id), TOKEN_CURLY_BRACE_OPEN);
+            indent++;
+            if (niche < 0) {
+                write_indent(indent, outfile);
+                fprintf(outfile, "%s tag%c\n", sum_tag_type(declaration), TOKEN_SEMICOLON);
+            }
+            if (sum_has_values(declaration)) {
+                write_indent(indent, outfile);
+                fprintf(outfile, "union %c\n", TOKEN_CURLY_BRACE_OPEN);
+                indent++;
+                for (int i = 0; i < declaration->data.sum.member_count; i++) {
+                    if (!declaration->data.sum.members[i].type_exists) continue;
+                    const char * member_type = get_type(declaration->data.sum.members[i].type);
+                    write_indent(indent, outfile);
+                    fprintf(outfile, "%s %s%c\n", member_type, string_cache_get(declaration->data.sum.members[i].id), TOKEN_SEMICOLON);
+                }
+                indent--;
+                write_indent(indent, outfile);
+                fprintf(outfile, "%c as%c\n", TOKEN_CURLY_BRACE_CLOSE, TOKEN_SEMICOLON);
+            }
+            indent--;
+            write_indent(indent, outfile);
+            fprintf(outfile, "%c", TOKEN_CURLY_BRACE_CLOSE);
+        } break;
     }
 }
 
@@ -460,19 +1884,75 @@ void handle_driver(SourceFile * file) {
         perror("Failed to open output file.");
         exit(EXIT_FAILURE);
     }
+    // The declarations are written to temporary files first, since the array structs they use are only known once they have all been written.
+    FILE * typefile = tmpfile();
+    FILE * valuefile = tmpfile();
+    if (typefile == NULL || valuefile == NULL) {
+        perror("Failed to open a temporary file.");
+        exit(EXIT_FAILURE);
+    }
 
     indent = 0;
+    array_count = 0;
+    vector_count = 0;
+    for_each_count = 0;
+    match_count = 0;
+    parallel_count = 0;
+    regex_count = 0;
+    arena_mark_count = 0;
+    array_allocations = false;
+    parallel_loops = false;
+    file_io = false;
+    current_function = NULL;
+    current_file = file;
+    outlined_file = valuefile;
     // First pass
     for (int i = 0; i < file->declaration_count; i++) {
         if (file->declarations[i].type != DECLARATION_VAR) {
-            handle_declaration(&file->declarations[i], outfile);
+            if (trace_enabled) trace_begin("emit declaration", string_cache_get(file->declarations[i].id));
+            handle_declaration(&file->declarations[i], typefile);
+            handle_statement_end(typefile);
+            if (trace_enabled) trace_end(NULL);
         }
     }
     // Second Pass
     for (int j = 0; j < file->declaration_count; j++) {
-        if (file->declarations[j].type == DECLARATION_VAR) {
-            handle_declaration(&file->declarations[j], outfile);
+        if (file->declarations[j].type != DECLARATION_VAR) continue;
+        // Every declaration goes through a file of its own, so the functions outlined from it can be written before it.
+        FILE * declfile = tmpfile();
+        if (declfile == NULL) {
+            perror("Failed to open a temporary file.");
+            exit(EXIT_FAILURE);
         }
+        if (trace_enabled) trace_begin("emit declaration", string_cache_get(file->declarations[j].id));
+        handle_declaration(&file->declarations[j], declfile);
+        if (!declaration_is_function(&file->declarations[j])) handle_statement_end(declfile);
+        handle_copy(declfile, valuefile);
+        if (trace_enabled) trace_end(NULL);
+    }
+
+    if (file_io) {
+        // The file functions take and return these, so they are written out whether the program uses them or not.
+        Type item = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_UINT8 };
+        get_type((Type) { .type = TYPE_ARRAY, .data.sub_type = &item });
+        item.data.primitive = TOKEN_KEYWORD_TYPE_CHAR;
+        get_type((Type) { .type = TYPE_ARRAY, .data.sub_type = &item });
     }
+    // The thread pool and the file functions use POSIX functions, which the C headers only declare if this comes before them.
+    if (parallel_loops || file_io) fprintf(outfile, "#define _POSIX_C_SOURCE 200809L\n");
+    if (parallel_loops) handle_parallel_runtime(outfile);
+    handle_vectors(outfile);
+    handle_arrays(outfile);
+    if (file_io) handle_file_runtime(outfile);
+    handle_copy(typefile, outfile);
+    handle_array_accessors(outfile);
+    handle_sums(file, outfile);
+    handle_copy(valuefile, outfile);
     fclose(outfile);
+
+    allocator_free(array_types);
+    allocator_free(vector_types);
+    array_types = NULL;
+    vector_types = NULL;
+    array_count_alloc = vector_count_alloc = 0;
 }   
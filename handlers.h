@@ -1,9 +1,15 @@
+#include <stdbool.h>
 #include <stdio.h>
 
 #include "parser.h"
 
 void write_indent(int count, FILE * outfile);
 const char * get_type(Type creadz_type);
+void handle_vectors(FILE * outfile);
+void handle_arrays(FILE * outfile);
+void handle_array_accessors(FILE * outfile);
+void handle_sums(SourceFile * file, FILE * outfile);
+void handle_array_literal(Expr * expr, bool initializer, FILE * outfile);
 void handle_scope(Scope * scope, FILE * outfile);
 void handle_expr(Expr * expr, FILE * outfile);
 void handle_declaration(Declaration * declaration, FILE * outfile);
@@ -0,0 +1,554 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "inline.h"
+#include "call_graph.h"
+#include "constant.h"
+#include "opt_util.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+
+#define INLINE_PASS "inline"
+
+typedef struct InlineCaller {
+    CallGraph *graph;
+    Declaration *decl;
+
+    StringId *local_ids; // Every name declared in the caller, inlined code must not refer to a global with one of these names.
+    int local_count;
+    int local_count_alloc;
+
+    int budget;
+    int growth;
+    int inlined;
+} InlineCaller;
+
+static void inline_local_add(InlineCaller *caller, StringId id) {
+    caller->local_count++;
+    if (caller->local_count > caller->local_count_alloc) {
+        caller->local_count_alloc = caller->local_count_alloc == 0 ? 8 : caller->local_count_alloc * 2;
+        caller->local_ids = allocator_realloc(ALLOCATOR_OPTIMIZE, caller->local_ids, sizeof(StringId) * caller->local_count_alloc);
+    }
+    caller->local_ids[caller->local_count - 1] = id;
+}
+
+static void inline_locals_collect(InlineCaller *caller, Scope *scope);
+
+static void inline_locals_collect_statement(InlineCaller *caller, Statement *statement) {
+    if (statement->type == STATEMENT_DECLARATION) inline_local_add(caller, statement->data.declaration.id);
+}
+
+static void inline_locals_collect(InlineCaller *caller, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            inline_locals_collect_statement(caller, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            inline_locals_collect(caller, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) inline_locals_collect(caller, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            inline_locals_collect_statement(caller, &scope->data.loop_for.init);
+            inline_locals_collect(caller, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            inline_local_add(caller, scope->data.loop_for_each.element);
+            inline_locals_collect(caller, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            inline_locals_collect(caller, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) inline_locals_collect(caller, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                if (match_case->declares) inline_locals_collect_statement(caller, &match_case->declared_var);
+                for (int j = 0; j < match_case->scope_count; j++) inline_locals_collect(caller, match_case->scopes + j);
+            }
+            break;
+    }
+}
+
+// Returns the returned expression if the body of this function is a single return statement.
+static Expr *inline_candidate_body(Expr *function) {
+    Scope *scope = function->data.function.scope;
+    if (scope->type == SCOPE_BLOCK) {
+        if (scope->data.block.scope_count != 1) return NULL;
+        scope = scope->data.block.scopes;
+    }
+    if (scope->type != SCOPE_STATEMENT) return NULL;
+
+    Statement *statement = &scope->data.statement;
+    if (statement->type != STATEMENT_RETURN || !statement->data.return_value.exists) return NULL;
+    return &statement->data.return_value.expr;
+}
+
+// Function expressions own a scope and array literals allocate, neither of which we duplicate.
+static bool inline_expr_is_clonable(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return inline_expr_is_clonable(expr->data.parenthesized);
+        case EXPR_UNARY:
+            return inline_expr_is_clonable(expr->data.unary.operand);
+        case EXPR_BINARY:
+            return inline_expr_is_clonable(expr->data.binary.lhs) && inline_expr_is_clonable(expr->data.binary.rhs);
+        case EXPR_TYPECAST:
+            return inline_expr_is_clonable(expr->data.typecast.operand);
+        case EXPR_ACCESS_MEMBER:
+            return inline_expr_is_clonable(expr->data.access_member.operand);
+        case EXPR_ACCESS_ARRAY:
+            return inline_expr_is_clonable(expr->data.access_array.operand) && inline_expr_is_clonable(expr->data.access_array.index);
+        case EXPR_FUNCTION_CALL:
+            if (!inline_expr_is_clonable(expr->data.function_call.function)) return false;
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                if (!inline_expr_is_clonable(expr->data.function_call.params + i)) return false;
+            }
+            return true;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) {
+                if (!inline_expr_is_clonable(expr->data.vector.args + i)) return false;
+            }
+            return true;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) {
+                if (!inline_expr_is_clonable(expr->data.file.args + i)) return false;
+            }
+            return true;
+        case EXPR_FUNCTION:
+        case EXPR_LITERAL_ARRAY:
+            return false;
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return true;
+    }
+    assert(false);
+}
+
+// A parameter that has its address taken can't be replaced by the argument expression.
+static bool inline_takes_address(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return inline_takes_address(expr->data.parenthesized);
+        case EXPR_UNARY:
+            return expr->data.unary.type == EXPR_UNARY_REF || inline_takes_address(expr->data.unary.operand);
+        case EXPR_BINARY:
+            return inline_takes_address(expr->data.binary.lhs) || inline_takes_address(expr->data.binary.rhs);
+        case EXPR_TYPECAST:
+            return inline_takes_address(expr->data.typecast.operand);
+        case EXPR_ACCESS_MEMBER:
+            return inline_takes_address(expr->data.access_member.operand);
+        case EXPR_ACCESS_ARRAY:
+            return inline_takes_address(expr->data.access_array.operand) || inline_takes_address(expr->data.access_array.index);
+        case EXPR_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                if (inline_takes_address(expr->data.function_call.params + i)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// Returns true if an identifier in the callee body that isn't a parameter would resolve to a local of the caller.
+static bool inline_is_shadowed(InlineCaller *caller, Expr *expr, Expr *function) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return inline_is_shadowed(caller, expr->data.parenthesized, function);
+        case EXPR_UNARY:
+            return inline_is_shadowed(caller, expr->data.unary.operand, function);
+        case EXPR_BINARY:
+            return inline_is_shadowed(caller, expr->data.binary.lhs, function) || inline_is_shadowed(caller, expr->data.binary.rhs, function);
+        case EXPR_TYPECAST:
+            return inline_is_shadowed(caller, expr->data.typecast.operand, function);
+        case EXPR_ACCESS_MEMBER:
+            return inline_is_shadowed(caller, expr->data.access_member.operand, function);
+        case EXPR_ACCESS_ARRAY:
+            return inline_is_shadowed(caller, expr->data.access_array.operand, function) || inline_is_shadowed(caller, expr->data.access_array.index, function);
+        case EXPR_FUNCTION_CALL:
+            if (inline_is_shadowed(caller, expr->data.function_call.function, function)) return true;
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                if (inline_is_shadowed(caller, expr->data.function_call.params + i, function)) return true;
+            }
+            return false;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) {
+                if (inline_is_shadowed(caller, expr->data.vector.args + i, function)) return true;
+            }
+            return false;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) {
+                if (inline_is_shadowed(caller, expr->data.file.args + i, function)) return true;
+            }
+            return false;
+        case EXPR_ID: {
+            Declaration *params = function->data.function.param_declarations;
+            int param_count = function->data.function.type.data.function.param_count;
+            if (params <= expr->data.id.declaration && expr->data.id.declaration < params + param_count) return false;
+            for (int i = 0; i < caller->local_count; i++) {
+                if (caller->local_ids[i].idx == expr->data.id.declaration_id.idx) return true;
+            }
+            return false;
+        }
+        case EXPR_FUNCTION:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+        case EXPR_LITERAL_ARRAY:
+            return false;
+    }
+    assert(false);
+}
+
+// An argument whose value can't be changed by a call in the inlined body, so it can be evaluated later than it would be.
+static bool inline_arg_is_stable(InlineCaller *caller, Expr *arg) {
+    if (constant_is_folded(arg)) return true;
+    if (arg->type != EXPR_ID) return false;
+    Declaration *decl = arg->data.id.declaration;
+    return call_graph_index(caller->graph, decl) < 0 || decl->type != DECLARATION_VAR || decl->data.var.type == DECLARATION_VAR_CONSTANT;
+}
+
+static bool inline_expr_is_atomic(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+        case EXPR_FUNCTION_CALL:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void inline_substitute(Expr *expr, Expr *function, Expr *args) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            inline_substitute(expr->data.parenthesized, function, args);
+            break;
+        case EXPR_UNARY:
+            inline_substitute(expr->data.unary.operand, function, args);
+            break;
+        case EXPR_BINARY:
+            inline_substitute(expr->data.binary.lhs, function, args);
+            inline_substitute(expr->data.binary.rhs, function, args);
+            break;
+        case EXPR_TYPECAST:
+            inline_substitute(expr->data.typecast.operand, function, args);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            inline_substitute(expr->data.access_member.operand, function, args);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            inline_substitute(expr->data.access_array.operand, function, args);
+            inline_substitute(expr->data.access_array.index, function, args);
+            break;
+        case EXPR_FUNCTION_CALL:
+            inline_substitute(expr->data.function_call.function, function, args);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) inline_substitute(expr->data.function_call.params + i, function, args);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) inline_substitute(expr->data.vector.args + i, function, args);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) inline_substitute(expr->data.file.args + i, function, args);
+            break;
+        case EXPR_ID: {
+            Declaration *params = function->data.function.param_declarations;
+            int param_count = function->data.function.type.data.function.param_count;
+            Declaration *decl = expr->data.id.declaration;
+            if (decl < params || params + param_count <= decl) break;
+
+            Expr *arg = args + (decl - params);
+            Expr replacement = expr_clone(arg);
+            if (!inline_expr_is_atomic(&replacement)) {
+                replacement = (Expr) {
+                    .location = arg->location,
+                    .type = EXPR_PAREN,
+                    .data.parenthesized = expr_alloc(replacement)
+                };
+            }
+            *expr = replacement;
+        } break;
+        case EXPR_FUNCTION:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+        case EXPR_LITERAL_ARRAY:
+            break;
+    }
+}
+
+// Folding after substitution must not report errors the program never hits at runtime,
+// like a division by a zero argument on a path that is never taken, so operations that can fail are left alone.
+static bool inline_fold_is_safe(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_BINARY: {
+            TokenType operator = expr->data.binary.operator;
+            if (operator == TOKEN_OP_DIVIDE || operator == TOKEN_OP_MODULO) return false;
+            if (operator == TOKEN_OP_SHIFT_LEFT || operator == TOKEN_OP_SHIFT_RIGHT) return false;
+            Expr *lhs = expr->data.binary.lhs;
+            return !(lhs->type == EXPR_LITERAL && (lhs->data.literal.type == LITERAL_FLOAT || lhs->data.literal.type == LITERAL_FLOAT64));
+        }
+        case EXPR_TYPECAST: {
+            Expr *operand = expr->data.typecast.operand;
+            return !(operand->type == EXPR_LITERAL && (operand->data.literal.type == LITERAL_FLOAT || operand->data.literal.type == LITERAL_FLOAT64));
+        }
+        default:
+            return true;
+    }
+}
+
+static void inline_fold(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            inline_fold(expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            inline_fold(expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            inline_fold(expr->data.binary.lhs);
+            inline_fold(expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            inline_fold(expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            inline_fold(expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            inline_fold(expr->data.access_array.operand);
+            inline_fold(expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.param_count; i++) inline_fold(expr->data.function_call.params + i);
+            break;
+        default:
+            break;
+    }
+    if (inline_fold_is_safe(expr)) constant_fold(expr);
+}
+
+static void inline_call(InlineCaller *caller, Expr *expr) {
+    Expr *callee_expr = expr->data.function_call.function;
+    while (callee_expr->type == EXPR_PAREN) callee_expr = callee_expr->data.parenthesized;
+    if (callee_expr->type != EXPR_ID) return;
+
+    Declaration *callee = callee_expr->data.id.declaration;
+    int idx = call_graph_index(caller->graph, callee);
+    if (idx < 0 || !declaration_is_function(callee)) return;
+
+    Expr *function = &callee->data.var.data.constant.value;
+    bool annotated = function->data.function.is_inline;
+    const char *name = string_cache_get(callee->id);
+
+    if (caller->graph->nodes[idx].recursive) {
+        if (annotated) remark(expr->location, INLINE_PASS, "'%s' not inlined: it is recursive", name);
+        return;
+    }
+
+    Expr *body = inline_candidate_body(function);
+    if (!body || !inline_expr_is_clonable(body) || inline_takes_address(body)) {
+        if (annotated) remark(expr->location, INLINE_PASS, "'%s' not inlined: its body is not a single return expression", name);
+        return;
+    }
+
+    int body_calls = expr_call_count(body);
+    int growth = expr_node_count(body) - expr_node_count(expr);
+    Expr *args = expr->data.function_call.params;
+    for (int i = 0; i < expr->data.function_call.param_count; i++) {
+        Expr *arg = args + i;
+        int uses = expr_uses(body, function->data.function.param_declarations + i);
+        bool reordered = expr_call_count(arg) > 0 ? uses != 1 || body_calls > 0 : body_calls > 0 && !inline_arg_is_stable(caller, arg);
+        if (reordered || !inline_expr_is_clonable(arg)) {
+            remark(expr->location, INLINE_PASS, "'%s' not inlined: argument %i would not be evaluated exactly once, in order", name, i + 1);
+            return;
+        }
+        growth += uses * (expr_node_count(arg) - 1);
+    }
+
+    if (inline_is_shadowed(caller, body, function)) {
+        remark(expr->location, INLINE_PASS, "'%s' not inlined: it refers to a name the caller redeclares", name);
+        return;
+    }
+
+    int threshold = annotated ? INLINE_GROWTH_MAX_ANNOTATED : INLINE_GROWTH_MAX;
+    if (growth > threshold) {
+        remark(expr->location, INLINE_PASS, "'%s' not inlined: cost %i exceeds threshold %i", name, growth, threshold);
+        return;
+    }
+    if (caller->growth + growth > caller->budget) {
+        remark(expr->location, INLINE_PASS, "'%s' not inlined: '%s' has used its growth budget of %i", name, string_cache_get(caller->decl->id), caller->budget);
+        return;
+    }
+
+    Expr inlined = expr_clone(body);
+    inline_substitute(&inlined, function, args);
+    Location location = expr->location;
+    expr_free(expr);
+    *expr = (Expr) {
+        .location = location,
+        .type = EXPR_PAREN,
+        .data.parenthesized = expr_alloc(inlined)
+    };
+    inline_fold(expr);
+
+    caller->growth += growth;
+    caller->inlined++;
+    remark(location, INLINE_PASS, "'%s' inlined into '%s' (cost %i, threshold %i)", name, string_cache_get(caller->decl->id), growth, threshold);
+}
+
+static void inline_visit_scope(InlineCaller *caller, Scope *scope);
+
+static void inline_visit_expr(InlineCaller *caller, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            inline_visit_expr(caller, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            inline_visit_expr(caller, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            inline_visit_expr(caller, expr->data.binary.lhs);
+            inline_visit_expr(caller, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            inline_visit_expr(caller, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            inline_visit_expr(caller, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            inline_visit_expr(caller, expr->data.access_array.operand);
+            inline_visit_expr(caller, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.param_count; i++) inline_visit_expr(caller, expr->data.function_call.params + i);
+            inline_call(caller, expr);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) inline_visit_expr(caller, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) inline_visit_expr(caller, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) inline_visit_expr(caller, expr->data.file.args + i);
+            break;
+        case EXPR_FUNCTION: // Nested functions are separate callers.
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void inline_visit_statement(InlineCaller *caller, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION: {
+            Declaration *decl = &statement->data.declaration;
+            if (decl->type != DECLARATION_VAR) break;
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) inline_visit_expr(caller, &decl->data.var.data.constant.value);
+            else if (decl->data.var.data.mutable.value_exists) inline_visit_expr(caller, &decl->data.var.data.mutable.value);
+        } break;
+        case STATEMENT_INCREMENT:
+            inline_visit_expr(caller, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            inline_visit_expr(caller, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            inline_visit_expr(caller, &statement->data.assign.assignee);
+            inline_visit_expr(caller, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            inline_visit_expr(caller, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) inline_visit_expr(caller, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+static void inline_visit_scope(InlineCaller *caller, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            inline_visit_statement(caller, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            inline_visit_expr(caller, &scope->data.conditional.condition);
+            inline_visit_scope(caller, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) inline_visit_scope(caller, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            inline_visit_statement(caller, &scope->data.loop_for.init);
+            inline_visit_expr(caller, &scope->data.loop_for.expr);
+            inline_visit_statement(caller, &scope->data.loop_for.step);
+            inline_visit_scope(caller, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            inline_visit_expr(caller, &scope->data.loop_for_each.array);
+            inline_visit_scope(caller, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            inline_visit_expr(caller, &scope->data.loop_while.expr);
+            inline_visit_scope(caller, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) inline_visit_scope(caller, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            inline_visit_expr(caller, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) inline_visit_scope(caller, scope->data.match.cases[i].scopes + j);
+            }
+            break;
+    }
+}
+
+void inline_functions(SourceFile *file) {
+    CallGraph graph = call_graph_new(file);
+    int inlined = 0;
+    int size_before = 0;
+    int size_after = 0;
+
+    // Callees come first, so their bodies have already had their own calls inlined when they get copied.
+    for (int i = 0; i < graph.node_count; i++) {
+        Declaration *decl = graph.nodes[graph.order[i]].decl;
+        if (!declaration_is_function(decl)) continue;
+
+        Expr *function = &decl->data.var.data.constant.value;
+        int size = declaration_node_count(decl);
+        InlineCaller caller = {
+            .graph = &graph,
+            .decl = decl,
+            .budget = size > INLINE_BUDGET_MIN ? size : INLINE_BUDGET_MIN
+        };
+        for (int j = 0; j < function->data.function.type.data.function.param_count; j++) {
+            inline_local_add(&caller, function->data.function.type.data.function.params[j].id);
+        }
+        inline_locals_collect(&caller, function->data.function.scope);
+
+        inline_visit_scope(&caller, function->data.function.scope);
+
+        inlined += caller.inlined;
+        size_before += size;
+        size_after += declaration_node_count(decl);
+        allocator_free(caller.local_ids);
+    }
+
+    remark_summary(INLINE_PASS, "%i call sites inlined, code size %i -> %i nodes (%+i)", inlined, size_before, size_after, size_after - size_before);
+    call_graph_free(&graph);
+}
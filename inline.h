@@ -0,0 +1,17 @@
+#ifndef CREED_INLINE_H
+#define CREED_INLINE_H
+
+#include "parser.h"
+
+// Functions whose body is a single return statement are substituted into their call sites.
+// A call is inlined when the estimated code growth fits under INLINE_GROWTH_MAX
+// (INLINE_GROWTH_MAX_ANNOTATED for functions annotated with inline), and the caller has budget left.
+// Recursive functions are never inlined. Run this after typechecking.
+
+#define INLINE_GROWTH_MAX 8
+#define INLINE_GROWTH_MAX_ANNOTATED 64
+#define INLINE_BUDGET_MIN 32 // A caller may grow by its own size, or by this much if it is smaller.
+
+void inline_functions(SourceFile *file);
+
+#endif
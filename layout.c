@@ -0,0 +1,231 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "layout.h"
+#include "parser.h"
+#include "string_cache.h"
+
+static unsigned long long layout_align_up(unsigned long long offset, unsigned long long align) {
+    return (offset + align - 1) / align * align;
+}
+
+LayoutSize layout_type_size(Type *type) {
+    switch (type->type) {
+        case TYPE_PRIMITIVE:
+            switch (type->data.primitive) {
+                case TOKEN_KEYWORD_TYPE_VOID: return (LayoutSize) { 0, 1 };
+                case TOKEN_KEYWORD_TYPE_CHAR:
+                case TOKEN_KEYWORD_TYPE_INT8:
+                case TOKEN_KEYWORD_TYPE_UINT8: return (LayoutSize) { 1, 1 };
+                case TOKEN_KEYWORD_TYPE_INT16:
+                case TOKEN_KEYWORD_TYPE_UINT16: return (LayoutSize) { 2, 2 };
+                case TOKEN_KEYWORD_TYPE_INT64:
+                case TOKEN_KEYWORD_TYPE_UINT64:
+                case TOKEN_KEYWORD_TYPE_FLOAT64:
+                case TOKEN_KEYWORD_FILE: return (LayoutSize) { 8, 8 }; // Files are a pointer to their state.
+                default: return (LayoutSize) { 4, 4 }; // int, uint, float, and bool, which is an int in C.
+            }
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+        case TYPE_FUNCTION:
+            return (LayoutSize) { 8, 8 };
+        case TYPE_ARRAY:
+            return (LayoutSize) { 16, 8 }; // A count and a pointer.
+        case TYPE_ID:
+            return layout_declaration_size(type->data.id.type_declaration);
+        case TYPE_VECTOR: {
+            // Aligned to their size, but no more than the 16 bytes allocations are aligned to.
+            Type element = { .type = TYPE_PRIMITIVE, .data.primitive = type->data.vector.element };
+            unsigned long long size = layout_type_size(&element).size * type->data.vector.width;
+            return (LayoutSize) { size, size < 16 ? size : 16 };
+        }
+    }
+    assert(false);
+    return (LayoutSize) { 0, 1 };
+}
+
+int layout_sum_niche_member(Declaration *sum) {
+    int niche = -1;
+    if (sum->data.sum.member_count > 4096) return -1;
+    for (int i = 0; i < sum->data.sum.member_count; i++) {
+        if (!sum->data.sum.members[i].type_exists) continue;
+        if (niche >= 0 || sum->data.sum.members[i].type.type != TYPE_PTR) return -1;
+        niche = i;
+    }
+    return niche;
+}
+
+int layout_sum_tag_size(Declaration *sum) {
+    if (sum->data.sum.member_count <= UCHAR_MAX + 1) return 1;
+    if (sum->data.sum.member_count <= USHRT_MAX + 1) return 2;
+    return 4;
+}
+
+LayoutSize layout_declaration_size(Declaration *decl) {
+    LayoutSize layout = { 0, 1 };
+    switch (decl->type) {
+        case DECLARATION_STRUCT:
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) {
+                LayoutSize member = layout_type_size(&decl->data.struct_union.members[i].type);
+                layout.size = layout_align_up(layout.size, member.align) + member.size;
+                if (member.align > layout.align) layout.align = member.align;
+            }
+            break;
+        case DECLARATION_UNION:
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) {
+                LayoutSize member = layout_type_size(&decl->data.struct_union.members[i].type);
+                if (member.size > layout.size) layout.size = member.size;
+                if (member.align > layout.align) layout.align = member.align;
+            }
+            break;
+        case DECLARATION_SUM: {
+            if (layout_sum_niche_member(decl) >= 0) return (LayoutSize) { 8, 8 };
+            // The tag, then a union of the values.
+            LayoutSize values = { 0, 1 };
+            for (int i = 0; i < decl->data.sum.member_count; i++) {
+                if (!decl->data.sum.members[i].type_exists) continue;
+                LayoutSize member = layout_type_size(&decl->data.sum.members[i].type);
+                if (member.size > values.size) values.size = member.size;
+                if (member.align > values.align) values.align = member.align;
+            }
+            layout.size = layout.align = layout_sum_tag_size(decl);
+            if (values.size > 0) layout.size = layout_align_up(layout.size, values.align) + values.size;
+            if (values.align > layout.align) layout.align = values.align;
+        } break;
+        case DECLARATION_ENUM:
+            return (LayoutSize) { 4, 4 };
+        case DECLARATION_VAR:
+            assert(false);
+            break;
+    }
+    layout.size = layout_align_up(layout.size, layout.align);
+    return layout;
+}
+
+static unsigned long long layout_padding(Declaration *decl, LayoutSize layout) {
+    unsigned long long used = 0;
+    for (int i = 0; i < decl->data.struct_union.member_count; i++) used += layout_type_size(&decl->data.struct_union.members[i].type).size;
+    return layout.size - used;
+}
+
+typedef struct LayoutProfileEntry {
+    char *type;
+    char *member;
+    unsigned long long count;
+} LayoutProfileEntry;
+
+static char *layout_string_copy(const char *string) {
+    char *copy = allocator_malloc(ALLOCATOR_OPTIMIZE, strlen(string) + 1);
+    strcpy(copy, string);
+    return copy;
+}
+
+static unsigned long long layout_profile_count(LayoutProfileEntry *profile, int profile_count, Declaration *decl, StringId member) {
+    for (int i = 0; i < profile_count; i++) {
+        if (!strcmp(profile[i].type, string_cache_get(decl->id)) && !strcmp(profile[i].member, string_cache_get(member))) return profile[i].count;
+    }
+    return 0;
+}
+
+void layout_optimize(SourceFile *file, const char *profile_path) {
+    LayoutProfileEntry *profile = NULL;
+    int profile_count = 0;
+    if (profile_path) {
+        FILE *profile_file = fopen(profile_path, "r");
+        if (!profile_file) {
+            perror("Failed to open the layout profile");
+            exit(EXIT_FAILURE);
+        }
+        char type[256], member[256];
+        unsigned long long count;
+        int profile_count_alloc = 0;
+        while (fscanf(profile_file, " %255[^. \t\n].%255s %llu", type, member, &count) == 3) {
+            profile_count++;
+            if (profile_count > profile_count_alloc) {
+                profile_count_alloc = profile_count_alloc == 0 ? 16 : profile_count_alloc * 2;
+                profile = allocator_realloc(ALLOCATOR_OPTIMIZE, profile, sizeof(LayoutProfileEntry) * profile_count_alloc);
+            }
+            profile[profile_count - 1] = (LayoutProfileEntry) { .type = layout_string_copy(type), .member = layout_string_copy(member), .count = count };
+        }
+        fclose(profile_file);
+    }
+
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (decl->type != DECLARATION_STRUCT) continue;
+        MemberStructUnion *members = decl->data.struct_union.members;
+        int member_count = decl->data.struct_union.member_count;
+
+        // An insertion sort keeps members that compare equal in the order they were declared.
+        for (int j = 1; j < member_count; j++) {
+            MemberStructUnion member = members[j];
+            bool hot = layout_profile_count(profile, profile_count, decl, member.id) > 0;
+            unsigned long long align = layout_type_size(&member.type).align;
+            int k = j;
+            while (k > 0) {
+                bool previous_hot = layout_profile_count(profile, profile_count, decl, members[k - 1].id) > 0;
+                unsigned long long previous_align = layout_type_size(&members[k - 1].type).align;
+                if (previous_hot != hot ? previous_hot : previous_align >= align) break;
+                members[k] = members[k - 1];
+                k--;
+            }
+            members[k] = member;
+        }
+    }
+
+    for (int i = 0; i < profile_count; i++) {
+        allocator_free(profile[i].type);
+        allocator_free(profile[i].member);
+    }
+    allocator_free(profile);
+}
+
+static LayoutSize *report_sizes;
+static unsigned long long *report_paddings;
+
+void layout_report_begin(SourceFile *file) {
+    report_sizes = allocator_calloc(ALLOCATOR_OPTIMIZE, file->declaration_count, sizeof(LayoutSize));
+    report_paddings = allocator_calloc(ALLOCATOR_OPTIMIZE, file->declaration_count, sizeof(unsigned long long));
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (decl->type != DECLARATION_STRUCT) continue;
+        report_sizes[i] = layout_declaration_size(decl);
+        report_paddings[i] = layout_padding(decl, report_sizes[i]);
+    }
+}
+
+void layout_report(SourceFile *file, FILE *outfile) {
+    unsigned long long saved = 0;
+    int struct_count = 0;
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (decl->type != DECLARATION_STRUCT) continue;
+        LayoutSize layout = layout_declaration_size(decl);
+        unsigned long long padding = layout_padding(decl, layout);
+        struct_count++;
+        saved += report_sizes[i].size - layout.size;
+
+        fprintf(outfile, "struct %s\n", string_cache_get(decl->id));
+        fprintf(outfile, "    declared:  %llu bytes, aligned to %llu, %llu byte%s of padding\n", report_sizes[i].size, report_sizes[i].align, report_paddings[i], report_paddings[i] == 1 ? "" : "s");
+        fprintf(outfile, "    optimized: %llu bytes, aligned to %llu, %llu byte%s of padding\n", layout.size, layout.align, padding, padding == 1 ? "" : "s");
+
+        unsigned long long offset = 0;
+        for (int j = 0; j < decl->data.struct_union.member_count; j++) {
+            LayoutSize member = layout_type_size(&decl->data.struct_union.members[j].type);
+            unsigned long long start = layout_align_up(offset, member.align);
+            if (start > offset) fprintf(outfile, "    %6llu  (%llu byte%s of padding)\n", offset, start - offset, start - offset == 1 ? "" : "s");
+            fprintf(outfile, "    %6llu  %s (%llu byte%s)\n", start, string_cache_get(decl->data.struct_union.members[j].id), member.size, member.size == 1 ? "" : "s");
+            offset = start + member.size;
+        }
+        if (layout.size > offset) fprintf(outfile, "    %6llu  (%llu byte%s of padding)\n", offset, layout.size - offset, layout.size - offset == 1 ? "" : "s");
+    }
+    fprintf(outfile, "%i structs, %llu bytes saved per value in total\n", struct_count, saved);
+
+    allocator_free(report_sizes);
+    allocator_free(report_paddings);
+    report_sizes = NULL;
+    report_paddings = NULL;
+}
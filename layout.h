@@ -0,0 +1,35 @@
+#ifndef CREED_LAYOUT_H
+#define CREED_LAYOUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "parser.h"
+
+// Sizes and alignments of the C types the code generator emits, for a target where pointers and long long are 8 bytes.
+typedef struct LayoutSize {
+    unsigned long long size;
+    unsigned long long align;
+} LayoutSize;
+
+LayoutSize layout_type_size(Type *type);
+LayoutSize layout_declaration_size(Declaration *decl);
+
+// A sum with a single member that holds a pointer, which can never be null or point into the first page of memory,
+// is stored as just that pointer, and the members without a value are those addresses. Returns that member, or -1.
+int layout_sum_niche_member(Declaration *sum);
+// Size in bytes of the smallest unsigned type that can tell every member of a sum apart.
+int layout_sum_tag_size(Declaration *sum);
+
+// Reorders the members of every struct so that as little space as possible is lost to padding: members with a larger alignment go first.
+// With a profile, members it counts as used go before all others, so they share the first cache lines.
+// A profile has a line per member with a use count, like "Particle.x 1200". Members not in it have a count of 0.
+// Structs have no positional syntax, so only their layout in memory changes.
+void layout_optimize(SourceFile *file, const char *profile_path);
+
+// Writes the size, alignment and padding of every struct, as it was declared and as it is now.
+// Call layout_report_begin before layout_optimize, and layout_report after.
+void layout_report_begin(SourceFile *file);
+void layout_report(SourceFile *file, FILE *outfile);
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "allocator.h"
 #include "lexer.h"
 #include "prelude.h"
 #include "string_builder.h"
@@ -20,19 +21,22 @@ Lexer lexer_new(StringId path) {
         exit(EXIT_FAILURE);
     }
 
-    char *str = malloc(st.st_size + sizeof(char));
+    char *str = allocator_malloc(ALLOCATOR_LEXER, st.st_size + sizeof(char));
     size_t size = fread(str, 1, st.st_size, file);
     fclose(file);
     str[size / sizeof(char)] = '\0';
 
-    StringId file_content = string_cache_insert(str); 
+    return lexer_new_content(path, string_cache_insert(str));
+}
 
+Lexer lexer_new_content(StringId file_name, StringId file_content) {
     return (Lexer) {
-        .file_name = path,
+        .file_name = file_name,
         .file_content = file_content,
         .file_content_ptr = string_cache_get(file_content),
         .idx_line = 0,
         .idx_char = 0,
+        .brace_depth = 0,
         .peek_idx = 0,
         .peek_count = 0
     };
@@ -180,7 +184,7 @@ static Token lexer_token_get_skip_cache(Lexer *lexer) {
     
     case '/': // todo: add multiline comments
         if (lexer_char_get_if(lexer, '/')) { // is a comment, skip
-            while (lexer_char_peek(lexer) != '\n') lexer_char_get(lexer);
+            while (lexer_char_peek(lexer) != '\n' && lexer_char_peek(lexer) != '\0') lexer_char_get(lexer);
             return lexer_token_get_skip_cache(lexer);
         } else if (lexer_char_get_if(lexer, '='))
             token.type = TOKEN_ASSIGN_DIVIDE;
@@ -301,7 +305,7 @@ static Token lexer_token_get_skip_cache(Lexer *lexer) {
                     token.type = TOKEN_ERROR_LITERAL_NUMBER_ILLEGAL_TYPE_SPEC;
                 }
 
-                free(string);
+                allocator_free(string);
             } else if (is_float) {
                 token.data.literal.type = LITERAL_FLOAT;
                 token.data.literal.data.l_float = (float) literal_float64;
@@ -327,7 +331,7 @@ static Token lexer_token_get_skip_cache(Lexer *lexer) {
                 if (!strcmp(string, string_keywords[i])) {
                     token.type = TOKEN_KEYWORD_MIN + i;
                     is_keyword = true;
-                    free(string);
+                    allocator_free(string);
                     break;
                 }
             }
@@ -370,11 +374,15 @@ Token lexer_token_peek_many(Lexer *lexer, int count) {
 }
 
 Token lexer_token_get(Lexer *lexer) {
+    Token token;
     if (lexer->peek_count > 0) {
         lexer->peek_count--;
-        int idx = lexer->peek_idx;
+        token = lexer->peeks[lexer->peek_idx];
         lexer->peek_idx = (lexer->peek_idx + 1) % LEXER_TOKEN_PEEK_MAX;
-        return lexer->peeks[idx];
+    } else {
+        token = lexer_token_get_skip_cache(lexer);
     }
-    return lexer_token_get_skip_cache(lexer);
+    if (token.type == TOKEN_CURLY_BRACE_OPEN) lexer->brace_depth++;
+    else if (token.type == TOKEN_CURLY_BRACE_CLOSE && lexer->brace_depth > 0) lexer->brace_depth--;
+    return token;
 }
@@ -12,6 +12,7 @@ typedef struct Lexer {
     const char *file_content_ptr; // We keep a raw pointer to this so we can access it quickly.
     int idx_char;
     int idx_line;
+    int brace_depth; // Of the tokens taken so far, not the ones only peeked at. Parser recovery skips to the end of the block it was in with this.
 
     int peek_count;
     int peek_idx;
@@ -19,6 +20,8 @@ typedef struct Lexer {
 } Lexer;
 
 Lexer lexer_new(StringId path);
+// Lexes source that is already in memory, under the given name.
+Lexer lexer_new_content(StringId file_name, StringId file_content);
 
 void lexer_free(Lexer *lexer);
 Token lexer_token_get(Lexer *lexer);
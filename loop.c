@@ -0,0 +1,828 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "loop.h"
+#include "constant.h"
+#include "opt_util.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+#include "token.h"
+
+#define LOOP_PASS "loop"
+#define LOOP_TEMPORARIES_MAX 16 // Per loop, so a loop never needs more than one insertion.
+
+typedef struct LoopFunction {
+    SourceFile *file;
+    Scope *root;
+    DeclarationSet address_taken; // Could be changed through a pointer at any time.
+    DeclarationSet globals_address_taken; // Taken anywhere in the file, so a pointer from another function can change them too.
+    int temporary_count; // Used to name temporaries.
+
+    int hoisted;
+    int reduced;
+    int simplified;
+    int removed;
+} LoopFunction;
+
+typedef struct Loop {
+    LoopFunction *function;
+    DeclarationSet modified; // Assigned or declared somewhere in the loop.
+    bool calls; // Calls can change any global.
+    bool jumps; // Has labels or gotos, so the end of the body isn't always reached before the next iteration.
+
+    // Temporaries declared right before the loop. Identifiers point here until they are inserted.
+    Scope temporaries[LOOP_TEMPORARIES_MAX];
+    int temporary_count;
+} Loop;
+
+// Returns the variable an lvalue ultimately assigns to.
+static Declaration *loop_lval_declaration(Expr *expr) {
+    while (true) {
+        switch (expr->type) {
+            case EXPR_PAREN: expr = expr->data.parenthesized; break;
+            case EXPR_ACCESS_MEMBER: expr = expr->data.access_member.operand; break;
+            case EXPR_ACCESS_ARRAY: expr = expr->data.access_array.operand; break;
+            case EXPR_ID: return expr->data.id.declaration;
+            default: return NULL;
+        }
+    }
+}
+
+static void loop_address_taken_expr(DeclarationSet *address_taken, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            loop_address_taken_expr(address_taken, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            if (expr->data.unary.type == EXPR_UNARY_REF) {
+                Declaration *decl = loop_lval_declaration(expr->data.unary.operand);
+                if (decl) declaration_set_add(address_taken, decl);
+            }
+            loop_address_taken_expr(address_taken, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            loop_address_taken_expr(address_taken, expr->data.binary.lhs);
+            loop_address_taken_expr(address_taken, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            loop_address_taken_expr(address_taken, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            loop_address_taken_expr(address_taken, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            loop_address_taken_expr(address_taken, expr->data.access_array.operand);
+            loop_address_taken_expr(address_taken, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            loop_address_taken_expr(address_taken, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) loop_address_taken_expr(address_taken, expr->data.function_call.params + i);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) loop_address_taken_expr(address_taken, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) loop_address_taken_expr(address_taken, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) loop_address_taken_expr(address_taken, expr->data.file.args + i);
+            break;
+        case EXPR_FUNCTION:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+// Calls visit on every expression directly held by a statement or scope, including those of nested scopes.
+typedef void (*LoopExprVisit)(void *context, Expr *expr);
+
+static void loop_each_expr_statement(Statement *statement, LoopExprVisit visit, void *context) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION: {
+            Declaration *decl = &statement->data.declaration;
+            if (decl->type != DECLARATION_VAR) break;
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) visit(context, &decl->data.var.data.constant.value);
+            else if (decl->data.var.data.mutable.value_exists) visit(context, &decl->data.var.data.mutable.value);
+        } break;
+        case STATEMENT_INCREMENT:
+            visit(context, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            visit(context, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            visit(context, &statement->data.assign.assignee);
+            visit(context, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            visit(context, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) visit(context, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+static void loop_each_expr(Scope *scope, LoopExprVisit visit, void *context) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            loop_each_expr_statement(&scope->data.statement, visit, context);
+            break;
+        case SCOPE_CONDITIONAL:
+            visit(context, &scope->data.conditional.condition);
+            loop_each_expr(scope->data.conditional.scope_if, visit, context);
+            if (scope->data.conditional.scope_else) loop_each_expr(scope->data.conditional.scope_else, visit, context);
+            break;
+        case SCOPE_LOOP_FOR:
+            loop_each_expr_statement(&scope->data.loop_for.init, visit, context);
+            visit(context, &scope->data.loop_for.expr);
+            loop_each_expr_statement(&scope->data.loop_for.step, visit, context);
+            loop_each_expr(scope->data.loop_for.scope, visit, context);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            visit(context, &scope->data.loop_for_each.array);
+            loop_each_expr(scope->data.loop_for_each.scope, visit, context);
+            break;
+        case SCOPE_LOOP_WHILE:
+            visit(context, &scope->data.loop_while.expr);
+            loop_each_expr(scope->data.loop_while.scope, visit, context);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) loop_each_expr(scope->data.block.scopes + i, visit, context);
+            break;
+        case SCOPE_MATCH:
+            visit(context, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) loop_each_expr(scope->data.match.cases[i].scopes + j, visit, context);
+            }
+            break;
+    }
+}
+
+static void loop_address_taken_visit(void *context, Expr *expr) {
+    loop_address_taken_expr(context, expr);
+}
+
+static void loop_calls_visit(void *context, Expr *expr) {
+    Loop *loop = context;
+    if (expr_call_count(expr) > 0) loop->calls = true;
+}
+
+static void loop_modified_statement(Loop *loop, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            declaration_set_add(&loop->modified, &statement->data.declaration);
+            break;
+        case STATEMENT_INCREMENT: {
+            Declaration *decl = loop_lval_declaration(&statement->data.increment);
+            if (decl) declaration_set_add(&loop->modified, decl);
+        } break;
+        case STATEMENT_DEINCREMENT: {
+            Declaration *decl = loop_lval_declaration(&statement->data.deincrement);
+            if (decl) declaration_set_add(&loop->modified, decl);
+        } break;
+        case STATEMENT_ASSIGN: {
+            Declaration *decl = loop_lval_declaration(&statement->data.assign.assignee);
+            if (decl) declaration_set_add(&loop->modified, decl);
+        } break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            loop->jumps = true;
+            break;
+        case STATEMENT_EXPR:
+        case STATEMENT_RETURN:
+            break;
+    }
+}
+
+static void loop_modified_scope(Loop *loop, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            loop_modified_statement(loop, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            loop_modified_scope(loop, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) loop_modified_scope(loop, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            loop_modified_statement(loop, &scope->data.loop_for.init);
+            loop_modified_statement(loop, &scope->data.loop_for.step);
+            loop_modified_scope(loop, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            if (scope->data.loop_for_each.element_declaration) declaration_set_add(&loop->modified, scope->data.loop_for_each.element_declaration);
+            loop_modified_scope(loop, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            loop_modified_scope(loop, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) loop_modified_scope(loop, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                if (match_case->declares) loop_modified_statement(loop, &match_case->declared_var);
+                for (int j = 0; j < match_case->scope_count; j++) loop_modified_scope(loop, match_case->scopes + j);
+            }
+            break;
+    }
+}
+
+static Type loop_primitive(TokenType primitive) {
+    return (Type) { .type = TYPE_PRIMITIVE, .data.primitive = primitive };
+}
+
+// Finds the type of an arithmetic expression without the typechecker's scopes, which are gone by now.
+// The typechecker already made sure the operands agree, so the type of the left operand is the type of the result.
+static bool loop_expr_type(Expr *expr, Type *type) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return loop_expr_type(expr->data.parenthesized, type);
+        case EXPR_UNARY:
+            if (expr->data.unary.type == EXPR_UNARY_LOGICAL_NOT) {
+                *type = loop_primitive(TOKEN_KEYWORD_TYPE_BOOL);
+                return true;
+            }
+            if (expr->data.unary.type == EXPR_UNARY_REF || expr->data.unary.type == EXPR_UNARY_DEREF) return false;
+            return loop_expr_type(expr->data.unary.operand, type);
+        case EXPR_BINARY: {
+            // Operations on vectors aren't hoisted, and a scalar operand of one does not have the type of the result.
+            Type operand;
+            if (loop_expr_type(expr->data.binary.lhs, &operand) && operand.type == TYPE_VECTOR) return false;
+            if (loop_expr_type(expr->data.binary.rhs, &operand) && operand.type == TYPE_VECTOR) return false;
+            if ((TOKEN_OP_EQ <= expr->data.binary.operator && expr->data.binary.operator <= TOKEN_OP_GE)
+                || expr->data.binary.operator == TOKEN_OP_LOGICAL_AND || expr->data.binary.operator == TOKEN_OP_LOGICAL_OR) {
+                *type = loop_primitive(TOKEN_KEYWORD_TYPE_BOOL);
+                return true;
+            }
+            return loop_expr_type(expr->data.binary.lhs, type);
+        }
+        case EXPR_TYPECAST:
+            *type = expr->data.typecast.cast_to;
+            return true;
+        case EXPR_ID: {
+            Declaration *decl = expr->data.id.declaration;
+            if (!decl || decl->type != DECLARATION_VAR) return false;
+            if (decl->data.var.type == DECLARATION_VAR_MUTABLE) {
+                *type = decl->data.var.data.mutable.type;
+                return true;
+            }
+            if (!decl->data.var.data.constant.type_explicit) return false;
+            *type = decl->data.var.data.constant.type;
+            return true;
+        }
+        case EXPR_LITERAL:
+            if (expr->data.literal.type == LITERAL_STRING) return false;
+            *type = loop_primitive(TOKEN_KEYWORD_TYPE_CHAR + (expr->data.literal.type - LITERAL_CHAR));
+            return true;
+        case EXPR_LITERAL_BOOL:
+            *type = loop_primitive(TOKEN_KEYWORD_TYPE_BOOL);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool loop_type_is_integer(Type *type) {
+    return type->type == TYPE_PRIMITIVE && TOKEN_KEYWORD_TYPE_INTEGER_MIN <= type->data.primitive && type->data.primitive <= TOKEN_KEYWORD_TYPE_INTEGER_MAX;
+}
+
+// Reads an integer literal as 64 bits, so literals of the same type can be compared.
+static bool loop_literal_bits(Expr *expr, unsigned long long *bits) {
+    if (expr->type != EXPR_LITERAL) return false;
+    Literal *literal = &expr->data.literal;
+    switch (literal->type) {
+        case LITERAL_INT8: *bits = (unsigned long long) literal->data.l_int8; return true;
+        case LITERAL_INT16: *bits = (unsigned long long) literal->data.l_int16; return true;
+        case LITERAL_INT: *bits = (unsigned long long) literal->data.l_int; return true;
+        case LITERAL_INT64: *bits = (unsigned long long) literal->data.l_int64; return true;
+        case LITERAL_UINT8: *bits = literal->data.l_uint8; return true;
+        case LITERAL_UINT16: *bits = literal->data.l_uint16; return true;
+        case LITERAL_UINT: *bits = literal->data.l_uint; return true;
+        case LITERAL_UINT64: *bits = literal->data.l_uint64; return true;
+        default: return false;
+    }
+}
+
+// An expression is invariant if it only reads variables the loop never changes, and evaluating it can't fail.
+// Memory accesses are never invariant since anything could write to that memory.
+static bool loop_is_invariant(Loop *loop, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return loop_is_invariant(loop, expr->data.parenthesized);
+        case EXPR_UNARY:
+            if (expr->data.unary.type == EXPR_UNARY_REF || expr->data.unary.type == EXPR_UNARY_DEREF) return false;
+            return loop_is_invariant(loop, expr->data.unary.operand);
+        case EXPR_BINARY: {
+            TokenType operator = expr->data.binary.operator;
+            unsigned long long divisor;
+            if ((operator == TOKEN_OP_DIVIDE || operator == TOKEN_OP_MODULO)
+                && (!loop_literal_bits(expr->data.binary.rhs, &divisor) || divisor == 0)) return false;
+            return loop_is_invariant(loop, expr->data.binary.lhs) && loop_is_invariant(loop, expr->data.binary.rhs);
+        }
+        case EXPR_TYPECAST:
+            return loop_is_invariant(loop, expr->data.typecast.operand);
+        case EXPR_ID: {
+            Declaration *decl = expr->data.id.declaration;
+            if (!decl || decl->type != DECLARATION_VAR) return false;
+            if (declaration_set_has(&loop->modified, decl) || declaration_set_has(&loop->function->address_taken, decl)) return false;
+            bool global = loop->function->file->declarations <= decl && decl < loop->function->file->declarations + loop->function->file->declaration_count;
+            return !(global && (loop->calls || declaration_set_has(&loop->function->globals_address_taken, decl)));
+        }
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static StringId loop_temporary_name(LoopFunction *function, const char *prefix) {
+    char *string = allocator_malloc(ALLOCATOR_OPTIMIZE, strlen(prefix) + 16);
+    sprintf(string, "%s%i", prefix, function->temporary_count++);
+    return string_cache_insert(string);
+}
+
+// Declares a temporary before the loop, initialized with value, and returns it.
+static Declaration *loop_temporary(Loop *loop, const char *prefix, Type *type, Expr value) {
+    assert(loop->temporary_count < LOOP_TEMPORARIES_MAX);
+    Scope *scope = loop->temporaries + loop->temporary_count++;
+    *scope = (Scope) {
+        .location = value.location,
+        .type = SCOPE_STATEMENT,
+        .data.statement = {
+            .location = value.location,
+            .type = STATEMENT_DECLARATION,
+            .data.declaration = {
+                .location = value.location,
+                .id = loop_temporary_name(loop->function, prefix),
+                .type = DECLARATION_VAR,
+                .state = DECLARATION_STATE_INITIALIZED,
+                .data.var = {
+                    .type = DECLARATION_VAR_MUTABLE,
+                    .data.mutable = { .type = type_clone(type), .value_exists = true, .value = value }
+                }
+            }
+        }
+    };
+    return &scope->data.statement.data.declaration;
+}
+
+static Expr loop_id(Declaration *decl, Location location) {
+    return (Expr) {
+        .location = location,
+        .type = EXPR_ID,
+        .data.id = { .declaration_id = decl->id, .declaration = decl }
+    };
+}
+
+// Hoists the largest invariant subexpressions that do any work.
+static void loop_hoist_expr(Loop *loop, Expr *expr) {
+    if (loop->temporary_count == LOOP_TEMPORARIES_MAX) return;
+
+    bool worth_hoisting = expr->type == EXPR_BINARY || expr->type == EXPR_TYPECAST
+        || (expr->type == EXPR_UNARY && !constant_is_folded(expr->data.unary.operand));
+    Type type;
+    if (worth_hoisting && loop_is_invariant(loop, expr) && loop_expr_type(expr, &type) && type.type == TYPE_PRIMITIVE) {
+        Location location = expr->location;
+        Declaration *temporary = loop_temporary(loop, "_loop_invariant", &type, *expr);
+        *expr = loop_id(temporary, location);
+        loop->function->hoisted++;
+        remark(location, LOOP_PASS, "loop-invariant expression hoisted out of the loop");
+        return;
+    }
+
+    switch (expr->type) {
+        case EXPR_PAREN:
+            loop_hoist_expr(loop, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            loop_hoist_expr(loop, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            // Hoisting out of the right side of && and || would evaluate it when it wasn't before.
+            loop_hoist_expr(loop, expr->data.binary.lhs);
+            if (expr->data.binary.operator != TOKEN_OP_LOGICAL_AND && expr->data.binary.operator != TOKEN_OP_LOGICAL_OR) loop_hoist_expr(loop, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            loop_hoist_expr(loop, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            loop_hoist_expr(loop, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            loop_hoist_expr(loop, expr->data.access_array.operand);
+            loop_hoist_expr(loop, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.param_count; i++) loop_hoist_expr(loop, expr->data.function_call.params + i);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) loop_hoist_expr(loop, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) loop_hoist_expr(loop, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) loop_hoist_expr(loop, expr->data.file.args + i);
+            break;
+        case EXPR_FUNCTION:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void loop_hoist_visit(void *context, Expr *expr) {
+    loop_hoist_expr(context, expr);
+}
+
+typedef struct InductionVariable {
+    Loop *loop;
+    Declaration *counter;
+    Expr *factor; // A literal or an invariant identifier.
+    Declaration *derived; // counter * factor, NULL until the first multiplication is found.
+    Type type;
+    Expr *start;
+    int replaced;
+} InductionVariable;
+
+static bool loop_same_factor(Expr *lhs, Expr *rhs) {
+    if (lhs->type == EXPR_ID && rhs->type == EXPR_ID) return lhs->data.id.declaration == rhs->data.id.declaration;
+    unsigned long long lhs_bits, rhs_bits;
+    if (!loop_literal_bits(lhs, &lhs_bits) || !loop_literal_bits(rhs, &rhs_bits)) return false;
+    return lhs->data.literal.type == rhs->data.literal.type && lhs_bits == rhs_bits;
+}
+
+static bool loop_is_factor(InductionVariable *iv, Expr *expr) {
+    unsigned long long bits;
+    if (loop_literal_bits(expr, &bits)) return true;
+    return expr->type == EXPR_ID && loop_is_invariant(iv->loop, expr);
+}
+
+static void loop_reduce_expr(InductionVariable *iv, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            loop_reduce_expr(iv, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            loop_reduce_expr(iv, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY: {
+            Expr *lhs = expr->data.binary.lhs;
+            Expr *rhs = expr->data.binary.rhs;
+            if (expr->data.binary.operator == TOKEN_OP_MULTIPLY) {
+                Expr *factor = NULL;
+                if (lhs->type == EXPR_ID && lhs->data.id.declaration == iv->counter && loop_is_factor(iv, rhs)) factor = rhs;
+                else if (rhs->type == EXPR_ID && rhs->data.id.declaration == iv->counter && loop_is_factor(iv, lhs)) factor = lhs;
+
+                if (factor && (!iv->factor || loop_same_factor(iv->factor, factor))) {
+                    if (!iv->derived) {
+                        if (iv->loop->temporary_count == LOOP_TEMPORARIES_MAX) break;
+                        iv->factor = expr_alloc(expr_clone(factor));
+                        Expr start = {
+                            .location = expr->location,
+                            .type = EXPR_BINARY,
+                            .data.binary = {
+                                .operator = TOKEN_OP_MULTIPLY,
+                                .lhs = expr_alloc((Expr) { .location = expr->location, .type = EXPR_PAREN, .data.parenthesized = expr_alloc(expr_clone(iv->start)) }),
+                                .rhs = expr_alloc(expr_clone(factor))
+                            }
+                        };
+                        iv->derived = loop_temporary(iv->loop, "_loop_induction", &iv->type, start);
+                    }
+                    Location location = expr->location;
+                    expr_free(expr);
+                    *expr = loop_id(iv->derived, location);
+                    iv->replaced++;
+                    break;
+                }
+            }
+            loop_reduce_expr(iv, lhs);
+            loop_reduce_expr(iv, rhs);
+        } break;
+        case EXPR_TYPECAST:
+            loop_reduce_expr(iv, expr->data.typecast.operand);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            loop_reduce_expr(iv, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            loop_reduce_expr(iv, expr->data.access_array.operand);
+            loop_reduce_expr(iv, expr->data.access_array.index);
+            break;
+        case EXPR_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.param_count; i++) loop_reduce_expr(iv, expr->data.function_call.params + i);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) loop_reduce_expr(iv, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) loop_reduce_expr(iv, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) loop_reduce_expr(iv, expr->data.file.args + i);
+            break;
+        case EXPR_FUNCTION:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+static void loop_reduce_visit(void *context, Expr *expr) {
+    loop_reduce_expr(context, expr);
+}
+
+// Returns the step a for loop adds to its counter every iteration, as an expression of the counter's type.
+static bool loop_for_step(Scope *scope, Declaration *counter, Expr *step, bool *negative) {
+    Statement *statement = &scope->data.loop_for.step;
+    Expr *operand;
+    switch (statement->type) {
+        case STATEMENT_INCREMENT:
+        case STATEMENT_DEINCREMENT:
+            operand = statement->type == STATEMENT_INCREMENT ? &statement->data.increment : &statement->data.deincrement;
+            if (operand->type != EXPR_ID || operand->data.id.declaration != counter) return false;
+            *negative = statement->type == STATEMENT_DEINCREMENT;
+            *step = (Expr) {
+                .location = statement->location,
+                .type = EXPR_LITERAL,
+                .data.literal = literal_from_bits(LITERAL_CHAR + (counter->data.var.data.mutable.type.data.primitive - TOKEN_KEYWORD_TYPE_CHAR), 1)
+            };
+            return true;
+        case STATEMENT_ASSIGN:
+            operand = &statement->data.assign.assignee;
+            if (operand->type != EXPR_ID || operand->data.id.declaration != counter) return false;
+            if (statement->data.assign.type != TOKEN_ASSIGN_PLUS && statement->data.assign.type != TOKEN_ASSIGN_MINUS) return false;
+            if (statement->data.assign.value.type != EXPR_LITERAL) return false;
+            *negative = statement->data.assign.type == TOKEN_ASSIGN_MINUS;
+            *step = statement->data.assign.value;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Replaces counter * factor in the body and condition with a variable that is advanced by step * factor at the end of the body.
+static bool loop_reduce(Loop *loop, Scope *scope) {
+    Statement *init = &scope->data.loop_for.init;
+    if (init->type != STATEMENT_DECLARATION || init->data.declaration.type != DECLARATION_VAR) return false;
+    Declaration *counter = &init->data.declaration;
+    if (counter->data.var.type != DECLARATION_VAR_MUTABLE || !counter->data.var.data.mutable.value_exists) return false;
+    if (!loop_type_is_integer(&counter->data.var.data.mutable.type)) return false;
+    if (expr_call_count(&counter->data.var.data.mutable.value) > 0) return false;
+    if (loop->jumps || scope->data.loop_for.scope->type != SCOPE_BLOCK) return false;
+
+    // The counter may only change in the step.
+    Loop body = { .function = loop->function };
+    loop_modified_scope(&body, scope->data.loop_for.scope);
+    bool modified = declaration_set_has(&body.modified, counter);
+    declaration_set_free(&body.modified);
+    if (modified) return false;
+
+    Expr step;
+    bool negative;
+    if (!loop_for_step(scope, counter, &step, &negative)) return false;
+
+    InductionVariable iv = {
+        .loop = loop,
+        .counter = counter,
+        .type = counter->data.var.data.mutable.type,
+        .start = &counter->data.var.data.mutable.value
+    };
+    loop_reduce_expr(&iv, &scope->data.loop_for.expr);
+    loop_each_expr(scope->data.loop_for.scope, loop_reduce_visit, &iv);
+    if (!iv.derived) return false;
+
+    Expr increase = {
+        .location = step.location,
+        .type = EXPR_BINARY,
+        .data.binary = { .operator = TOKEN_OP_MULTIPLY, .lhs = expr_alloc(expr_clone(&step)), .rhs = iv.factor }
+    };
+    constant_fold(&increase);
+    Scope advance = {
+        .location = scope->location,
+        .type = SCOPE_STATEMENT,
+        .data.statement = {
+            .location = scope->location,
+            .type = STATEMENT_ASSIGN,
+            .data.assign = {
+                .assignee = loop_id(iv.derived, scope->location),
+                .value = increase,
+                .type = negative ? TOKEN_ASSIGN_MINUS : TOKEN_ASSIGN_PLUS
+            }
+        }
+    };
+    Scope *body_block = scope->data.loop_for.scope;
+    scope_block_insert(loop->function->root, body_block, body_block->data.block.scope_count, &advance, 1);
+
+    loop->function->reduced += iv.replaced;
+    remark(scope->location, LOOP_PASS, "%i multiplications by the loop counter '%s' replaced with an addition",
+        iv.replaced, string_cache_get(counter->id));
+    return true;
+}
+
+static TokenType loop_comparison_negate(TokenType operator) {
+    switch (operator) {
+        case TOKEN_OP_EQ: return TOKEN_OP_NE;
+        case TOKEN_OP_NE: return TOKEN_OP_EQ;
+        case TOKEN_OP_LT: return TOKEN_OP_GE;
+        case TOKEN_OP_GE: return TOKEN_OP_LT;
+        case TOKEN_OP_GT: return TOKEN_OP_LE;
+        case TOKEN_OP_LE: return TOKEN_OP_GT;
+        default: return 0;
+    }
+}
+
+// Turns !(a < b) into a >= b. Only for integers, since a comparison with NaN is false both ways.
+static bool loop_condition_simplify(Expr *condition) {
+    Expr *inner = condition;
+    if (inner->type != EXPR_UNARY || inner->data.unary.type != EXPR_UNARY_LOGICAL_NOT) return false;
+    Expr *operand = inner->data.unary.operand;
+    while (operand->type == EXPR_PAREN) operand = operand->data.parenthesized;
+    if (operand->type != EXPR_BINARY || !loop_comparison_negate(operand->data.binary.operator)) return false;
+
+    Type type;
+    if (!loop_expr_type(operand->data.binary.lhs, &type) || !loop_type_is_integer(&type)) return false;
+
+    Expr negated = *operand;
+    negated.data.binary.operator = loop_comparison_negate(operand->data.binary.operator);
+    negated.location = condition->location;
+
+    // Free the ! and parentheses, but not the comparison's operands.
+    Expr *node = condition->data.unary.operand;
+    while (node != operand) {
+        Expr *next = node->data.parenthesized;
+        allocator_free(node);
+        node = next;
+    }
+    allocator_free(operand);
+    *condition = negated;
+    return true;
+}
+
+// Inserting scopes moves declarations around, so this is redone whenever the tree changes.
+static void loop_analyze(Loop *loop, Scope *scope) {
+    declaration_set_clear(&loop->modified);
+    loop->jumps = false;
+    loop->calls = false;
+    declaration_set_clear(&loop->function->address_taken);
+    loop_each_expr(loop->function->root, loop_address_taken_visit, &loop->function->address_taken);
+    loop_modified_scope(loop, scope);
+    loop_each_expr(scope, loop_calls_visit, loop);
+}
+
+typedef struct LoopTemporaries {
+    Scope *old;
+    Scope *new;
+    int count;
+} LoopTemporaries;
+
+static void *loop_temporaries_relocate(void *context, void *ptr) {
+    LoopTemporaries *temporaries = context;
+    char *old = ptr;
+    if (old < (char *) temporaries->old || (char *) (temporaries->old + temporaries->count) <= old) return ptr;
+    return (char *) temporaries->new + (old - (char *) temporaries->old);
+}
+
+static Expr *loop_condition(Scope *scope) {
+    return scope->type == SCOPE_LOOP_FOR ? &scope->data.loop_for.expr : &scope->data.loop_while.expr;
+}
+
+// Returns the number of scopes inserted into the block before the loop.
+static int loop_optimize_loop(LoopFunction *function, Scope *block, int idx) {
+    Scope *scope = block->data.block.scopes + idx;
+    Expr *condition = loop_condition(scope);
+
+    if (loop_condition_simplify(condition)) {
+        function->simplified++;
+        remark(condition->location, LOOP_PASS, "negated loop condition simplified");
+    }
+
+    if (condition->type == EXPR_LITERAL_BOOL && !condition->data.literal_bool) {
+        // Only the initialization of a for loop ever runs.
+        Location location = scope->location;
+        if (scope->type == SCOPE_LOOP_FOR) {
+            Scope init = { .location = location, .type = SCOPE_STATEMENT, .data.statement = scope->data.loop_for.init };
+            expr_free(&scope->data.loop_for.expr);
+            statement_free(&scope->data.loop_for.step);
+            scope_free(scope->data.loop_for.scope);
+            allocator_free(scope->data.loop_for.scope);
+            *scope = init;
+        } else {
+            scope_free(scope);
+            *scope = (Scope) { .location = location, .type = SCOPE_BLOCK, .data.block = { .scopes = NULL, .scope_count = 0 } };
+        }
+        function->removed++;
+        remark(location, LOOP_PASS, "loop whose condition is always false removed");
+        return 0;
+    }
+
+    Loop loop = { .function = function };
+    loop_analyze(&loop, scope);
+
+    if (scope->type == SCOPE_LOOP_FOR) {
+        // The variable that replaces a multiplication is carried from one iteration to the next, which a parallel loop has no order for.
+        if (!scope->data.loop_for.parallel && loop_reduce(&loop, scope)) loop_analyze(&loop, scope);
+        loop_hoist_expr(&loop, condition);
+        loop_each_expr_statement(&scope->data.loop_for.step, loop_hoist_visit, &loop);
+        loop_each_expr(scope->data.loop_for.scope, loop_hoist_visit, &loop);
+    } else {
+        loop_hoist_expr(&loop, condition);
+        loop_each_expr(scope->data.loop_while.scope, loop_hoist_visit, &loop);
+    }
+    declaration_set_free(&loop.modified);
+
+    int count = loop.temporary_count;
+    if (count == 0) return 0;
+
+    // Identifiers point at the temporaries in the loop struct, so insert them and then point those identifiers at their new home.
+    scope_block_insert(function->root, block, idx, loop.temporaries, count);
+    LoopTemporaries temporaries = { .old = loop.temporaries, .new = block->data.block.scopes + idx, .count = count };
+    Relocation relocation = { .relocate = loop_temporaries_relocate, .context = &temporaries };
+    relocate_scope(&relocation, function->root);
+    return count;
+}
+
+static void loop_visit_scope(LoopFunction *function, Scope *scope);
+
+static void loop_visit_block(LoopFunction *function, Scope *block) {
+    for (int i = 0; i < block->data.block.scope_count; i++) {
+        Scope *scope = block->data.block.scopes + i;
+        loop_visit_scope(function, scope);
+        if (scope->type == SCOPE_LOOP_FOR || scope->type == SCOPE_LOOP_WHILE) i += loop_optimize_loop(function, block, i);
+    }
+}
+
+// Inner loops are optimized first, so what they hoist can be hoisted further by the loops around them.
+static void loop_visit_scope(LoopFunction *function, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_CONDITIONAL:
+            loop_visit_scope(function, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) loop_visit_scope(function, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            loop_visit_scope(function, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            loop_visit_scope(function, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            loop_visit_scope(function, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            loop_visit_block(function, scope);
+            break;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) loop_visit_scope(function, scope->data.match.cases[i].scopes + j);
+            }
+            break;
+        case SCOPE_STATEMENT:
+            break;
+    }
+}
+
+void loop_optimize(SourceFile *file) {
+    LoopFunction function = { .file = file };
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (declaration_is_function(decl)) {
+            loop_each_expr(decl->data.var.data.constant.value.data.function.scope, loop_address_taken_visit, &function.globals_address_taken);
+        } else if (decl->type == DECLARATION_VAR && decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+            loop_address_taken_expr(&function.globals_address_taken, &decl->data.var.data.constant.value);
+        } else if (decl->type == DECLARATION_VAR && decl->data.var.data.mutable.value_exists) {
+            loop_address_taken_expr(&function.globals_address_taken, &decl->data.var.data.mutable.value);
+        }
+    }
+    for (int i = 0; i < file->declaration_count; i++) {
+        Declaration *decl = file->declarations + i;
+        if (!declaration_is_function(decl)) continue;
+
+        function.root = decl->data.var.data.constant.value.data.function.scope;
+        function.temporary_count = 0;
+        loop_visit_scope(&function, function.root);
+    }
+    declaration_set_free(&function.address_taken);
+    declaration_set_free(&function.globals_address_taken);
+
+    remark_summary(LOOP_PASS, "%i invariant expressions hoisted, %i multiplications strength-reduced, %i conditions simplified, %i loops removed",
+        function.hoisted, function.reduced, function.simplified, function.removed);
+}
@@ -0,0 +1,14 @@
+#ifndef CREED_LOOP_H
+#define CREED_LOOP_H
+
+#include "parser.h"
+
+// Loop optimizations on for and while loops. Run this after typechecking.
+//  - Loop-invariant arithmetic is computed once into a temporary declared before the loop.
+//  - In a for loop counting by a constant step, multiplications of the counter by an invariant
+//    are replaced by a variable that is increased by the step times the invariant every iteration.
+//  - Negated comparisons in loop conditions are flipped, and loops whose condition is false are removed.
+// These only work on the AST, so they apply whatever the output backend is.
+void loop_optimize(SourceFile *file);
+
+#endif
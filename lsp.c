@@ -0,0 +1,1150 @@
+#include <assert.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "diagnostics.h"
+#include "lexer.h"
+#include "lsp.h"
+#include "parser.h"
+#include "string_builder.h"
+#include "string_cache.h"
+#include "symbol_table.h"
+
+// The JSON of a message, parsed into a tree.
+typedef struct JsonValue {
+    enum {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    } type;
+
+    union {
+        bool boolean;
+        double number;
+
+        struct {
+            char *chars; // Decoded to UTF-8 and terminated, but can contain a \u0000.
+            int length;
+        } string;
+
+        struct {
+            struct JsonValue *items;
+            char **keys; // NULL for arrays.
+            int count;
+        } compound;
+    } data;
+} JsonValue;
+
+typedef struct JsonParser {
+    const char *text;
+    int idx;
+    int length;
+} JsonParser;
+
+static void json_skip_whitespace(JsonParser *parser) {
+    while (parser->idx < parser->length && strchr(" \t\r\n", parser->text[parser->idx])) parser->idx++;
+}
+
+static bool json_parse_literal(JsonParser *parser, const char *literal) {
+    int length = (int) strlen(literal);
+    if (parser->length - parser->idx < length || strncmp(parser->text + parser->idx, literal, length)) return false;
+    parser->idx += length;
+    return true;
+}
+
+static int json_hex(JsonParser *parser) {
+    int value = 0;
+    for (int i = 0; i < 4; i++, parser->idx++) {
+        if (parser->idx >= parser->length) return -1;
+        char c = parser->text[parser->idx];
+        value *= 16;
+        if ('0' <= c && c <= '9') value += c - '0';
+        else if ('a' <= c && c <= 'f') value += c - 'a' + 10;
+        else if ('A' <= c && c <= 'F') value += c - 'A' + 10;
+        else return -1;
+    }
+    return value;
+}
+
+static void json_add_utf8(StringBuilder *builder, int code_point) {
+    if (code_point < 0x80) {
+        string_builder_add_char(builder, (char) code_point);
+    } else if (code_point < 0x800) {
+        string_builder_add_char(builder, (char) (0xC0 | code_point >> 6));
+        string_builder_add_char(builder, (char) (0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        string_builder_add_char(builder, (char) (0xE0 | code_point >> 12));
+        string_builder_add_char(builder, (char) (0x80 | (code_point >> 6 & 0x3F)));
+        string_builder_add_char(builder, (char) (0x80 | (code_point & 0x3F)));
+    } else {
+        string_builder_add_char(builder, (char) (0xF0 | code_point >> 18));
+        string_builder_add_char(builder, (char) (0x80 | (code_point >> 12 & 0x3F)));
+        string_builder_add_char(builder, (char) (0x80 | (code_point >> 6 & 0x3F)));
+        string_builder_add_char(builder, (char) (0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Expects the opening quote to be taken already.
+static bool json_parse_string(JsonParser *parser, JsonValue *out) {
+    StringBuilder builder = string_builder_new();
+    bool ok = false;
+    while (parser->idx < parser->length) {
+        char c = parser->text[parser->idx++];
+        if (c == '"') {
+            ok = true;
+            break;
+        }
+        if (c != '\\') {
+            string_builder_add_char(&builder, c);
+            continue;
+        }
+        if (parser->idx >= parser->length) break;
+        c = parser->text[parser->idx++];
+        switch (c) {
+            case 'b': string_builder_add_char(&builder, '\b'); break;
+            case 'f': string_builder_add_char(&builder, '\f'); break;
+            case 'n': string_builder_add_char(&builder, '\n'); break;
+            case 'r': string_builder_add_char(&builder, '\r'); break;
+            case 't': string_builder_add_char(&builder, '\t'); break;
+            case 'u': {
+                int code_point = json_hex(parser);
+                // Characters outside of the basic plane are written as two escapes, a high and a low surrogate.
+                if (0xD800 <= code_point && code_point < 0xDC00 && json_parse_literal(parser, "\\u")) {
+                    int low = json_hex(parser);
+                    if (low >= 0) code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (code_point < 0) goto done;
+                json_add_utf8(&builder, code_point);
+            } break;
+            default: string_builder_add_char(&builder, c); break;
+        }
+    }
+done:
+    out->type = JSON_STRING;
+    out->data.string.length = builder.length;
+    out->data.string.chars = string_builder_free(&builder);
+    return ok;
+}
+
+static void json_free(JsonValue *value);
+
+static bool json_parse_value(JsonParser *parser, JsonValue *out) {
+    json_skip_whitespace(parser);
+    *out = (JsonValue) { .type = JSON_NULL };
+    if (parser->idx >= parser->length) return false;
+
+    char c = parser->text[parser->idx];
+    switch (c) {
+        case '"':
+            parser->idx++;
+            return json_parse_string(parser, out);
+
+        case '[':
+        case '{': {
+            parser->idx++;
+            bool object = c == '{';
+            char close = object ? '}' : ']';
+            out->type = object ? JSON_OBJECT : JSON_ARRAY;
+            int count_alloc = 0;
+
+            json_skip_whitespace(parser);
+            if (parser->idx < parser->length && parser->text[parser->idx] == close) {
+                parser->idx++;
+                return true;
+            }
+            while (true) {
+                if (out->data.compound.count == count_alloc) {
+                    count_alloc = count_alloc ? count_alloc * 2 : 4;
+                    out->data.compound.items = allocator_realloc(ALLOCATOR_LSP, out->data.compound.items, sizeof(JsonValue) * count_alloc);
+                    if (object) out->data.compound.keys = allocator_realloc(ALLOCATOR_LSP, out->data.compound.keys, sizeof(char *) * count_alloc);
+                }
+                int idx = out->data.compound.count;
+                if (object) {
+                    JsonValue key;
+                    json_skip_whitespace(parser);
+                    if (!json_parse_literal(parser, "\"") || !json_parse_string(parser, &key)) {
+                        if (key.type == JSON_STRING) json_free(&key);
+                        return false;
+                    }
+                    out->data.compound.keys[idx] = key.data.string.chars;
+                    out->data.compound.items[idx] = (JsonValue) { .type = JSON_NULL };
+                    out->data.compound.count++;
+                    json_skip_whitespace(parser);
+                    if (!json_parse_literal(parser, ":")) return false;
+                } else {
+                    out->data.compound.count++;
+                }
+                if (!json_parse_value(parser, out->data.compound.items + idx)) return false;
+
+                json_skip_whitespace(parser);
+                if (json_parse_literal(parser, ",")) continue;
+                char end[2] = { close, '\0' };
+                return json_parse_literal(parser, end);
+            }
+        }
+
+        case 't':
+            out->type = JSON_BOOL;
+            out->data.boolean = true;
+            return json_parse_literal(parser, "true");
+        case 'f':
+            out->type = JSON_BOOL;
+            out->data.boolean = false;
+            return json_parse_literal(parser, "false");
+        case 'n':
+            return json_parse_literal(parser, "null");
+
+        default: {
+            char *end;
+            out->type = JSON_NUMBER;
+            out->data.number = strtod(parser->text + parser->idx, &end);
+            if (end == parser->text + parser->idx) return false;
+            parser->idx = (int) (end - parser->text);
+            return true;
+        }
+    }
+}
+
+static void json_free(JsonValue *value) {
+    switch (value->type) {
+        case JSON_STRING:
+            allocator_free(value->data.string.chars);
+            break;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            for (int i = 0; i < value->data.compound.count; i++) {
+                json_free(value->data.compound.items + i);
+                if (value->data.compound.keys) allocator_free(value->data.compound.keys[i]);
+            }
+            allocator_free(value->data.compound.items);
+            allocator_free(value->data.compound.keys);
+            break;
+        case JSON_NULL:
+        case JSON_BOOL:
+        case JSON_NUMBER:
+            break;
+    }
+}
+
+// Both take NULL, so paths into a message can be followed without checking every step.
+static JsonValue *json_get(JsonValue *object, const char *key) {
+    if (!object || object->type != JSON_OBJECT) return NULL;
+    for (int i = 0; i < object->data.compound.count; i++) {
+        if (!strcmp(object->data.compound.keys[i], key)) return object->data.compound.items + i;
+    }
+    return NULL;
+}
+
+static int json_int(JsonValue *value) {
+    return value && value->type == JSON_NUMBER ? (int) value->data.number : 0;
+}
+
+static void lsp_write(StringBuilder *builder, const char *string) {
+    for (; *string; string++) string_builder_add_char(builder, *string);
+}
+
+static void lsp_write_int(StringBuilder *builder, int value) {
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%i", value);
+    lsp_write(builder, digits);
+}
+
+static void lsp_write_string(StringBuilder *builder, const char *string) {
+    string_builder_add_char(builder, '"');
+    for (; *string; string++) {
+        if (*string == '"' || *string == '\\') {
+            string_builder_add_char(builder, '\\');
+            string_builder_add_char(builder, *string);
+        } else if ((unsigned char) *string < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", *string);
+            lsp_write(builder, escape);
+        } else {
+            string_builder_add_char(builder, *string);
+        }
+    }
+    string_builder_add_char(builder, '"');
+}
+
+// Ids of requests are numbers or strings.
+static void lsp_write_id(StringBuilder *builder, JsonValue *id) {
+    if (id && id->type == JSON_STRING) lsp_write_string(builder, id->data.string.chars);
+    else if (id && id->type == JSON_NUMBER) lsp_write_int(builder, (int) id->data.number);
+    else lsp_write(builder, "null");
+}
+
+static void lsp_send(FILE *outfile, StringBuilder *builder) {
+    int length = builder->length;
+    char *body = string_builder_free(builder);
+    fprintf(outfile, "Content-Length: %i\r\n\r\n", length);
+    fwrite(body, sizeof(char), length, outfile);
+    fflush(outfile);
+    allocator_free(body);
+}
+
+// Starts a response to a request, for the caller to write the result and finish with lsp_send.
+static StringBuilder lsp_response(JsonValue *id) {
+    StringBuilder builder = string_builder_new();
+    lsp_write(&builder, "{\"jsonrpc\":\"2.0\",\"id\":");
+    lsp_write_id(&builder, id);
+    lsp_write(&builder, ",\"result\":");
+    return builder;
+}
+
+// Returns NULL at the end of the input.
+static char *lsp_read(FILE *infile, int *length) {
+    char header[256];
+    int content_length = -1;
+    while (fgets(header, sizeof(header), infile)) {
+        if (!strncmp(header, "Content-Length:", strlen("Content-Length:"))) content_length = atoi(header + strlen("Content-Length:"));
+        else if ((!strcmp(header, "\r\n") || !strcmp(header, "\n")) && content_length >= 0) break;
+    }
+    if (content_length < 0) return NULL;
+
+    char *body = allocator_malloc(ALLOCATOR_LSP, content_length + 1);
+    *length = (int) fread(body, sizeof(char), content_length, infile);
+    body[*length] = '\0';
+    if (*length < content_length) {
+        allocator_free(body);
+        return NULL;
+    }
+    return body;
+}
+
+// A document is split into chunks that each end at a semicolon outside of any braces, which is where top-level declarations end.
+// Every chunk is lexed and parsed as a file of its own, so an edit only parses the chunks it touched, and the locations in the
+// syntax tree of a chunk stay the same when the text before it moves.
+typedef struct LspChunk {
+    int start; // Offset in the text of the document.
+    int length;
+    int line; // The line of the document the chunk starts on.
+
+    // Slots in the string cache, released with the chunk, so edits don't add to it. The name is unique to each chunk,
+    // so the file name of a location tells which chunk it is in, and its string is the uri. The text belongs to the chunk.
+    StringId name;
+    StringId content;
+    Declaration *declarations;
+    int declaration_count;
+
+    int *ids; // The identifiers in the chunk, sorted. Anything that could refer to another declaration is one of these.
+    int id_count;
+
+    Diagnostic *diagnostics; // From parsing and typechecking it.
+    int diagnostic_count;
+
+    bool changed; // Its text is new, and it still has to be parsed.
+    bool dirty; // Parsed again, so it's typechecked again.
+} LspChunk;
+
+typedef struct LspDocument {
+    StringId uri;
+    char *text;
+    int length;
+    int length_alloc;
+
+    LspChunk *chunks;
+    int chunk_count;
+    int chunk_count_alloc;
+
+    SymbolTable table; // Its top-level declarations, kept between edits.
+    Diagnostic *duplicates; // Declarations left out of the table because their name was taken.
+    int duplicate_count;
+
+    // What the chunks that changed since the last analysis declared, before and after, so what uses them is checked again.
+    int *changed_ids;
+    int changed_id_count;
+    bool changed_type; // A type declaration changed, so every chunk is parsed again.
+} LspDocument;
+
+static LspDocument **lsp_documents;
+static int lsp_document_count = 0;
+
+static int lsp_id_compare(const void *lhs, const void *rhs) {
+    return *(const int *) lhs - *(const int *) rhs;
+}
+
+static void lsp_changed_id_add(LspDocument *doc, StringId id) {
+    doc->changed_id_count++;
+    doc->changed_ids = allocator_realloc(ALLOCATOR_LSP, doc->changed_ids, sizeof(int) * doc->changed_id_count);
+    doc->changed_ids[doc->changed_id_count - 1] = id.idx;
+}
+
+static bool lsp_declaration_is_type(Declaration *decl) {
+    return decl->type != DECLARATION_VAR;
+}
+
+// Takes a character of a string or character literal the way the lexer does, which stops at anything that can't be in one.
+static bool lsp_literal_char(LspDocument *doc, int *idx) {
+    if (*idx >= doc->length) return false;
+    char c = doc->text[*idx];
+    if (c == '\\') {
+        // A newline after it is left for the caller to count.
+        if (*idx + 1 >= doc->length || doc->text[*idx + 1] == '\n') return false;
+        *idx += 2;
+        return doc->text[*idx - 1] && strchr("\\nt0'\"r", doc->text[*idx - 1]);
+    }
+    if (' ' <= c && c <= '~' && c != '\'' && c != '"') {
+        (*idx)++;
+        return true;
+    }
+    return false;
+}
+
+// Returns the offset just after the end of the chunk that starts at idx, and counts the lines in it.
+// Skips comments, strings and characters the way the lexer does, so a semicolon in one doesn't end the chunk.
+static int lsp_chunk_end(LspDocument *doc, int idx, int *line) {
+    const char *text = doc->text;
+    int depth = 0;
+    while (idx < doc->length) {
+        char c = text[idx++];
+        switch (c) {
+            case '\n': (*line)++; break;
+            case '{': depth++; break;
+            case '}': if (depth > 0) depth--; break;
+            case ';': if (depth == 0) return idx; break;
+            case '/':
+                if (idx < doc->length && text[idx] == '/') {
+                    while (idx < doc->length && text[idx] != '\n') idx++;
+                }
+                break;
+            case '"':
+                while (lsp_literal_char(doc, &idx));
+                if (idx < doc->length && text[idx] == c) idx++;
+                break;
+            case '\'':
+                lsp_literal_char(doc, &idx);
+                if (idx < doc->length && text[idx] == c) idx++;
+                break;
+        }
+    }
+    return idx;
+}
+
+static LspChunk lsp_chunk_new(LspDocument *doc, int start, int end, int line) {
+    char *content = allocator_malloc(ALLOCATOR_LSP, end - start + 1);
+    memcpy(content, doc->text + start, end - start);
+    content[end - start] = '\0';
+
+    LspChunk chunk = {
+        .start = start,
+        .length = end - start,
+        .line = line,
+        .name = string_cache_slot_new(string_cache_get(doc->uri)),
+        .content = string_cache_slot_new(content),
+        .changed = true
+    };
+
+    Lexer lexer = lexer_new_content(chunk.name, chunk.content);
+    int id_count_alloc = 0;
+    // Lexing goes on past errors, which always take at least a character, so identifiers after them are still seen.
+    while (true) {
+        Token token = lexer_token_get(&lexer);
+        if (token.type == TOKEN_NULL) break;
+        if (token.type != TOKEN_ID) continue;
+        if (chunk.id_count == id_count_alloc) {
+            id_count_alloc = id_count_alloc ? id_count_alloc * 2 : 16;
+            chunk.ids = allocator_realloc(ALLOCATOR_LSP, chunk.ids, sizeof(int) * id_count_alloc);
+        }
+        chunk.ids[chunk.id_count++] = token.data.id.idx;
+    }
+    if (chunk.id_count > 0) qsort(chunk.ids, chunk.id_count, sizeof(int), lsp_id_compare);
+    int unique_count = 0;
+    for (int i = 0; i < chunk.id_count; i++) {
+        if (unique_count == 0 || chunk.ids[unique_count - 1] != chunk.ids[i]) chunk.ids[unique_count++] = chunk.ids[i];
+    }
+    chunk.id_count = unique_count;
+    return chunk;
+}
+
+// Frees everything but the declarations, which the chunk that replaces it can take over.
+static void lsp_chunk_free(LspChunk *chunk) {
+    allocator_free(string_cache_get(chunk->content));
+    string_cache_slot_release(chunk->name);
+    string_cache_slot_release(chunk->content);
+    allocator_free(chunk->ids);
+    allocator_free(chunk->diagnostics);
+}
+
+static void lsp_chunk_free_declarations(LspDocument *doc, LspChunk *chunk) {
+    for (int i = 0; i < chunk->declaration_count; i++) {
+        if (doc) {
+            lsp_changed_id_add(doc, chunk->declarations[i].id);
+            if (lsp_declaration_is_type(chunk->declarations + i)) doc->changed_type = true;
+        }
+        declaration_free(chunk->declarations + i);
+    }
+    allocator_free(chunk->declarations);
+    chunk->declarations = NULL;
+    chunk->declaration_count = 0;
+}
+
+static void lsp_chunk_take_diagnostics(LspChunk *chunk) {
+    int count;
+    const Diagnostic *diagnostics = diagnostics_get(&count);
+    chunk->diagnostics = allocator_realloc(ALLOCATOR_LSP, chunk->diagnostics, sizeof(Diagnostic) * (chunk->diagnostic_count + count));
+    if (count > 0) memcpy(chunk->diagnostics + chunk->diagnostic_count, diagnostics, sizeof(Diagnostic) * count);
+    chunk->diagnostic_count += count;
+    diagnostics_clear();
+}
+
+// Parses the chunk again. When it has as many declarations as before, they are written over the old ones,
+// so identifiers and types in other chunks that point to them stay valid.
+static void lsp_chunk_parse(LspDocument *doc, LspChunk *chunk) {
+    Lexer lexer = lexer_new_content(chunk->name, chunk->content);
+    SourceFile file = source_file_parse_lexer(&lexer);
+
+    if (file.declaration_count == chunk->declaration_count) {
+        for (int i = 0; i < chunk->declaration_count; i++) {
+            Declaration *decl = chunk->declarations + i;
+            if (chunk->changed) {
+                lsp_changed_id_add(doc, decl->id);
+                lsp_changed_id_add(doc, file.declarations[i].id);
+                // Types inferred in other chunks can point to a type declaration without naming it.
+                if (lsp_declaration_is_type(decl)) doc->changed_type = true;
+            }
+            declaration_free(decl);
+            *decl = file.declarations[i];
+        }
+        allocator_free(file.declarations);
+    } else {
+        lsp_chunk_free_declarations(doc, chunk);
+        chunk->declarations = file.declarations;
+        chunk->declaration_count = file.declaration_count;
+        for (int i = 0; i < chunk->declaration_count; i++) lsp_changed_id_add(doc, chunk->declarations[i].id);
+    }
+
+    chunk->diagnostic_count = 0;
+    lsp_chunk_take_diagnostics(chunk);
+    chunk->changed = false;
+    chunk->dirty = true;
+}
+
+static bool lsp_chunk_uses(LspChunk *chunk, int *ids, int id_count) {
+    for (int i = 0; i < id_count; i++) {
+        if (bsearch(ids + i, chunk->ids, chunk->id_count, sizeof(int), lsp_id_compare)) return true;
+    }
+    return false;
+}
+
+static LspChunk *lsp_chunk_named(LspDocument *doc, StringId name) {
+    for (int i = 0; i < doc->chunk_count; i++) {
+        if (doc->chunks[i].name.idx == name.idx) return doc->chunks + i;
+    }
+    return NULL;
+}
+
+// The index of the chunk the offset is in. An offset at the end of the text is in the last chunk.
+static int lsp_chunk_at(LspDocument *doc, int offset) {
+    int lo = 0;
+    int hi = doc->chunk_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (doc->chunks[mid].start <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// Parses the chunks that changed, and the ones that use what they declare, then typechecks what was parsed.
+// Uses go through declarations that aren't functions, since the type of a constant can come from what it uses,
+// but they stop at functions, whose types are always written out.
+static void lsp_document_analyze(LspDocument *doc) {
+    for (int i = 0; i < doc->chunk_count; i++) {
+        if (doc->chunks[i].changed) lsp_chunk_parse(doc, doc->chunks + i);
+    }
+
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (int i = 0; i < doc->chunk_count; i++) {
+            LspChunk *chunk = doc->chunks + i;
+            if (chunk->dirty || (!doc->changed_type && !lsp_chunk_uses(chunk, doc->changed_ids, doc->changed_id_count))) continue;
+            lsp_chunk_parse(doc, chunk);
+            for (int j = 0; j < chunk->declaration_count; j++) {
+                if (declaration_is_function(chunk->declarations + j)) continue;
+                lsp_changed_id_add(doc, chunk->declarations[j].id);
+                grew = true;
+            }
+        }
+    }
+    allocator_free(doc->changed_ids);
+    doc->changed_ids = NULL;
+    doc->changed_id_count = 0;
+    doc->changed_type = false;
+
+    // The table only holds pointers, so putting every declaration in it again is cheaper than finding the ones that moved.
+    symbol_table_free(&doc->table);
+    symbol_table_new(&doc->table, NULL);
+    doc->duplicate_count = 0;
+    for (int i = 0; i < doc->chunk_count; i++)
+    for (int j = 0; j < doc->chunks[i].declaration_count; j++) {
+        Declaration *decl = doc->chunks[i].declarations + j;
+        if (symbol_table_insert(&doc->table, decl)) continue;
+        doc->duplicate_count++;
+        doc->duplicates = allocator_realloc(ALLOCATOR_LSP, doc->duplicates, sizeof(Diagnostic) * doc->duplicate_count);
+        doc->duplicates[doc->duplicate_count - 1] = (Diagnostic) {
+            .severity = DIAGNOSTIC_ERROR,
+            .location = decl->location,
+            .message = "This declaration has a duplicate name."
+        };
+    }
+
+    // Declarations that were checked before are already initialized, so only the ones parsed again are checked.
+    DiagnosticRecovery recovery;
+    diagnostics_recovery_push(&recovery);
+    if (!setjmp(recovery.jump)) {
+        typecheck_table(&doc->table);
+        diagnostics_recovery_pop(&recovery);
+    }
+
+    // Errors in chunks that weren't parsed again were kept from before, so the same ones found again are left out.
+    int count;
+    const Diagnostic *diagnostics = diagnostics_get(&count);
+    for (int i = 0; i < count; i++) {
+        LspChunk *chunk = lsp_chunk_named(doc, diagnostics[i].location.file_name);
+        if (!chunk || !chunk->dirty) continue;
+        chunk->diagnostic_count++;
+        chunk->diagnostics = allocator_realloc(ALLOCATOR_LSP, chunk->diagnostics, sizeof(Diagnostic) * chunk->diagnostic_count);
+        chunk->diagnostics[chunk->diagnostic_count - 1] = diagnostics[i];
+    }
+    diagnostics_clear();
+    for (int i = 0; i < doc->chunk_count; i++) doc->chunks[i].dirty = false;
+}
+
+// Replaces the text between two offsets, and splits the text from the start of the first chunk it touched into chunks again,
+// until a chunk ends where one ended before. The chunks after that only move.
+static void lsp_document_edit(LspDocument *doc, int start, int end, const char *text, int length) {
+    int first = doc->chunk_count > 0 ? lsp_chunk_at(doc, start) : 0;
+    int last = doc->chunk_count > 0 ? lsp_chunk_at(doc, end > start ? end - 1 : start) : -1;
+    int delta = length - (end - start);
+    int line_delta = 0;
+    for (int i = start; i < end; i++) line_delta -= doc->text[i] == '\n';
+    for (int i = 0; i < length; i++) line_delta += text[i] == '\n';
+
+    if (doc->length + delta + 1 > doc->length_alloc) {
+        doc->length_alloc = (doc->length + delta + 1) * 3 / 2;
+        doc->text = allocator_realloc(ALLOCATOR_LSP, doc->text, doc->length_alloc);
+    }
+    memmove(doc->text + end + delta, doc->text + end, doc->length - end + 1);
+    memcpy(doc->text + start, text, length);
+    doc->length += delta;
+
+    LspChunk *chunks = NULL;
+    int chunk_count = 0;
+    int chunk_start = first < doc->chunk_count ? doc->chunks[first].start : 0;
+    int line = first < doc->chunk_count ? doc->chunks[first].line : 0;
+    int replaced_end = doc->chunk_count; // One past the last old chunk that is replaced.
+    int old = last;
+    while (chunk_start < doc->length) {
+        int chunk_line = line;
+        int chunk_end = lsp_chunk_end(doc, chunk_start, &line);
+        chunk_count++;
+        chunks = allocator_realloc(ALLOCATOR_LSP, chunks, sizeof(LspChunk) * chunk_count);
+        chunks[chunk_count - 1] = lsp_chunk_new(doc, chunk_start, chunk_end, chunk_line);
+        chunk_start = chunk_end;
+
+        while (old >= 0 && old < doc->chunk_count && doc->chunks[old].start + doc->chunks[old].length + delta < chunk_end) old++;
+        if (old >= 0 && old < doc->chunk_count && doc->chunks[old].start + doc->chunks[old].length + delta == chunk_end) {
+            replaced_end = old + 1;
+            break;
+        }
+    }
+
+    // Old and new chunks are paired up when there are as many of each, so the new ones can write over the old declarations.
+    int replaced_count = replaced_end - first;
+    for (int i = first; i < replaced_end; i++) {
+        LspChunk *chunk = doc->chunks + i;
+        if (replaced_count == chunk_count) {
+            chunks[i - first].declarations = chunk->declarations;
+            chunks[i - first].declaration_count = chunk->declaration_count;
+        } else {
+            lsp_chunk_free_declarations(doc, chunk);
+        }
+        lsp_chunk_free(chunk);
+    }
+
+    int new_chunk_count = doc->chunk_count - replaced_count + chunk_count;
+    if (new_chunk_count > doc->chunk_count_alloc) {
+        doc->chunk_count_alloc = new_chunk_count * 3 / 2;
+        doc->chunks = allocator_realloc(ALLOCATOR_LSP, doc->chunks, sizeof(LspChunk) * doc->chunk_count_alloc);
+    }
+    memmove(doc->chunks + first + chunk_count, doc->chunks + replaced_end, sizeof(LspChunk) * (doc->chunk_count - replaced_end));
+    if (chunk_count > 0) memcpy(doc->chunks + first, chunks, sizeof(LspChunk) * chunk_count);
+    allocator_free(chunks);
+    doc->chunk_count = new_chunk_count;
+
+    for (int i = first + chunk_count; i < doc->chunk_count; i++) {
+        doc->chunks[i].start += delta;
+        doc->chunks[i].line += line_delta;
+    }
+}
+
+// The length in UTF-16 code units, which positions in the protocol count in, of the UTF-8 text between two offsets.
+static int lsp_utf16_length(const char *text, int start, int end) {
+    int units = 0;
+    for (int i = start; i < end; i++) {
+        unsigned char c = (unsigned char) text[i];
+        if ((c & 0xC0) != 0x80) units += c >= 0xF0 ? 2 : 1;
+    }
+    return units;
+}
+
+static int lsp_offset(LspDocument *doc, JsonValue *position) {
+    int line = json_int(json_get(position, "line"));
+    int character = json_int(json_get(position, "character"));
+    if (doc->chunk_count == 0) return 0;
+
+    int lo = 0;
+    int hi = doc->chunk_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (doc->chunks[mid].line <= line) lo = mid;
+        else hi = mid - 1;
+    }
+
+    // The chunk can start in the middle of the line, after the semicolon of the one before.
+    int offset = doc->chunks[lo].start;
+    int offset_line = doc->chunks[lo].line;
+    if (offset_line >= line) {
+        while (offset > 0 && doc->text[offset - 1] != '\n') offset--;
+    }
+    for (; offset_line < line && offset < doc->length; offset++) {
+        if (doc->text[offset] == '\n') offset_line++;
+    }
+    while (character > 0 && offset < doc->length && doc->text[offset] != '\n') {
+        unsigned char c = (unsigned char) doc->text[offset];
+        int length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        character -= length == 4 ? 2 : 1;
+        offset += length;
+    }
+    return offset < doc->length ? offset : doc->length;
+}
+
+static void lsp_write_position(StringBuilder *builder, LspDocument *doc, int offset, int line) {
+    int line_start = offset;
+    while (line_start > 0 && doc->text[line_start - 1] != '\n') line_start--;
+    lsp_write(builder, "{\"line\":");
+    lsp_write_int(builder, line);
+    lsp_write(builder, ",\"character\":");
+    lsp_write_int(builder, lsp_utf16_length(doc->text, line_start, offset));
+    string_builder_add_char(builder, '}');
+}
+
+static void lsp_write_range(StringBuilder *builder, LspDocument *doc, LspChunk *chunk, Location location) {
+    int start = chunk->start + location.idx_start;
+    int end = chunk->start + location.idx_end;
+    int line = chunk->line + location.idx_line;
+    lsp_write(builder, "{\"start\":");
+    lsp_write_position(builder, doc, start, line);
+    for (int i = start; i < end; i++) line += doc->text[i] == '\n';
+    lsp_write(builder, ",\"end\":");
+    lsp_write_position(builder, doc, end, line);
+    string_builder_add_char(builder, '}');
+}
+
+static void lsp_write_diagnostic(StringBuilder *builder, LspDocument *doc, const Diagnostic *diagnostic, bool *first) {
+    LspChunk *chunk = lsp_chunk_named(doc, diagnostic->location.file_name);
+    if (!chunk) return;
+    if (!*first) string_builder_add_char(builder, ',');
+    *first = false;
+    lsp_write(builder, "{\"range\":");
+    lsp_write_range(builder, doc, chunk, diagnostic->location);
+    lsp_write(builder, ",\"severity\":");
+    lsp_write_int(builder, diagnostic->severity + 1); // Error, warning and information in the protocol.
+    lsp_write(builder, ",\"source\":\"creed\",\"message\":");
+    lsp_write_string(builder, diagnostic->message);
+    string_builder_add_char(builder, '}');
+}
+
+static void lsp_publish_diagnostics(FILE *outfile, LspDocument *doc) {
+    StringBuilder builder = string_builder_new();
+    lsp_write(&builder, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    lsp_write_string(&builder, string_cache_get(doc->uri));
+    lsp_write(&builder, ",\"diagnostics\":[");
+    bool first = true;
+    for (int i = 0; i < doc->chunk_count; i++)
+    for (int j = 0; j < doc->chunks[i].diagnostic_count; j++) {
+        lsp_write_diagnostic(&builder, doc, doc->chunks[i].diagnostics + j, &first);
+    }
+    for (int i = 0; i < doc->duplicate_count; i++) lsp_write_diagnostic(&builder, doc, doc->duplicates + i, &first);
+    lsp_write(&builder, "]}}");
+    lsp_send(outfile, &builder);
+}
+
+static bool lsp_contains(Location location, int idx) {
+    return location.idx_start <= idx && idx < location.idx_end;
+}
+
+// Finding what an identifier at an offset refers to, from the pointers the typechecker put in the syntax tree.
+static Declaration *lsp_find_scope(Scope *scope, int idx);
+static Declaration *lsp_find_declaration(Declaration *decl, int idx);
+
+static Declaration *lsp_find_type(Type *type, int idx) {
+    switch (type->type) {
+        case TYPE_ID:
+            return lsp_contains(type->location, idx) ? type->data.id.type_declaration : NULL;
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+        case TYPE_ARRAY:
+            return lsp_find_type(type->data.sub_type, idx);
+        case TYPE_FUNCTION:
+            for (int i = 0; i < type->data.function.param_count; i++) {
+                Declaration *found = lsp_find_type(&type->data.function.params[i].type, idx);
+                if (found) return found;
+            }
+            return lsp_find_type(type->data.function.result, idx);
+        case TYPE_PRIMITIVE:
+        case TYPE_VECTOR:
+            return NULL;
+    }
+    return NULL;
+}
+
+static Declaration *lsp_find_exprs(Expr *exprs, int count, int idx);
+
+static Declaration *lsp_find_expr(Expr *expr, int idx) {
+    if (!expr) return NULL;
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return lsp_find_expr(expr->data.parenthesized, idx);
+        case EXPR_UNARY:
+            return lsp_find_expr(expr->data.unary.operand, idx);
+        case EXPR_BINARY: {
+            Declaration *found = lsp_find_expr(expr->data.binary.lhs, idx);
+            return found ? found : lsp_find_expr(expr->data.binary.rhs, idx);
+        }
+        case EXPR_TYPECAST: {
+            Declaration *found = lsp_find_expr(expr->data.typecast.operand, idx);
+            return found ? found : lsp_find_type(&expr->data.typecast.cast_to, idx);
+        }
+        case EXPR_ACCESS_MEMBER:
+            return lsp_find_expr(expr->data.access_member.operand, idx);
+        case EXPR_ACCESS_ARRAY: {
+            Declaration *found = lsp_find_expr(expr->data.access_array.operand, idx);
+            return found ? found : lsp_find_expr(expr->data.access_array.index, idx);
+        }
+        case EXPR_FUNCTION: {
+            // A parameter is found from its own name, and from its type.
+            Declaration *found = lsp_find_type(&expr->data.function.type, idx);
+            return found ? found : lsp_find_scope(expr->data.function.scope, idx);
+        }
+        case EXPR_FUNCTION_CALL: {
+            Declaration *found = lsp_find_expr(expr->data.function_call.function, idx);
+            return found ? found : lsp_find_exprs(expr->data.function_call.params, expr->data.function_call.param_count, idx);
+        }
+        case EXPR_ID:
+            return lsp_contains(expr->location, idx) ? expr->data.id.declaration : NULL;
+        case EXPR_LITERAL_ARRAY: {
+            Declaration *found = lsp_find_type(&expr->data.literal_array.type, idx);
+            if (!found) found = lsp_find_expr(expr->data.literal_array.count, idx);
+            return found ? found : lsp_find_exprs(expr->data.literal_array.members, expr->data.literal_array.allocated_count, idx);
+        }
+        case EXPR_VECTOR:
+            return lsp_find_exprs(expr->data.vector.args, expr->data.vector.arg_count, idx);
+        case EXPR_FILE:
+            return lsp_find_exprs(expr->data.file.args, expr->data.file.arg_count, idx);
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return NULL;
+    }
+    return NULL;
+}
+
+static Declaration *lsp_find_exprs(Expr *exprs, int count, int idx) {
+    for (int i = 0; i < count; i++) {
+        Declaration *found = lsp_find_expr(exprs + i, idx);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+static Declaration *lsp_find_declaration(Declaration *decl, int idx) {
+    switch (decl->type) {
+        case DECLARATION_VAR:
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+                Declaration *found = decl->data.var.data.constant.type_explicit ? lsp_find_type(&decl->data.var.data.constant.type, idx) : NULL;
+                return found ? found : lsp_find_expr(&decl->data.var.data.constant.value, idx);
+            } else {
+                Declaration *found = lsp_find_type(&decl->data.var.data.mutable.type, idx);
+                if (found || !decl->data.var.data.mutable.value_exists) return found;
+                return lsp_find_expr(&decl->data.var.data.mutable.value, idx);
+            }
+        case DECLARATION_STRUCT:
+        case DECLARATION_UNION:
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) {
+                Declaration *found = lsp_find_type(&decl->data.struct_union.members[i].type, idx);
+                if (found) return found;
+            }
+            return NULL;
+        case DECLARATION_SUM:
+            for (int i = 0; i < decl->data.sum.member_count; i++) {
+                if (!decl->data.sum.members[i].type_exists) continue;
+                Declaration *found = lsp_find_type(&decl->data.sum.members[i].type, idx);
+                if (found) return found;
+            }
+            return NULL;
+        case DECLARATION_ENUM:
+            return NULL;
+    }
+    return NULL;
+}
+
+static Declaration *lsp_find_statement(Statement *statement, int idx) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            return lsp_find_declaration(&statement->data.declaration, idx);
+        case STATEMENT_INCREMENT:
+            return lsp_find_expr(&statement->data.increment, idx);
+        case STATEMENT_DEINCREMENT:
+            return lsp_find_expr(&statement->data.deincrement, idx);
+        case STATEMENT_ASSIGN: {
+            Declaration *found = lsp_find_expr(&statement->data.assign.assignee, idx);
+            return found ? found : lsp_find_expr(&statement->data.assign.value, idx);
+        }
+        case STATEMENT_EXPR:
+            return lsp_find_expr(&statement->data.expr, idx);
+        case STATEMENT_RETURN:
+            return statement->data.return_value.exists ? lsp_find_expr(&statement->data.return_value.expr, idx) : NULL;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            return NULL;
+    }
+    return NULL;
+}
+
+static Declaration *lsp_find_scope(Scope *scope, int idx) {
+    if (!scope || !lsp_contains(scope->location, idx)) return NULL;
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            return lsp_find_statement(&scope->data.statement, idx);
+        case SCOPE_CONDITIONAL: {
+            Declaration *found = lsp_find_expr(&scope->data.conditional.condition, idx);
+            if (!found) found = lsp_find_scope(scope->data.conditional.scope_if, idx);
+            return found ? found : lsp_find_scope(scope->data.conditional.scope_else, idx);
+        }
+        case SCOPE_LOOP_FOR: {
+            Declaration *found = lsp_find_statement(&scope->data.loop_for.init, idx);
+            if (!found) found = lsp_find_expr(&scope->data.loop_for.expr, idx);
+            if (!found) found = lsp_find_statement(&scope->data.loop_for.step, idx);
+            return found ? found : lsp_find_scope(scope->data.loop_for.scope, idx);
+        }
+        case SCOPE_LOOP_FOR_EACH: {
+            Declaration *found = lsp_find_expr(&scope->data.loop_for_each.array, idx);
+            return found ? found : lsp_find_scope(scope->data.loop_for_each.scope, idx);
+        }
+        case SCOPE_LOOP_WHILE: {
+            Declaration *found = lsp_find_expr(&scope->data.loop_while.expr, idx);
+            return found ? found : lsp_find_scope(scope->data.loop_while.scope, idx);
+        }
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) {
+                Declaration *found = lsp_find_scope(scope->data.block.scopes + i, idx);
+                if (found) return found;
+            }
+            return NULL;
+        case SCOPE_MATCH: {
+            Declaration *found = lsp_find_expr(&scope->data.match.expr, idx);
+            for (int i = 0; !found && i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                if (match_case->declares) found = lsp_find_statement(&match_case->declared_var, idx);
+                for (int j = 0; !found && j < match_case->scope_count; j++) found = lsp_find_scope(match_case->scopes + j, idx);
+            }
+            return found;
+        }
+    }
+    return NULL;
+}
+
+// Constants are folded into literals by the typechecker, which leaves no identifier in the tree for them.
+// Those are found from the name under the offset, among the top-level declarations.
+static Declaration *lsp_find_folded(LspDocument *doc, LspChunk *chunk, int idx) {
+    Lexer lexer = lexer_new_content(chunk->name, chunk->content);
+    while (true) {
+        Token token = lexer_token_get(&lexer);
+        if (token.type == TOKEN_NULL || token.location.idx_start > idx) return NULL;
+        if (token.type == TOKEN_ID && lsp_contains(token.location, idx)) return symbol_table_get(&doc->table, token.data.id);
+    }
+}
+
+static LspDocument *lsp_document_get(JsonValue *params) {
+    JsonValue *uri = json_get(json_get(params, "textDocument"), "uri");
+    if (!uri || uri->type != JSON_STRING) return NULL;
+    for (int i = 0; i < lsp_document_count; i++) {
+        if (!strcmp(string_cache_get(lsp_documents[i]->uri), uri->data.string.chars)) return lsp_documents[i];
+    }
+    return NULL;
+}
+
+static void lsp_document_free(LspDocument *doc) {
+    for (int i = 0; i < doc->chunk_count; i++) {
+        lsp_chunk_free_declarations(NULL, doc->chunks + i);
+        lsp_chunk_free(doc->chunks + i);
+    }
+    allocator_free(doc->chunks);
+    allocator_free(doc->text);
+    allocator_free(doc->duplicates);
+    allocator_free(doc->changed_ids);
+    symbol_table_free(&doc->table);
+    allocator_free(doc);
+}
+
+static void lsp_did_open(FILE *outfile, JsonValue *params) {
+    JsonValue *document = json_get(params, "textDocument");
+    JsonValue *uri = json_get(document, "uri");
+    JsonValue *text = json_get(document, "text");
+    if (!uri || uri->type != JSON_STRING || !text || text->type != JSON_STRING) return;
+
+    LspDocument *doc = allocator_calloc(ALLOCATOR_LSP, 1, sizeof(LspDocument));
+    doc->uri = string_cache_insert_static(uri->data.string.chars);
+    doc->length_alloc = 1;
+    doc->text = allocator_malloc(ALLOCATOR_LSP, 1);
+    doc->text[0] = '\0';
+    symbol_table_new(&doc->table, NULL);
+    lsp_document_edit(doc, 0, 0, text->data.string.chars, text->data.string.length);
+    lsp_document_analyze(doc);
+
+    lsp_document_count++;
+    lsp_documents = allocator_realloc(ALLOCATOR_LSP, lsp_documents, sizeof(LspDocument *) * lsp_document_count);
+    lsp_documents[lsp_document_count - 1] = doc;
+    lsp_publish_diagnostics(outfile, doc);
+}
+
+// Edits are applied in order, each to the text the one before it left, and the document is analyzed once after all of them.
+static void lsp_did_change(FILE *outfile, JsonValue *params) {
+    LspDocument *doc = lsp_document_get(params);
+    JsonValue *changes = json_get(params, "contentChanges");
+    if (!doc || !changes || changes->type != JSON_ARRAY) return;
+
+    for (int i = 0; i < changes->data.compound.count; i++) {
+        JsonValue *change = changes->data.compound.items + i;
+        JsonValue *range = json_get(change, "range");
+        JsonValue *text = json_get(change, "text");
+        if (!text || text->type != JSON_STRING) continue;
+        // Without a range, the change is the whole text.
+        int start = range ? lsp_offset(doc, json_get(range, "start")) : 0;
+        int end = range ? lsp_offset(doc, json_get(range, "end")) : doc->length;
+        if (end < start) end = start;
+        lsp_document_edit(doc, start, end, text->data.string.chars, text->data.string.length);
+    }
+    lsp_document_analyze(doc);
+    lsp_publish_diagnostics(outfile, doc);
+}
+
+static void lsp_did_close(FILE *outfile, JsonValue *params) {
+    LspDocument *doc = lsp_document_get(params);
+    if (!doc) return;
+    for (int i = 0; i < lsp_document_count; i++) {
+        if (lsp_documents[i] == doc) lsp_documents[i] = lsp_documents[--lsp_document_count];
+    }
+
+    // A closed document shows no diagnostics.
+    StringBuilder builder = string_builder_new();
+    lsp_write(&builder, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    lsp_write_string(&builder, string_cache_get(doc->uri));
+    lsp_write(&builder, ",\"diagnostics\":[]}}");
+    lsp_send(outfile, &builder);
+    lsp_document_free(doc);
+}
+
+static void lsp_definition(FILE *outfile, JsonValue *id, JsonValue *params) {
+    StringBuilder builder = lsp_response(id);
+    LspDocument *doc = lsp_document_get(params);
+    Declaration *found = NULL;
+    if (doc && doc->chunk_count > 0) {
+        int offset = lsp_offset(doc, json_get(params, "position"));
+        LspChunk *chunk = doc->chunks + lsp_chunk_at(doc, offset);
+        for (int i = 0; !found && i < chunk->declaration_count; i++) {
+            found = lsp_find_declaration(chunk->declarations + i, offset - chunk->start);
+        }
+        if (!found) found = lsp_find_folded(doc, chunk, offset - chunk->start);
+    }
+
+    LspChunk *target = found ? lsp_chunk_named(doc, found->location.file_name) : NULL;
+    if (target) {
+        // Only the name of the declaration, which its location starts with.
+        Location location = found->location;
+        location.idx_end = location.idx_start + (int) strlen(string_cache_get(found->id));
+        lsp_write(&builder, "{\"uri\":");
+        lsp_write_string(&builder, string_cache_get(doc->uri));
+        lsp_write(&builder, ",\"range\":");
+        lsp_write_range(&builder, doc, target, location);
+        string_builder_add_char(&builder, '}');
+    } else {
+        lsp_write(&builder, "null");
+    }
+    string_builder_add_char(&builder, '}');
+    lsp_send(outfile, &builder);
+}
+
+int lsp_run(FILE *infile, FILE *outfile) {
+    // Stdout is where the messages go, and an error should never end the server.
+    diagnostics_set_output(NULL);
+    diagnostics_set_max_errors(0);
+
+    bool shutdown = false;
+    while (true) {
+        int length;
+        char *body = lsp_read(infile, &length);
+        if (!body) return EXIT_FAILURE;
+
+        JsonParser parser = { .text = body, .idx = 0, .length = length };
+        JsonValue message;
+        bool parsed = json_parse_value(&parser, &message);
+        JsonValue *method = json_get(&message, "method");
+        JsonValue *id = json_get(&message, "id");
+        JsonValue *params = json_get(&message, "params");
+        const char *name = method && method->type == JSON_STRING ? method->data.string.chars : "";
+
+        if (!parsed) {
+            StringBuilder builder = string_builder_new();
+            lsp_write(&builder, "{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":{\"code\":-32700,\"message\":\"Parse error\"}}");
+            lsp_send(outfile, &builder);
+        } else if (!strcmp(name, "initialize")) {
+            StringBuilder builder = lsp_response(id);
+            // Edits come as ranges, so only the text that changed is sent.
+            lsp_write(&builder, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},\"definitionProvider\":true},");
+            lsp_write(&builder, "\"serverInfo\":{\"name\":\"creed\"}}}");
+            lsp_send(outfile, &builder);
+        } else if (!strcmp(name, "shutdown")) {
+            shutdown = true;
+            StringBuilder builder = lsp_response(id);
+            lsp_write(&builder, "null}");
+            lsp_send(outfile, &builder);
+        } else if (!strcmp(name, "exit")) {
+            json_free(&message);
+            allocator_free(body);
+            break;
+        } else if (!strcmp(name, "textDocument/didOpen")) {
+            lsp_did_open(outfile, params);
+        } else if (!strcmp(name, "textDocument/didChange")) {
+            lsp_did_change(outfile, params);
+        } else if (!strcmp(name, "textDocument/didClose")) {
+            lsp_did_close(outfile, params);
+        } else if (!strcmp(name, "textDocument/definition")) {
+            lsp_definition(outfile, id, params);
+        } else if (id && method) {
+            // Notifications that aren't handled are ignored, but requests always get an answer.
+            StringBuilder builder = string_builder_new();
+            lsp_write(&builder, "{\"jsonrpc\":\"2.0\",\"id\":");
+            lsp_write_id(&builder, id);
+            lsp_write(&builder, ",\"error\":{\"code\":-32601,\"message\":\"Method not found\"}}");
+            lsp_send(outfile, &builder);
+        }
+        json_free(&message);
+        allocator_free(body);
+    }
+
+    for (int i = 0; i < lsp_document_count; i++) lsp_document_free(lsp_documents[i]);
+    allocator_free(lsp_documents);
+    lsp_documents = NULL;
+    lsp_document_count = 0;
+    return shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+}
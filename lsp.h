@@ -0,0 +1,10 @@
+#ifndef CREED_LSP_H
+#define CREED_LSP_H
+
+#include <stdio.h>
+
+// A language server over JSON-RPC, with the headers of the Language Server Protocol. It publishes diagnostics for
+// open documents and answers go to definition, until it is told to exit. Returns the exit code of the process.
+int lsp_run(FILE *infile, FILE *outfile);
+
+#endif
@@ -3,22 +3,208 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "allocator.h"
+#include "diagnostics.h"
 #include "lexer.h"
 #include "token.h"
 #include "parser.h"
 #include "string_cache.h"
 #include "symbol_table.h"
 #include "handlers.h"
+#include "inline.h"
+#include "tail_call.h"
+#include "dead_code.h"
+#include "loop.h"
+#include "bounds.h"
+#include "escape.h"
+#include "layout.h"
+#include "timing.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "dump.h"
+#include "lsp.h"
+
+// Lexes a copy of the lexer to the end, so the lexer itself is left at the start of the file.
+static unsigned long long count_tokens(Lexer lexer) {
+    unsigned long long count = 0;
+    while (true) {
+        Token token = lexer_token_get(&lexer);
+        if (token.type == TOKEN_NULL || (TOKEN_ERROR_MIN <= token.type && token.type <= TOKEN_ERROR_MAX)) break;
+        count++;
+    }
+    return count;
+}
+
+// Each command runs the pipeline up to a later stage than the one before it.
+typedef enum Command {
+    COMMAND_DUMP_TOKENS,
+    COMMAND_DUMP_AST,
+    COMMAND_CHECK, // Parses and typechecks without writing any C.
+    COMMAND_EMIT_C,
+} Command;
+
+static const char *command_names[] = { "dump-tokens", "dump-ast", "check", "emit-c" };
 
 int main(int argc, char **argv) {
     string_cache_init();
+
+    Command command = COMMAND_EMIT_C;
+    DumpFormat format = DUMP_FORMAT_TEXT;
+    int first_option = 1;
+    for (int i = 0; argc > 1 && i < (int) (sizeof(command_names) / sizeof(command_names[0])); i++) {
+        if (!strcmp(argv[1], command_names[i])) {
+            command = i;
+            first_option = 2;
+        }
+    }
+
+    const char *path = NULL;
+    bool optimize = true;
+    bool reorder_fields = false;
+    const char *layout_profile = NULL;
+    bool layout_report_enabled = false;
+    bool time_report = false;
+    const char *time_report_path = NULL;
+    bool mem_report = false;
+    bool perf_counters = false;
+    const char *trace_path = NULL;
+    bool leak_check = false;
+    bool lsp = false;
+    for (int i = first_option; i < argc; i++) {
+        if (!strcmp(argv[i], "-O0")) optimize = false;
+        else if (!strcmp(argv[i], "-O1")) optimize = true;
+        else if (!strncmp(argv[i], "-Rpass=", strlen("-Rpass="))) remark_enable(argv[i] + strlen("-Rpass="));
+        else if (!strcmp(argv[i], "-freorder-fields")) reorder_fields = true;
+        else if (!strncmp(argv[i], "-flayout-profile=", strlen("-flayout-profile="))) {
+            reorder_fields = true;
+            layout_profile = argv[i] + strlen("-flayout-profile=");
+        }
+        else if (!strcmp(argv[i], "--layout-report")) layout_report_enabled = true;
+        else if (!strcmp(argv[i], "--time-report")) time_report = true;
+        else if (!strncmp(argv[i], "--time-report=", strlen("--time-report="))) {
+            time_report = true;
+            time_report_path = argv[i] + strlen("--time-report=");
+        }
+        else if (!strcmp(argv[i], "--mem-report")) mem_report = true;
+        else if (!strcmp(argv[i], "--perf-counters")) perf_counters = true;
+        else if (!strncmp(argv[i], "--trace=", strlen("--trace="))) trace_path = argv[i] + strlen("--trace=");
+        else if (!strcmp(argv[i], "--leak-check")) leak_check = true;
+        else if (!strncmp(argv[i], "--max-errors=", strlen("--max-errors="))) diagnostics_set_max_errors(atoi(argv[i] + strlen("--max-errors=")));
+        else if (!strcmp(argv[i], "--lsp")) lsp = true;
+        else if (!strcmp(argv[i], "--format=text")) format = DUMP_FORMAT_TEXT;
+        else if (!strcmp(argv[i], "--format=json")) format = DUMP_FORMAT_JSON;
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+            fprintf(stderr, "Usage: %s [emit-c | check | dump-ast | dump-tokens] [-O0 | -O1] [-Rpass=<pass | all>] [-freorder-fields] [-flayout-profile=<file>] [--layout-report]\n", argv[0]);
+            fprintf(stderr, "       [--time-report[=<json file>]] [--mem-report] [--perf-counters] [--trace=<json file>] [--leak-check] [--max-errors=<count>]\n");
+            fprintf(stderr, "       [--format=text | --format=json] <file>\n");
+            fprintf(stderr, "       %s --lsp\n", argv[0]);
+            return EXIT_FAILURE;
+        } else path = argv[i];
+    }
+    // The documents come from the client, so a language server needs no file.
+    if (lsp) return lsp_run(stdin, stdout);
+    if (first_option == 2 && !path) {
+        fprintf(stderr, "%s needs a file.\n", command_names[command]);
+        return EXIT_FAILURE;
+    }
+    // Dumps of large files are millions of small writes, so stdout gets a large buffer even when it is a terminal.
+    if (command <= COMMAND_DUMP_AST) setvbuf(stdout, NULL, _IOFBF, 1 << 16);
     
-    if (argc >= 2) {
-        SourceFile file = source_file_parse(string_cache_insert_static(argv[1]));
-        source_file_print(&file);
-        typecheck(&file);
-        handle_driver(&file);
-        source_file_free(&file);
+    if (path) {
+        TimingCounts counts = { 0 };
+        if (perf_counters) perf_counters = perf_counters_open(stderr);
+        if (trace_path && !trace_open(trace_path)) {
+            perror("Failed to open the trace");
+            return EXIT_FAILURE;
+        }
+        timing_begin(TIMING_LOAD);
+        Lexer lexer = lexer_new(string_cache_insert_static(path));
+        timing_end(TIMING_LOAD);
+        counts.bytes_read = strlen(lexer.file_content_ptr);
+
+        if (command == COMMAND_DUMP_TOKENS) {
+            timing_begin(TIMING_PRINT);
+            dump_tokens(lexer, format);
+            timing_end(TIMING_PRINT);
+        } else {
+            if (time_report || perf_counters) {
+                timing_begin(TIMING_LEX);
+                counts.tokens = count_tokens(lexer);
+                timing_end(TIMING_LEX);
+            }
+
+            timing_begin(TIMING_PARSE);
+            SourceFile file = source_file_parse_lexer(&lexer);
+            timing_end(TIMING_PARSE);
+            // The parser and typechecker go on after an error to report as many as they can, but nothing after them can.
+            if (diagnostics_error_count() > 0) return EXIT_FAILURE;
+            for (int i = 0; i < file.declaration_count; i++) counts.nodes += declaration_node_count(file.declarations + i);
+
+            if (command == COMMAND_DUMP_AST) {
+                timing_begin(TIMING_PRINT);
+                dump_ast(&file, format);
+                timing_end(TIMING_PRINT);
+            }
+
+            if (command >= COMMAND_CHECK) {
+                timing_begin(TIMING_TYPECHECK);
+                typecheck(&file);
+                timing_end(TIMING_TYPECHECK);
+                if (diagnostics_error_count() > 0) return EXIT_FAILURE;
+            }
+
+            if (command == COMMAND_EMIT_C) {
+                timing_begin(TIMING_OPTIMIZE);
+                if (layout_report_enabled) layout_report_begin(&file);
+                if (reorder_fields) layout_optimize(&file, layout_profile);
+                if (layout_report_enabled) layout_report(&file, stderr);
+                if (optimize) {
+                    inline_functions(&file);
+                    tail_call_eliminate(&file);
+                    dead_code_eliminate(&file);
+                    bounds_check_eliminate(&file);
+                    loop_optimize(&file);
+                }
+                escape_analyze(&file);
+                timing_end(TIMING_OPTIMIZE);
+
+                timing_begin(TIMING_EMIT);
+                handle_driver(&file);
+                timing_end(TIMING_EMIT);
+            }
+            if (leak_check) source_file_free(&file);
+        }
+
+        if (command == COMMAND_EMIT_C && (time_report || perf_counters)) {
+            FILE *emitted = fopen("file.c", "r");
+            if (emitted) {
+                fseek(emitted, 0, SEEK_END);
+                counts.bytes_emitted = ftell(emitted);
+                fclose(emitted);
+            }
+        }
+        if (time_report) {
+            timing_report(&counts, stderr);
+            if (time_report_path) {
+                FILE *json = fopen(time_report_path, "w");
+                if (!json) {
+                    perror("Failed to open the time report");
+                    return EXIT_FAILURE;
+                }
+                timing_report_json(&counts, json);
+                fclose(json);
+            }
+        }
+        if (perf_counters) {
+            perf_counters_report(&counts, stderr);
+            perf_counters_close();
+        }
+        trace_close();
+        if (mem_report) allocator_report(stderr, counts.bytes_read);
+        // The process is about to end, and the system takes all its memory back at once, so freeing the syntax tree
+        // and the strings one block at a time would only be slower. --leak-check frees them to test that it's done right.
+        if (!leak_check) return EXIT_SUCCESS;
     } else {
 
         { // test lexer getting tokens
@@ -60,6 +246,9 @@ int main(int argc, char **argv) {
         }
     }
 
+    diagnostics_clear();
     string_cache_free();
+    // The tests run without a file always free everything, so the free functions are checked by every run of them.
+    if (!allocator_leak_check(stderr)) return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,56 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "opt_util.h"
+#include "parser.h"
+
+static int declaration_set_slot(Declaration **slots, int slot_count, Declaration *decl) {
+    // Declarations are aligned, so the low bits carry nothing and the multiply spreads the rest.
+    uint64_t hash = ((uint64_t) (uintptr_t) decl >> 3) * 0x9E3779B97F4A7C15ull;
+    int slot = (int) (hash >> 32) & (slot_count - 1);
+    while (slots[slot] && slots[slot] != decl) slot = (slot + 1) & (slot_count - 1);
+    return slot;
+}
+
+void declaration_set_add(DeclarationSet *set, Declaration *decl) {
+    // Grow at half full so probe runs stay short.
+    if ((set->count + 1) * 2 > set->slot_count) {
+        int slot_count = set->slot_count == 0 ? 16 : set->slot_count * 2;
+        Declaration **slots = allocator_calloc(ALLOCATOR_OPTIMIZE, slot_count, sizeof(Declaration *));
+        for (int i = 0; i < set->slot_count; i++) {
+            if (set->slots[i]) slots[declaration_set_slot(slots, slot_count, set->slots[i])] = set->slots[i];
+        }
+        allocator_free(set->slots);
+        set->slots = slots;
+        set->slot_count = slot_count;
+    }
+    int slot = declaration_set_slot(set->slots, set->slot_count, decl);
+    if (set->slots[slot]) return;
+    set->slots[slot] = decl;
+    set->count++;
+}
+
+bool declaration_set_has(DeclarationSet *set, Declaration *decl) {
+    if (set->count == 0) return false;
+    return set->slots[declaration_set_slot(set->slots, set->slot_count, decl)] != NULL;
+}
+
+void declaration_set_clear(DeclarationSet *set) {
+    if (set->count == 0) return;
+    memset(set->slots, 0, sizeof(Declaration *) * set->slot_count);
+    set->count = 0;
+}
+
+void declaration_set_free(DeclarationSet *set) {
+    allocator_free(set->slots);
+    *set = (DeclarationSet) {0};
+}
+
+Expr *expr_alloc(Expr expr) {
+    Expr *alloc = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(Expr));
+    *alloc = expr;
+    return alloc;
+}
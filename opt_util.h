@@ -0,0 +1,26 @@
+#ifndef CREED_OPT_UTIL_H
+#define CREED_OPT_UTIL_H
+
+#include <stdbool.h>
+#include "parser.h"
+
+// Helpers the optimization passes share.
+
+// A set of declarations, zero-initialized to be empty.
+// It is an open addressing hash table keyed by the pointer, since the passes fill it with every declaration of a program.
+typedef struct DeclarationSet {
+    Declaration **slots; // NULL where empty, slot_count is a power of 2.
+    int slot_count;
+    int count;
+} DeclarationSet;
+
+void declaration_set_add(DeclarationSet *set, Declaration *decl);
+bool declaration_set_has(DeclarationSet *set, Declaration *decl);
+// Empties the set but keeps its slots for reuse.
+void declaration_set_clear(DeclarationSet *set);
+void declaration_set_free(DeclarationSet *set);
+
+// Copies an expression made by an optimization to the heap, for a node to point to.
+Expr *expr_alloc(Expr expr);
+
+#endif
@@ -1,14 +1,18 @@
 #include <assert.h>
 #include <limits.h>
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator.h"
+#include "diagnostics.h"
 #include "lexer.h"
 #include "parser.h"
 #include "prelude.h"
 #include "token.h"
+#include "trace.h"
 #include "handlers.h"
 
 Type type_parse(Lexer *lexer) {
@@ -39,7 +43,7 @@ Type type_parse(Lexer *lexer) {
             
             if (lexer_token_peek(lexer).type != TOKEN_PAREN_CLOSE) {            
                 int param_count_alloc = 2;
-                params = malloc(param_count_alloc * sizeof(FunctionParameter));
+                params = allocator_malloc(ALLOCATOR_PARSER, param_count_alloc * sizeof(FunctionParameter));
                 while (true) {
                     Token token_id = lexer_token_get(lexer);
                     if (token_id.type != TOKEN_ID) error_exit(token_id.location, "Expected the name of a function parameter to be an identifier.");
@@ -49,7 +53,7 @@ Type type_parse(Lexer *lexer) {
                     param_count++;
                     if (param_count > param_count_alloc) {
                         param_count_alloc *= 2;
-                        params = realloc(params, param_count_alloc * sizeof(FunctionParameter));
+                        params = allocator_realloc(ALLOCATOR_PARSER, params, param_count_alloc * sizeof(FunctionParameter));
                     }
                     
                     params[param_count - 1] = (FunctionParameter) {
@@ -69,7 +73,7 @@ Type type_parse(Lexer *lexer) {
             }
             lexer_token_get(lexer);
 
-            Type *result = malloc(sizeof(Type));
+            Type *result = allocator_malloc(ALLOCATOR_PARSER, sizeof(Type));
             *result = type_parse(lexer);
             
             return (Type) {
@@ -81,17 +85,29 @@ Type type_parse(Lexer *lexer) {
             };
         } break;
 
-        case TOKEN_ID:
+        case TOKEN_ID: {
             lexer_token_get(lexer);
+            Token token_element = lexer_token_peek(lexer);
+            int width = type_vector_width(token.data.id);
+            if (width > 0 && TOKEN_KEYWORD_TYPE_NUMERIC_MIN <= token_element.type && token_element.type <= TOKEN_KEYWORD_TYPE_NUMERIC_MAX) {
+                lexer_token_get(lexer);
+                return (Type) {
+                    .location = location_expand(token.location, token_element.location),
+                    .type = TYPE_VECTOR,
+                    .data.vector.element = token_element.type,
+                    .data.vector.width = width
+                };
+            }
             return (Type) {
                 .location = token.location,
                 .type = TYPE_ID,
                 .data.id.type_declaration_id = token.data.id,
                 .data.id.type_declaration = NULL // Just set this to null for now so we get a segfault if we try to access it.
             };
+        }
         
         default:
-            if (token.type < TOKEN_KEYWORD_TYPE_MIN || TOKEN_KEYWORD_TYPE_MAX < token.type) {
+            if ((token.type < TOKEN_KEYWORD_TYPE_MIN || TOKEN_KEYWORD_TYPE_MAX < token.type) && token.type != TOKEN_KEYWORD_FILE) {
                 error_exit(token.location, "Expected type signature here.");
             }
             lexer_token_get(lexer);
@@ -103,7 +119,7 @@ Type type_parse(Lexer *lexer) {
     }
 
     lexer_token_get(lexer);
-    Type *sub_type = malloc(sizeof(Type));
+    Type *sub_type = allocator_malloc(ALLOCATOR_PARSER, sizeof(Type));
     *sub_type = type_parse(lexer);
     
     return (Type) {
@@ -117,20 +133,21 @@ void type_free(Type *type) {
     switch (type->type) {   
         case TYPE_PRIMITIVE:
         case TYPE_ID:
+        case TYPE_VECTOR:
             break;
 
         case TYPE_PTR:
         case TYPE_PTR_NULLABLE:
         case TYPE_ARRAY:
             type_free(type->data.sub_type);
-            free(type->data.sub_type);
+            allocator_free(type->data.sub_type);
             break;
 
         case TYPE_FUNCTION:
             for (int i = 0; i < type->data.function.param_count; i++) type_free(&type->data.function.params[i].type);
-            free(type->data.function.params);
+            allocator_free(type->data.function.params);
             type_free(type->data.function.result);
-            free(type->data.function.result);
+            allocator_free(type->data.function.result);
             break;
     }
 }
@@ -176,6 +193,10 @@ void type_print(Type *type) {
             printf("%c ", TOKEN_PAREN_CLOSE);
             type_print(type->data.function.result);
             break;
+
+        case TYPE_VECTOR:
+            printf("vec%i %s", type->data.vector.width, string_keywords[type->data.vector.element - TOKEN_KEYWORD_MIN]);
+            break;
     }
 }
 
@@ -201,34 +222,83 @@ bool type_equal(Type *lhs, Type *rhs) {
                 if (!type_equal(&lhs->data.function.params[i].type, &rhs->data.function.params[i].type)) return false;
             }
             return type_equal(lhs->data.function.result, rhs->data.function.result);
+
+        case TYPE_VECTOR:
+            return lhs->data.vector.element == rhs->data.vector.element && lhs->data.vector.width == rhs->data.vector.width;
     }
     assert(false);
 }
 
+int type_vector_width(StringId id) {
+    const char *name = string_cache_get(id);
+    if (strncmp(name, "vec", 3) != 0) return 0;
+    int width = 0;
+    for (const char *digit = name + 3; *digit; digit++) {
+        if (*digit < '0' || *digit > '9' || width > 64) return 0;
+        width = width * 10 + *digit - '0';
+    }
+    // GCC vectors are at most 64 lanes, and a power of 2 wide.
+    if (width < 2 || width > 64 || (width & (width - 1)) != 0) return 0;
+    return width;
+}
+
+Type type_vector_mask(Type *vector) {
+    Type mask = *vector;
+    switch (vector->data.vector.element) {
+        case TOKEN_KEYWORD_TYPE_INT8:
+        case TOKEN_KEYWORD_TYPE_UINT8:
+            mask.data.vector.element = TOKEN_KEYWORD_TYPE_INT8;
+            break;
+        case TOKEN_KEYWORD_TYPE_INT16:
+        case TOKEN_KEYWORD_TYPE_UINT16:
+            mask.data.vector.element = TOKEN_KEYWORD_TYPE_INT16;
+            break;
+        case TOKEN_KEYWORD_TYPE_INT64:
+        case TOKEN_KEYWORD_TYPE_UINT64:
+        case TOKEN_KEYWORD_TYPE_FLOAT64:
+            mask.data.vector.element = TOKEN_KEYWORD_TYPE_INT64;
+            break;
+        default:
+            mask.data.vector.element = TOKEN_KEYWORD_TYPE_INT;
+            break;
+    }
+    return mask;
+}
+
+bool type_is_file(Type *type) {
+    return type->type == TYPE_PRIMITIVE && type->data.primitive == TOKEN_KEYWORD_FILE;
+}
+
+bool type_is_soa(Type *type) {
+    return type->type == TYPE_ID && type->data.id.type_declaration
+        && type->data.id.type_declaration->type == DECLARATION_STRUCT && type->data.id.type_declaration->data.struct_union.soa;
+}
+
 Type type_clone(Type *type) {
     switch (type->type) {
         case TYPE_PRIMITIVE:
         case TYPE_ID: 
+        case TYPE_VECTOR:
             return *type;
         
         case TYPE_PTR:
         case TYPE_PTR_NULLABLE:
         case TYPE_ARRAY: {
-             Type *sub_clone = malloc(sizeof(Type));
+             Type *sub_clone = allocator_malloc(ALLOCATOR_PARSER, sizeof(Type));
              *sub_clone = type_clone(type->data.sub_type);
              Type clone = *type;
-             clone.data.sub_type = type;
+             clone.data.sub_type = sub_clone;
              return clone;
          } break;
 
         case TYPE_FUNCTION: {
             int param_count = type->data.function.param_count;
-            FunctionParameter *params_clone = malloc(sizeof(FunctionParameter) * param_count);
+            FunctionParameter *params_clone = allocator_malloc(ALLOCATOR_PARSER, sizeof(FunctionParameter) * param_count);
             memcpy(params_clone, type->data.function.params, sizeof(FunctionParameter) * param_count);
             for (int i = 0; i < param_count; i++) {
                 params_clone[i].type = type_clone(&type->data.function.params[i].type);
             }
-            Type *result_clone = malloc(sizeof(Type));
+            Type *result_clone = allocator_malloc(ALLOCATOR_PARSER, sizeof(Type));
             *result_clone = type_clone(type->data.function.result);
             Type clone = *type;
             clone.data.function.params = params_clone;
@@ -259,15 +329,18 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
             if (lexer_token_peek_many(lexer, 2).type == TOKEN_PAREN_CLOSE || lexer_token_peek_many(lexer, 3).type == TOKEN_COLON) {
                 Type type = type_parse(lexer);
                 assert(type.type == TYPE_FUNCTION);
-                Scope *scope = malloc(sizeof(Scope));
+                Scope *scope = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
                 *scope = scope_parse(lexer);
                 expr.type = EXPR_FUNCTION;
                 expr.location = location_expand(type.location, scope->location);
                 expr.data.function.type = type;
                 expr.data.function.scope = scope;
+                expr.data.function.is_inline = false;
+                expr.data.function.uses_arena = false;
+                expr.data.function.param_declarations = NULL;
             } else { 
                 Token token_open = lexer_token_get(lexer);
-                Expr *parenthesized = malloc(sizeof(Expr));
+                Expr *parenthesized = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
                 *parenthesized = expr_parse(lexer);
                 
                 if (lexer_token_peek(lexer).type != TOKEN_PAREN_CLOSE) {
@@ -285,12 +358,47 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
         } break;
 
         case TOKEN_ID: {
+            Token token_next = lexer_token_peek_many(lexer, 2);
+            if (type_vector_width(lexer_token_peek(lexer).data.id) > 0 && TOKEN_KEYWORD_TYPE_NUMERIC_MIN <= token_next.type && token_next.type <= TOKEN_KEYWORD_TYPE_NUMERIC_MAX) {
+                // vec4 float(...) builds a vector.
+                Type type = type_parse(lexer);
+                if (lexer_token_get(lexer).type != TOKEN_PAREN_OPEN) error_exit(type.location, "Expected the values of the lanes in parentheses after a vector type.");
+                int arg_count = 0;
+                Expr *args = NULL;
+                while (true) {
+                    Expr arg = expr_parse(lexer);
+                    arg_count++;
+                    args = allocator_realloc(ALLOCATOR_PARSER, args, sizeof(Expr) * arg_count);
+                    args[arg_count - 1] = arg;
+                    if (lexer_token_peek(lexer).type == TOKEN_PAREN_CLOSE) break;
+                    if (lexer_token_get(lexer).type != TOKEN_COMMA) error_exit(arg.location, "Expected a comma after the value of a vector lane.");
+                }
+                Token paren_close = lexer_token_get(lexer);
+                expr = (Expr) {
+                    .location = location_expand(type.location, paren_close.location),
+                    .type = EXPR_VECTOR,
+                    .data.vector = { .op = EXPR_VECTOR_BUILD, .type = type, .args = args, .arg_count = arg_count, .checked = true }
+                };
+                break;
+            }
             Token token_id = lexer_token_get(lexer);
             expr.type = EXPR_ID;
-            expr.data.id = token_id.data.id;
+            expr.data.id.declaration_id = token_id.data.id;
+            expr.data.id.declaration = NULL;
             expr.location = token_id.location;
         } break;
         
+        case TOKEN_KEYWORD_INLINE: {
+            Token token_inline = lexer_token_get(lexer);
+            expr = expr_parse_modifiers(lexer);
+            if (expr.type != EXPR_FUNCTION) {
+                error_exit(location_expand(token_inline.location, expr.location), "Only functions can be annotated with inline.");
+            }
+            expr.data.function.is_inline = true;
+            expr.location = location_expand(token_inline.location, expr.location);
+            return expr;
+        }
+
         case TOKEN_KEYWORD_FALSE:
         case TOKEN_KEYWORD_TRUE: {
             Token token_bool = lexer_token_get(lexer);
@@ -299,6 +407,42 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
             expr.data.literal_bool = token_bool.type - TOKEN_KEYWORD_FALSE;
         } break;
 
+        case TOKEN_KEYWORD_FILE: {
+            Token token_file = lexer_token_get(lexer);
+            Token token_method = lexer_token_peek_many(lexer, 2);
+            if (lexer_token_peek(lexer).type != TOKEN_DOT || token_method.type != TOKEN_ID) {
+                error_exit(token_file.location, "Expected file.map or file.open.");
+            }
+            lexer_token_get(lexer);
+            lexer_token_get(lexer);
+            int op;
+            if (!strcmp(string_cache_get(token_method.data.id), "map")) op = EXPR_FILE_MAP;
+            else if (!strcmp(string_cache_get(token_method.data.id), "open")) op = EXPR_FILE_OPEN;
+            else error_exit(token_method.location, "Files can only be mapped with file.map or opened with file.open.");
+            if (lexer_token_get(lexer).type != TOKEN_PAREN_OPEN) error_exit(token_method.location, "Expected the path of the file in parentheses.");
+            Expr *path = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
+            *path = expr_parse(lexer);
+            Token paren_close = lexer_token_get(lexer);
+            if (paren_close.type != TOKEN_PAREN_CLOSE) error_exit(path->location, "Expected a closing parenthesis after the path of the file.");
+            expr = (Expr) {
+                .location = location_expand(token_file.location, paren_close.location),
+                .type = EXPR_FILE,
+                .data.file = { .op = op, .args = path, .arg_count = 1 }
+            };
+        } break;
+
+        case TOKEN_KEYWORD_REGEX: {
+            Token token_regex = lexer_token_get(lexer);
+            Token token_pattern = lexer_token_peek(lexer);
+            if (token_pattern.type != TOKEN_LITERAL || token_pattern.data.literal.type != LITERAL_STRING) {
+                error_exit(token_regex.location, "Expected a string literal with the pattern after regex.");
+            }
+            lexer_token_get(lexer);
+            expr.location = location_expand(token_regex.location, token_pattern.location);
+            expr.type = EXPR_REGEX;
+            expr.data.regex = token_pattern.data.literal.data.l_string;
+        } break;
+
         case TOKEN_UNARY_LOGICAL_NOT:
             unary_type = EXPR_UNARY_LOGICAL_NOT;
             goto unary;
@@ -320,7 +464,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
 
             unary: {
                 Token token_not = lexer_token_get(lexer);
-                Expr *operand = malloc(sizeof(Expr));
+                Expr *operand = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
                 *operand = expr_parse_modifiers(lexer);
                 return (Expr) {
                     .type = EXPR_UNARY,
@@ -333,7 +477,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
 
         case TOKEN_BRACKET_OPEN: {
             Token bracket_open = lexer_token_get(lexer);
-            Expr *array_size = malloc(sizeof(Expr));
+            Expr *array_size = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
             *array_size = expr_parse(lexer);
             
             Type array_type = type_parse(lexer);
@@ -341,13 +485,13 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
                 lexer_token_get(lexer);
                 int capacity = 2;
                 int member_count = 0;
-                Expr *members = malloc(sizeof(Expr) * capacity);
+                Expr *members = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr) * capacity);
                 while (true) {
                     Expr member = expr_parse(lexer);
                     member_count++;
                     if (member_count > capacity) { 
                         capacity *= 2;
-                        members = realloc(members, sizeof(Expr) * capacity);
+                        members = allocator_realloc(ALLOCATOR_PARSER, members, sizeof(Expr) * capacity);
                     }
                     members[member_count - 1] = member;
                     if (lexer_token_peek(lexer).type == TOKEN_BRACKET_CLOSE) break;
@@ -365,6 +509,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
                     .data.literal_array.allocated_count = member_count,
                     .data.literal_array.members = members,
                     .data.literal_array.type = array_type,
+                    .data.literal_array.storage = ARRAY_STORAGE_STACK
                 };
             } else { // do not init array members
                 if(lexer_token_peek(lexer).type != TOKEN_BRACKET_CLOSE) error_exit(lexer_token_get(lexer).location, "Expected an close bracket here.");
@@ -375,7 +520,8 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
                     .data.literal_array.count = array_size,
                     .data.literal_array.allocated_count = 0,
                     .data.literal_array.members = NULL,
-                    .data.literal_array.type = array_type
+                    .data.literal_array.type = array_type,
+                    .data.literal_array.storage = ARRAY_STORAGE_STACK
                 };
             }
         }
@@ -395,7 +541,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
                     Expr param = expr_parse(lexer);
                     
                     param_count++;
-                    params = realloc(params, sizeof(Expr) * param_count);
+                    params = allocator_realloc(ALLOCATOR_PARSER, params, sizeof(Expr) * param_count);
                     params[param_count - 1] = param;
                     
                     if (lexer_token_peek(lexer).type == TOKEN_PAREN_CLOSE) break;
@@ -408,7 +554,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
             }
             
             Token paren_close = lexer_token_get(lexer);
-            Expr *function = malloc(sizeof(Expr));
+            Expr *function = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
             *function = expr;
             expr.type = EXPR_FUNCTION_CALL;
             expr.data.function_call.function = function;
@@ -423,7 +569,7 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
                 error_exit(token_id.location, "Expected the name of a member in a member-access expression.");
             }
 
-            Expr *operand = malloc(sizeof(Expr));
+            Expr *operand = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
             *operand = expr;
 
             expr.type = EXPR_ACCESS_MEMBER;
@@ -431,20 +577,24 @@ static Expr expr_parse_modifiers(Lexer *lexer) { // parse unary operators, funct
             expr.data.access_member.member = token_id.data.id;
             expr.location = location_expand(expr.location, token_id.location);
         
-        } else if (lexer_token_peek(lexer).type == TOKEN_BRACKET_OPEN) { 
+        } else if (lexer_token_peek(lexer).type == TOKEN_BRACKET_OPEN && lexer_token_peek_many(lexer, 2).type != TOKEN_BRACKET_CLOSE) { 
+            // [] is an array type, like the item type in [2 []char: "a", "b"], not an array access.
             lexer_token_get(lexer);
-            Expr *index = malloc(sizeof(Expr));
+            Expr *index = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
             *index = expr_parse(lexer);
             if (lexer_token_peek(lexer).type != TOKEN_BRACKET_CLOSE) {
                 error_exit(index->location, "Expected a closing bracket at the end of an array access.");
             }
             Token token_end = lexer_token_get(lexer);
-            Expr *operand = malloc(sizeof(Expr));
+            Expr *operand = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
             *operand = expr;
             expr = (Expr) {
                 .type = EXPR_ACCESS_ARRAY,
                 .data.access_array.operand = operand,
                 .data.access_array.index = index,
+                .data.access_array.item_type = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_VOID },
+                .data.access_array.checked = true,
+                .data.access_array.vector = false,
                 .location = location_expand(expr.location, token_end.location) 
             };
         } else break;
@@ -462,7 +612,7 @@ static Expr expr_parse_precedence(Lexer *lexer, int precedence) {
         lexer_token_get(lexer);
         Type type = type_parse(lexer);
         
-        Expr *operand = malloc(sizeof(Expr));
+        Expr *operand = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
         *operand = expr;
 
         expr = (Expr) {
@@ -483,10 +633,10 @@ static Expr expr_parse_precedence(Lexer *lexer, int precedence) {
         
         lexer_token_get(lexer); // get the operator
 
-        Expr *lhs = malloc(sizeof(Expr));
+        Expr *lhs = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
         *lhs = expr;
         
-        Expr *rhs = malloc(sizeof(Expr));
+        Expr *rhs = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
         *rhs = expr_parse_precedence(lexer, op_precedence);
         
         expr = (Expr) {
@@ -511,67 +661,85 @@ void expr_free(Expr *expr) {
 
         case EXPR_PAREN:
             expr_free(expr->data.parenthesized);
-            free(expr->data.parenthesized);
+            allocator_free(expr->data.parenthesized);
             break;
 
         case EXPR_UNARY:
             expr_free(expr->data.unary.operand);
-            free(expr->data.unary.operand);
+            allocator_free(expr->data.unary.operand);
             break;
 
         case EXPR_BINARY:
             expr_free(expr->data.binary.lhs);
-            free(expr->data.binary.lhs);
+            allocator_free(expr->data.binary.lhs);
             expr_free(expr->data.binary.rhs);
-            free(expr->data.binary.rhs);
+            allocator_free(expr->data.binary.rhs);
             break;
     
         case EXPR_TYPECAST:
             expr_free(expr->data.typecast.operand);
-            free(expr->data.typecast.operand);
+            allocator_free(expr->data.typecast.operand);
             type_free(&expr->data.typecast.cast_to);
             break;
         
         case EXPR_ACCESS_MEMBER:
             expr_free(expr->data.access_member.operand);
-            free(expr->data.access_member.operand);
+            allocator_free(expr->data.access_member.operand);
             break;
 
         case EXPR_ACCESS_ARRAY:
             expr_free(expr->data.access_array.operand);
-            free(expr->data.access_array.operand);
+            allocator_free(expr->data.access_array.operand);
             expr_free(expr->data.access_array.index);
-            free(expr->data.access_array.index);
+            allocator_free(expr->data.access_array.index);
+            type_free(&expr->data.access_array.item_type);
             break;
 
         case EXPR_FUNCTION:
+            if (expr->data.function.param_declarations) {
+                for (int i = 0; i < expr->data.function.type.data.function.param_count; i++) {
+                    declaration_free(expr->data.function.param_declarations + i);
+                }
+                allocator_free(expr->data.function.param_declarations);
+            }
             type_free(&expr->data.function.type);
             scope_free(expr->data.function.scope);
-            free(expr->data.function.scope);
+            allocator_free(expr->data.function.scope);
             break;
 
         case EXPR_FUNCTION_CALL:
             for (int i = 0; i < expr->data.function_call.param_count; i++) {
                 expr_free(expr->data.function_call.params + i);
             }
-            free(expr->data.function_call.params);
+            allocator_free(expr->data.function_call.params);
             expr_free(expr->data.function_call.function);
-            free(expr->data.function_call.function);
+            allocator_free(expr->data.function_call.function);
             break;
 
         case EXPR_LITERAL_ARRAY:
             for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
                 expr_free(expr->data.literal_array.members + i);
             }
-            free(expr->data.literal_array.members);
+            allocator_free(expr->data.literal_array.members);
             type_free(&expr->data.literal_array.type);
             expr_free(expr->data.literal_array.count);
-            free(expr->data.literal_array.count);
+            allocator_free(expr->data.literal_array.count);
+            break;
+
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) expr_free(expr->data.vector.args + i);
+            allocator_free(expr->data.vector.args);
+            break;
+
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) expr_free(expr->data.file.args + i);
+            allocator_free(expr->data.file.args);
             break;
 
         case EXPR_ID:
         case EXPR_LITERAL:
         case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
             break;
     }
 }
@@ -598,7 +766,7 @@ void expr_print(Expr *expr, int indent) {
             break;
         
         case EXPR_ID:
-            print(string_cache_get(expr->data.id));
+            print(string_cache_get(expr->data.id.declaration_id));
             break;
 
         case EXPR_LITERAL:
@@ -609,6 +777,12 @@ void expr_print(Expr *expr, int indent) {
             print(string_keywords[expr->data.literal_bool + TOKEN_KEYWORD_FALSE - TOKEN_KEYWORD_MIN]);
             break;
 
+        case EXPR_REGEX: {
+            Literal pattern = { .type = LITERAL_STRING, .data.l_string = expr->data.regex };
+            printf("%s ", string_keywords[TOKEN_KEYWORD_REGEX - TOKEN_KEYWORD_MIN]);
+            literal_print(&pattern);
+        } break;
+
         case EXPR_TYPECAST:
             putchar('(');
             expr_print(expr->data.typecast.operand, indent);
@@ -633,6 +807,7 @@ void expr_print(Expr *expr, int indent) {
             break;
        
         case EXPR_FUNCTION:
+            if (expr->data.function.is_inline) printf("%s ", string_keywords[TOKEN_KEYWORD_INLINE - TOKEN_KEYWORD_MIN]);
             type_print(&expr->data.function.type);
             putchar(' ');
             scope_print(expr->data.function.scope, indent);
@@ -668,7 +843,250 @@ void expr_print(Expr *expr, int indent) {
             }
             putchar(TOKEN_BRACKET_CLOSE);
             break;
+
+        case EXPR_VECTOR: {
+            static const char *methods[] = { [EXPR_VECTOR_STORE] = "store", [EXPR_VECTOR_SHUFFLE] = "shuffle", [EXPR_VECTOR_TOTAL] = "total", [EXPR_VECTOR_MIN] = "min", [EXPR_VECTOR_MAX] = "max" };
+            int first_arg = 0;
+            if (expr->data.vector.op == EXPR_VECTOR_BUILD || expr->data.vector.op == EXPR_VECTOR_LOAD) {
+                type_print(&expr->data.vector.type);
+            } else {
+                putchar('(');
+                expr_print(expr->data.vector.args, indent);
+                printf(")%c%s", TOKEN_DOT, methods[expr->data.vector.op]);
+                first_arg = 1;
+                if (expr->data.vector.op >= EXPR_VECTOR_TOTAL) break;
+            }
+            putchar(TOKEN_PAREN_OPEN);
+            for (int i = first_arg; i < expr->data.vector.arg_count; i++) {
+                if (i > first_arg) printf("%c ", TOKEN_COMMA);
+                expr_print(&expr->data.vector.args[i], indent);
+            }
+            putchar(TOKEN_PAREN_CLOSE);
+        } break;
+
+        case EXPR_FILE: {
+            static const char *methods[] = { [EXPR_FILE_MAP] = "map", [EXPR_FILE_OPEN] = "open", [EXPR_FILE_NEXT] = "next", [EXPR_FILE_CLOSE] = "close" };
+            if (expr->data.file.op == EXPR_FILE_MAP || expr->data.file.op == EXPR_FILE_OPEN) {
+                printf("%s%c%s", string_keywords[TOKEN_KEYWORD_FILE - TOKEN_KEYWORD_MIN], TOKEN_DOT, methods[expr->data.file.op]);
+                putchar(TOKEN_PAREN_OPEN);
+                expr_print(expr->data.file.args, indent);
+                putchar(TOKEN_PAREN_CLOSE);
+            } else {
+                putchar('(');
+                expr_print(expr->data.file.args, indent);
+                printf(")%c%s()", TOKEN_DOT, methods[expr->data.file.op]);
+            }
+        } break;
+    }
+}
+
+static Expr *expr_clone_alloc(Expr *expr) {
+    Expr *clone = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr));
+    *clone = expr_clone(expr);
+    return clone;
+}
+
+// Function expressions cannot be cloned because they own a scope.
+Expr expr_clone(Expr *expr) {
+    Expr clone = *expr;
+    switch (expr->type) {
+        case EXPR_PAREN:
+            clone.data.parenthesized = expr_clone_alloc(expr->data.parenthesized);
+            break;
+
+        case EXPR_UNARY:
+            clone.data.unary.operand = expr_clone_alloc(expr->data.unary.operand);
+            break;
+
+        case EXPR_BINARY:
+            clone.data.binary.lhs = expr_clone_alloc(expr->data.binary.lhs);
+            clone.data.binary.rhs = expr_clone_alloc(expr->data.binary.rhs);
+            break;
+
+        case EXPR_TYPECAST:
+            clone.data.typecast.operand = expr_clone_alloc(expr->data.typecast.operand);
+            clone.data.typecast.cast_to = type_clone(&expr->data.typecast.cast_to);
+            break;
+
+        case EXPR_ACCESS_MEMBER:
+            clone.data.access_member.operand = expr_clone_alloc(expr->data.access_member.operand);
+            break;
+
+        case EXPR_ACCESS_ARRAY:
+            clone.data.access_array.operand = expr_clone_alloc(expr->data.access_array.operand);
+            clone.data.access_array.index = expr_clone_alloc(expr->data.access_array.index);
+            clone.data.access_array.item_type = type_clone(&expr->data.access_array.item_type);
+            break;
+
+        case EXPR_FUNCTION:
+            assert(false);
+            break;
+
+        case EXPR_FUNCTION_CALL:
+            clone.data.function_call.function = expr_clone_alloc(expr->data.function_call.function);
+            clone.data.function_call.params = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr) * expr->data.function_call.param_count);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) {
+                clone.data.function_call.params[i] = expr_clone(expr->data.function_call.params + i);
+            }
+            break;
+
+        case EXPR_LITERAL_ARRAY:
+            clone.data.literal_array.count = expr_clone_alloc(expr->data.literal_array.count);
+            clone.data.literal_array.type = type_clone(&expr->data.literal_array.type);
+            clone.data.literal_array.members = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr) * expr->data.literal_array.allocated_count);
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
+                clone.data.literal_array.members[i] = expr_clone(expr->data.literal_array.members + i);
+            }
+            break;
+
+        case EXPR_VECTOR:
+            clone.data.vector.args = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr) * expr->data.vector.arg_count);
+            for (int i = 0; i < expr->data.vector.arg_count; i++) clone.data.vector.args[i] = expr_clone(expr->data.vector.args + i);
+            break;
+
+        case EXPR_FILE:
+            clone.data.file.args = allocator_malloc(ALLOCATOR_PARSER, sizeof(Expr) * expr->data.file.arg_count);
+            for (int i = 0; i < expr->data.file.arg_count; i++) clone.data.file.args[i] = expr_clone(expr->data.file.args + i);
+            break;
+
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
     }
+    return clone;
+}
+
+// The number of nodes in the tree, used as an estimate of code size.
+int expr_node_count(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return expr_node_count(expr->data.parenthesized);
+        case EXPR_UNARY:
+            return 1 + expr_node_count(expr->data.unary.operand);
+        case EXPR_BINARY:
+            return 1 + expr_node_count(expr->data.binary.lhs) + expr_node_count(expr->data.binary.rhs);
+        case EXPR_TYPECAST:
+            return 1 + expr_node_count(expr->data.typecast.operand);
+        case EXPR_ACCESS_MEMBER:
+            return 1 + expr_node_count(expr->data.access_member.operand);
+        case EXPR_ACCESS_ARRAY:
+            return 1 + expr_node_count(expr->data.access_array.operand) + expr_node_count(expr->data.access_array.index);
+        case EXPR_FUNCTION:
+            return 1 + scope_node_count(expr->data.function.scope);
+        case EXPR_FUNCTION_CALL: {
+            int count = 1 + expr_node_count(expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) count += expr_node_count(expr->data.function_call.params + i);
+            return count;
+        }
+        case EXPR_LITERAL_ARRAY: {
+            int count = 1 + expr_node_count(expr->data.literal_array.count);
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) count += expr_node_count(expr->data.literal_array.members + i);
+            return count;
+        }
+        case EXPR_VECTOR: {
+            int count = 1;
+            for (int i = 0; i < expr->data.vector.arg_count; i++) count += expr_node_count(expr->data.vector.args + i);
+            return count;
+        }
+        case EXPR_FILE: {
+            int count = 1;
+            for (int i = 0; i < expr->data.file.arg_count; i++) count += expr_node_count(expr->data.file.args + i);
+            return count;
+        }
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return 1;
+    }
+    assert(false);
+}
+
+int expr_call_count(Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return expr_call_count(expr->data.parenthesized);
+        case EXPR_UNARY:
+            return expr_call_count(expr->data.unary.operand);
+        case EXPR_BINARY:
+            return expr_call_count(expr->data.binary.lhs) + expr_call_count(expr->data.binary.rhs);
+        case EXPR_TYPECAST:
+            return expr_call_count(expr->data.typecast.operand);
+        case EXPR_ACCESS_MEMBER:
+            return expr_call_count(expr->data.access_member.operand);
+        case EXPR_ACCESS_ARRAY:
+            return expr_call_count(expr->data.access_array.operand) + expr_call_count(expr->data.access_array.index);
+        case EXPR_FUNCTION_CALL: {
+            int count = 1 + expr_call_count(expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) count += expr_call_count(expr->data.function_call.params + i);
+            return count;
+        }
+        case EXPR_LITERAL_ARRAY: {
+            int count = expr_call_count(expr->data.literal_array.count);
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) count += expr_call_count(expr->data.literal_array.members + i);
+            return count;
+        }
+        case EXPR_VECTOR: {
+            int count = expr->data.vector.op == EXPR_VECTOR_STORE;
+            for (int i = 0; i < expr->data.vector.arg_count; i++) count += expr_call_count(expr->data.vector.args + i);
+            return count;
+        }
+        case EXPR_FILE: {
+            int count = 1;
+            for (int i = 0; i < expr->data.file.arg_count; i++) count += expr_call_count(expr->data.file.args + i);
+            return count;
+        }
+        case EXPR_FUNCTION:
+        case EXPR_ID:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            return 0;
+    }
+    assert(false);
+}
+
+int expr_uses(Expr *expr, Declaration *decl) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return expr_uses(expr->data.parenthesized, decl);
+        case EXPR_UNARY:
+            return expr_uses(expr->data.unary.operand, decl);
+        case EXPR_BINARY:
+            return expr_uses(expr->data.binary.lhs, decl) + expr_uses(expr->data.binary.rhs, decl);
+        case EXPR_TYPECAST:
+            return expr_uses(expr->data.typecast.operand, decl);
+        case EXPR_ACCESS_MEMBER:
+            return expr_uses(expr->data.access_member.operand, decl);
+        case EXPR_ACCESS_ARRAY:
+            return expr_uses(expr->data.access_array.operand, decl) + expr_uses(expr->data.access_array.index, decl);
+        case EXPR_FUNCTION_CALL: {
+            int count = expr_uses(expr->data.function_call.function, decl);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) count += expr_uses(expr->data.function_call.params + i, decl);
+            return count;
+        }
+        case EXPR_VECTOR: {
+            int count = 0;
+            for (int i = 0; i < expr->data.vector.arg_count; i++) count += expr_uses(expr->data.vector.args + i, decl);
+            return count;
+        }
+        case EXPR_FILE: {
+            int count = 0;
+            for (int i = 0; i < expr->data.file.arg_count; i++) count += expr_uses(expr->data.file.args + i, decl);
+            return count;
+        }
+        case EXPR_ID:
+            return expr->data.id.declaration == decl;
+        case EXPR_FUNCTION:
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+        case EXPR_LITERAL_ARRAY:
+            return 0;
+    }
+    assert(false);
 }
 
 Declaration declaration_parse(Lexer *lexer) {
@@ -678,6 +1096,13 @@ Declaration declaration_parse(Lexer *lexer) {
     Declaration decl;
     decl.id = token_id.data.id;
     decl.state = DECLARATION_STATE_UNINITIALIZED;
+    decl.exported = false;
+
+    bool soa = lexer_token_peek(lexer).type == TOKEN_KEYWORD_SOA;
+    if (soa) {
+        lexer_token_get(lexer);
+        if (lexer_token_peek(lexer).type != TOKEN_KEYWORD_STRUCT) error_exit(token_id.location, "Only structs can be declared with soa.");
+    }
 
     switch (lexer_token_peek(lexer).type) {
         case TOKEN_COLON: {
@@ -728,7 +1153,7 @@ Declaration declaration_parse(Lexer *lexer) {
             
             int member_count = 0;
             int member_count_alloc = 2;
-            StringId *members = malloc(sizeof(StringId) * member_count_alloc);
+            StringId *members = allocator_malloc(ALLOCATOR_PARSER, sizeof(StringId) * member_count_alloc);
             
             while (lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {
                 Token token_id = lexer_token_get(lexer);
@@ -738,7 +1163,7 @@ Declaration declaration_parse(Lexer *lexer) {
                 member_count++;
                 if (member_count > member_count_alloc) {
                     member_count_alloc *= 2;
-                    members = realloc(members, sizeof(StringId) * member_count_alloc);
+                    members = allocator_realloc(ALLOCATOR_PARSER, members, sizeof(StringId) * member_count_alloc);
                 }
                 members[member_count - 1] = token_id.data.id;
                 if (lexer_token_peek(lexer).type != TOKEN_SEMICOLON) {
@@ -765,7 +1190,7 @@ Declaration declaration_parse(Lexer *lexer) {
             
             int member_count = 0;
             int member_count_alloc = 2;
-            MemberStructUnion *members = malloc(sizeof(MemberStructUnion) * member_count_alloc);
+            MemberStructUnion *members = allocator_malloc(ALLOCATOR_PARSER, sizeof(MemberStructUnion) * member_count_alloc);
             while (lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {
                 Token token_id = lexer_token_get(lexer);
                 if (token_id.type != TOKEN_ID) {
@@ -781,7 +1206,7 @@ Declaration declaration_parse(Lexer *lexer) {
                 member_count++;
                 if (member_count > member_count_alloc) {
                     member_count_alloc *= 2;
-                    members = realloc(members, sizeof(MemberStructUnion) * member_count_alloc);
+                    members = allocator_realloc(ALLOCATOR_PARSER, members, sizeof(MemberStructUnion) * member_count_alloc);
                 }
                 members[member_count - 1] = (MemberStructUnion) {
                     .location = location_expand(token_id.location, type.location),
@@ -794,6 +1219,7 @@ Declaration declaration_parse(Lexer *lexer) {
             decl.type = type;
             decl.data.struct_union.member_count = member_count;
             decl.data.struct_union.members = members;
+            decl.data.struct_union.soa = soa;
         } break;
         
         case TOKEN_KEYWORD_SUM: {
@@ -805,7 +1231,7 @@ Declaration declaration_parse(Lexer *lexer) {
 
             int member_count = 0;
             int member_count_alloc = 2;
-            MemberSum *members = malloc(sizeof(MemberSum) * member_count_alloc);
+            MemberSum *members = allocator_malloc(ALLOCATOR_PARSER, sizeof(MemberSum) * member_count_alloc);
             while (lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {
                 Token sum_token_id = lexer_token_get(lexer);
                 if (sum_token_id.type != TOKEN_ID) {
@@ -821,7 +1247,7 @@ Declaration declaration_parse(Lexer *lexer) {
                 member_count++;
                 if (member_count > member_count_alloc) {
                     member_count_alloc *= 2;
-                    members = realloc(members, sizeof(MemberSum) * member_count_alloc);
+                    members = allocator_realloc(ALLOCATOR_PARSER, members, sizeof(MemberSum) * member_count_alloc);
                 }
                 members[member_count - 1] = member;
                 if (lexer_token_get(lexer).type != TOKEN_SEMICOLON) {
@@ -837,7 +1263,7 @@ Declaration declaration_parse(Lexer *lexer) {
         } break;
 
         default: {
-            return (Declaration) {0}; 
+            error_exit(token_id.location, "Expected a colon after the name of a declaration.");
         } break;
     }
     return decl;
@@ -862,26 +1288,27 @@ void declaration_free(Declaration *decl) {
             }
             break;
         case DECLARATION_ENUM:
-            free(decl->data.enumeration.members);
+            allocator_free(decl->data.enumeration.members);
             break;
         case DECLARATION_STRUCT:
         case DECLARATION_UNION:
             for (int i = 0; i < decl->data.struct_union.member_count; i++) {
                 type_free(&decl->data.struct_union.members[i].type);
             }
-            free(decl->data.struct_union.members);
+            allocator_free(decl->data.struct_union.members);
             break;
         case DECLARATION_SUM:
             for (int i = 0; i < decl->data.sum.member_count; i++) {
                 if (decl->data.sum.members[i].type_exists) type_free(&decl->data.sum.members[i].type);
             }
-            free(decl->data.sum.members);
+            allocator_free(decl->data.sum.members);
             break;
     }
 }
 
 void declaration_print(Declaration *decl, int indent) {
     
+    if (decl->exported) printf("%s ", string_keywords[TOKEN_KEYWORD_EXPORT - TOKEN_KEYWORD_MIN]);
     printf("%s", string_cache_get(decl->id));
     switch (decl->type) {
         case DECLARATION_VAR:
@@ -919,6 +1346,7 @@ void declaration_print(Declaration *decl, int indent) {
         case DECLARATION_STRUCT:
         case DECLARATION_UNION: {
             const char *keyword = string_keywords[(decl->type == DECLARATION_STRUCT ? TOKEN_KEYWORD_STRUCT : TOKEN_KEYWORD_UNION) - TOKEN_KEYWORD_MIN];
+            if (decl->data.struct_union.soa) printf(" %s", string_keywords[TOKEN_KEYWORD_SOA - TOKEN_KEYWORD_MIN]);
             printf(" %s %c\n", keyword, TOKEN_CURLY_BRACE_OPEN);
             for (int i = 0; i < decl->data.struct_union.member_count; i++) {
                 print_indent(indent + 1);
@@ -1127,18 +1555,51 @@ void statement_print(Statement *statement, int indent) {
     }  
 }
 
+// A missing semicolon at the end of a line is most likely only that, so what came before it is kept.
+// Anything else after a statement or declaration is more likely the rest of one that went wrong.
+static bool parser_line_ended(Lexer *lexer, Location location) {
+    Token next = lexer_token_peek(lexer);
+    return memchr(lexer->file_content_ptr + location.idx_end, '\n', next.location.idx_start - location.idx_end) != NULL;
+}
+
+// Skips the rest of what failed to parse: up to and including a semicolon in the block at depth,
+// or up to the brace that ends that block. Returns false at the end of the file or a token the lexer could not make sense of,
+// where there is nothing left to parse.
+static bool parser_synchronize(Lexer *lexer, int depth) {
+    while (true) {
+        Token token = lexer_token_peek(lexer);
+        if (token.type == TOKEN_NULL || (TOKEN_ERROR_MIN <= token.type && token.type <= TOKEN_ERROR_MAX)) return false;
+        if (lexer->brace_depth == depth && depth > 0 && token.type == TOKEN_CURLY_BRACE_CLOSE) return true;
+        lexer_token_get(lexer);
+        if (lexer->brace_depth == depth && token.type == TOKEN_SEMICOLON) return true;
+        // A block statement like an if or while ends at its closing brace, without a semicolon.
+        if (lexer->brace_depth == depth && depth > 0 && token.type == TOKEN_CURLY_BRACE_CLOSE) return true;
+    }
+}
+
 Scope scope_parse(Lexer *lexer) {
     switch (lexer_token_peek(lexer).type) {
         case TOKEN_CURLY_BRACE_OPEN: {
             Token token_open = lexer_token_get(lexer);
+            int depth = lexer->brace_depth;
 
             int scope_count = 0;
             Scope *scopes = NULL;
             
             while (lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {
+                // A statement that fails to parse is left out, and parsing goes on after its semicolon.
+                DiagnosticRecovery recovery;
+                diagnostics_recovery_push(&recovery);
+                if (setjmp(recovery.jump)) {
+                    if (!parser_synchronize(lexer, depth)) diagnostics_unwind();
+                    continue;
+                }
+                Scope scope = scope_parse(lexer);
+                diagnostics_recovery_pop(&recovery);
+
                 scope_count++;
-                scopes = realloc(scopes, sizeof(Scope) * scope_count);
-                scopes[scope_count - 1] = scope_parse(lexer);
+                scopes = allocator_realloc(ALLOCATOR_PARSER, scopes, sizeof(Scope) * scope_count);
+                scopes[scope_count - 1] = scope;
             }
 
             Token token_close = lexer_token_get(lexer);
@@ -1156,13 +1617,13 @@ Scope scope_parse(Lexer *lexer) {
             Expr expr = expr_parse(lexer);
             
             Location location;
-            Scope *scope_if = malloc(sizeof(Scope));
+            Scope *scope_if = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
             *scope_if = scope_parse(lexer);
 
             Scope *scope_else;
             if (lexer_token_peek(lexer).type == TOKEN_KEYWORD_ELSE) {
                 lexer_token_get(lexer);
-                scope_else = malloc(sizeof(Scope));
+                scope_else = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
                 *scope_else = scope_parse(lexer);
                 location = location_expand(token_if.location, scope_else->location);
             } else {
@@ -1191,15 +1652,18 @@ Scope scope_parse(Lexer *lexer) {
                 lexer_token_get(lexer);
                 
                 Expr array = expr_parse(lexer);
-                Scope *scope = malloc(sizeof(Scope));
+                Scope *scope = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
                 *scope = scope_parse(lexer);
 
                 return (Scope) {
                     .location = location_expand(token_for.location, scope->location),
                     .type = SCOPE_LOOP_FOR_EACH,
                     .data.loop_for_each.element = token_id.data.id,
+                    .data.loop_for_each.element_declaration = NULL,
                     .data.loop_for_each.array = array,
-                    .data.loop_for_each.scope = scope
+                    .data.loop_for_each.scope = scope,
+                    .data.loop_for_each.parallel = false,
+                    .data.loop_for_each.file = false
                 };
             }
 
@@ -1215,7 +1679,7 @@ Scope scope_parse(Lexer *lexer) {
 
             Statement step = statement_parse(lexer);
             
-            Scope *scope = malloc(sizeof(Scope));
+            Scope *scope = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
             *scope = scope_parse(lexer);
             
             return (Scope) {
@@ -1224,14 +1688,25 @@ Scope scope_parse(Lexer *lexer) {
                 .data.loop_for.init = init,
                 .data.loop_for.expr = expr,
                 .data.loop_for.step = step,
-                .data.loop_for.scope = scope
+                .data.loop_for.scope = scope,
+                .data.loop_for.parallel = false
             };
         }
         
+        case TOKEN_KEYWORD_PARALLEL: {
+            Token token_parallel = lexer_token_get(lexer);
+            if (lexer_token_peek(lexer).type != TOKEN_KEYWORD_FOR) error_exit(token_parallel.location, "Expected a for loop after parallel.");
+            Scope scope = scope_parse(lexer);
+            scope.location = location_expand(token_parallel.location, scope.location);
+            if (scope.type == SCOPE_LOOP_FOR) scope.data.loop_for.parallel = true;
+            else scope.data.loop_for_each.parallel = true;
+            return scope;
+        }
+
         case TOKEN_KEYWORD_WHILE: {
             Token token_while = lexer_token_get(lexer);
             Expr expr = expr_parse(lexer);
-            Scope *scope = malloc(sizeof(Scope));
+            Scope *scope = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope));
             *scope = scope_parse(lexer);
 
             return (Scope) {
@@ -1254,7 +1729,7 @@ Scope scope_parse(Lexer *lexer) {
                 error_exit(open_brace_token.location, "Expected an open curly brace after match expression.");
             }
 
-            MatchCase *cases = malloc(sizeof(MatchCase) * case_count_allocated);
+            MatchCase *cases = allocator_malloc(ALLOCATOR_PARSER, sizeof(MatchCase) * case_count_allocated);
             while (lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {
                 Token token_pipe = lexer_token_peek(lexer);
                 if (token_pipe.type != TOKEN_OP_BITWISE_OR) {
@@ -1268,6 +1743,26 @@ Scope scope_parse(Lexer *lexer) {
                 }
                 lexer_token_get(lexer);
 
+                // A second identifier names the value the sum member holds, as in | move distance ->.
+                Statement declared_var = {0};
+                bool declares = lexer_token_peek(lexer).type == TOKEN_ID;
+                if (declares) {
+                    Token token_var = lexer_token_get(lexer);
+                    declared_var = (Statement) {
+                        .location = token_var.location,
+                        .type = STATEMENT_DECLARATION,
+                        .data.declaration = {
+                            .location = token_var.location,
+                            .id = token_var.data.id,
+                            .type = DECLARATION_VAR,
+                            .data.var.type = DECLARATION_VAR_MUTABLE,
+                            // The type is that of the sum member, which is filled in by the typechecker.
+                            .data.var.data.mutable.type = { .location = token_var.location, .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_VOID },
+                            .data.var.data.mutable.value_exists = false
+                        }
+                    };
+                }
+
                 Token token_lambda = lexer_token_peek(lexer);
                 if (token_lambda.type != TOKEN_LAMBDA) { 
                     error_exit(token_lambda.location, "Expected a '->' between a match case and its body."); 
@@ -1276,13 +1771,13 @@ Scope scope_parse(Lexer *lexer) {
 
                 int scope_count = 0;
                 int scope_count_allocated = 2;
-                Scope *scopes = malloc(sizeof(Scope) * scope_count_allocated);
+                Scope *scopes = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope) * scope_count_allocated);
 
                 while (lexer_token_peek(lexer).type != TOKEN_OP_BITWISE_OR && lexer_token_peek(lexer).type != TOKEN_CURLY_BRACE_CLOSE) {                   
                     scope_count++;
                     if (scope_count > scope_count_allocated) {
                         scope_count_allocated *= 2; // double the size allocated for scopes
-                        cases = realloc(cases, sizeof(Scope) * scope_count_allocated);
+                        scopes = allocator_realloc(ALLOCATOR_PARSER, scopes, sizeof(Scope) * scope_count_allocated);
                     }
                     scopes[scope_count - 1] = scope_parse(lexer);
                 }
@@ -1290,7 +1785,7 @@ Scope scope_parse(Lexer *lexer) {
                 case_count++;
                 if (case_count > case_count_allocated) {
                     case_count_allocated *= 2; // double the size for matches
-                    cases = realloc(cases, sizeof(MatchCase) * case_count_allocated);
+                    cases = allocator_realloc(ALLOCATOR_PARSER, cases, sizeof(MatchCase) * case_count_allocated);
                 }
               
                 Location location = scope_count == 0 
@@ -1300,7 +1795,8 @@ Scope scope_parse(Lexer *lexer) {
                 cases[case_count - 1] = (MatchCase) {
                     .location = location,
                     .match_id = token_id.data.id,
-                    .declares = false, // TODO: add parsing for a declared var in match
+                    .declares = declares,
+                    .declared_var = declared_var,
                     .scope_count = scope_count,
                     .scopes = scopes
                 };
@@ -1320,14 +1816,18 @@ Scope scope_parse(Lexer *lexer) {
 
         default: {
             Statement statement = statement_parse(lexer);
-            Token token_semicolon = lexer_token_peek(lexer);
-            if (token_semicolon.type != TOKEN_SEMICOLON) {
+            Location location = statement.location;
+            if (lexer_token_peek(lexer).type == TOKEN_SEMICOLON) {
+                location = location_expand(location, lexer_token_get(lexer).location);
+            } else if (parser_line_ended(lexer, statement.location)) {
+                diagnostics_report(DIAGNOSTIC_ERROR, statement.location, "Expected a semicolon after a statement.");
+            } else {
+                statement_free(&statement);
                 error_exit(statement.location, "Expected a semicolon after a statement.");
             }
-            lexer_token_get(lexer);
 
             return (Scope) {
-                .location = location_expand(statement.location, token_semicolon.location),
+                .location = location,
                 .type = SCOPE_STATEMENT,
                 .data.statement = statement
             };
@@ -1343,10 +1843,10 @@ void scope_free(Scope *scope) {
         case SCOPE_CONDITIONAL:
             expr_free(&scope->data.conditional.condition);
             scope_free(scope->data.conditional.scope_if);
-            free(scope->data.conditional.scope_if);
+            allocator_free(scope->data.conditional.scope_if);
             if (scope->data.conditional.scope_else) {
                 scope_free(scope->data.conditional.scope_else);
-                free(scope->data.conditional.scope_else);
+                allocator_free(scope->data.conditional.scope_else);
             }
             break;
         case SCOPE_LOOP_FOR:
@@ -1354,21 +1854,25 @@ void scope_free(Scope *scope) {
             expr_free(&scope->data.loop_for.expr);
             statement_free(&scope->data.loop_for.step);
             scope_free(scope->data.loop_for.scope);
-            free(scope->data.loop_for.scope);
+            allocator_free(scope->data.loop_for.scope);
             break;
         case SCOPE_LOOP_FOR_EACH:
+            if (scope->data.loop_for_each.element_declaration) {
+                declaration_free(scope->data.loop_for_each.element_declaration);
+                allocator_free(scope->data.loop_for_each.element_declaration);
+            }
             expr_free(&scope->data.loop_for_each.array);
             scope_free(scope->data.loop_for_each.scope);
-            free(scope->data.loop_for_each.scope);
+            allocator_free(scope->data.loop_for_each.scope);
             break;
         case SCOPE_LOOP_WHILE:
             expr_free(&scope->data.loop_while.expr);
             scope_free(scope->data.loop_while.scope);
-            free(scope->data.loop_while.scope);
+            allocator_free(scope->data.loop_while.scope);
             break;
         case SCOPE_BLOCK:
             for (int i = 0; i < scope->data.block.scope_count; i++) scope_free(scope->data.block.scopes + i);
-            free(scope->data.block.scopes);
+            allocator_free(scope->data.block.scopes);
             break;
         case SCOPE_MATCH:
             expr_free(&scope->data.match.expr);
@@ -1378,9 +1882,9 @@ void scope_free(Scope *scope) {
                 int scope_count = scope->data.match.cases[i].scope_count;
                 for (int j = 0; j < scope_count; ++j) 
                     scope_free(scope->data.match.cases[i].scopes + j);
-                free(scope->data.match.cases[i].scopes);
+                allocator_free(scope->data.match.cases[i].scopes);
             }
-            free(scope->data.match.cases);
+            allocator_free(scope->data.match.cases);
             break;
     }
 }
@@ -1405,6 +1909,7 @@ void scope_print(Scope *scope, int indent) {
             break;
 
         case SCOPE_LOOP_FOR:
+            if (scope->data.loop_for.parallel) printf("%s ", string_keywords[TOKEN_KEYWORD_PARALLEL - TOKEN_KEYWORD_MIN]);
             print(string_keywords[TOKEN_KEYWORD_FOR - TOKEN_KEYWORD_MIN]);
             putchar(' ');
             statement_print(&scope->data.loop_for.init, indent);
@@ -1417,6 +1922,7 @@ void scope_print(Scope *scope, int indent) {
             break;
 
         case SCOPE_LOOP_FOR_EACH:
+            if (scope->data.loop_for_each.parallel) printf("%s ", string_keywords[TOKEN_KEYWORD_PARALLEL - TOKEN_KEYWORD_MIN]);
             print(string_keywords[TOKEN_KEYWORD_FOR - TOKEN_KEYWORD_MIN]);
             printf(" %s %s ", string_cache_get(scope->data.loop_for_each.element), string_keywords[TOKEN_KEYWORD_IN - TOKEN_KEYWORD_MIN]);
             expr_print(&scope->data.loop_for_each.array, indent);
@@ -1453,6 +1959,7 @@ void scope_print(Scope *scope, int indent) {
                 print_indent(indent); 
                 printf("%s ", string_operators[TOKEN_OP_BITWISE_OR - TOKEN_OP_MIN]);
                 print(string_cache_get(scope->data.match.cases[i].match_id));
+                if (scope->data.match.cases[i].declares) printf(" %s", string_cache_get(scope->data.match.cases[i].declared_var.data.declaration.id));
                 printf(" ->\n");
                 for (int j = 0; j < scope->data.match.cases[i].scope_count; ++j) {
                     print_indent(indent + 1);
@@ -1466,25 +1973,330 @@ void scope_print(Scope *scope, int indent) {
     }
 }
 
+static int statement_node_count(Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            return declaration_node_count(&statement->data.declaration);
+        case STATEMENT_INCREMENT:
+            return 1 + expr_node_count(&statement->data.increment);
+        case STATEMENT_DEINCREMENT:
+            return 1 + expr_node_count(&statement->data.deincrement);
+        case STATEMENT_ASSIGN:
+            return 1 + expr_node_count(&statement->data.assign.assignee) + expr_node_count(&statement->data.assign.value);
+        case STATEMENT_EXPR:
+            return expr_node_count(&statement->data.expr);
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            return 1;
+        case STATEMENT_RETURN:
+            return 1 + (statement->data.return_value.exists ? expr_node_count(&statement->data.return_value.expr) : 0);
+    }
+    assert(false);
+}
+
+bool declaration_is_function(Declaration *decl) {
+    return decl->type == DECLARATION_VAR
+        && decl->data.var.type == DECLARATION_VAR_CONSTANT
+        && decl->data.var.data.constant.value.type == EXPR_FUNCTION;
+}
+
+int declaration_node_count(Declaration *decl) {
+    switch (decl->type) {
+        case DECLARATION_VAR:
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) return 1 + expr_node_count(&decl->data.var.data.constant.value);
+            return 1 + (decl->data.var.data.mutable.value_exists ? expr_node_count(&decl->data.var.data.mutable.value) : 0);
+        case DECLARATION_ENUM:
+            return 1 + decl->data.enumeration.member_count;
+        case DECLARATION_STRUCT:
+        case DECLARATION_UNION:
+            return 1 + decl->data.struct_union.member_count;
+        case DECLARATION_SUM:
+            return 1 + decl->data.sum.member_count;
+    }
+    assert(false);
+}
+
+int scope_node_count(Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            return statement_node_count(&scope->data.statement);
+        case SCOPE_CONDITIONAL: {
+            int count = 1 + expr_node_count(&scope->data.conditional.condition) + scope_node_count(scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) count += scope_node_count(scope->data.conditional.scope_else);
+            return count;
+        }
+        case SCOPE_LOOP_FOR:
+            return 1 + statement_node_count(&scope->data.loop_for.init) + expr_node_count(&scope->data.loop_for.expr) 
+                + statement_node_count(&scope->data.loop_for.step) + scope_node_count(scope->data.loop_for.scope);
+        case SCOPE_LOOP_FOR_EACH:
+            return 1 + expr_node_count(&scope->data.loop_for_each.array) + scope_node_count(scope->data.loop_for_each.scope);
+        case SCOPE_LOOP_WHILE:
+            return 1 + expr_node_count(&scope->data.loop_while.expr) + scope_node_count(scope->data.loop_while.scope);
+        case SCOPE_BLOCK: {
+            int count = 1;
+            for (int i = 0; i < scope->data.block.scope_count; i++) count += scope_node_count(scope->data.block.scopes + i);
+            return count;
+        }
+        case SCOPE_MATCH: {
+            int count = 1 + expr_node_count(&scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) count += scope_node_count(scope->data.match.cases[i].scopes + j);
+            }
+            return count;
+        }
+    }
+    assert(false);
+}
+
+// Declarations are stored inline in scopes and in the source file, so moving them has to update the identifiers and types that point to them.
+static void relocate_type(Relocation *relocation, Type *type) {
+    switch (type->type) {
+        case TYPE_ID:
+            type->data.id.type_declaration = relocation->relocate(relocation->context, type->data.id.type_declaration);
+            break;
+        case TYPE_PTR:
+        case TYPE_PTR_NULLABLE:
+        case TYPE_ARRAY:
+            relocate_type(relocation, type->data.sub_type);
+            break;
+        case TYPE_FUNCTION:
+            for (int i = 0; i < type->data.function.param_count; i++) relocate_type(relocation, &type->data.function.params[i].type);
+            relocate_type(relocation, type->data.function.result);
+            break;
+        case TYPE_PRIMITIVE:
+        case TYPE_VECTOR:
+            break;
+    }
+}
+
+static void relocate_expr(Relocation *relocation, Expr *expr) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            relocate_expr(relocation, expr->data.parenthesized);
+            break;
+        case EXPR_UNARY:
+            relocate_expr(relocation, expr->data.unary.operand);
+            break;
+        case EXPR_BINARY:
+            relocate_expr(relocation, expr->data.binary.lhs);
+            relocate_expr(relocation, expr->data.binary.rhs);
+            break;
+        case EXPR_TYPECAST:
+            relocate_expr(relocation, expr->data.typecast.operand);
+            relocate_type(relocation, &expr->data.typecast.cast_to);
+            break;
+        case EXPR_ACCESS_MEMBER:
+            relocate_expr(relocation, expr->data.access_member.operand);
+            break;
+        case EXPR_ACCESS_ARRAY:
+            relocate_expr(relocation, expr->data.access_array.operand);
+            relocate_expr(relocation, expr->data.access_array.index);
+            relocate_type(relocation, &expr->data.access_array.item_type);
+            break;
+        case EXPR_FUNCTION:
+            relocate_type(relocation, &expr->data.function.type);
+            if (expr->data.function.param_declarations) {
+                for (int i = 0; i < expr->data.function.type.data.function.param_count; i++) {
+                    relocate_declaration(relocation, expr->data.function.param_declarations + i);
+                }
+            }
+            relocate_scope(relocation, expr->data.function.scope);
+            break;
+        case EXPR_FUNCTION_CALL:
+            relocate_expr(relocation, expr->data.function_call.function);
+            for (int i = 0; i < expr->data.function_call.param_count; i++) relocate_expr(relocation, expr->data.function_call.params + i);
+            break;
+        case EXPR_ID:
+            expr->data.id.declaration = relocation->relocate(relocation->context, expr->data.id.declaration);
+            break;
+        case EXPR_LITERAL_ARRAY:
+            relocate_type(relocation, &expr->data.literal_array.type);
+            relocate_expr(relocation, expr->data.literal_array.count);
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) relocate_expr(relocation, expr->data.literal_array.members + i);
+            break;
+        case EXPR_VECTOR:
+            for (int i = 0; i < expr->data.vector.arg_count; i++) relocate_expr(relocation, expr->data.vector.args + i);
+            break;
+        case EXPR_FILE:
+            for (int i = 0; i < expr->data.file.arg_count; i++) relocate_expr(relocation, expr->data.file.args + i);
+            break;
+        case EXPR_LITERAL:
+        case EXPR_LITERAL_BOOL:
+        case EXPR_REGEX:
+            break;
+    }
+}
+
+void relocate_declaration(Relocation *relocation, Declaration *decl) {
+    switch (decl->type) {
+        case DECLARATION_VAR:
+            if (decl->data.var.type == DECLARATION_VAR_CONSTANT) {
+                relocate_type(relocation, &decl->data.var.data.constant.type);
+                relocate_expr(relocation, &decl->data.var.data.constant.value);
+            } else {
+                relocate_type(relocation, &decl->data.var.data.mutable.type);
+                if (decl->data.var.data.mutable.value_exists) relocate_expr(relocation, &decl->data.var.data.mutable.value);
+            }
+            break;
+        case DECLARATION_STRUCT:
+        case DECLARATION_UNION:
+            for (int i = 0; i < decl->data.struct_union.member_count; i++) relocate_type(relocation, &decl->data.struct_union.members[i].type);
+            break;
+        case DECLARATION_SUM:
+            for (int i = 0; i < decl->data.sum.member_count; i++) {
+                if (decl->data.sum.members[i].type_exists) relocate_type(relocation, &decl->data.sum.members[i].type);
+            }
+            break;
+        case DECLARATION_ENUM:
+            break;
+    }
+}
+
+static void relocate_statement(Relocation *relocation, Statement *statement) {
+    switch (statement->type) {
+        case STATEMENT_DECLARATION:
+            relocate_declaration(relocation, &statement->data.declaration);
+            break;
+        case STATEMENT_INCREMENT:
+            relocate_expr(relocation, &statement->data.increment);
+            break;
+        case STATEMENT_DEINCREMENT:
+            relocate_expr(relocation, &statement->data.deincrement);
+            break;
+        case STATEMENT_ASSIGN:
+            relocate_expr(relocation, &statement->data.assign.assignee);
+            relocate_expr(relocation, &statement->data.assign.value);
+            break;
+        case STATEMENT_EXPR:
+            relocate_expr(relocation, &statement->data.expr);
+            break;
+        case STATEMENT_RETURN:
+            if (statement->data.return_value.exists) relocate_expr(relocation, &statement->data.return_value.expr);
+            break;
+        case STATEMENT_LABEL:
+        case STATEMENT_LABEL_GOTO:
+            break;
+    }
+}
+
+void relocate_scope(Relocation *relocation, Scope *scope) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            relocate_statement(relocation, &scope->data.statement);
+            break;
+        case SCOPE_CONDITIONAL:
+            relocate_expr(relocation, &scope->data.conditional.condition);
+            relocate_scope(relocation, scope->data.conditional.scope_if);
+            if (scope->data.conditional.scope_else) relocate_scope(relocation, scope->data.conditional.scope_else);
+            break;
+        case SCOPE_LOOP_FOR:
+            relocate_statement(relocation, &scope->data.loop_for.init);
+            relocate_expr(relocation, &scope->data.loop_for.expr);
+            relocate_statement(relocation, &scope->data.loop_for.step);
+            relocate_scope(relocation, scope->data.loop_for.scope);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            if (scope->data.loop_for_each.element_declaration) relocate_declaration(relocation, scope->data.loop_for_each.element_declaration);
+            relocate_expr(relocation, &scope->data.loop_for_each.array);
+            relocate_scope(relocation, scope->data.loop_for_each.scope);
+            break;
+        case SCOPE_LOOP_WHILE:
+            relocate_expr(relocation, &scope->data.loop_while.expr);
+            relocate_scope(relocation, scope->data.loop_while.scope);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) relocate_scope(relocation, scope->data.block.scopes + i);
+            break;
+        case SCOPE_MATCH:
+            relocate_expr(relocation, &scope->data.match.expr);
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                if (scope->data.match.cases[i].declares) relocate_statement(relocation, &scope->data.match.cases[i].declared_var);
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) relocate_scope(relocation, scope->data.match.cases[i].scopes + j);
+            }
+            break;
+    }
+}
+
+typedef struct ScopeInsertion {
+    Scope *old;
+    int old_count;
+    Scope *scopes;
+    int idx;
+    int count;
+} ScopeInsertion;
+
+static void *scope_block_insert_relocate(void *context, void *ptr) {
+    ScopeInsertion *insertion = context;
+    char *begin = (char *) insertion->old;
+    char *old = ptr;
+    if (old < begin || (char *) (insertion->old + insertion->old_count) <= old) return ptr;
+    int offset = (int) (old - begin);
+    int idx = offset / (int) sizeof(Scope);
+    if (idx >= insertion->idx) idx += insertion->count;
+    return (char *) (insertion->scopes + idx) + offset % (int) sizeof(Scope);
+}
+
+void scope_block_insert(Scope *root, Scope *block, int idx, Scope *scopes, int count) {
+    assert(block->type == SCOPE_BLOCK);
+    assert(0 <= idx && idx <= block->data.block.scope_count);
+
+    Scope *old = block->data.block.scopes;
+    int old_count = block->data.block.scope_count;
+    Scope *new = allocator_malloc(ALLOCATOR_PARSER, sizeof(Scope) * (old_count + count));
+    memcpy(new, old, sizeof(Scope) * idx);
+    memcpy(new + idx, scopes, sizeof(Scope) * count);
+    memcpy(new + idx + count, old + idx, sizeof(Scope) * (old_count - idx));
+
+    block->data.block.scopes = new;
+    block->data.block.scope_count = old_count + count;
+
+    ScopeInsertion insertion = { .old = old, .old_count = old_count, .scopes = new, .idx = idx, .count = count };
+    Relocation relocation = { .relocate = scope_block_insert_relocate, .context = &insertion };
+    relocate_scope(&relocation, root);
+    allocator_free(old);
+}
+
 SourceFile source_file_parse(StringId path) {
     Lexer lexer = lexer_new(path);
-   
+    return source_file_parse_lexer(&lexer);
+}
+
+SourceFile source_file_parse_lexer(Lexer *lexer) {
     // Ignoring imports for now
 
     int decl_count = 0;
     int decl_count_alloc = 4;
-    Declaration *decls = malloc(sizeof(Declaration) * decl_count_alloc);
+    Declaration *decls = allocator_malloc(ALLOCATOR_PARSER, sizeof(Declaration) * decl_count_alloc);
+
+    while (lexer_token_peek(lexer).type != TOKEN_NULL) {
+        // A declaration that fails to parse is left out, and parsing goes on after the semicolon outside of any braces.
+        DiagnosticRecovery recovery;
+        diagnostics_recovery_push(&recovery);
+        if (setjmp(recovery.jump)) {
+            if (trace_enabled) trace_end(NULL);
+            if (!parser_synchronize(lexer, 0)) break;
+            continue;
+        }
+
+        bool exported = lexer_token_peek(lexer).type == TOKEN_KEYWORD_EXPORT;
+        if (exported) lexer_token_get(lexer);
 
-    while (lexer_token_peek(&lexer).type != TOKEN_NULL) {
-        Declaration decl = declaration_parse(&lexer);
-        if (lexer_token_get(&lexer).type != TOKEN_SEMICOLON) {
+        if (trace_enabled) trace_begin("parse declaration", NULL);
+        Declaration decl = declaration_parse(lexer);
+        decl.exported = exported;
+        if (lexer_token_peek(lexer).type == TOKEN_SEMICOLON) lexer_token_get(lexer);
+        else if (parser_line_ended(lexer, decl.location)) diagnostics_report(DIAGNOSTIC_ERROR, decl.location, "Expected a semicolon after a declaration.");
+        else {
+            declaration_free(&decl);
             error_exit(decl.location, "Expected a semicolon after a declaration.");
         }
+        diagnostics_recovery_pop(&recovery);
+        if (trace_enabled) trace_end(string_cache_get(decl.id));
         
         decl_count++;
         if (decl_count > decl_count_alloc) {
             decl_count_alloc = (int) ((float) decl_count_alloc * 1.5f);
-            decls = realloc(decls, sizeof(Declaration) * decl_count_alloc);
+            decls = allocator_realloc(ALLOCATOR_PARSER, decls, sizeof(Declaration) * decl_count_alloc);
         }
         decls[decl_count - 1] = decl;
     }
@@ -1499,7 +2311,7 @@ void source_file_free(SourceFile *file) {
     for (int i = 0; i < file->declaration_count; i++) {
         declaration_free(file->declarations + i);
     }
-    free(file->declarations);
+    allocator_free(file->declarations);
 }
 
 void source_file_print(SourceFile *file) {
@@ -17,7 +17,8 @@ typedef struct Type {
         TYPE_PTR,
         TYPE_PTR_NULLABLE,
         TYPE_ARRAY,
-        TYPE_FUNCTION
+        TYPE_FUNCTION,
+        TYPE_VECTOR
     } type;
 
     union {
@@ -35,6 +36,12 @@ typedef struct Type {
             int param_count;
             struct Type *result;
         } function;
+
+        // vec4 float is a SIMD vector of 4 floats. The width is a power of 2, and the lanes are numeric.
+        struct {
+            TokenType element;
+            int width;
+        } vector;
     } data;
 } Type;
 
@@ -49,6 +56,14 @@ void type_print(Type *type);
 void type_free(Type *type);
 bool type_equal(Type *lhs, Type *rhs);
 Type type_clone(Type *type);
+// Whether this is a struct declared with soa, whose arrays are stored member by member.
+bool type_is_soa(Type *type);
+// Whether this is the type of a file opened with file.open, which is read a chunk at a time.
+bool type_is_file(Type *type);
+// The width of a vector type written with this name, like 4 for vec4, or 0 if it isn't one.
+int type_vector_width(StringId id);
+// The type comparisons of a vector result in: as many lanes of signed integers of the same size, which are -1 where the comparison is true and 0 where it isn't.
+Type type_vector_mask(Type *vector);
 
 struct Scope;
 
@@ -68,6 +83,9 @@ typedef struct Expr {
         EXPR_LITERAL,
         EXPR_LITERAL_BOOL,
         EXPR_LITERAL_ARRAY,
+        EXPR_VECTOR,
+        EXPR_REGEX,
+        EXPR_FILE,
     } type;
 
     union {
@@ -94,6 +112,9 @@ typedef struct Expr {
         struct {
             Type type;
             struct Scope *scope; // has to be a ptr because Scope contains expressions.
+            bool is_inline; // Annotated with the inline keyword.
+            bool uses_arena; // Set by escape analysis if an array literal in the function is allocated in its per-call arena.
+            struct Declaration *param_declarations; // Created by the typechecker so identifiers can point to parameters. One per parameter.
         } function;
 
         struct {
@@ -115,6 +136,9 @@ typedef struct Expr {
         struct {
             struct Expr *operand;
             struct Expr *index;
+            Type item_type; // Set by the typechecker.
+            bool checked; // If the index is checked against the count of the array at runtime. Cleared where the index is known to be in bounds.
+            bool vector; // A lane of a vector instead of an item of an array. Set by the typechecker.
         } access_array;
 
         struct {
@@ -122,17 +146,60 @@ typedef struct Expr {
             struct Expr *count;
             struct Expr *members;
             Type type;
+            enum {
+                ARRAY_STORAGE_STACK, // Lives as long as the block it is in, or the whole program outside of functions.
+                ARRAY_STORAGE_ARENA, // Lives until the function it is in returns.
+                ARRAY_STORAGE_HEAP, // Lives forever.
+            } storage; // Set by escape analysis.
+            bool from_string; // The typechecker turns string literals into []char literals whose items are the chars of the string.
+            StringId string;
         } literal_array;
 
+        struct {
+            StringId declaration_id;
+            struct Declaration *declaration; // Set by the typechecker.
+        } id;
+
+        struct {
+            enum {
+                EXPR_VECTOR_BUILD, // vec4 float(a, b, c, d) has a value for every lane, and vec4 float(a) puts a in all of them.
+                EXPR_VECTOR_LOAD, // vec4 float(array, index) reads 4 items of the array starting at index.
+                EXPR_VECTOR_STORE, // v.store(array, index) writes the lanes of v to the array starting at index.
+                EXPR_VECTOR_SHUFFLE, // v.shuffle(3, 2, 1, 0) picks a lane of v for every lane of the result.
+                EXPR_VECTOR_TOTAL, // v.total, v.min and v.max reduce the lanes of v to one value.
+                EXPR_VECTOR_MIN,
+                EXPR_VECTOR_MAX,
+            } op; // The parser only creates builds. The typechecker turns them into loads, and the methods on vectors into the rest.
+            Type type; // The vector that is built or loaded, or the one the method is called on.
+            struct Expr *args; // A method has the vector it is called on as its first argument.
+            int arg_count;
+            bool checked; // If loads and stores check that all the items are in the array at runtime.
+        } vector;
+
+        struct {
+            enum {
+                EXPR_FILE_MAP, // file.map(path) maps the whole file into memory as a []uint8. Writes to it don't change the file.
+                EXPR_FILE_OPEN, // file.open(path) opens the file to be read a chunk at a time.
+                EXPR_FILE_NEXT, // f.next() reads the next chunk into the buffer of f and returns it, or an empty array at the end.
+                EXPR_FILE_CLOSE, // f.close() closes the file and frees its buffer.
+            } op; // The parser only creates maps and opens. The typechecker turns the methods on files into the rest.
+            struct Expr *args; // The path, or the file a method is called on.
+            int arg_count;
+        } file;
+
         Literal literal;
         bool literal_bool;
-        StringId id;
+        StringId regex; // regex "pattern" is a function that tells if a whole []char matches the pattern, compiled to a DFA.
     } data;
 } Expr;
 
 Expr expr_parse(Lexer *lexer);
 void expr_free(Expr *expr);
 void expr_print(Expr *expr, int indent);
+Expr expr_clone(Expr *expr);
+int expr_node_count(Expr *expr);
+int expr_call_count(Expr *expr); // Calls are the only expressions with side effects, so stores to memory like v.store(array, 0) count as one.
+int expr_uses(Expr *expr, struct Declaration *decl); // The number of identifiers referring to decl.
 
 typedef struct MemberStructUnion {
     Location location;
@@ -161,9 +228,12 @@ typedef struct Declaration {
     enum {
         DECLARATION_STATE_UNINITIALIZED,
         DECLARATION_STATE_INITIALIZING,
-        DECLARATION_STATE_INITIALIZED
+        DECLARATION_STATE_INITIALIZED,
+        DECLARATION_STATE_FAILED // An error was reported while initializing it, so whatever uses it is skipped.
     } state;
 
+    bool exported; // Top-level declarations marked with export are kept even if main doesn't use them.
+
     union {
         struct {
             enum {
@@ -189,6 +259,7 @@ typedef struct Declaration {
         struct {
             MemberStructUnion *members;
             int member_count;
+            bool soa; // Arrays of this struct store each member in an array of its own.
         } struct_union;
         
         struct {
@@ -206,6 +277,8 @@ typedef struct Declaration {
 Declaration declaration_parse(Lexer *lexer);
 void declaration_free(Declaration *decl);
 void declaration_print(Declaration *decl, int indent);
+int declaration_node_count(Declaration *decl);
+bool declaration_is_function(Declaration *decl);
 
 typedef struct Statement {
     Location location;
@@ -248,7 +321,8 @@ typedef struct MatchCase {
     Location location;
     StringId match_id;
     bool declares; // if the case creates a new variable
-    Statement declared_var; // id for created variable
+    Statement declared_var; // id for created variable, holding the value of the sum member.
+    int member; // Index of the sum member this case matches, set by the typechecker.
     int scope_count;
     struct Scope *scopes;
 } MatchCase;
@@ -277,6 +351,8 @@ typedef struct Scope {
             Expr expr;
             Statement step;
             struct Scope *scope;
+            bool parallel; // Iterations are split between threads. The counter starts at a value, is compared to a bound with < or <=, and counts up by a constant.
+            bool resets_arena; // The array literals the body puts in the arena of the function are dead after each iteration. Set by escape analysis.
         } loop_for;
         
         struct {
@@ -287,13 +363,18 @@ typedef struct Scope {
 
         struct {
             StringId element;
+            Declaration *element_declaration; // Created by the typechecker so identifiers can point to the element.
             Expr array;
             struct Scope *scope;
+            bool parallel;
+            bool file; // The bytes of a file are read a chunk at a time instead of iterating an array. Set by the typechecker.
+            bool resets_arena;
         } loop_for_each;
 
         struct {
             Expr expr;
             struct Scope *scope;
+            bool resets_arena;
         } loop_while;
 
         struct {
@@ -305,6 +386,7 @@ typedef struct Scope {
             Expr expr;
             int case_count;
             MatchCase *cases;
+            Declaration *sum; // The sum type being matched, set by the typechecker.
         } match;
     } data;
 } Scope;
@@ -312,6 +394,19 @@ typedef struct Scope {
 Scope scope_parse(Lexer *lexer);
 void scope_free(Scope *scope);
 void scope_print(Scope *scope, int indentation);
+int scope_node_count(Scope *scope);
+// Inserts count scopes into block at idx. Identifiers anywhere in root that refer to declarations in the block are kept pointing at them.
+void scope_block_insert(Scope *root, Scope *block, int idx, Scope *scopes, int count);
+
+// Calls relocate on every declaration pointer in identifiers and types, and replaces the pointer with the result.
+// Used to keep them valid after moving declarations.
+typedef struct Relocation {
+    void *(*relocate)(void *context, void *ptr);
+    void *context;
+} Relocation;
+
+void relocate_declaration(Relocation *relocation, Declaration *decl);
+void relocate_scope(Relocation *relocation, Scope *scope);
 
 typedef struct SourceFile {
     Declaration *declarations;
@@ -319,6 +414,8 @@ typedef struct SourceFile {
 } SourceFile;
 
 SourceFile source_file_parse(StringId path);
+// Parses the rest of the tokens of a lexer that was already made, so reading the file can be timed on its own.
+SourceFile source_file_parse_lexer(Lexer *lexer);
 void source_file_free(SourceFile *file);
 void source_file_print(SourceFile *file);
 #endif
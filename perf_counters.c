@@ -0,0 +1,138 @@
+#define _GNU_SOURCE // For syscall.
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.h"
+
+static const char *perf_counter_names[PERF_COUNTER_COUNT] = { "cycles", "instructions", "branch misses", "L1d misses", "LLC misses" };
+
+static int perf_fds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1, -1 };
+static bool perf_open;
+
+static struct {
+    bool ran;
+    double counts[PERF_COUNTER_COUNT];
+    double starts[PERF_COUNTER_COUNT];
+} perf_phases[TIMING_PHASE_COUNT];
+
+#ifdef __linux__
+
+static int perf_counter_open_one(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1; // Leaving out the kernel is what perf_event_paranoid 2 still allows.
+    attr.exclude_hv = 1;
+    // The times let a counter that shared the hardware with others be scaled up to the whole phase.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double perf_counter_read(int fd) {
+    uint64_t values[3]; // The count, the time enabled, and the time running.
+    if (read(fd, values, sizeof(values)) != sizeof(values)) return 0;
+    if (values[2] == 0) return 0;
+    return (double) values[0] * ((double) values[1] / values[2]);
+}
+
+bool perf_counters_open(FILE *outfile) {
+    static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    };
+    int errors[PERF_COUNTER_COUNT] = { 0 };
+    int error = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perf_fds[i] = perf_counter_open_one(events[i].type, events[i].config);
+        if (perf_fds[i] < 0) error = errors[i] = errno;
+        else perf_open = true;
+    }
+    if (!perf_open) {
+        fprintf(outfile, "Performance counters are not available: %s.", strerror(error));
+        if (error == EACCES || error == EPERM) fprintf(outfile, " Lowering /proc/sys/kernel/perf_event_paranoid may allow them.");
+        else if (error == ENOENT || error == ENODEV || error == EOPNOTSUPP) fprintf(outfile, " The processor, or the virtual machine, doesn't expose them.");
+        fprintf(outfile, " Compiling without them.\n");
+        return false;
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_fds[i] < 0) fprintf(outfile, "The %s counter is not available: %s.\n", perf_counter_names[i], strerror(errors[i]));
+    }
+    return true;
+}
+
+void perf_counters_close(void) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_fds[i] >= 0) close(perf_fds[i]);
+        perf_fds[i] = -1;
+    }
+    perf_open = false;
+}
+
+void perf_counters_begin(TimingPhase phase) {
+    if (!perf_open) return;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_fds[i] >= 0) perf_phases[phase].starts[i] = perf_counter_read(perf_fds[i]);
+    }
+}
+
+void perf_counters_end(TimingPhase phase) {
+    if (!perf_open) return;
+    perf_phases[phase].ran = true;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_fds[i] >= 0) perf_phases[phase].counts[i] += perf_counter_read(perf_fds[i]) - perf_phases[phase].starts[i];
+    }
+}
+
+#else
+
+bool perf_counters_open(FILE *outfile) {
+    fprintf(outfile, "Performance counters are only available on Linux. Compiling without them.\n");
+    return false;
+}
+
+void perf_counters_close(void) {}
+void perf_counters_begin(TimingPhase phase) { (void) phase; }
+void perf_counters_end(TimingPhase phase) { (void) phase; }
+
+#endif
+
+void perf_counters_report(TimingCounts *counts, FILE *outfile) {
+    if (!perf_open) return;
+    fprintf(outfile, "%-10s", "phase");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) fprintf(outfile, " %15s", perf_counter_names[i]);
+    fprintf(outfile, " %6s  %s\n", "IPC", "branch, L1d and LLC misses per unit");
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++) {
+        if (!perf_phases[i].ran) continue;
+        double *phase = perf_phases[i].counts;
+        fprintf(outfile, "%-10s", timing_phase_name(i));
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+            if (perf_fds[j] >= 0) fprintf(outfile, " %15.0f", phase[j]);
+            else fprintf(outfile, " %15s", "-");
+        }
+        if (perf_fds[PERF_COUNTER_CYCLES] >= 0 && perf_fds[PERF_COUNTER_INSTRUCTIONS] >= 0 && phase[PERF_COUNTER_CYCLES] > 0) {
+            fprintf(outfile, " %6.2f", phase[PERF_COUNTER_INSTRUCTIONS] / phase[PERF_COUNTER_CYCLES]);
+        } else fprintf(outfile, " %6s", "-");
+        const char *unit;
+        unsigned long long count = timing_phase_count(counts, i, &unit);
+        if (count > 0) {
+            fprintf(outfile, "  per %-6s", unit);
+            for (int j = PERF_COUNTER_BRANCH_MISSES; j < PERF_COUNTER_COUNT; j++) {
+                if (perf_fds[j] >= 0) fprintf(outfile, " %8.4f", phase[j] / count);
+                else fprintf(outfile, " %8s", "-");
+            }
+        }
+        fputc('\n', outfile);
+    }
+}
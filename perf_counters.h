@@ -0,0 +1,31 @@
+#ifndef CREED_PERF_COUNTERS_H
+#define CREED_PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "timing.h"
+
+typedef enum PerfCounter {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_L1D_MISSES, // Reads that miss the level 1 data cache.
+    PERF_COUNTER_LLC_MISSES, // Reads that miss the last level cache.
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+// Opens the hardware counters of this process with perf_event_open, counting user space only.
+// Counters the kernel or the processor don't allow are left out, and if none can be opened the reason is written to
+// outfile and false is returned. The compile goes on either way.
+// Once open, timing_begin and timing_end count each phase.
+bool perf_counters_open(FILE *outfile);
+void perf_counters_close(void);
+
+void perf_counters_begin(TimingPhase phase);
+void perf_counters_end(TimingPhase phase);
+
+// A table of the counters of every phase, with instructions per cycle and misses per unit for the phases that are counted.
+void perf_counters_report(TimingCounts *counts, FILE *outfile);
+
+#endif
@@ -1,8 +1,11 @@
 #include <assert.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "prelude.h"
+#include "diagnostics.h"
 
 void print_indent(int count) {
     for (int i = 0; i < count; i++) print("    ");
@@ -101,31 +104,48 @@ void print_literal_char(char c) {
     }
 }
 
-#define CMD_RED "\x1B[31m"
-#define CMD_GREEN "\x1B[32m"
-#define CMD_RESET "\x1B[0m"
-
+// Reports the error, then goes back to the innermost recovery point, or ends the compile if there is none.
 void error_exit(Location location, const char *error) {
+    diagnostics_report(DIAGNOSTIC_ERROR, location, error);
+    diagnostics_unwind();
+}
+
+#define REMARK_PASSES_MAX 16
+
+static const char *remark_passes[REMARK_PASSES_MAX];
+static int remark_pass_count = 0;
+
+// Passing "all" enables remarks for every pass.
+void remark_enable(const char *pass) {
+    if (remark_pass_count == REMARK_PASSES_MAX) return;
+    remark_passes[remark_pass_count] = pass;
+    remark_pass_count++;
+}
+
+bool remark_enabled(const char *pass) {
+    for (int i = 0; i < remark_pass_count; i++) {
+        if (!strcmp(remark_passes[i], pass) || !strcmp(remark_passes[i], "all")) return true;
+    }
+    return false;
+}
+
+// Remarks go to stderr so they don't get mixed up with the compiler output.
+void remark(Location location, const char *pass, const char *format, ...) {
+    if (!remark_enabled(pass)) return;
+    fprintf(stderr, "%s:%i: remark: ", string_cache_get(location.file_name), location.idx_line + 1);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, " [-Rpass=%s]\n", pass);
+}
 
-    printf("Error! %s\n%s:%i\n", error, string_cache_get(location.file_name), location.idx_line + 1);
-    
-    const char *file = string_cache_get(location.file_content);
-    int idx_start_line = location.idx_start;
-    while (idx_start_line > 0 && file[idx_start_line - 1] != '\n') idx_start_line--;
-    
-    putchar('\n');
-    print(CMD_GREEN);
-    fwrite(file + idx_start_line, sizeof(char), location.idx_start - idx_start_line, stdout);
-    
-    print(CMD_RED);
-    fwrite(file + location.idx_start, sizeof(char), location.idx_end - location.idx_start, stdout);
-    print(CMD_GREEN);
-    
-    int idx_end_line = location.idx_end;
-    while (file[idx_end_line] != '\n' && file[idx_end_line] != '\0') idx_end_line++;
-    
-    fwrite(file + location.idx_end, sizeof(char), idx_end_line - location.idx_end, stdout);
-    print(CMD_RESET"\n\n");
-    
-    exit(EXIT_SUCCESS);
+void remark_summary(const char *pass, const char *format, ...) {
+    if (!remark_enabled(pass)) return;
+    fputs("remark: ", stderr);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, " [-Rpass=%s]\n", pass);
 }
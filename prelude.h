@@ -2,6 +2,7 @@
 #define CREED_PRELUDE_H
 // This defines commonly used constructs throughout the compiler.
 
+#include <stdbool.h>
 #include "string_cache.h"
 
 void print_indent(int count);
@@ -58,4 +59,10 @@ void print(const char *str);
 void print_literal_char(char c);
 void error_exit(Location location, const char *error);
 
+// Optimization remarks, enabled per pass on the command line with -Rpass=<pass>.
+void remark_enable(const char *pass);
+bool remark_enabled(const char *pass);
+void remark(Location location, const char *pass, const char *format, ...);
+void remark_summary(const char *pass, const char *format, ...);
+
 #endif
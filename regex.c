@@ -0,0 +1,564 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "regex.h"
+
+#define REGEX_STATE_LIMIT 4096
+#define REGEX_REPEAT_LIMIT 255
+
+typedef struct RegexState {
+    enum {
+        REGEX_STATE_SET, // Moves to out on any byte in set.
+        REGEX_STATE_SPLIT, // Moves to both out and out_other without reading anything.
+        REGEX_STATE_EMPTY, // Moves to out without reading anything.
+        REGEX_STATE_MATCH,
+    } type;
+    unsigned char set[32];
+    int out;
+    int out_other;
+} RegexState;
+
+// A piece of the NFA that goes from start to end, where end is an empty state that isn't connected to anything yet.
+typedef struct RegexFragment {
+    int start;
+    int end;
+} RegexFragment;
+
+typedef struct RegexParser {
+    const char *pattern;
+    int idx;
+    Location location;
+    RegexState *states;
+    int state_count;
+    int state_count_alloc;
+} RegexParser;
+
+static void regex_set_add(unsigned char *set, int c) {
+    set[c >> 3] |= 1 << (c & 7);
+}
+
+static bool regex_set_has(const unsigned char *set, int c) {
+    return set[c >> 3] & (1 << (c & 7));
+}
+
+static void regex_set_add_range(unsigned char *set, int lo, int hi) {
+    for (int c = lo; c <= hi; c++) regex_set_add(set, c);
+}
+
+static int regex_state_new(RegexParser *parser, int type) {
+    parser->state_count++;
+    if (parser->state_count > parser->state_count_alloc) {
+        parser->state_count_alloc = parser->state_count_alloc == 0 ? 16 : parser->state_count_alloc * 2;
+        parser->states = allocator_realloc(ALLOCATOR_REGEX, parser->states, sizeof(RegexState) * parser->state_count_alloc);
+    }
+    RegexState *state = parser->states + parser->state_count - 1;
+    state->type = type;
+    memset(state->set, 0, sizeof(state->set));
+    state->out = -1;
+    state->out_other = -1;
+    if (parser->state_count > REGEX_STATE_LIMIT * 4) error_exit(parser->location, "This regex is too large.");
+    return parser->state_count - 1;
+}
+
+static RegexFragment regex_empty(RegexParser *parser) {
+    int state = regex_state_new(parser, REGEX_STATE_EMPTY);
+    return (RegexFragment) { state, state };
+}
+
+static RegexFragment regex_set(RegexParser *parser, const unsigned char *set) {
+    int start = regex_state_new(parser, REGEX_STATE_SET);
+    int end = regex_state_new(parser, REGEX_STATE_EMPTY);
+    memcpy(parser->states[start].set, set, sizeof(parser->states[start].set));
+    parser->states[start].out = end;
+    return (RegexFragment) { start, end };
+}
+
+static RegexFragment regex_concat(RegexParser *parser, RegexFragment first, RegexFragment second) {
+    parser->states[first.end].out = second.start;
+    return (RegexFragment) { first.start, second.end };
+}
+
+static RegexFragment regex_alternate(RegexParser *parser, RegexFragment first, RegexFragment second) {
+    int start = regex_state_new(parser, REGEX_STATE_SPLIT);
+    int end = regex_state_new(parser, REGEX_STATE_EMPTY);
+    parser->states[start].out = first.start;
+    parser->states[start].out_other = second.start;
+    parser->states[first.end].out = end;
+    parser->states[second.end].out = end;
+    return (RegexFragment) { start, end };
+}
+
+static RegexFragment regex_star(RegexParser *parser, RegexFragment fragment) {
+    int start = regex_state_new(parser, REGEX_STATE_SPLIT);
+    int end = regex_state_new(parser, REGEX_STATE_EMPTY);
+    parser->states[start].out = fragment.start;
+    parser->states[start].out_other = end;
+    parser->states[fragment.end].out = start;
+    return (RegexFragment) { start, end };
+}
+
+static RegexFragment regex_plus(RegexParser *parser, RegexFragment fragment) {
+    RegexFragment star = regex_star(parser, fragment);
+    return (RegexFragment) { fragment.start, star.end };
+}
+
+static RegexFragment regex_optional(RegexParser *parser, RegexFragment fragment) {
+    int start = regex_state_new(parser, REGEX_STATE_SPLIT);
+    int end = regex_state_new(parser, REGEX_STATE_EMPTY);
+    parser->states[start].out = fragment.start;
+    parser->states[start].out_other = end;
+    parser->states[fragment.end].out = end;
+    return (RegexFragment) { start, end };
+}
+
+// The states of a fragment are the ones from first up to last, so a copy of it is a copy of those states.
+static RegexFragment regex_copy(RegexParser *parser, int first, int last, RegexFragment fragment) {
+    int offset = parser->state_count - first;
+    for (int i = first; i < last; i++) {
+        int copy = regex_state_new(parser, REGEX_STATE_EMPTY);
+        parser->states[copy] = parser->states[i];
+        if (first <= parser->states[copy].out && parser->states[copy].out < last) parser->states[copy].out += offset;
+        if (first <= parser->states[copy].out_other && parser->states[copy].out_other < last) parser->states[copy].out_other += offset;
+    }
+    return (RegexFragment) { fragment.start + offset, fragment.end + offset };
+}
+
+// Adds the bytes of \d, \w, \s and their negations to set. Returns false for any other escape.
+static bool regex_escape_class(unsigned char *set, char escape) {
+    unsigned char class[32] = { 0 };
+    switch (escape) {
+        case 'd': case 'D':
+            regex_set_add_range(class, '0', '9');
+            break;
+        case 'w': case 'W':
+            regex_set_add_range(class, '0', '9');
+            regex_set_add_range(class, 'a', 'z');
+            regex_set_add_range(class, 'A', 'Z');
+            regex_set_add(class, '_');
+            break;
+        case 's': case 'S':
+            regex_set_add(class, ' ');
+            regex_set_add_range(class, '\t', '\r');
+            break;
+        default:
+            return false;
+    }
+    bool negate = escape == 'D' || escape == 'W' || escape == 'S';
+    for (int i = 0; i < 32; i++) set[i] |= negate ? ~class[i] : class[i];
+    return true;
+}
+
+// Reads the character after a backslash. Returns -1 if it was a class, which is added to set.
+static int regex_escape(RegexParser *parser, unsigned char *set) {
+    char escape = parser->pattern[parser->idx];
+    if (escape == '\0') error_exit(parser->location, "This regex ends in a backslash that does not escape anything.");
+    parser->idx++;
+    if (regex_escape_class(set, escape)) return -1;
+    switch (escape) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+    }
+    if (('a' <= escape && escape <= 'z') || ('A' <= escape && escape <= 'Z') || ('0' <= escape && escape <= '9')) {
+        error_exit(parser->location, "This regex has an escape sequence that does not exist. Only punctuation can be escaped to match itself.");
+    }
+    return (unsigned char) escape;
+}
+
+static void regex_parse_class(RegexParser *parser, unsigned char *set) {
+    parser->idx++;
+    bool negate = parser->pattern[parser->idx] == '^';
+    if (negate) parser->idx++;
+    bool first = true;
+    while (first || parser->pattern[parser->idx] != ']') {
+        first = false;
+        if (parser->pattern[parser->idx] == '\0') error_exit(parser->location, "Expected a ] at the end of a character class in this regex.");
+        int lo = (unsigned char) parser->pattern[parser->idx++];
+        if (lo == '\\' && (lo = regex_escape(parser, set)) < 0) continue;
+        if (parser->pattern[parser->idx] != '-' || parser->pattern[parser->idx + 1] == ']' || parser->pattern[parser->idx + 1] == '\0') {
+            regex_set_add(set, lo);
+            continue;
+        }
+        parser->idx++;
+        int hi = (unsigned char) parser->pattern[parser->idx++];
+        if (hi == '\\' && (hi = regex_escape(parser, set)) < 0) error_exit(parser->location, "A range in a character class of a regex can not end in a class like \\d.");
+        if (hi < lo) error_exit(parser->location, "A range in a character class of a regex has to go from the lower character to the higher one.");
+        regex_set_add_range(set, lo, hi);
+    }
+    parser->idx++;
+    if (negate) {
+        for (int i = 0; i < 32; i++) set[i] = ~set[i];
+    }
+}
+
+static RegexFragment regex_parse_alternatives(RegexParser *parser);
+
+static RegexFragment regex_parse_atom(RegexParser *parser) {
+    unsigned char set[32] = { 0 };
+    char c = parser->pattern[parser->idx];
+    switch (c) {
+        case '(': {
+            parser->idx++;
+            RegexFragment group = regex_parse_alternatives(parser);
+            if (parser->pattern[parser->idx] != ')') error_exit(parser->location, "Expected a ) at the end of a group in this regex.");
+            parser->idx++;
+            return group;
+        }
+        case '[':
+            regex_parse_class(parser, set);
+            return regex_set(parser, set);
+        case '.':
+            parser->idx++;
+            regex_set_add_range(set, 0, 255);
+            set['\n' >> 3] &= ~(1 << ('\n' & 7));
+            return regex_set(parser, set);
+        case '\\': {
+            parser->idx++;
+            int escaped = regex_escape(parser, set);
+            if (escaped >= 0) regex_set_add(set, escaped);
+            return regex_set(parser, set);
+        }
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            error_exit(parser->location, "This regex repeats nothing. Escape the character with a backslash to match it.");
+            break;
+        case '^':
+        case '$':
+            error_exit(parser->location, "A regex always matches the whole string, so it has no ^ or $. Escape the character with a backslash to match it.");
+            break;
+    }
+    parser->idx++;
+    regex_set_add(set, (unsigned char) c);
+    return regex_set(parser, set);
+}
+
+static int regex_parse_count(RegexParser *parser) {
+    const char *digits = parser->pattern + parser->idx;
+    if (*digits < '0' || '9' < *digits) return -1;
+    int count = 0;
+    while ('0' <= parser->pattern[parser->idx] && parser->pattern[parser->idx] <= '9') {
+        count = count * 10 + parser->pattern[parser->idx++] - '0';
+        if (count > REGEX_REPEAT_LIMIT) error_exit(parser->location, "A regex can repeat something at most 255 times.");
+    }
+    return count;
+}
+
+static RegexFragment regex_parse_repeat(RegexParser *parser) {
+    int first = parser->state_count;
+    RegexFragment fragment = regex_parse_atom(parser);
+    while (true) {
+        switch (parser->pattern[parser->idx]) {
+            case '*':
+                parser->idx++;
+                fragment = regex_star(parser, fragment);
+                continue;
+            case '+':
+                parser->idx++;
+                fragment = regex_plus(parser, fragment);
+                continue;
+            case '?':
+                parser->idx++;
+                fragment = regex_optional(parser, fragment);
+                continue;
+            case '{': {
+                parser->idx++;
+                int min = regex_parse_count(parser);
+                int max = min;
+                if (parser->pattern[parser->idx] == ',') {
+                    parser->idx++;
+                    max = parser->pattern[parser->idx] == '}' ? -1 : regex_parse_count(parser);
+                    if (max == -1 && parser->pattern[parser->idx] != '}') min = -1;
+                }
+                if (min < 0 || parser->pattern[parser->idx] != '}') error_exit(parser->location, "Expected a count like {2}, {2,} or {2,5} in this regex.");
+                if (max >= 0 && max < min) error_exit(parser->location, "The most times something is repeated in this regex is less than the least.");
+                parser->idx++;
+
+                // The fragment is copied once for every time it is repeated, and the original is left unconnected.
+                RegexFragment original = fragment;
+                int end = parser->state_count;
+                fragment = regex_empty(parser);
+                for (int i = 0; i < min; i++) fragment = regex_concat(parser, fragment, regex_copy(parser, first, end, original));
+                if (max < 0) fragment = regex_concat(parser, fragment, regex_star(parser, regex_copy(parser, first, end, original)));
+                for (int i = min; i < max; i++) fragment = regex_concat(parser, fragment, regex_optional(parser, regex_copy(parser, first, end, original)));
+                first = end;
+                continue;
+            }
+        }
+        return fragment;
+    }
+}
+
+static RegexFragment regex_parse_sequence(RegexParser *parser) {
+    RegexFragment fragment = regex_empty(parser);
+    while (parser->pattern[parser->idx] != '\0' && parser->pattern[parser->idx] != '|' && parser->pattern[parser->idx] != ')') {
+        fragment = regex_concat(parser, fragment, regex_parse_repeat(parser));
+    }
+    return fragment;
+}
+
+static RegexFragment regex_parse_alternatives(RegexParser *parser) {
+    RegexFragment fragment = regex_parse_sequence(parser);
+    while (parser->pattern[parser->idx] == '|') {
+        parser->idx++;
+        fragment = regex_alternate(parser, fragment, regex_parse_sequence(parser));
+    }
+    return fragment;
+}
+
+// Sets of NFA states are bitsets of words words.
+typedef struct RegexSubsets {
+    RegexState *states;
+    int words;
+    unsigned long long *sets;
+    int count;
+    int count_alloc;
+    int *table; // Open addressing hash table of indices into sets, -1 where empty.
+    int table_size;
+    int *stack;
+} RegexSubsets;
+
+static unsigned long long *regex_subset(RegexSubsets *subsets, int idx) {
+    return subsets->sets + (size_t) idx * subsets->words;
+}
+
+static unsigned long long regex_subset_hash(RegexSubsets *subsets, unsigned long long *set) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (int i = 0; i < subsets->words; i++) hash = (hash ^ set[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Adds every state that can be reached from set without reading anything. Only states that read or match are kept,
+// since the others are only ways to get to those.
+static void regex_closure(RegexSubsets *subsets, unsigned long long *set, unsigned long long *visited) {
+    int words = subsets->words;
+    int top = 0;
+    memset(visited, 0, sizeof(unsigned long long) * words);
+    for (int i = 0; i < words * 64; i++) {
+        if (set[i / 64] & (1ull << (i % 64))) subsets->stack[top++] = i;
+    }
+    memset(set, 0, sizeof(unsigned long long) * words);
+    while (top > 0) {
+        int state = subsets->stack[--top];
+        if (state < 0 || visited[state / 64] & (1ull << (state % 64))) continue;
+        visited[state / 64] |= 1ull << (state % 64);
+        RegexState *nfa = subsets->states + state;
+        if (nfa->type == REGEX_STATE_SET || nfa->type == REGEX_STATE_MATCH) set[state / 64] |= 1ull << (state % 64);
+        if (nfa->type == REGEX_STATE_SPLIT || nfa->type == REGEX_STATE_EMPTY) subsets->stack[top++] = nfa->out;
+        if (nfa->type == REGEX_STATE_SPLIT) subsets->stack[top++] = nfa->out_other;
+    }
+}
+
+// Returns the index of the DFA state for a set of NFA states, adding it if it is new.
+static int regex_subset_find(RegexSubsets *subsets, unsigned long long *set, Location location) {
+    size_t words = subsets->words;
+    if (subsets->count * 2 >= subsets->table_size) {
+        subsets->table_size = subsets->table_size == 0 ? 64 : subsets->table_size * 2;
+        allocator_free(subsets->table);
+        subsets->table = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * subsets->table_size);
+        for (int i = 0; i < subsets->table_size; i++) subsets->table[i] = -1;
+        for (int i = 0; i < subsets->count; i++) {
+            int slot = (int) (regex_subset_hash(subsets, regex_subset(subsets, i)) & (subsets->table_size - 1));
+            while (subsets->table[slot] >= 0) slot = (slot + 1) & (subsets->table_size - 1);
+            subsets->table[slot] = i;
+        }
+    }
+    int slot = (int) (regex_subset_hash(subsets, set) & (subsets->table_size - 1));
+    while (subsets->table[slot] >= 0) {
+        if (!memcmp(regex_subset(subsets, subsets->table[slot]), set, sizeof(unsigned long long) * words)) return subsets->table[slot];
+        slot = (slot + 1) & (subsets->table_size - 1);
+    }
+
+    if (subsets->count == REGEX_STATE_LIMIT) error_exit(location, "This regex needs too many states to be matched by a table.");
+    subsets->count++;
+    if (subsets->count > subsets->count_alloc) {
+        subsets->count_alloc = subsets->count_alloc == 0 ? 16 : subsets->count_alloc * 2;
+        subsets->sets = allocator_realloc(ALLOCATOR_REGEX, subsets->sets, sizeof(unsigned long long) * words * subsets->count_alloc);
+    }
+    memcpy(regex_subset(subsets, subsets->count - 1), set, sizeof(unsigned long long) * words);
+    subsets->table[slot] = subsets->count - 1;
+    return subsets->count - 1;
+}
+
+// The signatures of the states while minimizing, for the comparison function of qsort.
+static int *regex_signatures;
+static int regex_signature_length;
+
+static int regex_signature_compare(const void *lhs, const void *rhs) {
+    const int *a = regex_signatures + (size_t) *(const int *) lhs * regex_signature_length;
+    const int *b = regex_signatures + (size_t) *(const int *) rhs * regex_signature_length;
+    for (int i = 0; i < regex_signature_length; i++) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// Moore's algorithm: states start out split into accepting and not, and groups are split by which groups their transitions go to
+// until no group splits any more. Every group is then one state.
+static void regex_minimize(RegexDfa *dfa) {
+    int count = dfa->state_count;
+    int classes = dfa->class_count;
+    int *group = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * count);
+    int *order = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * count);
+    regex_signature_length = classes + 1;
+    regex_signatures = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * (size_t) count * regex_signature_length);
+    for (int i = 0; i < count; i++) group[i] = dfa->accepting[i];
+
+    int group_count = 0;
+    while (true) {
+        for (int i = 0; i < count; i++) {
+            int *signature = regex_signatures + (size_t) i * regex_signature_length;
+            signature[0] = group[i];
+            for (int c = 0; c < classes; c++) signature[c + 1] = group[dfa->next[i * classes + c]];
+            order[i] = i;
+        }
+        qsort(order, count, sizeof(int), regex_signature_compare);
+        int new_count = 0;
+        for (int i = 0; i < count; i++) {
+            if (i > 0 && regex_signature_compare(order + i - 1, order + i) != 0) new_count++;
+            group[order[i]] = new_count;
+        }
+        new_count++;
+        if (new_count == group_count) break;
+        group_count = new_count;
+    }
+
+    int *next = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * group_count * classes);
+    bool *accepting = allocator_malloc(ALLOCATOR_REGEX, sizeof(bool) * group_count);
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < classes; c++) next[group[i] * classes + c] = group[dfa->next[i * classes + c]];
+        accepting[group[i]] = dfa->accepting[i];
+    }
+    dfa->start = group[dfa->start];
+    dfa->state_count = group_count;
+    allocator_free(dfa->next);
+    allocator_free(dfa->accepting);
+    dfa->next = next;
+    dfa->accepting = accepting;
+
+    dfa->dead = -1;
+    for (int i = 0; i < group_count && dfa->dead < 0; i++) {
+        bool dead = !accepting[i];
+        for (int c = 0; c < classes; c++) dead = dead && next[i * classes + c] == i;
+        if (dead) dfa->dead = i;
+    }
+
+    allocator_free(group);
+    allocator_free(order);
+    allocator_free(regex_signatures);
+    regex_signatures = NULL;
+}
+
+RegexDfa regex_compile(const char *pattern, Location location) {
+    RegexParser parser = { .pattern = pattern, .idx = 0, .location = location, .states = NULL, .state_count = 0, .state_count_alloc = 0 };
+    RegexFragment fragment = regex_parse_alternatives(&parser);
+    if (pattern[parser.idx] == ')') error_exit(location, "This regex has a ) without a ( before it.");
+    int match = regex_state_new(&parser, REGEX_STATE_MATCH);
+    parser.states[fragment.end].out = match;
+
+    // Bytes are in the same class if every set of the NFA either has both or neither.
+    RegexDfa dfa = { .class_count = 1, .dead = -1 };
+    memset(dfa.classes, 0, sizeof(dfa.classes));
+    for (int i = 0; i < parser.state_count; i++) {
+        if (parser.states[i].type != REGEX_STATE_SET) continue;
+        int split[256][2];
+        int class_count = 0;
+        for (int c = 0; c < 256; c++) split[c][0] = split[c][1] = -1;
+        for (int c = 0; c < 256; c++) {
+            int *class = &split[dfa.classes[c]][regex_set_has(parser.states[i].set, c)];
+            if (*class < 0) *class = class_count++;
+            dfa.classes[c] = *class;
+        }
+        dfa.class_count = class_count;
+    }
+    int representatives[256];
+    for (int c = 255; c >= 0; c--) representatives[dfa.classes[c]] = c;
+
+    // Subset construction, where every DFA state is the set of NFA states that could be active.
+    RegexSubsets subsets = { .states = parser.states, .words = (parser.state_count + 63) / 64 };
+    subsets.stack = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * (parser.state_count * 2 + 64 * subsets.words));
+    unsigned long long *set = allocator_calloc(ALLOCATOR_REGEX, subsets.words, sizeof(unsigned long long));
+    unsigned long long *visited = allocator_malloc(ALLOCATOR_REGEX, sizeof(unsigned long long) * subsets.words);
+    set[fragment.start / 64] |= 1ull << (fragment.start % 64);
+    regex_closure(&subsets, set, visited);
+    dfa.start = regex_subset_find(&subsets, set, location);
+
+    int next_alloc = 0;
+    for (int state = 0; state < subsets.count; state++) {
+        for (int c = 0; c < dfa.class_count; c++) {
+            memset(set, 0, sizeof(unsigned long long) * subsets.words);
+            unsigned long long *current = regex_subset(&subsets, state);
+            for (int i = 0; i < parser.state_count; i++) {
+                if (!(current[i / 64] & (1ull << (i % 64))) || parser.states[i].type != REGEX_STATE_SET) continue;
+                if (regex_set_has(parser.states[i].set, representatives[c])) set[parser.states[i].out / 64] |= 1ull << (parser.states[i].out % 64);
+            }
+            regex_closure(&subsets, set, visited);
+            int target = regex_subset_find(&subsets, set, location);
+            if ((state + 1) * dfa.class_count > next_alloc) {
+                next_alloc = next_alloc == 0 ? 16 * dfa.class_count : next_alloc * 2;
+                dfa.next = allocator_realloc(ALLOCATOR_REGEX, dfa.next, sizeof(int) * next_alloc);
+            }
+            dfa.next[state * dfa.class_count + c] = target;
+        }
+    }
+    dfa.state_count = subsets.count;
+    dfa.accepting = allocator_malloc(ALLOCATOR_REGEX, sizeof(bool) * dfa.state_count);
+    for (int state = 0; state < dfa.state_count; state++) {
+        dfa.accepting[state] = regex_subset(&subsets, state)[match / 64] & (1ull << (match % 64));
+    }
+
+    allocator_free(set);
+    allocator_free(visited);
+    allocator_free(subsets.sets);
+    allocator_free(subsets.table);
+    allocator_free(subsets.stack);
+    allocator_free(parser.states);
+
+    regex_minimize(&dfa);
+    return dfa;
+}
+
+void regex_free(RegexDfa *dfa) {
+    allocator_free(dfa->next);
+    allocator_free(dfa->accepting);
+}
+
+static void regex_write_row(const char *indent, int *values, int stride, int count, FILE *outfile) {
+    fprintf(outfile, "%s", indent);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) fprintf(outfile, i % 16 == 0 ? ",\n%s" : ", ", indent);
+        fprintf(outfile, "%i", values[i * stride]);
+    }
+}
+
+void regex_write_matcher(RegexDfa *dfa, const char *name, const char *array_type, FILE *outfile) {
+    int classes[256];
+    for (int c = 0; c < 256; c++) classes[c] = dfa->classes[c];
+    int *accepting = allocator_malloc(ALLOCATOR_REGEX, sizeof(int) * dfa->state_count);
+    for (int i = 0; i < dfa->state_count; i++) accepting[i] = dfa->accepting[i];
+
+    fprintf(outfile, "static int %s(%s text) {\n", name, array_type);
+    fprintf(outfile, "    static const unsigned char classes[256] = {\n");
+    regex_write_row("        ", classes, 1, 256, outfile);
+    fprintf(outfile, "\n    };\n");
+    fprintf(outfile, "    static const unsigned %s next[%i][%i] = {\n", dfa->state_count <= 256 ? "char" : "short", dfa->state_count, dfa->class_count);
+    for (int i = 0; i < dfa->state_count; i++) {
+        fprintf(outfile, "        {\n");
+        regex_write_row("            ", dfa->next + i * dfa->class_count, 1, dfa->class_count, outfile);
+        fprintf(outfile, "\n        },\n");
+    }
+    fprintf(outfile, "    };\n");
+    fprintf(outfile, "    static const unsigned char accepting[%i] = {\n", dfa->state_count);
+    regex_write_row("        ", accepting, 1, dfa->state_count, outfile);
+    fprintf(outfile, "\n    };\n");
+    fprintf(outfile, "    unsigned int state = %i;\n", dfa->start);
+    fprintf(outfile, "    for (unsigned long long i = 0; i < text.count; i++) {\n");
+    fprintf(outfile, "        state = next[state][classes[(unsigned char) text.data[i]]];\n");
+    if (dfa->dead >= 0) fprintf(outfile, "        if (state == %i) return 0;\n", dfa->dead);
+    fprintf(outfile, "    }\n");
+    fprintf(outfile, "    return accepting[state];\n");
+    fprintf(outfile, "}\n\n");
+    allocator_free(accepting);
+}
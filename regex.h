@@ -0,0 +1,31 @@
+#ifndef CREED_REGEX_H
+#define CREED_REGEX_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "prelude.h"
+
+// A deterministic automaton that tells if a whole string matches a regular expression, built while the program is compiled.
+// Bytes that the pattern never tells apart share a class, so the table has a column per class instead of one per byte.
+typedef struct RegexDfa {
+    unsigned char classes[256];
+    int class_count;
+    int state_count;
+    int start;
+    int dead; // The state that can never reach an accepting one, or -1 if there is none.
+    int *next; // The state after each state and class, state_count rows of class_count.
+    bool *accepting;
+} RegexDfa;
+
+// Patterns are made of characters, . for any character but a newline, classes like [a-z_] and [^0-9], the escapes \d \w \s
+// and their negations \D \W \S, groups, alternatives with |, and repetition with *, +, ?, {m}, {m,} and {m,n}.
+// A pattern always matches the whole string, so there is no ^ or $. Errors are reported at location.
+// The automaton is determinized from a Thompson NFA and then minimized.
+RegexDfa regex_compile(const char *pattern, Location location);
+void regex_free(RegexDfa *dfa);
+
+// Writes a C function with this name that takes an array of chars and returns 1 if all of it matches, without allocating.
+void regex_write_matcher(RegexDfa *dfa, const char *name, const char *array_type, FILE *outfile);
+
+#endif
@@ -1,10 +1,11 @@
 #include <math.h>
 #include <stdlib.h>
+#include "allocator.h"
 #include "string_builder.h"
 
 
 StringBuilder string_builder_new(void) {
-    char *str = malloc(sizeof(char) * STRING_BUILDER_INITIAL_SIZE);
+    char *str = allocator_malloc(ALLOCATOR_STRING_BUILDER, sizeof(char) * STRING_BUILDER_INITIAL_SIZE);
     str[0] = '\0';
     return (StringBuilder) {
         .alloc_length = STRING_BUILDER_INITIAL_SIZE,
@@ -17,7 +18,7 @@ void string_builder_add_char(StringBuilder *builder, char c) {
     int required_size = builder->length + 2;
     if (required_size > builder->alloc_length) {
         builder->alloc_length = (int) ceilf(required_size * STRING_BUILDER_SIZE_INCREASE);
-        builder->raw = realloc(builder->raw, builder->alloc_length * sizeof(char));
+        builder->raw = allocator_realloc(ALLOCATOR_STRING_BUILDER, builder->raw, builder->alloc_length * sizeof(char));
     }
     builder->raw[builder->length] = c;
     builder->length++;
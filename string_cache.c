@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "allocator.h"
 #include "string_cache.h"
+#include "trace.h"
 
 // This is a very naive implementation for now.
 
@@ -32,19 +34,36 @@ static char **strings;
 static int strings_length = 0;
 static int strings_length_alloc = STRINGS_LENGTH_DEFAULT;
 
+static int *free_slots;
+static int free_slot_count = 0;
+static int free_slot_count_alloc = 0;
+
 void string_cache_init(void) {
-    strings = malloc(sizeof(char *) * STRINGS_LENGTH_DEFAULT);
+    strings = allocator_malloc(ALLOCATOR_STRING_CACHE, sizeof(char *) * STRINGS_LENGTH_DEFAULT);
     // default lengths are initialized above.
 }
 
 void string_cache_free(void) {
     for (int i = 0; i < STRING_TABLE_LENGTH; i++) {
         for (int j = 0; j < string_table[i].node_count; j++) {
-            free(string_table[i].nodes[j].string);
+            allocator_free(string_table[i].nodes[j].string);
         }
-        free(string_table[i].nodes);
+        allocator_free(string_table[i].nodes);
+    }
+    allocator_free(strings);
+    allocator_free(free_slots);
+}
+
+static StringId string_id_new(char *string) {
+    StringId id = { .idx = strings_length};
+    strings_length++;
+    if (strings_length > strings_length_alloc) {
+        strings_length_alloc = (int) (strings_length_alloc * STRINGS_REALLOC_MULTIPLIER);
+        strings = allocator_realloc(ALLOCATOR_STRING_CACHE, strings, strings_length_alloc * sizeof(char *));
+        if (trace_enabled) trace_counter("string cache", "capacity", strings_length_alloc);
     }
-    free(strings);
+    strings[id.idx] = string;
+    return id;
 }
 
 // the string cache takes ownership of the string (It is responsible for freeing it.) Don't pass literal strings into this!
@@ -55,24 +74,17 @@ StringId string_cache_insert(char *string) {
     
     for (int i = 0; i < string_table[idx].node_count; i++) {
         if (string_table[idx].nodes[i].hash == hash && !strcmp(string_table[idx].nodes[i].string, string)) {
-            free(string);
+            allocator_free(string);
             return string_table[idx].nodes[i].id;
         }
     }
 
     // insert the string into the StringId -> char* array;
-    StringId id = { .idx = strings_length};
-    strings_length++;
-    if (strings_length > strings_length_alloc) {
-        strings_length_alloc = (int) (strings_length_alloc * STRINGS_REALLOC_MULTIPLIER);
-        strings = realloc(strings, strings_length_alloc * sizeof(char *));
-    }
-
-    strings[id.idx] = string;
+    StringId id = string_id_new(string);
     
     // insert the string into the hashtable
     string_table[idx].node_count++;
-    string_table[idx].nodes = realloc(string_table[idx].nodes, sizeof(StringNode) * string_table[idx].node_count);
+    string_table[idx].nodes = allocator_realloc(ALLOCATOR_STRING_CACHE, string_table[idx].nodes, sizeof(StringNode) * string_table[idx].node_count);
     string_table[idx].nodes[string_table[idx].node_count - 1] = (StringNode) {
         .string = string,
         .hash = hash,
@@ -84,7 +96,7 @@ StringId string_cache_insert(char *string) {
 }
 
 StringId string_cache_insert_static(const char *string) {
-    char *string_copy = malloc(sizeof(char) * (strlen(string) + 1));
+    char *string_copy = allocator_malloc(ALLOCATOR_STRING_CACHE, sizeof(char) * (strlen(string) + 1));
     strcpy(string_copy, string);
     return string_cache_insert(string_copy);
 }
@@ -92,3 +104,19 @@ StringId string_cache_insert_static(const char *string) {
 char *string_cache_get(StringId id) {
     return strings[id.idx];
 }
+
+StringId string_cache_slot_new(char *string) {
+    if (free_slot_count == 0) return string_id_new(string);
+    StringId id = { .idx = free_slots[--free_slot_count] };
+    strings[id.idx] = string;
+    return id;
+}
+
+void string_cache_slot_release(StringId id) {
+    if (free_slot_count == free_slot_count_alloc) {
+        free_slot_count_alloc = free_slot_count_alloc ? free_slot_count_alloc * 2 : 16;
+        free_slots = allocator_realloc(ALLOCATOR_STRING_CACHE, free_slots, sizeof(int) * free_slot_count_alloc);
+    }
+    strings[id.idx] = NULL;
+    free_slots[free_slot_count++] = id.idx;
+}
@@ -11,4 +11,9 @@ StringId string_cache_insert(char *string);
 StringId string_cache_insert_static(const char *string);
 char *string_cache_get(StringId id);
 
+// Slots are ids whose string belongs to whoever made them. They are never found by their string,
+// so strings that are replaced often can be given an id without adding to the cache. Released slots are reused.
+StringId string_cache_slot_new(char *string);
+void string_cache_slot_release(StringId id);
+
 #endif
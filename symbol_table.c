@@ -1,10 +1,17 @@
 #include <assert.h>
+#include <setjmp.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator.h"
+#include "constant.h"
+#include "diagnostics.h"
 #include "lexer.h"
 #include "parser.h"
+#include "regex.h"
+#include "string_cache.h"
 #include "symbol_table.h"
+#include "trace.h"
 
 void expr_result_free(ExprResult *result) {
     type_free(&result->type);
@@ -13,11 +20,12 @@ void expr_result_free(ExprResult *result) {
 void symbol_table_new(SymbolTable *out, SymbolTable *previous) {
     memset(&out->nodes, 0, sizeof(SymbolTableNode) * SYMBOL_TABLE_NODE_COUNT);
     out->previous = previous;
+    out->parallel = NULL;
 }
 
 void symbol_table_free(SymbolTable *table) {
     for (int i = 0; i < SYMBOL_TABLE_NODE_COUNT; i++) {
-        free(table->nodes[i].declarations);
+        allocator_free(table->nodes[i].declarations);
     }
 }
 
@@ -35,7 +43,7 @@ bool symbol_table_insert(SymbolTable *table, Declaration *decl) {
             table->nodes[idx].declaration_count_alloc *= 2;
         }
         
-        table->nodes[idx].declarations = realloc(table->nodes[idx].declarations, sizeof(Declaration *) * table->nodes[idx].declaration_count_alloc);
+        table->nodes[idx].declarations = allocator_realloc(ALLOCATOR_TYPECHECK, table->nodes[idx].declarations, sizeof(Declaration *) * table->nodes[idx].declaration_count_alloc);
     }
 
     table->nodes[idx].declarations[table->nodes[idx].declaration_count - 1] = decl;
@@ -57,12 +65,15 @@ Declaration *symbol_table_get(SymbolTable *table, StringId id) {
 void symbol_table_resolve_type(SymbolTable *table, Type *type) {
     switch (type->type) {
         case TYPE_PRIMITIVE:
+        case TYPE_VECTOR:
             break;
 
         case TYPE_ID: {
             Declaration *decl = symbol_table_get(table, type->data.id.type_declaration_id);
             if (!decl) error_exit(type->location, "This type does not exist in the current scope.");
             if (decl->type == DECLARATION_VAR) error_exit(type->location, "This is the name of a variable, not a type.");
+            // Its members may not be resolved, and why was already reported.
+            if (decl->state == DECLARATION_STATE_FAILED) diagnostics_unwind();
             type->data.id.type_declaration = decl;
         } break;
 
@@ -82,7 +93,9 @@ void symbol_table_resolve_type(SymbolTable *table, Type *type) {
     }
 }
 
-static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl) {
+static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl);
+
+static void symbol_table_declaration_init_recoverable(SymbolTable *table, Declaration *decl) {
     int decl_state = decl->state;
     decl->state = DECLARATION_STATE_INITIALIZING;
 
@@ -92,6 +105,26 @@ static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl)
                 case DECLARATION_VAR: {
                     switch (decl->data.var.type) {
                         case DECLARATION_VAR_CONSTANT: {
+                            Expr *value = &decl->data.var.data.constant.value;
+                            if (value->type == EXPR_FUNCTION) {
+                                // The type of a function is known from its signature, so mark it as initialized before checking its body.
+                                // This lets functions call themselves and each other.
+                                symbol_table_resolve_type(table, &value->data.function.type);
+                                if (decl->data.var.data.constant.type_explicit) {
+                                    symbol_table_resolve_type(table, &decl->data.var.data.constant.type); 
+                                    if (!type_equal(&value->data.function.type, &decl->data.var.data.constant.type)) {
+                                        error_exit(decl->location, "The type of this constant and its assigned expression are not the same.");
+                                    }
+                                } else {
+                                    decl->data.var.data.constant.type = type_clone(&value->data.function.type);
+                                }
+                                decl->state = DECLARATION_STATE_INITIALIZED;
+                                
+                                ExprResult result = symbol_table_check_expr(table, value);
+                                expr_result_free(&result);
+                                break;
+                            }
+
                             ExprResult result = symbol_table_check_expr(table, &decl->data.var.data.constant.value);
                             if (result.state != EXPR_RESULT_CONSTANT) error_exit(decl->location, "The value of a constant must itself be derivable from constants.");
                             
@@ -136,6 +169,10 @@ static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl)
                                 error_exit(decl->location, "This struct contains duplicate members.");
                             }
                         }
+                        // The arrays of each member are stored next to the count of the array.
+                        if (decl->data.struct_union.soa && !strcmp(string_cache_get(member_id), "count")) {
+                            error_exit(decl->data.struct_union.members[i].location, "A struct declared with soa cannot have a member named count.");
+                        }
 
                         symbol_table_resolve_type(table, &decl->data.struct_union.members[i].type);
                         
@@ -148,7 +185,19 @@ static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl)
                 } break;
 
                 case DECLARATION_SUM: {
-                    error_exit(decl->location, "Sum types are currently not supported.");
+                    for (int i = 0; i < decl->data.sum.member_count; i++) {
+                        MemberSum *member = decl->data.sum.members + i;
+                        for (int j = 0; j < i; j++) {
+                            if (decl->data.sum.members[j].id.idx == member->id.idx) error_exit(decl->location, "This sum type contains duplicate members.");
+                        }
+                        if (!member->type_exists) continue;
+
+                        symbol_table_resolve_type(table, &member->type);
+                        if (member->type.type == TYPE_PRIMITIVE && member->type.data.primitive == TOKEN_KEYWORD_TYPE_VOID) {
+                            error_exit(member->type.location, "A sum member without a value is written without a type.");
+                        }
+                        if (member->type.type == TYPE_ID) symbol_table_declaration_init(table, member->type.data.id.type_declaration);
+                    }
                 } break;
             } break;
 
@@ -162,13 +211,392 @@ static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl)
     decl->state = DECLARATION_STATE_INITIALIZED;
 }
 
-ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
+// The table the declaration was inserted in, or NULL if it isn't in one yet.
+static SymbolTable *symbol_table_owner(SymbolTable *table, Declaration *decl) {
+    int idx = decl->id.idx % SYMBOL_TABLE_NODE_COUNT;
+    for (; table; table = table->previous) {
+        for (int i = 0; i < table->nodes[idx].declaration_count; i++) {
+            if (table->nodes[idx].declarations[i] == decl) return table;
+        }
+    }
+    return NULL;
+}
+
+// Every use of an identifier comes through here, so initialized declarations return before setting up a recovery point.
+// A declaration that fails is marked, and the error goes on to whatever uses it without being reported again.
+static void symbol_table_declaration_init(SymbolTable *table, Declaration *decl) {
+    if (decl->state == DECLARATION_STATE_INITIALIZED) return;
+    if (decl->state == DECLARATION_STATE_FAILED) diagnostics_unwind();
+    // A global first used inside a function is checked in the scope it was declared in, not the function's.
+    SymbolTable *owner = symbol_table_owner(table, decl);
+    if (owner) table = owner;
+
+    DiagnosticRecovery recovery;
+    diagnostics_recovery_push(&recovery);
+    if (setjmp(recovery.jump)) {
+        if (decl->state == DECLARATION_STATE_INITIALIZING) decl->state = DECLARATION_STATE_FAILED;
+        diagnostics_unwind();
+    }
+    symbol_table_declaration_init_recoverable(table, decl);
+    diagnostics_recovery_pop(&recovery);
+}
+
+static bool symbol_table_is_integer(Type *type) {
+    return type->type == TYPE_PRIMITIVE && TOKEN_KEYWORD_TYPE_INTEGER_MIN <= type->data.primitive && type->data.primitive <= TOKEN_KEYWORD_TYPE_INTEGER_MAX;
+}
+
+// The index of a lane has to be known at compile time, since SIMD instructions take it as an immediate.
+static int symbol_table_vector_lane(SymbolTable *table, Expr *index, int width) {
+    ExprResult result = symbol_table_check_expr(table, index);
+    if (!symbol_table_is_integer(&result.type) || !constant_is_folded(index)) error_exit(index->location, "The lane of a vector must be a constant integer.");
+    expr_result_free(&result);
+    unsigned long long lane = literal_get_bits(&index->data.literal);
+    if (lane >= (unsigned long long) width) error_exit(index->location, "This vector does not have a lane with this index.");
+    return (int) lane;
+}
+
+// Operators work on every lane of a vector at once. The other operand is a vector of the same type, or a scalar of the lane type that is used for every lane.
+static ExprResult symbol_table_check_vector_binary(Expr *expr, ExprResult *lhs, ExprResult *rhs) {
+    Type vector = lhs->type.type == TYPE_VECTOR ? lhs->type : rhs->type;
+    Type element = { .type = TYPE_PRIMITIVE, .data.primitive = vector.data.vector.element };
+    for (ExprResult *operand = lhs; operand; operand = operand == lhs ? rhs : NULL) {
+        if (!type_equal(&operand->type, &vector) && !type_equal(&operand->type, &element)) {
+            error_exit(expr->location, "The other operand of an operation on a vector must be a vector of the same type, or a value of the type of its lanes.");
+        }
+    }
+    TokenType primitive = vector.data.vector.element;
+    bool integer = TOKEN_KEYWORD_TYPE_INTEGER_MIN <= primitive && primitive <= TOKEN_KEYWORD_TYPE_INTEGER_MAX;
+    switch (expr->data.binary.operator) {
+        case TOKEN_OP_LOGICAL_AND:
+        case TOKEN_OP_LOGICAL_OR:
+            error_exit(expr->location, "Vectors have no logical operators. Use the bitwise operators on the result of a comparison instead.");
+            break;
+
+        case TOKEN_OP_GE:
+        case TOKEN_OP_LE:
+        case TOKEN_OP_GT:
+        case TOKEN_OP_LT:
+        case TOKEN_OP_EQ:
+        case TOKEN_OP_NE:
+            vector = type_vector_mask(&vector);
+            break;
+
+        case TOKEN_OP_SHIFT_LEFT:
+        case TOKEN_OP_SHIFT_RIGHT:
+            if (lhs->type.type != TYPE_VECTOR) error_exit(expr->location, "Only a vector can be shifted by a vector.");
+            if (primitive < TOKEN_KEYWORD_TYPE_UINT_MIN || TOKEN_KEYWORD_TYPE_UINT_MAX < primitive) {
+                error_exit(expr->location, "The lanes of a shifted vector must be of an unsigned integer type.");
+            }
+            break;
+
+        case TOKEN_OP_BITWISE_AND:
+        case TOKEN_OP_BITWISE_OR:
+        case TOKEN_OP_BITWISE_XOR:
+        case TOKEN_OP_MODULO:
+            if (!integer) error_exit(expr->location, "The lanes of the operands of this operator must be of an integer type.");
+            break;
+
+        case TOKEN_OP_PLUS:
+        case TOKEN_OP_MINUS:
+        case TOKEN_OP_MULTIPLY:
+        case TOKEN_OP_DIVIDE:
+            break;
+
+        default:
+            error_exit(expr->location, "Typechecking this binary operator is not implemented yet.");
+    }
+    expr_result_free(lhs);
+    expr_result_free(rhs);
+    return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = vector };
+}
+
+static ExprResult symbol_table_check_vector(SymbolTable *table, Expr *expr) {
+    Type vector = expr->data.vector.type;
+    Type element = { .type = TYPE_PRIMITIVE, .data.primitive = vector.data.vector.element };
+    int width = vector.data.vector.width;
+    Expr *args = expr->data.vector.args;
+    int arg_count = expr->data.vector.arg_count;
+
+    switch (expr->data.vector.op) {
+        case EXPR_VECTOR_BUILD:
+        case EXPR_VECTOR_LOAD: {
+            ExprResult first = symbol_table_check_expr(table, args);
+            if (first.type.type == TYPE_ARRAY) {
+                if (arg_count != 2) error_exit(expr->location, "A vector is loaded from an array and the index of its first item.");
+                if (!type_equal(first.type.data.sub_type, &element)) error_exit(args[0].location, "The items of this array are not of the type of the lanes of the vector.");
+                ExprResult index = symbol_table_check_expr(table, args + 1);
+                if (!symbol_table_is_integer(&index.type)) error_exit(args[1].location, "The index of a vector load must be of an integer type.");
+                expr_result_free(&index);
+                expr->data.vector.op = EXPR_VECTOR_LOAD;
+            } else {
+                if (arg_count != 1 && arg_count != width) {
+                    error_exit(expr->location, "A vector is built from a value for every lane, one value for all of them, or an array and an index to load them from.");
+                }
+                if (!type_equal(&first.type, &element)) error_exit(args[0].location, "This value is not of the type of the lanes of the vector.");
+                for (int i = 1; i < arg_count; i++) {
+                    ExprResult lane = symbol_table_check_expr(table, args + i);
+                    if (!type_equal(&lane.type, &element)) error_exit(args[i].location, "This value is not of the type of the lanes of the vector.");
+                    expr_result_free(&lane);
+                }
+            }
+            expr_result_free(&first);
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = vector };
+        }
+
+        case EXPR_VECTOR_STORE: {
+            if (arg_count != 3) error_exit(expr->location, "A vector is stored to an array at the index of its first item.");
+            ExprResult array = symbol_table_check_expr(table, args + 1);
+            if (array.type.type != TYPE_ARRAY || !type_equal(array.type.data.sub_type, &element)) {
+                error_exit(args[1].location, "A vector can only be stored to an array with items of the type of its lanes.");
+            }
+            expr_result_free(&array);
+            ExprResult index = symbol_table_check_expr(table, args + 2);
+            if (!symbol_table_is_integer(&index.type)) error_exit(args[2].location, "The index of a vector store must be of an integer type.");
+            expr_result_free(&index);
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_VOID } };
+        }
+
+        case EXPR_VECTOR_SHUFFLE:
+            if (arg_count - 1 != width) error_exit(expr->location, "A shuffle needs the index of a lane of the vector for every lane of the result.");
+            for (int i = 1; i < arg_count; i++) symbol_table_vector_lane(table, args + i, width);
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = vector };
+
+        case EXPR_VECTOR_TOTAL:
+        case EXPR_VECTOR_MIN:
+        case EXPR_VECTOR_MAX:
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = element };
+    }
+    assert(false);
+    return (ExprResult) { 0 };
+}
+
+// Calls of the methods of vectors become vector expressions. The vector has already been typechecked.
+static void symbol_table_vector_method(Expr *expr, Expr *vector, Type *type, int op, Expr *params, int param_count) {
+    Expr *args = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Expr) * (param_count + 1));
+    args[0] = *vector;
+    for (int i = 0; i < param_count; i++) args[i + 1] = params[i];
+    *expr = (Expr) {
+        .location = expr->location,
+        .type = EXPR_VECTOR,
+        .data.vector = { .op = op, .type = *type, .args = args, .arg_count = param_count + 1, .checked = true }
+    };
+}
+
+// The bytes of files are read as arrays of uint8, and their paths are arrays of chars.
+static Type symbol_table_array_of(TokenType primitive, Location location) {
+    Type *item = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
+    *item = (Type) { .location = location, .type = TYPE_PRIMITIVE, .data.primitive = primitive };
+    return (Type) { .location = location, .type = TYPE_ARRAY, .data.sub_type = item };
+}
+
+static ExprResult symbol_table_check_file(SymbolTable *table, Expr *expr) {
+    Expr *args = expr->data.file.args;
+    switch (expr->data.file.op) {
+        case EXPR_FILE_MAP:
+        case EXPR_FILE_OPEN: {
+            ExprResult path = symbol_table_check_expr(table, args);
+            Type path_type = symbol_table_array_of(TOKEN_KEYWORD_TYPE_CHAR, args->location);
+            if (!type_equal(&path.type, &path_type)) error_exit(args->location, "The path of a file must be a []char.");
+            type_free(&path_type);
+            expr_result_free(&path);
+            if (expr->data.file.op == EXPR_FILE_MAP) return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = symbol_table_array_of(TOKEN_KEYWORD_TYPE_UINT8, expr->location) };
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = { .location = expr->location, .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_FILE } };
+        }
+
+        case EXPR_FILE_NEXT:
+            if (expr->data.file.arg_count != 1) error_exit(expr->location, "The next method of files takes no arguments.");
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = symbol_table_array_of(TOKEN_KEYWORD_TYPE_UINT8, expr->location) };
+
+        case EXPR_FILE_CLOSE:
+            if (expr->data.file.arg_count != 1) error_exit(expr->location, "The close method of files takes no arguments.");
+            return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_VOID } };
+    }
+    assert(false);
+    return (ExprResult) { 0 };
+}
+
+// The variables declared outside of a parallel loop that its body adds to. Each is added to a copy per thread,
+// and the copies are added to the variable once the loop is done.
+typedef struct SymbolTableParallel {
+    Declaration *counter; // The counter of a parallel for loop, which only the loop itself can change.
+    Declaration **reductions;
+    int *reduction_adds; // The number of += statements on each reduction.
+    int reduction_count;
+} SymbolTableParallel;
+
+static bool symbol_table_contains(SymbolTable *table, Declaration *decl) {
+    SymbolTableNode *node = table->nodes + decl->id.idx % SYMBOL_TABLE_NODE_COUNT;
+    for (int i = 0; i < node->declaration_count; i++) {
+        if (node->declarations[i] == decl) return true;
+    }
+    return false;
+}
+
+// Returns the table of the innermost parallel loop around this table that decl was declared outside of, or NULL.
+static SymbolTable *symbol_table_parallel_outside(SymbolTable *table, Declaration *decl) {
+    for (; table; table = table->previous) {
+        if (symbol_table_contains(table, decl)) return NULL;
+        if (table->parallel) return table;
+    }
+    return NULL;
+}
+
+static bool symbol_table_in_parallel(SymbolTable *table) {
+    for (; table; table = table->previous) {
+        if (table->parallel) return true;
+    }
+    return false;
+}
+
+// Returns the variable an lval is stored in, or NULL if it is stored in memory an array or pointer points to.
+// Sets type to the type of the lval when it is known.
+static Declaration *symbol_table_lval_variable(Expr *expr, Type **type) {
+    switch (expr->type) {
+        case EXPR_PAREN:
+            return symbol_table_lval_variable(expr->data.parenthesized, type);
+        case EXPR_ID: {
+            Declaration *decl = expr->data.id.declaration;
+            if (!decl || decl->type != DECLARATION_VAR) return NULL;
+            *type = decl->data.var.type == DECLARATION_VAR_MUTABLE ? &decl->data.var.data.mutable.type : &decl->data.var.data.constant.type;
+            return decl;
+        }
+        case EXPR_ACCESS_MEMBER: {
+            Declaration *decl = symbol_table_lval_variable(expr->data.access_member.operand, type);
+            if (!decl || !*type || (*type)->type != TYPE_ID) return NULL;
+            Declaration *complex = (*type)->data.id.type_declaration;
+            *type = NULL;
+            if (complex->type != DECLARATION_STRUCT && complex->type != DECLARATION_UNION) return decl;
+            for (int i = 0; i < complex->data.struct_union.member_count; i++) {
+                if (complex->data.struct_union.members[i].id.idx == expr->data.access_member.member.idx) *type = &complex->data.struct_union.members[i].type;
+            }
+            return decl;
+        }
+        case EXPR_ACCESS_ARRAY:
+            // Lanes are part of the vector, items of arrays are not part of the array.
+            if (!expr->data.access_array.vector) return NULL;
+            Declaration *decl = symbol_table_lval_variable(expr->data.access_array.operand, type);
+            *type = NULL;
+            return decl;
+        default:
+            return NULL;
+    }
+}
+
+// Iterations of a parallel loop run at the same time, so the only variables declared outside of it that they can change are
+// the ones they add to, which every thread has its own copy of. Those copies are also the only way they can use them.
+static void symbol_table_parallel_write(SymbolTable *table, Statement *statement, Expr *assignee) {
+    Type *type = NULL;
+    Declaration *decl = symbol_table_lval_variable(assignee, &type);
+    if (!decl) return;
+    while (assignee->type == EXPR_PAREN) assignee = assignee->data.parenthesized;
+    bool add = statement->type == STATEMENT_ASSIGN && statement->data.assign.type == TOKEN_ASSIGN_PLUS && assignee->type == EXPR_ID;
+
+    // A variable added to in a loop inside another parallel loop is added to by that one as well, once the inner loop is done.
+    for (SymbolTable *outside = symbol_table_parallel_outside(table, decl); outside; outside = symbol_table_parallel_outside(outside->previous, decl)) {
+        SymbolTableParallel *parallel = outside->parallel;
+        if (decl == parallel->counter) error_exit(statement->location, "The counter of a parallel for loop is only changed by the loop.");
+        if (!add) error_exit(statement->location, "Iterations of a parallel loop run at the same time, so the only way they can change a variable declared outside of it is by adding to it with +=.");
+        if (type->type != TYPE_VECTOR && (type->type != TYPE_PRIMITIVE || type->data.primitive < TOKEN_KEYWORD_TYPE_NUMERIC_MIN || TOKEN_KEYWORD_TYPE_NUMERIC_MAX < type->data.primitive)) {
+            error_exit(statement->location, "Only numbers and vectors declared outside of a parallel loop can be added to in it.");
+        }
+
+        int idx = 0;
+        while (idx < parallel->reduction_count && parallel->reductions[idx] != decl) idx++;
+        if (idx == parallel->reduction_count) {
+            parallel->reduction_count++;
+            parallel->reductions = allocator_realloc(ALLOCATOR_TYPECHECK, parallel->reductions, sizeof(Declaration *) * parallel->reduction_count);
+            parallel->reduction_adds = allocator_realloc(ALLOCATOR_TYPECHECK, parallel->reduction_adds, sizeof(int) * parallel->reduction_count);
+            parallel->reductions[idx] = decl;
+            parallel->reduction_adds[idx] = 0;
+        }
+        parallel->reduction_adds[idx]++;
+    }
+}
+
+typedef struct SymbolTableUses {
+    Declaration *decl;
+    int count;
+} SymbolTableUses;
+
+static void *symbol_table_uses_visit(void *context, void *ptr) {
+    SymbolTableUses *uses = context;
+    if (ptr == uses->decl) uses->count++;
+    return ptr;
+}
+
+// A parallel for loop is split into ranges of iterations before it runs, so its counter has to count up by a constant to a bound.
+// The bound is computed once, before the loop.
+static Declaration *symbol_table_parallel_counter(Scope *scope) {
+    Statement *init = &scope->data.loop_for.init;
+    Declaration *counter = &init->data.declaration;
+    if (init->type != STATEMENT_DECLARATION || counter->type != DECLARATION_VAR || counter->data.var.type != DECLARATION_VAR_MUTABLE
+            || !counter->data.var.data.mutable.value_exists || !symbol_table_is_integer(&counter->data.var.data.mutable.type)) {
+        error_exit(init->location, "The counter of a parallel for loop must be declared with an integer type and a starting value.");
+    }
+
+    Expr *condition = &scope->data.loop_for.expr;
+    while (condition->type == EXPR_PAREN) condition = condition->data.parenthesized;
+    Expr *lhs = condition->type == EXPR_BINARY ? condition->data.binary.lhs : NULL;
+    while (lhs && lhs->type == EXPR_PAREN) lhs = lhs->data.parenthesized;
+    if (!lhs || (condition->data.binary.operator != TOKEN_OP_LT && condition->data.binary.operator != TOKEN_OP_LE)
+            || lhs->type != EXPR_ID || lhs->data.id.declaration != counter || expr_uses(condition->data.binary.rhs, counter) > 0) {
+        error_exit(scope->data.loop_for.expr.location, "The condition of a parallel for loop must compare its counter to a bound with < or <=.");
+    }
+
+    Statement *step = &scope->data.loop_for.step;
+    Expr *stepped = step->type == STATEMENT_INCREMENT ? &step->data.increment : step->type == STATEMENT_ASSIGN ? &step->data.assign.assignee : NULL;
+    while (stepped && stepped->type == EXPR_PAREN) stepped = stepped->data.parenthesized;
+    bool by_one = step->type == STATEMENT_INCREMENT;
+    bool by_constant = step->type == STATEMENT_ASSIGN && step->data.assign.type == TOKEN_ASSIGN_PLUS && constant_is_folded(&step->data.assign.value)
+        && (long long) literal_get_bits(&step->data.assign.value.data.literal) > 0;
+    if (!stepped || stepped->type != EXPR_ID || stepped->data.id.declaration != counter || !(by_one || by_constant)) {
+        error_exit(step->location, "The step of a parallel for loop must be ++ or += a positive constant on its counter.");
+    }
+    return counter;
+}
+
+// Checks the body of a parallel loop in table, which has to be a new table around only the body and the declarations made for each iteration.
+static void symbol_table_check_parallel(SymbolTable *table, Scope *body, Declaration *counter, Type *return_type) {
+    SymbolTableParallel parallel = { .counter = counter, .reductions = NULL, .reduction_adds = NULL, .reduction_count = 0 };
+    table->parallel = &parallel;
+    if (body->type == SCOPE_BLOCK) {
+        for (int i = 0; i < body->data.block.scope_count; i++) {
+            symbol_table_check_scope(table, body->data.block.scopes + i, return_type);
+        }
+    } else {
+        symbol_table_check_scope(table, body, return_type);
+    }
+
+    for (int i = 0; i < parallel.reduction_count; i++) {
+        SymbolTableUses uses = { .decl = parallel.reductions[i], .count = 0 };
+        Relocation relocation = { .relocate = symbol_table_uses_visit, .context = &uses };
+        relocate_scope(&relocation, body);
+        if (uses.count != parallel.reduction_adds[i]) {
+            error_exit(body->location, "A variable declared outside of a parallel loop that is added to in it can not be used in it in any other way, since every thread adds to its own copy.");
+        }
+    }
+    allocator_free(parallel.reductions);
+    allocator_free(parallel.reduction_adds);
+    table->parallel = NULL;
+}
+
+static ExprResult symbol_table_check_expr_unfolded(SymbolTable *table, Expr *expr) {
     switch (expr->type) {
         case EXPR_PAREN:
             return symbol_table_check_expr(table, expr->data.parenthesized);
         case EXPR_UNARY: {
             ExprResult result = symbol_table_check_expr(table, expr->data.unary.operand);
-            if (result.type.type != TYPE_PRIMITIVE) {
+            bool pointer_operator = expr->data.unary.type == EXPR_UNARY_REF || expr->data.unary.type == EXPR_UNARY_DEREF;
+            if (result.type.type == TYPE_VECTOR && !pointer_operator) {
+                TokenType primitive = result.type.data.vector.element;
+                if (expr->data.unary.type == EXPR_UNARY_LOGICAL_NOT) error_exit(expr->location, "Vectors cannot be negated logically. Use ~ on the result of a comparison instead.");
+                if (expr->data.unary.type == EXPR_UNARY_BITWISE_NOT && (primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN || TOKEN_KEYWORD_TYPE_INTEGER_MAX < primitive)) {
+                    error_exit(expr->location, "The lanes of the operand of a bitwise not expression must be of an integer type.");
+                }
+                result.state = EXPR_RESULT_RVAL;
+                return result;
+            }
+            if (result.type.type != TYPE_PRIMITIVE && !pointer_operator) {
                 error_exit(expr->location, "The operand of a unary expression must have a primitive type.");
             }
             switch (expr->data.unary.type) {
@@ -186,8 +614,18 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     if (result.state != EXPR_RESULT_LVAL) {
                         error_exit(expr->location, "The operand of a reference must be an lval.");
                     }
+                    Expr *ref_operand = expr->data.unary.operand;
+                    while (ref_operand->type == EXPR_PAREN) ref_operand = ref_operand->data.parenthesized;
+                    if (ref_operand->type == EXPR_ACCESS_ARRAY && type_is_soa(&result.type)) {
+                        error_exit(expr->location, "The items of an array of a struct declared with soa are stored member by member, so they have no address.");
+                    }
+                    Type *ref_type = NULL;
+                    Declaration *ref_variable = symbol_table_lval_variable(ref_operand, &ref_type);
+                    if (ref_variable && symbol_table_parallel_outside(table, ref_variable)) {
+                        error_exit(expr->location, "A parallel loop works on copies of the variables declared outside of it, so it can not take their address.");
+                    }
 
-                    Type *sub_type = malloc(sizeof(Type));
+                    Type *sub_type = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
                     *sub_type = result.type;
 
                     return (ExprResult) {
@@ -212,7 +650,13 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     expr_result_free(&result);
                     return deref_result;
 
-                case EXPR_UNARY_NEGATE: // TODO: what is this operator?
+                case EXPR_UNARY_NEGATE:
+                    if (result.type.data.primitive < TOKEN_KEYWORD_TYPE_NUMERIC_MIN || TOKEN_KEYWORD_TYPE_NUMERIC_MAX < result.type.data.primitive) {
+                        error_exit(expr->location, "The operand of a negation must have a numeric type.");
+                    }
+                    if (result.state == EXPR_RESULT_LVAL) result.state = EXPR_RESULT_RVAL;
+                    return result;
+
                 default: 
                     error_exit(expr->location, "Typechecking this unary operator is not implemented yet.");
             }
@@ -221,6 +665,7 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
         case EXPR_BINARY: { // unfinished
             ExprResult result_lhs = symbol_table_check_expr(table, expr->data.binary.lhs);
             ExprResult result_rhs = symbol_table_check_expr(table, expr->data.binary.rhs);
+            if (result_lhs.type.type == TYPE_VECTOR || result_rhs.type.type == TYPE_VECTOR) return symbol_table_check_vector_binary(expr, &result_lhs, &result_rhs);
             
             if (result_lhs.type.type != TYPE_PRIMITIVE || result_rhs.type.type != TYPE_PRIMITIVE) {
                 error_exit(expr->location, "The operands of a binary expression must both be of a primitive type.");
@@ -291,6 +736,20 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     result_lhs.state = state;
                     return result_lhs;
 
+                case TOKEN_OP_BITWISE_AND:
+                case TOKEN_OP_BITWISE_OR:
+                case TOKEN_OP_BITWISE_XOR:
+                    if (result_lhs.type.data.primitive != result_rhs.type.data.primitive) {
+                        error_exit(expr->location, "The operands of a bitwise expression must be of the same type.");
+                    }
+                    if (result_lhs.type.data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN || TOKEN_KEYWORD_TYPE_INTEGER_MAX < result_lhs.type.data.primitive) {
+                        error_exit(expr->location, "The operands of a bitwise expression must be of an integer type.");
+                    }
+
+                    expr_result_free(&result_rhs);
+                    result_lhs.state = state;
+                    return result_lhs;
+
                 case TOKEN_OP_MODULO:
                     if (result_lhs.type.data.primitive != result_rhs.type.data.primitive) {
                         error_exit(expr->location, "The operands of a modulo expression must be of the same type.");
@@ -336,6 +795,13 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     if (expr->data.typecast.cast_to.type != TYPE_PTR) error_exit(expr->location, "Pointers can only be cast to other pointer types.");
                     break;
 
+                case TYPE_VECTOR:
+                    // Every lane is converted like its value would be.
+                    if (expr->data.typecast.cast_to.type != TYPE_VECTOR || expr->data.typecast.cast_to.data.vector.width != result.type.data.vector.width) {
+                        error_exit(expr->location, "Vectors can only be cast to other vectors with as many lanes.");
+                    }
+                    break;
+
                 case TYPE_ARRAY:
                 case TYPE_ID:
                 case TYPE_FUNCTION: // You actually might want to be able to cast a function pointer.
@@ -352,9 +818,66 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
         } break;
 
         case EXPR_ACCESS_MEMBER: {
+            // A member of a sum type is created with Sum.member, or Sum.member(value) if it holds a value.
+            Expr *operand = expr->data.access_member.operand;
+            Declaration *sum = operand->type == EXPR_ID ? symbol_table_get(table, operand->data.id.declaration_id) : NULL;
+            if (sum && sum->type == DECLARATION_SUM) {
+                symbol_table_declaration_init(table, sum);
+                operand->data.id.declaration = sum;
+                for (int i = 0; i < sum->data.sum.member_count; i++) {
+                    MemberSum *member = sum->data.sum.members + i;
+                    if (member->id.idx != expr->data.access_member.member.idx) continue;
+
+                    Type sum_type = { .location = expr->location, .type = TYPE_ID, .data.id = { .type_declaration_id = sum->id, .type_declaration = sum } };
+                    if (!member->type_exists) return (ExprResult) { .state = EXPR_RESULT_RVAL, .type = sum_type };
+
+                    // Members that hold a value are functions from the value to the sum.
+                    FunctionParameter *param = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(FunctionParameter));
+                    *param = (FunctionParameter) { .location = member->location, .id = member->id, .type = type_clone(&member->type) };
+                    Type *result = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
+                    *result = sum_type;
+                    return (ExprResult) {
+                        .state = EXPR_RESULT_RVAL,
+                        .type = { .location = expr->location, .type = TYPE_FUNCTION, .data.function = { .params = param, .param_count = 1, .result = result } }
+                    };
+                }
+                error_exit(expr->location, "This sum type does not have a member with this name.");
+            }
+
             ExprResult result = symbol_table_check_expr(table, expr->data.access_member.operand);
+            if (type_is_file(&result.type)) error_exit(expr->location, "Files only have the methods next and close, which have to be called.");
+            if (result.type.type == TYPE_VECTOR) {
+                const char *member = string_cache_get(expr->data.access_member.member);
+                int op;
+                if (!strcmp(member, "total")) op = EXPR_VECTOR_TOTAL;
+                else if (!strcmp(member, "min")) op = EXPR_VECTOR_MIN;
+                else if (!strcmp(member, "max")) op = EXPR_VECTOR_MAX;
+                else if (!strcmp(member, "store") || !strcmp(member, "shuffle")) error_exit(expr->location, "This method of vectors has to be called.");
+                else error_exit(expr->location, "Vectors only have the members total, min and max, and the methods store and shuffle.");
+                Expr *operand = expr->data.access_member.operand;
+                symbol_table_vector_method(expr, operand, &result.type, op, NULL, 0);
+                allocator_free(operand);
+                return symbol_table_check_vector(table, expr);
+            }
+            if (result.type.type == TYPE_ARRAY) {
+                // Arrays are a count and a pointer to their first item. Neither can be assigned to.
+                ExprResult member;
+                if (!strcmp(string_cache_get(expr->data.access_member.member), "count")) {
+                    member.type = (Type) { .location = expr->location, .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_UINT64 };
+                } else if (!strcmp(string_cache_get(expr->data.access_member.member), "data")) {
+                    if (type_is_soa(result.type.data.sub_type)) error_exit(expr->location, "Arrays of a struct declared with soa have an array per member instead of data.");
+                    member.type = (Type) { .location = expr->location, .type = TYPE_PTR, .data.sub_type = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type)) };
+                    *member.type.data.sub_type = type_clone(result.type.data.sub_type);
+                } else {
+                    error_exit(expr->location, "Arrays only have the members count and data.");
+                }
+                member.state = EXPR_RESULT_RVAL;
+                expr_result_free(&result);
+                return member;
+            }
+
             Type *sub_type = &result.type;
-            while (sub_type->type == TYPE_PTR || sub_type->type == TYPE_PTR_NULLABLE || sub_type->type == TYPE_ARRAY) {
+            while (sub_type->type == TYPE_PTR || sub_type->type == TYPE_PTR_NULLABLE) {
                 sub_type = sub_type->data.sub_type;
             }
 
@@ -378,11 +901,20 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                             if (result.state == EXPR_RESULT_CONSTANT) state = EXPR_RESULT_CONSTANT;
                             else if (result.state == EXPR_RESULT_LVAL
                                     || result.type.type == TYPE_PTR 
-                                    || result.type.type == TYPE_PTR_NULLABLE 
-                                    || result.type.type == TYPE_ARRAY) 
+                                    || result.type.type == TYPE_PTR_NULLABLE) 
                                     state = EXPR_RESULT_LVAL;
                             else state = EXPR_RESULT_RVAL;
 
+                            // C needs the pointers dereferenced, so the operand becomes (*operand).
+                            for (Type *pointer = &result.type; pointer->type == TYPE_PTR || pointer->type == TYPE_PTR_NULLABLE; pointer = pointer->data.sub_type) {
+                                Expr *operand = expr->data.access_member.operand;
+                                Expr *deref = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Expr));
+                                *deref = (Expr) { .location = operand->location, .type = EXPR_UNARY, .data.unary = { .type = EXPR_UNARY_DEREF, .operand = operand } };
+                                Expr *paren = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Expr));
+                                *paren = (Expr) { .location = operand->location, .type = EXPR_PAREN, .data.parenthesized = deref };
+                                expr->data.access_member.operand = paren;
+                            }
+
                             ExprResult member = {
                                 .state = state,
                                 .type = type_clone(&decl->data.struct_union.members[i].type)
@@ -395,26 +927,45 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     break;
 
                 case DECLARATION_SUM: 
-                    error_exit(expr->location, "We haven't decided what to do if you try to directly access the member of a sum type yet.");
+                    error_exit(expr->location, "The members of a sum type can only be accessed with a match statement.");
                     break;
             }
         } break;
         
         case EXPR_ACCESS_ARRAY: {
-            error_exit(expr->location, "Array access expressions are currently not implemented.");
-            /*
             ExprResult operand_result = symbol_table_check_expr(table, expr->data.access_array.operand);
+            if (operand_result.type.type == TYPE_VECTOR) {
+                // A lane of a vector. Its index is checked here, so there is nothing to check at runtime.
+                symbol_table_vector_lane(table, expr->data.access_array.index, operand_result.type.data.vector.width);
+                type_free(&expr->data.access_array.item_type);
+                expr->data.access_array.item_type = (Type) { .type = TYPE_PRIMITIVE, .data.primitive = operand_result.type.data.vector.element };
+                expr->data.access_array.checked = false;
+                expr->data.access_array.vector = true;
+                return (ExprResult) {
+                    .type = expr->data.access_array.item_type,
+                    .state = operand_result.state == EXPR_RESULT_LVAL ? EXPR_RESULT_LVAL : EXPR_RESULT_RVAL
+                };
+            }
             if (operand_result.type.type != TYPE_ARRAY) {
                 error_exit(expr->location, "The operand of this array access is not an array.");
             }
+            ExprResult index_result = symbol_table_check_expr(table, expr->data.access_array.index);
+            if (index_result.type.type != TYPE_PRIMITIVE 
+                    || index_result.type.data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN 
+                    || TOKEN_KEYWORD_TYPE_INTEGER_MAX < index_result.type.data.primitive) {
+                error_exit(expr->data.access_array.index->location, "The index of an array access must be of an integer type.");
+            }
+            expr_result_free(&index_result);
             
+            // An array is a view of memory that lives somewhere else, so its items can be assigned to even if the array itself is an rval.
             ExprResult item = {
                 .type = type_clone(operand_result.type.data.sub_type),
-                .state = operand_result.state == EXPR_RESULT_CONSTANT ? EXPR_RESULT_CONSTANT : EXPR_RESULT_LVAL
+                .state = EXPR_RESULT_LVAL
             };
+            type_free(&expr->data.access_array.item_type);
+            expr->data.access_array.item_type = type_clone(operand_result.type.data.sub_type);
             expr_result_free(&operand_result);
             return item;
-            */
         } break;
 
         case EXPR_FUNCTION: {
@@ -424,8 +975,28 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
            
             SymbolTable table_function;
             symbol_table_new(&table_function, table_global);
-            // TODO: Add function parameters.
-            symbol_table_check_scope(table, expr->data.function.scope, expr->data.function.type.data.function.result);
+            
+            int param_count = expr->data.function.type.data.function.param_count;
+            Declaration *param_declarations = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Declaration) * param_count);
+            for (int i = 0; i < param_count; i++) {
+                FunctionParameter *param = expr->data.function.type.data.function.params + i;
+                param_declarations[i] = (Declaration) {
+                    .location = param->location,
+                    .id = param->id,
+                    .type = DECLARATION_VAR,
+                    .state = DECLARATION_STATE_INITIALIZED,
+                    .data.var.type = DECLARATION_VAR_MUTABLE,
+                    .data.var.data.mutable.type = type_clone(&param->type),
+                    .data.var.data.mutable.value_exists = false
+                };
+                if (!symbol_table_insert(&table_function, param_declarations + i)) {
+                    error_exit(param->location, "A function parameter with this name already exists.");
+                }
+            }
+            expr->data.function.param_declarations = param_declarations;
+
+            symbol_table_check_scope(&table_function, expr->data.function.scope, expr->data.function.type.data.function.result);
+            symbol_table_free(&table_function);
             return (ExprResult) {
                 .state = EXPR_RESULT_CONSTANT,
                 .type = type_clone(&expr->data.function.type)
@@ -433,6 +1004,42 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
         } break;
         
         case EXPR_FUNCTION_CALL: {
+            Expr *function = expr->data.function_call.function;
+            const char *method = function->type == EXPR_ACCESS_MEMBER ? string_cache_get(function->data.access_member.member) : "";
+            if (!strcmp(method, "store") || !strcmp(method, "shuffle")) {
+                ExprResult operand_result = symbol_table_check_expr(table, function->data.access_member.operand);
+                if (operand_result.type.type == TYPE_VECTOR) {
+                    Expr *operand = function->data.access_member.operand;
+                    Expr *params = expr->data.function_call.params;
+                    symbol_table_vector_method(expr, operand, &operand_result.type, !strcmp(method, "store") ? EXPR_VECTOR_STORE : EXPR_VECTOR_SHUFFLE, params, expr->data.function_call.param_count);
+                    allocator_free(operand);
+                    allocator_free(function);
+                    allocator_free(params);
+                    return symbol_table_check_vector(table, expr);
+                }
+                expr_result_free(&operand_result);
+            }
+            if (!strcmp(method, "next") || !strcmp(method, "close")) {
+                ExprResult operand_result = symbol_table_check_expr(table, function->data.access_member.operand);
+                if (type_is_file(&operand_result.type)) {
+                    // The file becomes the first argument, the same way the vector of a vector method does.
+                    Expr *args = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Expr) * (expr->data.function_call.param_count + 1));
+                    args[0] = *function->data.access_member.operand;
+                    for (int i = 0; i < expr->data.function_call.param_count; i++) args[i + 1] = expr->data.function_call.params[i];
+                    int arg_count = expr->data.function_call.param_count + 1;
+                    allocator_free(function->data.access_member.operand);
+                    allocator_free(function);
+                    allocator_free(expr->data.function_call.params);
+                    *expr = (Expr) {
+                        .location = expr->location,
+                        .type = EXPR_FILE,
+                        .data.file = { .op = !strcmp(method, "next") ? EXPR_FILE_NEXT : EXPR_FILE_CLOSE, .args = args, .arg_count = arg_count }
+                    };
+                    expr_result_free(&operand_result);
+                    return symbol_table_check_file(table, expr);
+                }
+                expr_result_free(&operand_result);
+            }
             ExprResult function_result = symbol_table_check_expr(table, expr->data.function_call.function);
             if (function_result.type.type != TYPE_FUNCTION) {
                 error_exit(expr->data.function_call.function->location, "This expression does not have a function type, so it cannot be called.");        
@@ -445,6 +1052,7 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                 if (!type_equal(&param_result.type, &function_result.type.data.function.params[i].type)) {
                     error_exit(expr->data.function_call.params[i].location, "The type of expression does not match the type of the function parameter.");
                 }
+                expr_result_free(&param_result);
             }
             Type return_type = type_clone(function_result.type.data.function.result);
             expr_result_free(&function_result); 
@@ -457,19 +1065,28 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
         } break;
         
         case EXPR_ID: {
-            Declaration *decl = symbol_table_get(table, expr->data.id);
+            Declaration *decl = symbol_table_get(table, expr->data.id.declaration_id);
             if (!decl) error_exit(expr->location, "This identifier does not exist in the current scope.");
             if (decl->type != DECLARATION_VAR) {
                 error_exit(expr->location, "This identifier is the name of a type, not a variable.");
             }
             symbol_table_declaration_init(table, decl); // Make sure the declaration is initialized if this is in the global scope.
+            expr->data.id.declaration = decl;
             
             switch (decl->data.var.type) {
-                case DECLARATION_VAR_CONSTANT:
-                    return (ExprResult) {
+                case DECLARATION_VAR_CONSTANT: {
+                    ExprResult result = {
                         .state = EXPR_RESULT_CONSTANT,
                         .type = type_clone(&decl->data.var.data.constant.type)
                     };
+                    // Propagate the value of constants that have already been folded into a literal.
+                    if (constant_is_folded(&decl->data.var.data.constant.value)) {
+                        Location location = expr->location;
+                        *expr = decl->data.var.data.constant.value;
+                        expr->location = location;
+                    }
+                    return result;
+                }
                 case DECLARATION_VAR_MUTABLE:
                     return (ExprResult) {
                         .state = EXPR_RESULT_LVAL,
@@ -479,23 +1096,31 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
         } break;
         
         case EXPR_LITERAL: {
-            Type type;
+            // A string is an array literal of its chars, so its items are copied like any other and can be written to.
             if (expr->data.literal.type == LITERAL_STRING) {
-                Type *sub_type = malloc(sizeof(Type));
-                *sub_type = (Type) {
-                    .type = TYPE_PRIMITIVE,
-                    .data.primitive = TOKEN_KEYWORD_TYPE_CHAR
+                StringId string = expr->data.literal.data.l_string;
+                Expr *count = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Expr));
+                *count = (Expr) {
+                    .location = expr->location,
+                    .type = EXPR_LITERAL,
+                    .data.literal = { .type = LITERAL_UINT64, .data.l_uint64 = strlen(string_cache_get(string)) }
                 };
-                type = (Type) { 
-                    .type = TYPE_ARRAY,
-                    .data.sub_type = sub_type
-                };
-            } else {
-                type = (Type) {
-                    .type = TYPE_PRIMITIVE,
-                    .data.primitive = TOKEN_KEYWORD_TYPE_CHAR + expr->data.literal.type - LITERAL_CHAR 
+                *expr = (Expr) {
+                    .location = expr->location,
+                    .type = EXPR_LITERAL_ARRAY,
+                    .data.literal_array = {
+                        .count = count,
+                        .type = { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_CHAR },
+                        .from_string = true,
+                        .string = string
+                    }
                 };
+                return symbol_table_check_expr_unfolded(table, expr);
             }
+            Type type = {
+                .type = TYPE_PRIMITIVE,
+                .data.primitive = TOKEN_KEYWORD_TYPE_CHAR + expr->data.literal.type - LITERAL_CHAR 
+            };
 
             return (ExprResult) {
                 .type = type,
@@ -513,9 +1138,64 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
             };
         } break;
 
+        case EXPR_REGEX: {
+            // Compiled here only to report errors in the pattern, the matcher is compiled again when it is written.
+            RegexDfa dfa = regex_compile(string_cache_get(expr->data.regex), expr->location);
+            regex_free(&dfa);
+
+            FunctionParameter *param = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(FunctionParameter));
+            Type *item_type = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
+            *item_type = (Type) { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_CHAR };
+            *param = (FunctionParameter) {
+                .location = expr->location,
+                .id = string_cache_insert_static("text"),
+                .type = (Type) { .type = TYPE_ARRAY, .data.sub_type = item_type }
+            };
+            Type *result = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
+            *result = (Type) { .type = TYPE_PRIMITIVE, .data.primitive = TOKEN_KEYWORD_TYPE_BOOL };
+            return (ExprResult) {
+                .type = (Type) {
+                    .type = TYPE_FUNCTION,
+                    .data.function = { .params = param, .param_count = 1, .result = result }
+                },
+                .state = EXPR_RESULT_CONSTANT
+            };
+        } break;
+
         case EXPR_LITERAL_ARRAY: {
-            // TODO: typecheck members and check to make sure member count is a constant.
-            Type *sub_type = malloc(sizeof(Type));
+            symbol_table_resolve_type(table, &expr->data.literal_array.type);
+
+            Expr *count = expr->data.literal_array.count;
+            ExprResult count_result = symbol_table_check_expr(table, count);
+            if (count_result.type.type != TYPE_PRIMITIVE 
+                    || count_result.type.data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN 
+                    || TOKEN_KEYWORD_TYPE_INTEGER_MAX < count_result.type.data.primitive) {
+                error_exit(count->location, "The size of an array literal must be of an integer type.");
+            }
+            // Arrays with a size that is only known at runtime are allocated instead of being put on the stack.
+            bool size_constant = count_result.state == EXPR_RESULT_CONSTANT && constant_is_folded(count);
+            expr_result_free(&count_result);
+
+            if (size_constant) {
+                Literal size = count->data.literal;
+                bool size_negative = (size.type == LITERAL_INT8 && size.data.l_int8 < 0)
+                    || (size.type == LITERAL_INT16 && size.data.l_int16 < 0)
+                    || (size.type == LITERAL_INT && size.data.l_int < 0)
+                    || (size.type == LITERAL_INT64 && size.data.l_int64 < 0);
+                if (size_negative) error_exit(count->location, "The size of an array literal cannot be negative.");
+                if (literal_get_bits(&size) < (unsigned long long) expr->data.literal_array.allocated_count) error_exit(expr->location, "This array literal has more members than its size.");
+            }
+
+            for (int i = 0; i < expr->data.literal_array.allocated_count; i++) {
+                Expr *member = expr->data.literal_array.members + i;
+                ExprResult member_result = symbol_table_check_expr(table, member);
+                if (!type_equal(&member_result.type, &expr->data.literal_array.type)) {
+                    error_exit(member->location, "The type of this array member does not match the type of the array.");
+                }
+                expr_result_free(&member_result);
+            }
+
+            Type *sub_type = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Type));
             *sub_type = type_clone(&expr->data.literal_array.type);
             
             return (ExprResult) {
@@ -523,13 +1203,26 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
                     .type = TYPE_ARRAY,
                     .data.sub_type = sub_type
                 },
-                .state = EXPR_RESULT_CONSTANT
+                .state = size_constant ? EXPR_RESULT_CONSTANT : EXPR_RESULT_RVAL
             };
         } break;
+
+        case EXPR_VECTOR:
+            return symbol_table_check_vector(table, expr);
+
+        case EXPR_FILE:
+            return symbol_table_check_file(table, expr);
     }
     assert(false);
 }
 
+// Constant subexpressions are folded into literals as soon as they have been typechecked, so by the time
+// the typechecker is done every constant that can be evaluated at compile time has been.
+ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr) {
+    ExprResult result = symbol_table_check_expr_unfolded(table, expr);
+    if (result.state == EXPR_RESULT_CONSTANT) constant_fold(expr);
+    return result;
+}
 
 void symbol_table_check_statement(SymbolTable *table, Statement *statement, Type *return_type) {
     switch (statement->type) {
@@ -546,6 +1239,7 @@ void symbol_table_check_statement(SymbolTable *table, Statement *statement, Type
             Expr *increment = statement->type == STATEMENT_INCREMENT ? &statement->data.increment : &statement->data.deincrement;
             ExprResult result = symbol_table_check_expr(table, increment);
             if (result.state != EXPR_RESULT_LVAL) error_exit(statement->location, "Only lvals can be incremented.");
+            symbol_table_parallel_write(table, statement, increment);
             if (result.type.type != TYPE_PRIMITIVE || result.type.data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN || TOKEN_KEYWORD_TYPE_INTEGER_MAX < result.type.data.primitive) {
                 error_exit(statement->location, "An incremented variable must be of an integer numeric type.");
             }
@@ -555,16 +1249,39 @@ void symbol_table_check_statement(SymbolTable *table, Statement *statement, Type
         case STATEMENT_ASSIGN: {
             ExprResult result = symbol_table_check_expr(table, &statement->data.assign.assignee);
             if (result.state != EXPR_RESULT_LVAL) error_exit(statement->location, "You can only assign to lvals.");
+            symbol_table_parallel_write(table, statement, &statement->data.assign.assignee);
             ExprResult value_result = symbol_table_check_expr(table, &statement->data.assign.value);
             if (!type_equal(&result.type, &value_result.type)) {
                 error_exit(statement->location, "The assignee and assigned value in an assignment statement must be of the same type.");
             }
-            switch (statement->data.assign.type) {
-                case TOKEN_ASSIGN: 
-                    break;
-                default:
-                    error_exit(statement->location, "Typechecking this type of assignment statement is not yet implemented.");
-                    break;
+            if (statement->data.assign.type != TOKEN_ASSIGN) {
+                // A compound assignment is checked as the binary expression it is short for.
+                TokenType operator;
+                switch (statement->data.assign.type) {
+                    case TOKEN_ASSIGN_LOGICAL_AND: operator = TOKEN_OP_LOGICAL_AND; break;
+                    case TOKEN_ASSIGN_LOGICAL_OR: operator = TOKEN_OP_LOGICAL_OR; break;
+                    case TOKEN_ASSIGN_BITWISE_AND: operator = TOKEN_OP_BITWISE_AND; break;
+                    case TOKEN_ASSIGN_BITWISE_OR: operator = TOKEN_OP_BITWISE_OR; break;
+                    case TOKEN_ASSIGN_BITWISE_XOR: operator = TOKEN_OP_BITWISE_XOR; break;
+                    case TOKEN_ASSIGN_SHIFT_LEFT: operator = TOKEN_OP_SHIFT_LEFT; break;
+                    case TOKEN_ASSIGN_SHIFT_RIGHT: operator = TOKEN_OP_SHIFT_RIGHT; break;
+                    case TOKEN_ASSIGN_PLUS: operator = TOKEN_OP_PLUS; break;
+                    case TOKEN_ASSIGN_MINUS: operator = TOKEN_OP_MINUS; break;
+                    case TOKEN_ASSIGN_MULTIPLY: operator = TOKEN_OP_MULTIPLY; break;
+                    case TOKEN_ASSIGN_DIVIDE: operator = TOKEN_OP_DIVIDE; break;
+                    case TOKEN_ASSIGN_MODULO: operator = TOKEN_OP_MODULO; break;
+                    default: assert(false); break;
+                }
+                Expr binary = {
+                    .location = statement->location,
+                    .type = EXPR_BINARY,
+                    .data.binary = { .operator = operator, .lhs = &statement->data.assign.assignee, .rhs = &statement->data.assign.value }
+                };
+                ExprResult binary_result = symbol_table_check_expr_unfolded(table, &binary);
+                if (!type_equal(&result.type, &binary_result.type)) {
+                    error_exit(statement->location, "The result of a compound assignment must be of the same type as the assignee.");
+                }
+                expr_result_free(&binary_result);
             }
             expr_result_free(&result);
             expr_result_free(&value_result);
@@ -580,6 +1297,7 @@ void symbol_table_check_statement(SymbolTable *table, Statement *statement, Type
 
 
         case STATEMENT_RETURN: {
+            if (symbol_table_in_parallel(table)) error_exit(statement->location, "The body of a parallel loop runs on other threads, so it can not return from the function.");
             if (!statement->data.return_value.exists) {
                 if (return_type->type != TYPE_PRIMITIVE || return_type->data.primitive != TOKEN_KEYWORD_TYPE_VOID) {
                     error_exit(statement->location, "Missing return value.");
@@ -606,7 +1324,12 @@ void symbol_table_check_scope(SymbolTable *table, Scope *scope, Type *return_typ
             SymbolTable table_scope;
             symbol_table_new(&table_scope, table);
             for (int i = 0; i < scope->data.block.scope_count; i++) {
+                // A statement that fails to typecheck is reported, and checking goes on with the next one.
+                DiagnosticRecovery recovery;
+                diagnostics_recovery_push(&recovery);
+                if (setjmp(recovery.jump)) continue;
                 symbol_table_check_scope(&table_scope, scope->data.block.scopes + i, return_type);
+                diagnostics_recovery_pop(&recovery);
             }
             symbol_table_free(&table_scope);
         } break;
@@ -636,7 +1359,59 @@ void symbol_table_check_scope(SymbolTable *table, Scope *scope, Type *return_typ
             }
             expr_result_free(&result);
             symbol_table_check_statement(&table_scope, &scope->data.loop_for.step, return_type);
-            symbol_table_check_scope(&table_scope, scope->data.loop_for.scope, return_type);
+            if (scope->data.loop_for.parallel) {
+                SymbolTable table_body;
+                symbol_table_new(&table_body, &table_scope);
+                symbol_table_check_parallel(&table_body, scope->data.loop_for.scope, symbol_table_parallel_counter(scope), return_type);
+                symbol_table_free(&table_body);
+            } else {
+                symbol_table_check_scope(&table_scope, scope->data.loop_for.scope, return_type);
+            }
+            symbol_table_free(&table_scope);
+        } break;
+
+        case SCOPE_LOOP_FOR_EACH: {
+            ExprResult result = symbol_table_check_expr(table, &scope->data.loop_for_each.array);
+            if (type_is_file(&result.type)) {
+                // The bytes of a file that haven't been read yet are iterated like an array of uint8, a chunk at a time.
+                if (scope->data.loop_for_each.parallel) {
+                    error_exit(scope->data.loop_for_each.array.location, "A parallel for .. in loop can not read a file, since it is only read one chunk at a time.");
+                }
+                scope->data.loop_for_each.file = true;
+                expr_result_free(&result);
+                result.type = symbol_table_array_of(TOKEN_KEYWORD_TYPE_UINT8, scope->data.loop_for_each.array.location);
+            }
+            if (result.type.type != TYPE_ARRAY) {
+                error_exit(scope->data.loop_for_each.array.location, "The expression of a for .. in loop is expected to be an array or a file.");
+            }
+
+            Declaration *element = allocator_malloc(ALLOCATOR_TYPECHECK, sizeof(Declaration));
+            *element = (Declaration) {
+                .location = scope->location,
+                .id = scope->data.loop_for_each.element,
+                .type = DECLARATION_VAR,
+                .state = DECLARATION_STATE_INITIALIZED,
+                .data.var.type = DECLARATION_VAR_MUTABLE,
+                .data.var.data.mutable.type = type_clone(result.type.data.sub_type),
+                .data.var.data.mutable.value_exists = false
+            };
+            scope->data.loop_for_each.element_declaration = element;
+            expr_result_free(&result);
+
+            // The element is declared in the same C block as the body, so the body cannot redeclare it.
+            SymbolTable table_scope;
+            symbol_table_new(&table_scope, table);
+            symbol_table_insert(&table_scope, element);
+            Scope *body = scope->data.loop_for_each.scope;
+            if (scope->data.loop_for_each.parallel) {
+                symbol_table_check_parallel(&table_scope, body, NULL, return_type);
+            } else if (body->type == SCOPE_BLOCK) {
+                for (int i = 0; i < body->data.block.scope_count; i++) {
+                    symbol_table_check_scope(&table_scope, body->data.block.scopes + i, return_type);
+                }
+            } else {
+                symbol_table_check_scope(&table_scope, body, return_type);
+            }
             symbol_table_free(&table_scope);
         } break;
 
@@ -649,9 +1424,44 @@ void symbol_table_check_scope(SymbolTable *table, Scope *scope, Type *return_typ
             symbol_table_check_scope(table, scope->data.loop_while.scope, return_type);
         } break;
         
-        default:
-            error_exit(scope->location, "Typechecking this kind of scope hasn't been implemented yet.");
-            break;
+        case SCOPE_MATCH: {
+            ExprResult result = symbol_table_check_expr(table, &scope->data.match.expr);
+            if (result.type.type != TYPE_ID || result.type.data.id.type_declaration->type != DECLARATION_SUM) {
+                error_exit(scope->data.match.expr.location, "The expression of a match statement is expected to be of a sum type.");
+            }
+            Declaration *sum = result.type.data.id.type_declaration;
+            scope->data.match.sum = sum;
+            expr_result_free(&result);
+
+            // Every member has to be matched exactly once.
+            bool *matched = allocator_calloc(ALLOCATOR_TYPECHECK, sum->data.sum.member_count, sizeof(bool));
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                int member = 0;
+                while (member < sum->data.sum.member_count && sum->data.sum.members[member].id.idx != match_case->match_id.idx) member++;
+                if (member == sum->data.sum.member_count) error_exit(match_case->location, "The matched sum type does not have a member with this name.");
+                if (matched[member]) error_exit(match_case->location, "This sum member has already been matched.");
+                matched[member] = true;
+                match_case->member = member;
+
+                SymbolTable table_case;
+                symbol_table_new(&table_case, table);
+                if (match_case->declares) {
+                    if (!sum->data.sum.members[member].type_exists) error_exit(match_case->declared_var.location, "This sum member does not hold a value.");
+                    Declaration *decl = &match_case->declared_var.data.declaration;
+                    type_free(&decl->data.var.data.mutable.type);
+                    decl->data.var.data.mutable.type = type_clone(&sum->data.sum.members[member].type);
+                    decl->state = DECLARATION_STATE_INITIALIZED;
+                    symbol_table_insert(&table_case, decl);
+                }
+                for (int j = 0; j < match_case->scope_count; j++) symbol_table_check_scope(&table_case, match_case->scopes + j, return_type);
+                symbol_table_free(&table_case);
+            }
+            for (int i = 0; i < sum->data.sum.member_count; i++) {
+                if (!matched[i]) error_exit(scope->location, "This match statement does not handle every member of the sum type.");
+            }
+            allocator_free(matched);
+        } break;
     }
 }
 
@@ -661,22 +1471,52 @@ void typecheck(SourceFile *file) {
    
     for (int i = 0; i < file->declaration_count; i++) {
         if (symbol_table_insert(&table, file->declarations + i)) continue;
-        error_exit(file->declarations[i].location, "This declaration has a duplicate name.");
+        // The first declaration with the name is checked, and this one is left out of the table.
+        diagnostics_report(DIAGNOSTIC_ERROR, file->declarations[i].location, "This declaration has a duplicate name.");
     }
-    
+    typecheck_table(&table);
+    symbol_table_free(&table);
+}
+
+void typecheck_table(SymbolTable *table) {
+    // A declaration that fails to typecheck is reported, and checking goes on with the next one.
     for (int i = 0; i < SYMBOL_TABLE_NODE_COUNT; i++)
-    for (int j = 0; j < table.nodes[i].declaration_count; j++) {
-        Declaration *decl = table.nodes[i].declarations[j];
+    for (int j = 0; j < table->nodes[i].declaration_count; j++) {
+        Declaration *decl = table->nodes[i].declarations[j];
         if (decl->type == DECLARATION_VAR) continue;
-        symbol_table_declaration_init(&table, decl);
+        if (trace_enabled) trace_begin("typecheck declaration", string_cache_get(decl->id));
+        DiagnosticRecovery recovery;
+        diagnostics_recovery_push(&recovery);
+        if (setjmp(recovery.jump)) {
+            if (trace_enabled) trace_end(NULL);
+            continue;
+        }
+        symbol_table_declaration_init(table, decl);
+        diagnostics_recovery_pop(&recovery);
+        if (trace_enabled) trace_end(NULL);
     }
 
     for (int i = 0; i < SYMBOL_TABLE_NODE_COUNT; i++)
-    for (int j = 0; j < table.nodes[i].declaration_count; j++) {
-        Declaration *decl = table.nodes[i].declarations[j];
+    for (int j = 0; j < table->nodes[i].declaration_count; j++) {
+        Declaration *decl = table->nodes[i].declarations[j];
         if (decl->type != DECLARATION_VAR) continue;
-        symbol_table_declaration_init(&table, decl);
+        if (trace_enabled) trace_begin("typecheck declaration", string_cache_get(decl->id));
+        DiagnosticRecovery recovery;
+        diagnostics_recovery_push(&recovery);
+        if (setjmp(recovery.jump)) {
+            if (trace_enabled) trace_end(NULL);
+            continue;
+        }
+        symbol_table_declaration_init(table, decl);
+
+        // Globals are not allocated at runtime, so their arrays have to be a constant size.
+        if (decl->data.var.type == DECLARATION_VAR_MUTABLE && decl->data.var.data.mutable.value_exists) {
+            Expr *value = &decl->data.var.data.mutable.value;
+            if (value->type == EXPR_LITERAL_ARRAY && !constant_is_folded(value->data.literal_array.count)) {
+                error_exit(value->location, "The size of an array literal outside of a function must be a constant.");
+            }
+        }
+        diagnostics_recovery_pop(&recovery);
+        if (trace_enabled) trace_end(NULL);
     }
-    
-    symbol_table_free(&table);
 }
@@ -25,6 +25,8 @@ typedef struct SymbolTableNode {
 typedef struct SymbolTable {
     SymbolTableNode nodes[SYMBOL_TABLE_NODE_COUNT];
     struct SymbolTable *previous;
+    // Set on the table around the body of a parallel loop. Declarations in the tables before it are outside of the loop.
+    struct SymbolTableParallel *parallel;
 } SymbolTable;
 
 void symbol_table_new(SymbolTable *out, SymbolTable *previous);
@@ -37,4 +39,7 @@ ExprResult symbol_table_check_expr(SymbolTable *table, Expr *expr);
 void symbol_table_check_scope(SymbolTable *table, Scope *scope, Type *return_type);
 
 void typecheck(SourceFile *file);
+// Typechecks the top-level declarations in the table that weren't typechecked before, so a table kept between
+// edits only checks what was parsed again.
+void typecheck_table(SymbolTable *table);
 #endif
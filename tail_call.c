@@ -0,0 +1,433 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "tail_call.h"
+#include "constant.h"
+#include "opt_util.h"
+#include "parser.h"
+#include "prelude.h"
+#include "string_cache.h"
+#include "token.h"
+
+#define TAIL_CALL_PASS "tailcall"
+
+typedef struct TailCall {
+    Declaration *decl;
+    Expr *function;
+    bool rewrite; // False while looking for tail calls, true while rewriting them.
+
+    StringId label;
+    TokenType operator; // The operator accumulated results are combined with, 0 if there is none.
+    bool operator_mixed; // Different operators are used, so nothing is accumulated.
+    Declaration *accumulator;
+
+    int sites;
+    int sites_accumulated;
+} TailCall;
+
+static bool tail_call_operator_accumulates(TokenType operator) {
+    switch (operator) {
+        case TOKEN_OP_PLUS:
+        case TOKEN_OP_MULTIPLY:
+        case TOKEN_OP_BITWISE_AND:
+        case TOKEN_OP_BITWISE_OR:
+        case TOKEN_OP_BITWISE_XOR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Type *tail_call_result(TailCall *tail) {
+    return tail->function->data.function.type.data.function.result;
+}
+
+static bool tail_call_is_self(TailCall *tail, Expr *expr) {
+    while (expr->type == EXPR_PAREN) expr = expr->data.parenthesized;
+    if (expr->type != EXPR_FUNCTION_CALL) return false;
+
+    Expr *callee = expr->data.function_call.function;
+    while (callee->type == EXPR_PAREN) callee = callee->data.parenthesized;
+    return callee->type == EXPR_ID && callee->data.id.declaration == tail->decl;
+}
+
+// Matches `e op f(...)` or `f(...) op e`. Returns e and sets call, or returns NULL.
+// `e` can only be combined early when the operator is associative and commutative at runtime. Bitwise operators always are,
+// but + and * only on unsigned integers, which wrap in C. Signed overflow is undefined, and a new order could overflow where the old didn't.
+static Expr *tail_call_accumulated(TailCall *tail, Expr *value, TokenType *operator, Expr **call) {
+    while (value->type == EXPR_PAREN) value = value->data.parenthesized;
+    if (value->type != EXPR_BINARY || !tail_call_operator_accumulates(value->data.binary.operator)) return NULL;
+
+    Type *result = tail_call_result(tail);
+    if (result->type != TYPE_PRIMITIVE) return NULL;
+    if (result->data.primitive < TOKEN_KEYWORD_TYPE_INTEGER_MIN || TOKEN_KEYWORD_TYPE_INTEGER_MAX < result->data.primitive) return NULL;
+    bool arithmetic = value->data.binary.operator == TOKEN_OP_PLUS || value->data.binary.operator == TOKEN_OP_MULTIPLY;
+    if (arithmetic && result->data.primitive < TOKEN_KEYWORD_TYPE_UINT_MIN) return NULL;
+
+    Expr *lhs = value->data.binary.lhs;
+    Expr *rhs = value->data.binary.rhs;
+    *operator = value->data.binary.operator;
+    if (tail_call_is_self(tail, rhs) && expr_call_count(lhs) == 0) {
+        *call = rhs;
+        return lhs;
+    }
+    if (tail_call_is_self(tail, lhs) && expr_call_count(rhs) == 0) {
+        *call = lhs;
+        return rhs;
+    }
+    return NULL;
+}
+
+static Expr tail_call_id(Declaration *decl, Location location) {
+    return (Expr) {
+        .location = location,
+        .type = EXPR_ID,
+        .data.id = { .declaration_id = decl->id, .declaration = decl }
+    };
+}
+
+static Scope tail_call_assign(Expr assignee, Expr value) {
+    return (Scope) {
+        .location = value.location,
+        .type = SCOPE_STATEMENT,
+        .data.statement = {
+            .location = value.location,
+            .type = STATEMENT_ASSIGN,
+            .data.assign = { .assignee = assignee, .value = value, .type = TOKEN_ASSIGN }
+        }
+    };
+}
+
+static Expr tail_call_combine(TailCall *tail, Expr value) {
+    Location location = value.location;
+    if (value.type != EXPR_ID && value.type != EXPR_LITERAL && value.type != EXPR_PAREN && value.type != EXPR_FUNCTION_CALL) {
+        value = (Expr) { .location = location, .type = EXPR_PAREN, .data.parenthesized = expr_alloc(value) };
+    }
+    return (Expr) {
+        .location = location,
+        .type = EXPR_BINARY,
+        .data.binary = {
+            .operator = tail->operator,
+            .lhs = expr_alloc(tail_call_id(tail->accumulator, location)),
+            .rhs = expr_alloc(value)
+        }
+    };
+}
+
+static StringId tail_call_name(const char *prefix, StringId id) {
+    const char *name = string_cache_get(id);
+    size_t length = strlen(prefix) + strlen(name) + 1;
+    char *string = allocator_malloc(ALLOCATOR_OPTIMIZE, length);
+    snprintf(string, length, "%s%s", prefix, name);
+    return string_cache_insert(string);
+}
+
+// Removes the parentheses around an expression, freeing them.
+static Expr tail_call_unwrap(Expr expr) {
+    while (expr.type == EXPR_PAREN) {
+        Expr *parenthesized = expr.data.parenthesized;
+        expr = *parenthesized;
+        allocator_free(parenthesized);
+    }
+    return expr;
+}
+
+// Replaces the statement in scope with assignments to the parameters and a jump to the start of the function.
+// The arguments are moved out of the call, which is freed. accumulated is moved into the accumulator if it isn't NULL.
+static void tail_call_rewrite(TailCall *tail, Scope *scope, Expr call, Expr *accumulated) {
+    Location location = scope->location;
+    assert(call.type == EXPR_FUNCTION_CALL);
+
+    int param_count = call.data.function_call.param_count;
+    Expr *args = call.data.function_call.params;
+    Declaration *params = tail->function->data.function.param_declarations;
+    FunctionParameter *param_types = tail->function->data.function.type.data.function.params;
+
+    // Parameters are assigned in order, so an argument that reads an earlier parameter has to be saved in a temporary first.
+    // If any argument has a side effect every argument is saved, to keep them evaluated in order.
+    bool *identity = allocator_calloc(ALLOCATOR_OPTIMIZE, param_count, sizeof(bool));
+    bool *temporary = allocator_calloc(ALLOCATOR_OPTIMIZE, param_count, sizeof(bool));
+    bool calls = false;
+    for (int i = 0; i < param_count; i++) {
+        identity[i] = args[i].type == EXPR_ID && args[i].data.id.declaration == params + i;
+        if (expr_call_count(args + i) > 0) calls = true;
+    }
+    for (int i = 0; i < param_count; i++) {
+        if (identity[i]) continue;
+        temporary[i] = calls;
+        for (int j = 0; j < i && !temporary[i]; j++) {
+            if (!identity[j] && expr_uses(args + i, params + j) > 0) temporary[i] = true;
+        }
+    }
+
+    Scope *scopes = allocator_malloc(ALLOCATOR_OPTIMIZE, sizeof(Scope) * (2 * param_count + 2));
+    int scope_count = 0;
+
+    if (accumulated) {
+        scopes[scope_count++] = tail_call_assign(tail_call_id(tail->accumulator, location), tail_call_combine(tail, *accumulated));
+        allocator_free(accumulated);
+    }
+
+    for (int i = 0; i < param_count; i++) {
+        if (!temporary[i]) continue;
+        scopes[scope_count++] = (Scope) {
+            .location = args[i].location,
+            .type = SCOPE_STATEMENT,
+            .data.statement = {
+                .location = args[i].location,
+                .type = STATEMENT_DECLARATION,
+                .data.declaration = {
+                    .location = args[i].location,
+                    .id = tail_call_name("_tail_", param_types[i].id),
+                    .type = DECLARATION_VAR,
+                    .state = DECLARATION_STATE_INITIALIZED,
+                    .data.var = {
+                        .type = DECLARATION_VAR_MUTABLE,
+                        .data.mutable = { .type = type_clone(&param_types[i].type), .value_exists = true, .value = args[i] }
+                    }
+                }
+            }
+        };
+    }
+
+    // Declarations are only pointed to once every scope is in place, so the pointers stay valid.
+    int temporary_idx = accumulated ? 1 : 0;
+    for (int i = 0; i < param_count; i++) {
+        if (identity[i]) continue;
+        Expr value = args[i];
+        if (temporary[i]) value = tail_call_id(&scopes[temporary_idx++].data.statement.data.declaration, args[i].location);
+        scopes[scope_count++] = tail_call_assign(tail_call_id(params + i, args[i].location), value);
+    }
+
+    scopes[scope_count++] = (Scope) {
+        .location = location,
+        .type = SCOPE_STATEMENT,
+        .data.statement = { .location = location, .type = STATEMENT_LABEL_GOTO, .data.label_goto = tail->label }
+    };
+
+    allocator_free(args);
+    expr_free(call.data.function_call.function);
+    allocator_free(call.data.function_call.function);
+    allocator_free(identity);
+    allocator_free(temporary);
+
+    *scope = (Scope) {
+        .location = location,
+        .type = SCOPE_BLOCK,
+        .data.block = { .scopes = scopes, .scope_count = scope_count }
+    };
+}
+
+static void tail_call_visit_return(TailCall *tail, Scope *scope) {
+    Statement *statement = &scope->data.statement;
+    Location location = statement->location;
+    Expr *value = &statement->data.return_value.expr;
+
+    if (tail_call_is_self(tail, value)) {
+        if (!tail->rewrite) {
+            tail->sites++;
+            return;
+        }
+        tail_call_rewrite(tail, scope, tail_call_unwrap(*value), NULL);
+        remark(location, TAIL_CALL_PASS, "tail call to '%s' turned into a loop", string_cache_get(tail->decl->id));
+        return;
+    }
+
+    TokenType operator;
+    Expr *call;
+    Expr *accumulated = tail_call_accumulated(tail, value, &operator, &call);
+    if (!tail->rewrite) {
+        if (!accumulated) return;
+        if (tail->operator && tail->operator != operator) tail->operator_mixed = true;
+        tail->operator = operator;
+        tail->sites_accumulated++;
+        return;
+    }
+    if (!tail->accumulator) return;
+
+    if (accumulated) {
+        // Both operands are moved out of the binary expression, which is all that is left of the statement.
+        tail_call_unwrap(*value);
+        Expr call_value = tail_call_unwrap(*call);
+        allocator_free(call);
+        tail_call_rewrite(tail, scope, call_value, accumulated);
+        remark(location, TAIL_CALL_PASS, "tail call to '%s' turned into a loop with an accumulator", string_cache_get(tail->decl->id));
+        return;
+    }
+
+    *value = tail_call_combine(tail, *value);
+}
+
+static void tail_call_visit_scope(TailCall *tail, Scope *scope, bool tail_position) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT: {
+            Statement *statement = &scope->data.statement;
+            if (statement->type == STATEMENT_RETURN && statement->data.return_value.exists) {
+                tail_call_visit_return(tail, scope);
+            } else if (statement->type == STATEMENT_EXPR && tail_position && tail_call_is_self(tail, &statement->data.expr)) {
+                // Falling off the end of a function after calling itself.
+                if (!tail->rewrite) {
+                    tail->sites++;
+                    break;
+                }
+                Location location = statement->location;
+                tail_call_rewrite(tail, scope, tail_call_unwrap(statement->data.expr), NULL);
+                remark(location, TAIL_CALL_PASS, "tail call to '%s' turned into a loop", string_cache_get(tail->decl->id));
+            }
+        } break;
+        case SCOPE_CONDITIONAL:
+            tail_call_visit_scope(tail, scope->data.conditional.scope_if, tail_position);
+            if (scope->data.conditional.scope_else) tail_call_visit_scope(tail, scope->data.conditional.scope_else, tail_position);
+            break;
+        case SCOPE_LOOP_FOR:
+            tail_call_visit_scope(tail, scope->data.loop_for.scope, false);
+            break;
+        case SCOPE_LOOP_FOR_EACH:
+            tail_call_visit_scope(tail, scope->data.loop_for_each.scope, false);
+            break;
+        case SCOPE_LOOP_WHILE:
+            tail_call_visit_scope(tail, scope->data.loop_while.scope, false);
+            break;
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) {
+                tail_call_visit_scope(tail, scope->data.block.scopes + i, tail_position && i == scope->data.block.scope_count - 1);
+            }
+            break;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                MatchCase *match_case = scope->data.match.cases + i;
+                for (int j = 0; j < match_case->scope_count; j++) tail_call_visit_scope(tail, match_case->scopes + j, false);
+            }
+            break;
+    }
+}
+
+// Returns true if a local declared anywhere in scope has this name.
+static bool tail_call_declares(Scope *scope, StringId id) {
+    switch (scope->type) {
+        case SCOPE_STATEMENT:
+            return scope->data.statement.type == STATEMENT_DECLARATION && scope->data.statement.data.declaration.id.idx == id.idx;
+        case SCOPE_CONDITIONAL:
+            return tail_call_declares(scope->data.conditional.scope_if, id)
+                || (scope->data.conditional.scope_else && tail_call_declares(scope->data.conditional.scope_else, id));
+        case SCOPE_LOOP_FOR:
+            return (scope->data.loop_for.init.type == STATEMENT_DECLARATION && scope->data.loop_for.init.data.declaration.id.idx == id.idx)
+                || tail_call_declares(scope->data.loop_for.scope, id);
+        case SCOPE_LOOP_FOR_EACH:
+            return scope->data.loop_for_each.element.idx == id.idx || tail_call_declares(scope->data.loop_for_each.scope, id);
+        case SCOPE_LOOP_WHILE:
+            return tail_call_declares(scope->data.loop_while.scope, id);
+        case SCOPE_BLOCK:
+            for (int i = 0; i < scope->data.block.scope_count; i++) {
+                if (tail_call_declares(scope->data.block.scopes + i, id)) return true;
+            }
+            return false;
+        case SCOPE_MATCH:
+            for (int i = 0; i < scope->data.match.case_count; i++) {
+                if (scope->data.match.cases[i].declares && scope->data.match.cases[i].declared_var.data.declaration.id.idx == id.idx) return true;
+                for (int j = 0; j < scope->data.match.cases[i].scope_count; j++) {
+                    if (tail_call_declares(scope->data.match.cases[i].scopes + j, id)) return true;
+                }
+            }
+            return false;
+    }
+    assert(false);
+}
+
+static Literal tail_call_identity(TokenType operator, TokenType primitive) {
+    int type = LITERAL_CHAR + (primitive - TOKEN_KEYWORD_TYPE_CHAR);
+    switch (operator) {
+        case TOKEN_OP_MULTIPLY:
+            return literal_from_bits(type, 1);
+        case TOKEN_OP_BITWISE_AND:
+            return literal_from_bits(type, ~0ull);
+        default:
+            return literal_from_bits(type, 0);
+    }
+}
+
+// Returns the number of tail calls rewritten.
+static int tail_call_function(Declaration *decl) {
+    Expr *function = &decl->data.var.data.constant.value;
+    Scope *root = function->data.function.scope;
+    if (root->type != SCOPE_BLOCK) return 0;
+
+    TailCall tail = { .decl = decl, .function = function };
+    tail_call_visit_scope(&tail, root, true);
+    if (tail.operator_mixed) tail.sites_accumulated = 0;
+    if (tail.sites == 0 && tail.sites_accumulated == 0) return 0;
+
+    // Assignments to a parameter would go to the local instead.
+    for (int i = 0; i < function->data.function.type.data.function.param_count; i++) {
+        StringId param = function->data.function.type.data.function.params[i].id;
+        if (tail_call_declares(root, param)) {
+            remark(decl->location, TAIL_CALL_PASS, "tail calls in '%s' not eliminated: a local redeclares parameter '%s'",
+                string_cache_get(decl->id), string_cache_get(param));
+            return 0;
+        }
+    }
+
+    // The accumulator is declared before the label so it keeps its value across iterations.
+    Scope inserted[2];
+    int inserted_count = 0;
+    if (tail.sites_accumulated > 0) {
+        Type *result = tail_call_result(&tail);
+        inserted[inserted_count++] = (Scope) {
+            .location = decl->location,
+            .type = SCOPE_STATEMENT,
+            .data.statement = {
+                .location = decl->location,
+                .type = STATEMENT_DECLARATION,
+                .data.declaration = {
+                    .location = decl->location,
+                    .id = string_cache_insert_static("_tail_accumulator"),
+                    .type = DECLARATION_VAR,
+                    .state = DECLARATION_STATE_INITIALIZED,
+                    .data.var = {
+                        .type = DECLARATION_VAR_MUTABLE,
+                        .data.mutable = {
+                            .type = type_clone(result),
+                            .value_exists = true,
+                            .value = {
+                                .location = decl->location,
+                                .type = EXPR_LITERAL,
+                                .data.literal = tail_call_identity(tail.operator, result->data.primitive)
+                            }
+                        }
+                    }
+                }
+            }
+        };
+    } else {
+        tail.operator = 0;
+    }
+
+    tail.label = tail_call_name("_tail_", decl->id);
+    inserted[inserted_count++] = (Scope) {
+        .location = decl->location,
+        .type = SCOPE_STATEMENT,
+        .data.statement = { .location = decl->location, .type = STATEMENT_LABEL, .data.label = tail.label }
+    };
+    scope_block_insert(root, root, 0, inserted, inserted_count);
+    if (tail.operator) tail.accumulator = &root->data.block.scopes[0].data.statement.data.declaration;
+
+    tail.rewrite = true;
+    tail_call_visit_scope(&tail, root, true);
+    return tail.sites + tail.sites_accumulated;
+}
+
+void tail_call_eliminate(SourceFile *file) {
+    int sites = 0;
+    int functions = 0;
+    for (int i = 0; i < file->declaration_count; i++) {
+        if (!declaration_is_function(file->declarations + i)) continue;
+        int function_sites = tail_call_function(file->declarations + i);
+        sites += function_sites;
+        if (function_sites > 0) functions++;
+    }
+    remark_summary(TAIL_CALL_PASS, "%i tail calls turned into loops in %i functions", sites, functions);
+}
@@ -0,0 +1,11 @@
+#ifndef CREED_TAIL_CALL_H
+#define CREED_TAIL_CALL_H
+
+#include "parser.h"
+
+// Rewrites calls a function makes to itself in tail position into a jump back to the start of the function.
+// A return of `e op f(...)` where op is an associative and commutative integer operator is also rewritten,
+// by keeping the pending `e op` parts in an accumulator. Run this after typechecking.
+void tail_call_eliminate(SourceFile *file);
+
+#endif
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Compiles programs made by test/bench_gen.c at each scale in BENCH_LINES and compares the time and peak resident set size
+# of every phase with test/bench_baseline.txt. Run by make bench, and by make bench-baseline with --update to store the results.
+
+set -e
+
+baseline="test/bench_baseline.txt"
+results="bench_results.txt"
+lines="${BENCH_LINES:-1000 100000}"
+seed="${BENCH_SEED:-1}"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+echo "# lines phase wall_seconds max_rss_kb" > "$results"
+for n in $lines; do
+    ./bench_gen --seed="$seed" --lines="$n" > "$work/$n.creed"
+    if ! ./creed --time-report="$work/$n.json" "$work/$n.creed" > "$work/$n.out" 2> /dev/null; then
+        echo "The program of $n lines did not compile:"
+        grep -a -A 1 "Error!" "$work/$n.out"
+        exit 1
+    fi
+    awk -v n="$n" '/"name"/ {
+        match($0, /"name": "[a-z]+"/); name = substr($0, RSTART + 9, RLENGTH - 10)
+        match($0, /"wall": [0-9.]+/); wall = substr($0, RSTART + 8, RLENGTH - 8)
+        match($0, /"max_rss_kb": [0-9]+/); rss = substr($0, RSTART + 14, RLENGTH - 14)
+        print n, name, wall, rss
+    }' "$work/$n.json" >> "$results"
+done
+
+if [ "$1" = "--update" ] || [ ! -f "$baseline" ]; then
+    cp "$results" "$baseline"
+    echo "Stored the results in $baseline."
+    exit 0
+fi
+
+# A phase more than 1.5 times slower or bigger than the baseline is marked, but only above a millisecond or a MiB,
+# so noise in the smallest scale isn't.
+awk '
+    /^#/ { next }
+    FILENAME == ARGV[1] { wall[$1 " " $2] = $3; rss[$1 " " $2] = $4; next }
+    FNR == 2 { printf "%10s %-10s %11s %11s %7s %9s %9s %7s\n", "lines", "phase", "wall ms", "baseline", "ratio", "rss MiB", "baseline", "ratio" }
+    {
+        key = $1 " " $2
+        if (!(key in wall)) { printf "%10s %-10s %11.3f %11s %7s %9.1f %9s %7s\n", $1, $2, $3 * 1e3, "-", "-", $4 / 1024, "-", "-"; next }
+        wall_ratio = wall[key] > 0 ? $3 / wall[key] : 1
+        rss_ratio = rss[key] > 0 ? $4 / rss[key] : 1
+        mark = (wall_ratio > 1.5 && $3 > 0.001) || (rss_ratio > 1.5 && $4 > 1024) ? "  regressed" : ""
+        printf "%10s %-10s %11.3f %11.3f %6.2fx %9.1f %9.1f %6.2fx%s\n", $1, $2, $3 * 1e3, wall[key] * 1e3, wall_ratio, $4 / 1024, rss[key] / 1024, rss_ratio, mark
+    }
+' "$baseline" "$results"
@@ -0,0 +1,194 @@
+// Writes a valid Creed program of about the requested number of lines to stdout, for make bench.
+// The same seed and options always give the same program.
+// Usage: bench_gen [--seed=<n>] [--lines=<n>] [--structs=<n>] [--members=<n>] [--locals=<n>] [--depth=<n>] [--expr=<n>]
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Options {
+    unsigned long long seed;
+    unsigned long long lines;
+    int structs; // Struct declarations, each with members ints that functions read and write.
+    int members;
+    int locals; // Local variables declared at the top of each function, besides its two parameters.
+    int depth; // How deep ifs and loops nest.
+    int expr; // The most operands in one expression.
+} Options;
+
+static unsigned long long state;
+static unsigned long long lines;
+static int counters; // Numbers the while loop counters, which share the scope of the statements around them.
+static int quiet; // Lines are only counted, not written.
+
+// xorshift64*, so the output doesn't depend on the C library.
+static unsigned long long gen_random(void) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+static int gen_below(int n) {
+    return (int) (gen_random() % (unsigned long long) n);
+}
+
+static void gen_line(int indent, const char *format, ...) {
+    lines++;
+    if (quiet) return;
+    for (int i = 0; i < indent; i++) fputs("    ", stdout);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+// The names an expression in a function can read: the parameters, the locals, and the members of the local struct.
+static void gen_operand(Options *options, char *out) {
+    int choice = gen_below(options->locals + 2 + (options->structs > 0 ? 2 : 0) + 1);
+    if (choice == 0) sprintf(out, "a");
+    else if (choice == 1) sprintf(out, "b");
+    else if (choice < options->locals + 2) sprintf(out, "v%i", choice - 2);
+    else if (choice < options->locals + 2 + (options->structs > 0 ? 2 : 0)) sprintf(out, "s.m%i", gen_below(options->members));
+    else sprintf(out, "%i", gen_below(100));
+}
+
+// Operands joined by + - * & | ^ and %, which has a constant right side so it can never divide by zero.
+static void gen_expr(Options *options, char *out) {
+    static const char *operators[] = { " + ", " - ", " * ", " & ", " | ", " ^ " };
+    int count = 1 + gen_below(options->expr);
+    out[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        char operand[32];
+        gen_operand(options, operand);
+        if (i > 0) strcat(out, operators[gen_below(sizeof(operators) / sizeof(operators[0]))]);
+        if (gen_below(8) == 0) {
+            strcat(out, "(");
+            strcat(out, operand);
+            sprintf(operand, " %% %i)", 2 + gen_below(50));
+        }
+        strcat(out, operand);
+    }
+}
+
+// The calls a function adds to its return, to its children in a binary tree of the functions: fK calls f(2K + 1) and f(2K + 2).
+static void gen_calls(int function, int functions, const char *args, char *out) {
+    out[0] = '\0';
+    for (int child = 2 * function + 1; child <= 2 * function + 2 && child < functions; child++) sprintf(out + strlen(out), " + f%i(%s)", child, args);
+}
+
+static void gen_statements(Options *options, int indent, int depth, int count) {
+    char expr[1024], other[1024];
+    for (int i = 0; i < count; i++) {
+        int kind = depth < options->depth ? gen_below(6) : 0;
+        int local = gen_below(options->locals);
+        gen_expr(options, expr);
+        switch (kind) {
+            case 0: case 1: case 2:
+                if (options->structs > 0 && gen_below(4) == 0) gen_line(indent, "s.m%i = %s;", gen_below(options->members), expr);
+                else gen_line(indent, "v%i %s %s;", local, gen_below(2) ? "=" : "+=", expr);
+                break;
+            case 3:
+                gen_expr(options, other);
+                gen_line(indent, "if (%s) < (%s) {", expr, other);
+                gen_statements(options, indent + 1, depth + 1, 1 + gen_below(3));
+                if (gen_below(2)) {
+                    gen_line(indent, "} else {");
+                    gen_statements(options, indent + 1, depth + 1, 1 + gen_below(3));
+                }
+                gen_line(indent, "}");
+                break;
+            case 4:
+                gen_line(indent, "for i%i : int = 0; i%i < %i; ++i%i {", depth, depth, 1 + gen_below(8), depth);
+                gen_statements(options, indent + 1, depth + 1, 1 + gen_below(3));
+                gen_line(indent, "}");
+                break;
+            case 5: {
+                int counter = counters++;
+                gen_line(indent, "w%i : int = %i;", counter, 1 + gen_below(8));
+                gen_line(indent, "while w%i > 0 {", counter);
+                gen_statements(options, indent + 1, depth + 1, 1 + gen_below(3));
+                gen_line(indent + 1, "--w%i;", counter);
+                gen_line(indent, "}");
+            } break;
+        }
+    }
+}
+
+// Writes the program, with the calls to the functions that are below the total, and returns how many functions it has.
+// How many there will be is only known at the end, so it is written once quietly with a total of 0 to count them first.
+static int gen_program(Options *options, int total) {
+    state = options->seed * 0x9E3779B97F4A7C15ULL + 1;
+    lines = 0;
+    counters = 0;
+    for (int i = 0; i < options->structs; i++) {
+        gen_line(0, "S%i struct {", i);
+        for (int j = 0; j < options->members; j++) gen_line(1, "m%i: int;", j);
+        gen_line(0, "};");
+        gen_line(0, "");
+    }
+
+    // main calls f0 and each function calls its children, so dead code elimination keeps them all, and no chain of calls
+    // is longer than the log of the number of functions. Every fourth one is a single return expression the inliner can take.
+    int functions = 0;
+    char expr[1024], calls[128];
+    while (lines + 4 < options->lines || functions == 0) {
+        if (functions % 4 == 3) {
+            int scale = 1 + gen_below(9);
+            int modulo = 2 + gen_below(30);
+            gen_calls(functions, total, "b, a", calls);
+            gen_line(0, "f%i :: (a: int, b: int) int {", functions);
+            gen_line(1, "return a * %i + b - a %% %i%s;", scale, modulo, calls);
+            gen_line(0, "};");
+            gen_line(0, "");
+            functions++;
+            continue;
+        }
+        gen_line(0, "f%i :: (a: int, b: int) int {", functions);
+        for (int i = 0; i < options->locals; i++) gen_line(1, "v%i : int = %i;", i, gen_below(100));
+        if (options->structs > 0) {
+            gen_line(1, "s : S%i;", gen_below(options->structs));
+            for (int i = 0; i < options->members; i++) gen_line(1, "s.m%i = a + %i;", i, i);
+        }
+        unsigned long long remaining = options->lines > lines + 4 ? options->lines - lines - 4 : 1;
+        gen_statements(options, 1, 0, remaining < 12 ? (int) remaining : 4 + gen_below(8));
+        gen_expr(options, expr);
+        gen_calls(functions, total, "v0, b", calls);
+        gen_line(1, "return %s%s;", expr, calls);
+        gen_line(0, "};");
+        gen_line(0, "");
+        functions++;
+    }
+
+    gen_line(0, "main :: () int {");
+    gen_line(1, "return f0(1, 2) %% 256;");
+    gen_line(0, "};");
+    return functions;
+}
+
+int main(int argc, char **argv) {
+    Options options = { .seed = 1, .lines = 1000, .structs = 8, .members = 6, .locals = 8, .depth = 3, .expr = 6 };
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--seed=", 7)) options.seed = strtoull(argv[i] + 7, NULL, 10);
+        else if (!strncmp(argv[i], "--lines=", 8)) options.lines = strtoull(argv[i] + 8, NULL, 10);
+        else if (!strncmp(argv[i], "--structs=", 10)) options.structs = atoi(argv[i] + 10);
+        else if (!strncmp(argv[i], "--members=", 10)) options.members = atoi(argv[i] + 10);
+        else if (!strncmp(argv[i], "--locals=", 9)) options.locals = atoi(argv[i] + 9);
+        else if (!strncmp(argv[i], "--depth=", 8)) options.depth = atoi(argv[i] + 8);
+        else if (!strncmp(argv[i], "--expr=", 7)) options.expr = atoi(argv[i] + 7);
+        else {
+            fprintf(stderr, "Unknown option '%s'.\nUsage: %s [--seed=<n>] [--lines=<n>] [--structs=<n>] [--members=<n>] [--locals=<n>] [--depth=<n>] [--expr=<n>]\n", argv[i], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.members < 1) options.members = 1;
+    if (options.locals < 1) options.locals = 1;
+    if (options.expr < 1) options.expr = 1;
+
+    quiet = 1;
+    int functions = gen_program(&options, 0);
+    quiet = 0;
+    gen_program(&options, functions);
+    return EXIT_SUCCESS;
+}
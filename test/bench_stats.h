@@ -0,0 +1,24 @@
+// Timing helpers shared by the benchmark drivers in test. Define _POSIX_C_SOURCE before including, for clock_gettime.
+#ifndef CREED_BENCH_STATS_H
+#define CREED_BENCH_STATS_H
+
+#include <time.h>
+
+static inline double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static inline int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, so with few runs the 95th percentile is the slowest one.
+static inline double percentile(double *sorted, int count, int percent) {
+    int rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+#endif
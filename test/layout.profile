@@ -0,0 +1,3 @@
+Particle.x 1000000
+Particle.y 1000000
+Particle.alive 500000
@@ -0,0 +1,241 @@
+// Starts creed --lsp on a generated program, and times how long the language server takes to publish diagnostics after
+// an edit in the middle of it, and to answer go to definition there. Checks the answers, and fails if the 95th percentile
+// of either is over the budget. Built and run by make lsp-bench.
+// Usage: lsp_bench <creed> <program> <runs> <budget in ms>
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_stats.h"
+
+static FILE *server_in;
+static FILE *server_out;
+
+static void send(const char *body) {
+    fprintf(server_in, "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+    fflush(server_in);
+}
+
+// Returns the body of the next message, which the caller frees, or NULL if the server is gone.
+static char *receive(void) {
+    char header[256];
+    long length = -1;
+    while (fgets(header, sizeof(header), server_out)) {
+        if (!strncmp(header, "Content-Length:", 15)) length = atol(header + 15);
+        else if (!strcmp(header, "\r\n") && length >= 0) break;
+    }
+    if (length < 0) return NULL;
+    char *body = malloc(length + 1);
+    if (fread(body, 1, length, server_out) != (size_t) length) {
+        free(body);
+        return NULL;
+    }
+    body[length] = '\0';
+    return body;
+}
+
+static int count(const char *text, const char *part) {
+    int found = 0;
+    for (const char *at = strstr(text, part); at; at = strstr(at + 1, part)) found++;
+    return found;
+}
+
+// Writes the text as a JSON string.
+static void add_string(char **out, const char *text) {
+    *(*out)++ = '"';
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') *(*out)++ = '\\';
+        if (*text == '\n') {
+            *(*out)++ = '\\';
+            *(*out)++ = 'n';
+        } else {
+            *(*out)++ = *text;
+        }
+    }
+    *(*out)++ = '"';
+    **out = '\0';
+}
+
+// Sends an edit and returns how many diagnostics the server published for the document after it, or -1.
+static int edit(int line, int start, int end, const char *text, double *elapsed) {
+    char body[512];
+    snprintf(body, sizeof(body), "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":{\"uri\":\"file:///bench.creed\",\"version\":1},"
+        "\"contentChanges\":[{\"range\":{\"start\":{\"line\":%i,\"character\":%i},\"end\":{\"line\":%i,\"character\":%i}},\"text\":\"%s\"}]}}",
+        line, start, line, end, text);
+    double begin = seconds();
+    send(body);
+    char *reply = receive();
+    *elapsed = seconds() - begin;
+    if (!reply) return -1;
+    int diagnostics = count(reply, "\"severity\"");
+    free(reply);
+    return diagnostics;
+}
+
+// Returns the line go to definition at the position went to, or -1.
+static int definition(int line, int character, double *elapsed) {
+    char body[256];
+    snprintf(body, sizeof(body), "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"textDocument/definition\",\"params\":{\"textDocument\":{\"uri\":\"file:///bench.creed\"},"
+        "\"position\":{\"line\":%i,\"character\":%i}}}", line, character);
+    double begin = seconds();
+    send(body);
+    char *reply = receive();
+    *elapsed = seconds() - begin;
+    if (!reply) return -1;
+    const char *start = strstr(reply, "\"start\":{\"line\":");
+    int target = start ? atoi(start + strlen("\"start\":{\"line\":")) : -1;
+    free(reply);
+    return target;
+}
+
+static void report(const char *name, double *times, int runs, double budget, int *failed) {
+    qsort(times, runs, sizeof(double), compare_doubles);
+    double median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    double p95 = percentile(times, runs, 95);
+    printf("%-12s %9.3f %9.3f\n", name, median * 1e3, p95 * 1e3);
+    if (p95 * 1e3 > budget) {
+        fprintf(stderr, "%s: the 95th percentile is over the budget of %.1f ms.\n", name, budget);
+        *failed = 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <creed> <program> <runs> <budget in ms>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int runs = atoi(argv[3]);
+    double budget = atof(argv[4]);
+    if (runs < 1) runs = 1;
+
+    FILE *file = fopen(argv[2], "rb");
+    if (!file) {
+        perror("Failed to open the program");
+        return EXIT_FAILURE;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *program = malloc(length + 1);
+    length = (long) fread(program, 1, length, file);
+    program[length] = '\0';
+    fclose(file);
+
+    // The functions the generator writes are f0, f1, ..., and fK returns calls to f(2K + 1) and f(2K + 2) if they exist.
+    // The edits go in the return of the one in the middle, and go to definition is on its call to f(2K + 1).
+    int functions = 0;
+    for (const char *line = program; line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        if (line[0] == 'f' && strstr(line, " :: (") == strchr(line, ' ')) functions++;
+    }
+    if (functions < 2) {
+        fprintf(stderr, "The program has no functions that call each other.\n");
+        return EXIT_FAILURE;
+    }
+    int caller = (functions - 2) / 2;
+    char callee[32], callee_declaration[40], caller_declaration[40], call[40];
+    snprintf(callee, sizeof(callee), "f%i", 2 * caller + 1);
+    snprintf(callee_declaration, sizeof(callee_declaration), "\n%s :: (", callee);
+    snprintf(caller_declaration, sizeof(caller_declaration), "\nf%i :: (", caller);
+    snprintf(call, sizeof(call), " %s(", callee);
+    const char *callee_at = strstr(program, callee_declaration);
+    const char *caller_at = strstr(program, caller_declaration);
+    const char *return_at = caller_at ? strstr(caller_at, "return ") : NULL;
+    const char *call_at = return_at ? strstr(return_at, call) : NULL;
+    if (!callee_at || !call_at) {
+        fprintf(stderr, "The middle function doesn't return a call to %s.\n", callee);
+        return EXIT_FAILURE;
+    }
+    int callee_line = 1, return_line = 0;
+    for (const char *at = program; at <= callee_at; at++) callee_line += *at == '\n'; // It starts after the newline it was found with.
+    for (const char *at = program; at < return_at; at++) return_line += *at == '\n';
+    const char *line_start = return_at;
+    while (line_start > program && line_start[-1] != '\n') line_start--;
+    int return_column = (int) (return_at - line_start) + (int) strlen("return ");
+    int call_column = (int) (call_at - line_start) + 1;
+
+    int to_server[2], from_server[2];
+    if (pipe(to_server) || pipe(from_server)) {
+        perror("Failed to start the server");
+        return EXIT_FAILURE;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Failed to start the server");
+        return EXIT_FAILURE;
+    }
+    if (pid == 0) {
+        dup2(to_server[0], STDIN_FILENO);
+        dup2(from_server[1], STDOUT_FILENO);
+        close(to_server[1]);
+        close(from_server[0]);
+        execl(argv[1], argv[1], "--lsp", (char *) NULL);
+        _exit(127);
+    }
+    close(to_server[0]);
+    close(from_server[1]);
+    server_in = fdopen(to_server[1], "w");
+    server_out = fdopen(from_server[0], "r");
+
+    send("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+    free(receive());
+
+    char *open = malloc(length * 2 + 256);
+    char *out = open + sprintf(open, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":{\"uri\":\"file:///bench.creed\","
+        "\"languageId\":\"creed\",\"version\":1,\"text\":");
+    add_string(&out, program);
+    strcpy(out, "}}}");
+    double begin = seconds();
+    send(open);
+    char *reply = receive();
+    double open_time = seconds() - begin;
+    free(open);
+    if (!reply || count(reply, "\"severity\"")) {
+        fprintf(stderr, "The program should have no diagnostics when opened.\n");
+        return EXIT_FAILURE;
+    }
+    free(reply);
+    printf("Opened %li lines in %.1f ms. Editing the return of f%i and going to the definition of %s, %i times.\n",
+        (long) count(program, "\n"), open_time * 1e3, caller, callee, runs);
+    printf("%-12s %9s %9s\n", "", "median ms", "p95 ms");
+
+    double *edit_times = malloc(sizeof(double) * runs * 4);
+    double *definition_times = malloc(sizeof(double) * runs);
+    int failed = 0;
+    for (int i = 0; i < runs && !failed; i++) {
+        // Inserting a term keeps it valid, and inserting a bool makes it an error, which removing it fixes.
+        double *times = edit_times + i * 4;
+        if (edit(return_line, return_column, return_column, "1 + ", times) != 0
+            || edit(return_line, return_column, return_column + 4, "", times + 1) != 0
+            || edit(return_line, return_column, return_column, "true + ", times + 2) != 1
+            || edit(return_line, return_column, return_column + 7, "", times + 3) != 0) {
+            fprintf(stderr, "An edit didn't publish the diagnostics it should have.\n");
+            failed = 1;
+        }
+        // Lines in the protocol count from 0.
+        if (definition(return_line, call_column + 1, definition_times + i) != callee_line - 1) {
+            fprintf(stderr, "Go to definition on %s didn't go to line %i.\n", callee, callee_line);
+            failed = 1;
+        }
+    }
+    if (!failed) {
+        report("edit", edit_times, runs * 4, budget, &failed);
+        report("definition", definition_times, runs, budget, &failed);
+    }
+
+    send("{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"shutdown\"}");
+    free(receive());
+    send("{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "The server didn't exit cleanly after shutdown.\n");
+        failed = 1;
+    }
+    free(edit_times);
+    free(definition_times);
+    free(program);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
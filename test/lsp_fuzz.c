@@ -0,0 +1,318 @@
+// Makes random edits to the test programs in creed --lsp, and checks that the diagnostics it publishes after the last
+// edit are the ones a fresh server publishes for the edited text when it is opened whole. Also asks for go to definition
+// at random positions after each edit, so a crash anywhere in the incremental paths shows up. Built and run by make
+// lsp-fuzz, which runs it on a build with AddressSanitizer. The text of the first failure is written to
+// lsp_fuzz_failure.creed, and the same seed repeats the same edits.
+// Usage: lsp_fuzz <creed> <iterations> <seed> <program>...
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct Server {
+    pid_t pid;
+    FILE *in;
+    FILE *out;
+} Server;
+
+// Inserted at random, mostly to break the program in the ways typing does.
+static const char *snippets[] = {
+    ";", "{", "}", "true", "1", " + 1", "x", "int", "float64", "\n", " :: 1;\n", "return 0;", "//", "\"", "'", "struct",
+    " := ", "(", ")", "Foo", "y :: x;\n", "x :: 2;\n"
+};
+
+static int random_below(int limit) {
+    return limit > 0 ? rand() % limit : 0;
+}
+
+static int server_start(Server *server, const char *creed) {
+    int to_server[2], from_server[2];
+    if (pipe(to_server) || pipe(from_server)) return -1;
+    server->pid = fork();
+    if (server->pid < 0) return -1;
+    if (server->pid == 0) {
+        dup2(to_server[0], STDIN_FILENO);
+        dup2(from_server[1], STDOUT_FILENO);
+        close(to_server[1]);
+        close(from_server[0]);
+        execl(creed, creed, "--lsp", (char *) NULL);
+        _exit(127);
+    }
+    close(to_server[0]);
+    close(from_server[1]);
+    server->in = fdopen(to_server[1], "w");
+    server->out = fdopen(from_server[0], "r");
+    return 0;
+}
+
+static void send(Server *server, const char *body) {
+    fprintf(server->in, "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+    fflush(server->in);
+}
+
+// Returns the body of the next message, which the caller frees, or NULL if the server is gone.
+static char *receive(Server *server) {
+    char header[256];
+    long length = -1;
+    while (fgets(header, sizeof(header), server->out)) {
+        if (!strncmp(header, "Content-Length:", 15)) length = atol(header + 15);
+        else if (!strcmp(header, "\r\n") && length >= 0) break;
+    }
+    if (length < 0) return NULL;
+    char *body = malloc(length + 1);
+    if (fread(body, 1, length, server->out) != (size_t) length) {
+        free(body);
+        return NULL;
+    }
+    body[length] = '\0';
+    return body;
+}
+
+// Returns whether the server answered the shutdown and exited with 0, which AddressSanitizer doesn't let it do after an error.
+static int server_stop(Server *server) {
+    send(server, "{\"jsonrpc\":\"2.0\",\"id\":9,\"method\":\"shutdown\"}");
+    char *reply = receive(server);
+    send(server, "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    fclose(server->in);
+    fclose(server->out);
+    int status;
+    waitpid(server->pid, &status, 0);
+    free(reply);
+    return reply && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Writes the text as a JSON string into out, which has room for 6 times its length plus 2.
+static char *add_string(char *out, const char *text, size_t length) {
+    *out++ = '"';
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        } else if (c == '\n') {
+            *out++ = '\\';
+            *out++ = 'n';
+        } else if (c < 0x20) {
+            out += sprintf(out, "\\u%04x", c);
+        } else {
+            *out++ = c;
+        }
+    }
+    *out++ = '"';
+    *out = '\0';
+    return out;
+}
+
+// Returns the publishDiagnostics reply to opening the text, or NULL.
+static char *open_document(Server *server, const char *text, size_t length) {
+    send(server, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+    free(receive(server));
+    char *body = malloc(length * 6 + 256);
+    char *out = body + sprintf(body, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":{\"uri\":\"file:///fuzz.creed\","
+        "\"languageId\":\"creed\",\"version\":1,\"text\":");
+    out = add_string(out, text, length);
+    strcpy(out, "}}}");
+    send(server, body);
+    free(body);
+    return receive(server);
+}
+
+// The line and character of an offset, counted from 0 like the protocol does.
+static void position(const char *text, size_t offset, int *line, int *character) {
+    *line = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < offset; i++) {
+        if (text[i] == '\n') {
+            (*line)++;
+            start = i + 1;
+        }
+    }
+    *character = (int) (offset - start);
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// The diagnostics of a publishDiagnostics reply as one string per diagnostic, sorted, so their order doesn't matter.
+static char **diagnostics(const char *reply, int *count) {
+    *count = 0;
+    const char *at = strstr(reply, "\"diagnostics\":[");
+    if (!at) return NULL;
+    at += strlen("\"diagnostics\":[");
+    char **found = NULL;
+    int depth = 0;
+    int in_string = 0;
+    const char *start = NULL;
+    for (; *at && (depth > 0 || *at != ']'); at++) {
+        if (in_string) {
+            if (*at == '\\') at++;
+            else if (*at == '"') in_string = 0;
+        } else if (*at == '"') {
+            in_string = 1;
+        } else if (*at == '{') {
+            if (depth++ == 0) start = at;
+        } else if (*at == '}' && --depth == 0) {
+            found = realloc(found, sizeof(char *) * (*count + 1));
+            found[*count] = strndup(start, at + 1 - start);
+            (*count)++;
+        }
+    }
+    qsort(found, *count, sizeof(char *), compare_strings);
+    return found;
+}
+
+static void free_diagnostics(char **found, int count) {
+    for (int i = 0; i < count; i++) free(found[i]);
+    free(found);
+}
+
+static char *read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    *length = fread(text, 1, size, file);
+    text[*length] = '\0';
+    fclose(file);
+    return text;
+}
+
+static void write_failure(const char *text, size_t length) {
+    FILE *file = fopen("lsp_fuzz_failure.creed", "wb");
+    if (!file) return;
+    fwrite(text, 1, length, file);
+    fclose(file);
+}
+
+// Edits the text at random the way the server is told to, then returns the reply to the last edit, or NULL if the
+// server died. Frees the old text and sets text and length to the edited one.
+static char *fuzz_edits(Server *server, char **text, size_t *length) {
+    char *reply = NULL;
+    int edits = 1 + random_below(8);
+    for (int e = 0; e < edits; e++) {
+        static const int spans[] = { 0, 0, 1, 2, 5, 20, 100 };
+        size_t start = random_below((int) *length + 1);
+        size_t end = start + spans[random_below(sizeof(spans) / sizeof(spans[0]))];
+        if (end > *length) end = *length;
+
+        // Mostly a few snippets, and sometimes a piece of the program moved somewhere else.
+        char insert[256] = "";
+        if (random_below(10) < 3) {
+            size_t from = random_below((int) *length + 1);
+            size_t count = random_below(200);
+            if (from + count > *length) count = *length - from;
+            memcpy(insert, *text + from, count);
+            insert[count] = '\0';
+        } else {
+            static const int counts[] = { 0, 1, 1, 2, 3 };
+            int count = counts[random_below(sizeof(counts) / sizeof(counts[0]))];
+            for (int i = 0; i < count; i++) strcat(insert, snippets[random_below(sizeof(snippets) / sizeof(snippets[0]))]);
+        }
+        size_t insert_length = strlen(insert);
+
+        int start_line, start_character, end_line, end_character;
+        position(*text, start, &start_line, &start_character);
+        position(*text, end, &end_line, &end_character);
+        char body[2048];
+        char *out = body + sprintf(body, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":{\"uri\":\"file:///fuzz.creed\",\"version\":%i},"
+            "\"contentChanges\":[{\"range\":{\"start\":{\"line\":%i,\"character\":%i},\"end\":{\"line\":%i,\"character\":%i}},\"text\":",
+            e + 2, start_line, start_character, end_line, end_character);
+        out = add_string(out, insert, insert_length);
+        strcpy(out, "}]}}");
+        send(server, body);
+
+        char *edited = malloc(*length - (end - start) + insert_length + 1);
+        memcpy(edited, *text, start);
+        memcpy(edited + start, insert, insert_length);
+        memcpy(edited + start + insert_length, *text + end, *length - end + 1);
+        *length = *length - (end - start) + insert_length;
+        free(*text);
+        *text = edited;
+
+        free(reply);
+        reply = receive(server);
+        if (!reply) return NULL;
+
+        int line, character;
+        position(*text, random_below((int) *length + 1), &line, &character);
+        snprintf(body, sizeof(body), "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"textDocument/definition\",\"params\":{\"textDocument\":{\"uri\":\"file:///fuzz.creed\"},"
+            "\"position\":{\"line\":%i,\"character\":%i}}}", line, character);
+        send(server, body);
+        char *definition = receive(server);
+        if (!definition) {
+            free(reply);
+            return NULL;
+        }
+        free(definition);
+    }
+    return reply;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <creed> <iterations> <seed> <program>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int iterations = atoi(argv[2]);
+    srand((unsigned) atoi(argv[3]));
+    char **programs = argv + 4;
+    int program_count = argc - 4;
+
+    int mismatches = 0;
+    for (int i = 0; i < iterations; i++) {
+        const char *path = programs[random_below(program_count)];
+        size_t length;
+        char *text = read_file(path, &length);
+        if (!text) {
+            fprintf(stderr, "Failed to open %s.\n", path);
+            return EXIT_FAILURE;
+        }
+
+        Server edited, fresh;
+        if (server_start(&edited, argv[1])) {
+            perror("Failed to start the server");
+            return EXIT_FAILURE;
+        }
+        free(open_document(&edited, text, length));
+        char *reply = fuzz_edits(&edited, &text, &length);
+        if (!server_stop(&edited) || !reply) {
+            fprintf(stderr, "Iteration %i: the server editing %s crashed or didn't exit cleanly.\n", i, path);
+            write_failure(text, length);
+            return EXIT_FAILURE;
+        }
+        if (server_start(&fresh, argv[1])) {
+            perror("Failed to start the server");
+            return EXIT_FAILURE;
+        }
+        char *expected = open_document(&fresh, text, length);
+        if (!server_stop(&fresh) || !expected) {
+            fprintf(stderr, "Iteration %i: the server opening the edited %s crashed or didn't exit cleanly.\n", i, path);
+            write_failure(text, length);
+            return EXIT_FAILURE;
+        }
+
+        int count, expected_count;
+        char **found = diagnostics(reply, &count);
+        char **wanted = diagnostics(expected, &expected_count);
+        int same = count == expected_count;
+        for (int d = 0; same && d < count; d++) same = !strcmp(found[d], wanted[d]);
+        if (!same) {
+            if (!mismatches) write_failure(text, length);
+            mismatches++;
+            fprintf(stderr, "Iteration %i: editing %s published %i diagnostics, and opening the result published %i.\n",
+                i, path, count, expected_count);
+        }
+        free_diagnostics(found, count);
+        free_diagnostics(wanted, expected_count);
+        free(reply);
+        free(expected);
+        free(text);
+    }
+    printf("%i iterations, %i mismatches.\n", iterations, mismatches);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
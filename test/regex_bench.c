@@ -0,0 +1,87 @@
+// Times the matchers compiled from test/regex_bench.creed against POSIX regcomp/regexec on generated log lines.
+// Built by make regex-bench, which compiles the creed file to file.c first.
+#define _POSIX_C_SOURCE 200809L
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_stats.h"
+
+#define main creed_main
+#include "../file.c"
+#undef main
+
+#define LINE_COUNT 200000
+#define ROUNDS 5
+
+typedef struct Pattern {
+    const char *name;
+    int (*matcher)(Array_char);
+    const char *posix; // The same pattern as an anchored POSIX extended regex.
+} Pattern;
+
+static const char *levels[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+static const char *paths[] = { "/api/v1/users", "/api/v2/orders/recent", "/static/app.js", "/api/v10/search_index", "/health" };
+
+int main(void) {
+    Pattern patterns[] = {
+        { "log_error", log_error, "^[0-9]{4}-[0-9][0-9]-[0-9][0-9] [0-9][0-9]:[0-9][0-9]:[0-9][0-9] (ERROR|FATAL) .*$" },
+        { "api_request", api_request, "^.*GET /api/v[0-9]+/[a-z_/]+ HTTP/1\\.[01].*$" },
+        { "ip_address", ip_address, "^.*[^0-9]([0-9]{1,3}\\.){3}[0-9]{1,3}([^0-9].*)?$" },
+    };
+    int pattern_count = sizeof(patterns) / sizeof(patterns[0]);
+
+    char (*lines)[160] = malloc(sizeof(*lines) * LINE_COUNT);
+    unsigned int seed = 12345;
+    for (int i = 0; i < LINE_COUNT; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 8;
+        snprintf(lines[i], sizeof(lines[i]), "2026-%02u-%02u %02u:%02u:%02u %s client %u.%u.%u.%u GET %s HTTP/1.%u took %ums",
+            r % 12 + 1, r % 28 + 1, r % 24, r % 60, (r >> 6) % 60, levels[(r >> 3) % 5], r % 256, (r >> 8) % 256, (r >> 4) % 256, (r >> 12) % 256,
+            paths[(r >> 5) % 5], (r >> 7) % 3, r % 1000);
+        // Some lines are damaged, so not every line matches.
+        if (r % 7 == 0) lines[i][r % 40] = '#';
+    }
+
+    int failed = 0;
+    printf("%-12s %8s %12s %12s %8s\n", "pattern", "matches", "dfa ns/line", "posix ns/line", "speedup");
+    for (int p = 0; p < pattern_count; p++) {
+        regex_t posix;
+        if (regcomp(&posix, patterns[p].posix, REG_EXTENDED | REG_NOSUB) != 0) {
+            fprintf(stderr, "Failed to compile %s with regcomp.\n", patterns[p].name);
+            return EXIT_FAILURE;
+        }
+        int matches = 0;
+        for (int i = 0; i < LINE_COUNT; i++) {
+            int dfa = patterns[p].matcher((Array_char) { strlen(lines[i]), lines[i] });
+            int expected = regexec(&posix, lines[i], 0, NULL, 0) == 0;
+            if (dfa != expected && failed++ < 10) fprintf(stderr, "%s: %s gives %i, regexec gives %i\n", patterns[p].name, lines[i], dfa, expected);
+            matches += dfa;
+        }
+
+        // Lengths are measured first, so both only pay for matching.
+        Array_char *texts = malloc(sizeof(Array_char) * LINE_COUNT);
+        for (int i = 0; i < LINE_COUNT; i++) texts[i] = (Array_char) { strlen(lines[i]), lines[i] };
+        volatile int sink = 0;
+        double start = seconds();
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int i = 0; i < LINE_COUNT; i++) sink += patterns[p].matcher(texts[i]);
+        }
+        double dfa_time = seconds() - start;
+        start = seconds();
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int i = 0; i < LINE_COUNT; i++) sink += regexec(&posix, lines[i], 0, NULL, 0) == 0;
+        }
+        double posix_time = seconds() - start;
+        (void) sink;
+
+        double per_line = 1e9 / ((double) LINE_COUNT * ROUNDS);
+        printf("%-12s %8i %12.1f %12.1f %7.1fx\n", patterns[p].name, matches, dfa_time * per_line, posix_time * per_line, posix_time / dfa_time);
+        free(texts);
+        regfree(&posix);
+    }
+    free(lines);
+    if (failed) fprintf(stderr, "%i lines matched differently.\n", failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
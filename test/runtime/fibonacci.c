@@ -0,0 +1,9 @@
+// The baseline for fibonacci.creed.
+static int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+    return fib(37) % 256;
+}
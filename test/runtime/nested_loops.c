@@ -0,0 +1,33 @@
+// The baseline for nested_loops.creed.
+#include <stdlib.h>
+
+static void multiply(const int *restrict a, const int *restrict b, int *restrict c, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < n; k++) {
+            int scale = a[i * n + k];
+            for (int j = 0; j < n; j++) c[i * n + j] += scale * b[k * n + j];
+        }
+    }
+}
+
+static int run(int n) {
+    int *a = malloc(n * n * sizeof(int));
+    int *b = malloc(n * n * sizeof(int));
+    int *c = malloc(n * n * sizeof(int));
+    for (int i = 0; i < n * n; i++) {
+        a[i] = i % 7;
+        b[i] = i % 5 + 1;
+        c[i] = 0;
+    }
+    multiply(a, b, c, n);
+    int total = 0;
+    for (int i = 0; i < n * n; i++) total += c[i];
+    free(a);
+    free(b);
+    free(c);
+    return total;
+}
+
+int main(void) {
+    return (run(400) % 251 + 251) % 251;
+}
@@ -0,0 +1,71 @@
+// Runs the program compiled from a Creed benchmark and its hand-written C baseline, after some warmup runs, and prints
+// the median and 95th percentile of their wall times. Built and run by make runtime-bench.
+// Usage: run <name> <runs> <warmup runs> <creed program> <baseline program>
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../bench_stats.h"
+
+// Returns the exit status of the program, or -1 if it couldn't be run or was killed.
+static int run_once(const char *program, double *elapsed) {
+    double start = seconds();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execl(program, program, (char *) NULL);
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    *elapsed = seconds() - start;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int measure(const char *program, int runs, int warmup, double *median, double *p95) {
+    double *times = malloc(sizeof(double) * runs);
+    double elapsed;
+    int status = 0;
+    for (int i = 0; i < warmup + runs; i++) {
+        int result = run_once(program, &elapsed);
+        if (result < 0 || (i > 0 && result != status)) {
+            free(times);
+            return -1;
+        }
+        status = result;
+        if (i >= warmup) times[i - warmup] = elapsed;
+    }
+    qsort(times, runs, sizeof(double), compare_doubles);
+    *median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    *p95 = percentile(times, runs, 95);
+    free(times);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 6) {
+        fprintf(stderr, "Usage: %s <name> <runs> <warmup runs> <creed program> <baseline program>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int runs = atoi(argv[2]);
+    int warmup = atoi(argv[3]);
+    if (runs < 1) runs = 1;
+    if (warmup < 0) warmup = 0;
+
+    double creed_median, creed_p95, c_median, c_p95;
+    int creed_status = measure(argv[4], runs, warmup, &creed_median, &creed_p95);
+    int c_status = measure(argv[5], runs, warmup, &c_median, &c_p95);
+    if (creed_status < 0 || c_status < 0) {
+        fprintf(stderr, "%s: %s failed or didn't exit the same way every run.\n", argv[1], creed_status < 0 ? argv[4] : argv[5]);
+        return EXIT_FAILURE;
+    }
+    if (creed_status != c_status) {
+        fprintf(stderr, "%s: the Creed program exited with %i, but the baseline with %i.\n", argv[1], creed_status, c_status);
+        return EXIT_FAILURE;
+    }
+    printf("%-14s %11.2f %11.2f %11.2f %11.2f %7.2fx\n", argv[1], creed_median * 1e3, creed_p95 * 1e3, c_median * 1e3, c_p95 * 1e3,
+        c_median > 0 ? creed_median / c_median : 0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compiles every test/runtime/<name>.creed with creed and cc -O2, and its baseline test/runtime/<name>.c with cc -O2,
+# then times both with test/runtime/run.c. Run by make runtime-bench. RUNS and WARMUP set how many times each runs.
+
+set -e
+
+cc="${CC:-cc}"
+runs="${RUNS:-11}"
+warmup="${WARMUP:-2}"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+"$cc" test/runtime/run.c -o "$work/run" -O2 -std=c99 -Wall -Werror
+
+printf "%-14s %11s %11s %11s %11s %8s\n" "benchmark" "creed ms" "creed p95" "C ms" "C p95" "ratio"
+for source in test/runtime/*.creed; do
+    name=$(basename "$source" .creed)
+    if ! ./creed "$source" > "$work/$name.out"; then
+        echo "$source did not compile:"
+        grep -a -A 1 "Error!" "$work/$name.out"
+        exit 1
+    fi
+    "$cc" file.c -o "$work/$name.creed" -O2 -std=c99 -w -lm -pthread
+    "$cc" "test/runtime/$name.c" -o "$work/$name.c" -O2 -std=c99 -Wall -Werror
+    "$work/run" "$name" "$runs" "$warmup" "$work/$name.creed" "$work/$name.c"
+done
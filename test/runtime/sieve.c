@@ -0,0 +1,23 @@
+// The baseline for sieve.creed.
+#include <stdbool.h>
+#include <stdlib.h>
+
+static int count_primes(int n) {
+    bool *composite = malloc(n * sizeof(bool));
+    for (int i = 0; i < n; i++) composite[i] = false;
+    int count = 0;
+    for (int i = 2; i < n; i++) {
+        if (!composite[i]) {
+            count++;
+            for (int j = i * 2; j < n; j += i) composite[j] = true;
+        }
+    }
+    free(composite);
+    return count;
+}
+
+int main(void) {
+    int total = 0;
+    for (int round = 0; round < 10; round++) total += count_primes(2000000 + round);
+    return total % 256;
+}
@@ -0,0 +1,34 @@
+// The baseline for strings.creed.
+#include <stdlib.h>
+#include <string.h>
+
+static void fill(char *text, int count) {
+    const char *words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over " };
+    int at = 0;
+    int w = 0;
+    while (at < count) {
+        const char *word = words[w % 6];
+        size_t length = strlen(word);
+        for (size_t i = 0; i < length && at < count; i++) text[at++] = word[i];
+        w += 7;
+    }
+}
+
+int main(void) {
+    int n = 20000000;
+    char *text = malloc(n);
+    fill(text, n);
+    int words = 0;
+    int vowels = 0;
+    unsigned hash = 2166136261u;
+    char previous = ' ';
+    for (int i = 0; i < n; i++) {
+        char c = text[i];
+        if (c != ' ' && previous == ' ') words++;
+        if (c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u') vowels++;
+        hash = (hash ^ (unsigned) c) * 16777619u;
+        previous = c;
+    }
+    free(text);
+    return (words + vowels + (int) (hash % 256u)) & 255;
+}
@@ -0,0 +1,36 @@
+// The baseline for structs.creed.
+#include <stdlib.h>
+
+typedef struct Body {
+    int x;
+    int y;
+    int dx;
+    int dy;
+    int mass;
+} Body;
+
+static void step(Body *bodies, int count) {
+    for (int i = 0; i < count; i++) {
+        bodies[i].dx += (0 - bodies[i].x) / (bodies[i].mass + 64);
+        bodies[i].dy += (0 - bodies[i].y) / (bodies[i].mass + 64);
+        bodies[i].x += bodies[i].dx;
+        bodies[i].y += bodies[i].dy;
+    }
+}
+
+int main(void) {
+    int n = 10000;
+    Body *bodies = malloc(n * sizeof(Body));
+    for (int i = 0; i < n; i++) {
+        bodies[i].x = i % 1000 - 500;
+        bodies[i].y = i % 777 - 388;
+        bodies[i].dx = 0;
+        bodies[i].dy = 0;
+        bodies[i].mass = i % 13 + 1;
+    }
+    for (int t = 0; t < 1000; t++) step(bodies, n);
+    int total = 0;
+    for (int i = 0; i < n; i++) total += bodies[i].x + bodies[i].y;
+    free(bodies);
+    return total & 255;
+}
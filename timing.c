@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "perf_counters.h"
+#include "timing.h"
+#include "trace.h"
+
+static const char *timing_phase_names[TIMING_PHASE_COUNT] = { "load", "lex", "parse", "print", "typecheck", "optimize", "emit" };
+
+static struct {
+    bool ran;
+    double wall;
+    double cpu;
+    double wall_start;
+    double cpu_start;
+    long max_rss; // The peak resident set size of the process in KiB when the phase last ended.
+} timing_phases[TIMING_PHASE_COUNT];
+
+static double timing_clock(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void timing_begin(TimingPhase phase) {
+    timing_phases[phase].wall_start = timing_clock(CLOCK_MONOTONIC);
+    timing_phases[phase].cpu_start = timing_clock(CLOCK_PROCESS_CPUTIME_ID);
+    perf_counters_begin(phase);
+    if (trace_enabled) trace_begin(timing_phase_names[phase], NULL);
+}
+
+void timing_end(TimingPhase phase) {
+    if (trace_enabled) trace_end(NULL);
+    perf_counters_end(phase);
+    timing_phases[phase].ran = true;
+    timing_phases[phase].wall += timing_clock(CLOCK_MONOTONIC) - timing_phases[phase].wall_start;
+    timing_phases[phase].cpu += timing_clock(CLOCK_PROCESS_CPUTIME_ID) - timing_phases[phase].cpu_start;
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) timing_phases[phase].max_rss = usage.ru_maxrss;
+}
+
+const char *timing_phase_name(TimingPhase phase) {
+    return timing_phase_names[phase];
+}
+
+unsigned long long timing_phase_count(TimingCounts *counts, TimingPhase phase, const char **unit) {
+    switch (phase) {
+        case TIMING_LOAD: *unit = "bytes"; return counts->bytes_read;
+        case TIMING_LEX: *unit = "tokens"; return counts->tokens;
+        case TIMING_PARSE: *unit = "nodes"; return counts->nodes;
+        case TIMING_EMIT: *unit = "bytes"; return counts->bytes_emitted;
+        default: *unit = ""; return 0;
+    }
+}
+
+void timing_report(TimingCounts *counts, FILE *outfile) {
+    double wall = 0, cpu = 0;
+    fprintf(outfile, "%-10s %12s %12s %7s %13s %20s\n", "phase", "wall ms", "cpu ms", "wall %", "peak rss MiB", "throughput");
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++) {
+        wall += timing_phases[i].wall;
+        cpu += timing_phases[i].cpu;
+    }
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++) {
+        if (!timing_phases[i].ran) continue;
+        fprintf(outfile, "%-10s %12.3f %12.3f %6.1f%% %13.1f", timing_phase_names[i], timing_phases[i].wall * 1e3, timing_phases[i].cpu * 1e3,
+            wall > 0 ? timing_phases[i].wall / wall * 100 : 0, timing_phases[i].max_rss / 1024.0);
+        const char *unit;
+        unsigned long long count = timing_phase_count(counts, i, &unit);
+        if (count > 0 && timing_phases[i].wall > 0) fprintf(outfile, " %12.0f %s/s", count / timing_phases[i].wall, unit);
+        fputc('\n', outfile);
+    }
+    fprintf(outfile, "%-10s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+    fprintf(outfile, "%llu bytes read, %llu tokens, %llu syntax tree nodes, %llu bytes emitted\n",
+        counts->bytes_read, counts->tokens, counts->nodes, counts->bytes_emitted);
+}
+
+void timing_report_json(TimingCounts *counts, FILE *outfile) {
+    fprintf(outfile, "{\n  \"phases\": [\n");
+    bool first = true;
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++) {
+        if (!timing_phases[i].ran) continue;
+        const char *unit;
+        unsigned long long count = timing_phase_count(counts, i, &unit);
+        fprintf(outfile, "%s    { \"name\": \"%s\", \"wall\": %.9f, \"cpu\": %.9f, \"max_rss_kb\": %ld", first ? "" : ",\n", timing_phase_names[i],
+            timing_phases[i].wall, timing_phases[i].cpu, timing_phases[i].max_rss);
+        if (count > 0) fprintf(outfile, ", \"%s_per_second\": %.1f", unit, timing_phases[i].wall > 0 ? count / timing_phases[i].wall : 0);
+        fprintf(outfile, " }");
+        first = false;
+    }
+    fprintf(outfile, "\n  ],\n  \"bytes_read\": %llu,\n  \"tokens\": %llu,\n  \"nodes\": %llu,\n  \"bytes_emitted\": %llu\n}\n",
+        counts->bytes_read, counts->tokens, counts->nodes, counts->bytes_emitted);
+}
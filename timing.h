@@ -0,0 +1,39 @@
+#ifndef CREED_TIMING_H
+#define CREED_TIMING_H
+
+#include <stdio.h>
+
+// The phases of a compile, in the order they run.
+typedef enum TimingPhase {
+    TIMING_LOAD, // Reading the source file.
+    TIMING_LEX, // Only with --time-report, a pass that just counts the tokens. The parser lexes them again as it goes.
+    TIMING_PARSE,
+    TIMING_PRINT, // Dumping the tokens or the syntax tree.
+    TIMING_TYPECHECK,
+    TIMING_OPTIMIZE, // Struct layout, the optimization passes, and escape analysis.
+    TIMING_EMIT, // Writing the C file.
+    TIMING_PHASE_COUNT
+} TimingPhase;
+
+typedef struct TimingCounts {
+    unsigned long long bytes_read;
+    unsigned long long tokens;
+    unsigned long long nodes;
+    unsigned long long bytes_emitted;
+} TimingCounts;
+
+// Phases are timed on the monotonic clock for wall time, and on the clock of the process for CPU time.
+// A phase that is timed more than once adds up. The peak resident set size is sampled as each phase ends.
+void timing_begin(TimingPhase phase);
+void timing_end(TimingPhase phase);
+
+const char *timing_phase_name(TimingPhase phase);
+// The count a phase is measured in, like the tokens of the lex phase, or 0 for phases that aren't.
+unsigned long long timing_phase_count(TimingCounts *counts, TimingPhase phase, const char **unit);
+
+// A table of the time of every phase that ran and the throughput of the ones that are counted.
+void timing_report(TimingCounts *counts, FILE *outfile);
+// The same as one JSON object, with times in seconds.
+void timing_report_json(TimingCounts *counts, FILE *outfile);
+
+#endif
@@ -126,7 +126,11 @@ typedef enum TokenType {
     TOKEN_KEYWORD_LABEL,
     TOKEN_KEYWORD_RETURN,
     TOKEN_KEYWORD_IMPORT,
-    TOKEN_KEYWORD_MAX = TOKEN_KEYWORD_IMPORT,
+    TOKEN_KEYWORD_INLINE,
+    TOKEN_KEYWORD_EXPORT,
+    TOKEN_KEYWORD_SOA,
+    TOKEN_KEYWORD_PARALLEL,
+    TOKEN_KEYWORD_MAX = TOKEN_KEYWORD_PARALLEL,
 
     TOKEN_ID,
     TOKEN_LITERAL,
@@ -144,10 +148,10 @@ typedef enum TokenType {
     TOKEN_ERROR_MAX = TOKEN_ERROR_CHARACTER_UNKNOWN
 } TokenType;
 
-char *string_operators[TOKEN_OP_MAX - TOKEN_OP_MIN + 1];
-int operator_precedences[TOKEN_OP_MAX - TOKEN_OP_MIN + 1];
-char *string_keywords[TOKEN_KEYWORD_MAX - TOKEN_KEYWORD_MIN + 1];
-char *string_assigns[TOKEN_ASSIGN_MAX - TOKEN_ASSIGN_MIN + 1];
+extern char *string_operators[TOKEN_OP_MAX - TOKEN_OP_MIN + 1];
+extern int operator_precedences[TOKEN_OP_MAX - TOKEN_OP_MIN + 1];
+extern char *string_keywords[TOKEN_KEYWORD_MAX - TOKEN_KEYWORD_MIN + 1];
+extern char *string_assigns[TOKEN_ASSIGN_MAX - TOKEN_ASSIGN_MIN + 1];
 
 typedef union TokenData {
     Literal literal;
@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+
+#include "allocator.h"
+#include "trace.h"
+
+bool trace_enabled = false;
+
+static FILE *trace_file;
+static double trace_start;
+
+static double trace_microseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3 - trace_start;
+}
+
+static void trace_string(const char *string) {
+    fputc('"', trace_file);
+    for (; *string; string++) {
+        if (*string == '"' || *string == '\\') fprintf(trace_file, "\\%c", *string);
+        else if ((unsigned char) *string < 0x20) fprintf(trace_file, "\\u%04x", *string);
+        else fputc(*string, trace_file);
+    }
+    fputc('"', trace_file);
+}
+
+// Writes the start of an event on process 1 and thread 1, for the caller to finish.
+// Every event is followed by a comma, which the array format allows after the last one.
+static void trace_event(const char *name, char phase) {
+    fputc('{', trace_file);
+    if (name) {
+        fprintf(trace_file, "\"name\":");
+        trace_string(name);
+        fputc(',', trace_file);
+    }
+    fprintf(trace_file, "\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1", phase, trace_microseconds());
+}
+
+bool trace_open(const char *path) {
+    trace_file = fopen(path, "w");
+    if (!trace_file) return false;
+    trace_enabled = true;
+    trace_start = 0;
+    trace_start = trace_microseconds();
+    fprintf(trace_file, "[\n");
+    fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"compiler\"}},\n");
+    return true;
+}
+
+void trace_close(void) {
+    if (!trace_file) return;
+    fclose(trace_file);
+    trace_file = NULL;
+    trace_enabled = false;
+}
+
+static void trace_declaration(const char *declaration) {
+    if (declaration) {
+        fprintf(trace_file, ",\"args\":{\"declaration\":");
+        trace_string(declaration);
+        fputc('}', trace_file);
+    }
+    fprintf(trace_file, "},\n");
+}
+
+void trace_begin(const char *name, const char *declaration) {
+    trace_event(name, 'B');
+    trace_declaration(declaration);
+}
+
+// Each span that ends also samples the live bytes of every allocator tag, so memory growth lines up with the spans.
+void trace_end(const char *declaration) {
+    trace_event(NULL, 'E');
+    trace_declaration(declaration);
+    trace_event("live bytes", 'C');
+    fprintf(trace_file, ",\"args\":{");
+    for (int i = 0; i < ALLOCATOR_TAG_COUNT; i++) {
+        fprintf(trace_file, "%s\"%s\":%llu", i ? "," : "", allocator_tag_name(i), allocator_live_bytes(i));
+    }
+    fprintf(trace_file, "}},\n");
+}
+
+void trace_counter(const char *name, const char *series, unsigned long long value) {
+    trace_event(name, 'C');
+    fprintf(trace_file, ",\"args\":{");
+    trace_string(series);
+    fprintf(trace_file, ":%llu}},\n", value);
+}
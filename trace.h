@@ -0,0 +1,22 @@
+#ifndef CREED_TRACE_H
+#define CREED_TRACE_H
+
+#include <stdbool.h>
+
+// Trace events in the Chrome JSON array format, which chrome://tracing and Perfetto open.
+// Callers check trace_enabled before calling anything else here, so a compile without --trace only pays for that branch.
+extern bool trace_enabled;
+
+// The array is never closed, which the format allows, so a trace is still readable when the compile stops at an error.
+bool trace_open(const char *path);
+void trace_close(void);
+
+// Spans nest on the thread that starts them. The compiler has one thread for now, so every span is on the same lane.
+// A span can be given the name of the declaration it is for, at either end, since the parser only knows it at the end.
+void trace_begin(const char *name, const char *declaration);
+void trace_end(const char *declaration);
+
+// A counter event, drawn as a graph over time.
+void trace_counter(const char *name, const char *series, unsigned long long value);
+
+#endif